@@ -0,0 +1,395 @@
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <dirent.h>
+    #include <sys/stat.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "archive_source.h"
+#include "logger.h"
+
+#define ARCHIVE_PATH_MAX 1024
+#define ARCHIVE_PROBE_SIZE 128     /* Smallest record length, holds blockette 1000 */
+#define SDS_DAY_MARGIN 3600.0      /* Records may straddle the day boundary */
+
+typedef struct {
+    char *path;
+    double first_time;
+} ArchiveFile;
+
+/* Open file with its next record buffered */
+typedef struct {
+    FILE *fp;
+    int file_index;
+    ArchiveRecord rec;
+} ArchiveCursor;
+
+struct ArchiveSource {
+    ArchiveFile *files;
+    size_t file_count;
+    size_t file_capacity;
+    size_t next_file;           /* First file not opened yet */
+    ArchiveCursor **heap;       /* Min-heap on rec.hdr.start_time */
+    size_t heap_count;
+    size_t heap_capacity;
+    double start_time;
+    double end_time;
+    ArchiveSourceStats stats;
+};
+
+/* Days since 1970-01-01 for a proleptic Gregorian date */
+static long days_from_civil(int year, int month, int day) {
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yoe = year - era * 400;
+    long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+int archive_parse_time(const char *text, double *epoch) {
+    int year, month, day, hour = 0, min = 0;
+    double sec = 0.0;
+    int fields = sscanf(text, "%d-%d-%d%*1[T ]%d:%d:%lf", &year, &month, &day,
+                        &hour, &min, &sec);
+
+    if (fields != 3 && fields != 6)
+        return -1;
+    if (month < 1 || month > 12 || day < 1 || day > 31 ||
+        hour < 0 || hour > 23 || min < 0 || min > 59 || sec < 0.0 || sec >= 61.0)
+        return -1;
+
+    *epoch = (double)days_from_civil(year, month, day) * 86400.0 +
+             hour * 3600.0 + min * 60.0 + sec;
+    return 0;
+}
+
+/*
+ * SDS day files are NET.STA.LOC.CHA.TYPE.YEAR.DOY; skip those whose day
+ * is clearly outside the window without opening them.
+ */
+static int sds_day_outside(const ArchiveSource *src, const char *name) {
+    const char *doy_dot = strrchr(name, '.');
+    const char *year_dot;
+    int year, doy;
+    double day_start;
+
+    if (src->start_time <= 0.0 && src->end_time <= 0.0)
+        return 0;
+    if (doy_dot == NULL || doy_dot == name)
+        return 0;
+    for (year_dot = doy_dot - 1; year_dot > name && *year_dot != '.'; year_dot--)
+        ;
+    if (*year_dot != '.' || doy_dot - year_dot != 5 || strlen(doy_dot + 1) != 3)
+        return 0;
+    if (sscanf(year_dot + 1, "%4d", &year) != 1 || sscanf(doy_dot + 1, "%3d", &doy) != 1 ||
+        doy < 1 || doy > 366)
+        return 0;
+
+    day_start = mseed_days_from_year_doy(year, doy) * 86400.0;
+    if (src->start_time > 0.0 && day_start + 86400.0 + SDS_DAY_MARGIN < src->start_time)
+        return 1;
+    if (src->end_time > 0.0 && day_start - SDS_DAY_MARGIN > src->end_time)
+        return 1;
+    return 0;
+}
+
+/*
+ * Read the next record that overlaps the window into rec.
+ * Returns 1 on success, 0 at end of file or on data that is not miniSEED.
+ */
+static int read_record(ArchiveSource *src, FILE *fp, const char *path, ArchiveRecord *rec) {
+    for (;;) {
+        size_t n = fread(rec->data, 1, ARCHIVE_PROBE_SIZE, fp);
+
+        if (n == 0)
+            return 0;
+        if (n < ARCHIVE_PROBE_SIZE ||
+            mseed_parse_header(rec->data, ARCHIVE_PROBE_SIZE, &rec->hdr) < 0) {
+            LOG_WARN(LOG_CAT_RINGCLIENT, "Replay: stopping at non-miniSEED data in %s", path);
+            return 0;
+        }
+
+        /* The probe already read past a shorter record; the stream is out of step */
+        if (rec->hdr.record_length < ARCHIVE_PROBE_SIZE) {
+            LOG_WARN(LOG_CAT_RINGCLIENT, "Replay: stopping at %d-byte record in %s",
+                     rec->hdr.record_length, path);
+            return 0;
+        }
+        if (rec->hdr.record_length > ARCHIVE_MAX_RECORD) {
+            src->stats.skipped++;
+            if (fseek(fp, rec->hdr.record_length - ARCHIVE_PROBE_SIZE, SEEK_CUR) != 0)
+                return 0;
+            continue;
+        }
+        if (rec->hdr.record_length > ARCHIVE_PROBE_SIZE &&
+            fread(rec->data + ARCHIVE_PROBE_SIZE, 1,
+                  rec->hdr.record_length - ARCHIVE_PROBE_SIZE, fp) !=
+            (size_t)(rec->hdr.record_length - ARCHIVE_PROBE_SIZE))
+            return 0;
+
+        if ((src->start_time > 0.0 && rec->hdr.end_time < src->start_time) ||
+            (src->end_time > 0.0 && rec->hdr.start_time > src->end_time)) {
+            src->stats.skipped++;
+            continue;
+        }
+
+        rec->length = (uint32_t)rec->hdr.record_length;
+        snprintf(rec->stationid, sizeof(rec->stationid), "%s_%s",
+                 rec->hdr.network, rec->hdr.station);
+        return 1;
+    }
+}
+
+static void add_file(ArchiveSource *src, const char *path, const char *name) {
+    ArchiveRecord *probe;
+    FILE *fp;
+    int found;
+
+    if (sds_day_outside(src, name))
+        return;
+
+    fp = fopen(path, "rb");
+    if (fp == NULL)
+        return;
+    probe = (ArchiveRecord*)malloc(sizeof(ArchiveRecord));
+    if (probe == NULL) {
+        fclose(fp);
+        return;
+    }
+    found = read_record(src, fp, path, probe);
+    fclose(fp);
+
+    if (found) {
+        if (src->file_count >= src->file_capacity) {
+            size_t capacity = src->file_capacity ? src->file_capacity * 2 : 64;
+            ArchiveFile *grown = (ArchiveFile*)realloc(src->files, capacity * sizeof(ArchiveFile));
+            if (grown == NULL) {
+                free(probe);
+                return;
+            }
+            src->files = grown;
+            src->file_capacity = capacity;
+        }
+        src->files[src->file_count].path = strdup(path);
+        src->files[src->file_count].first_time = probe->hdr.start_time;
+        if (src->files[src->file_count].path != NULL)
+            src->file_count++;
+    }
+    free(probe);
+}
+
+static void scan_path(ArchiveSource *src, const char *path, int depth) {
+    char child[ARCHIVE_PATH_MAX];
+
+    if (depth > 16)
+        return;
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA fd;
+    HANDLE h;
+    DWORD attrs = GetFileAttributesA(path);
+
+    if (attrs == INVALID_FILE_ATTRIBUTES)
+        return;
+    if (!(attrs & FILE_ATTRIBUTE_DIRECTORY)) {
+        const char *name = strrchr(path, '\\');
+        add_file(src, path, name ? name + 1 : path);
+        return;
+    }
+
+    snprintf(child, sizeof(child), "%s\\*", path);
+    h = FindFirstFileA(child, &fd);
+    if (h == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        if (fd.cFileName[0] == '.')
+            continue;
+        snprintf(child, sizeof(child), "%s\\%s", path, fd.cFileName);
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            scan_path(src, child, depth + 1);
+        else
+            add_file(src, child, fd.cFileName);
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+#else
+    struct stat st;
+    struct dirent *entry;
+    DIR *dir;
+
+    if (stat(path, &st) != 0)
+        return;
+    if (!S_ISDIR(st.st_mode)) {
+        const char *name = strrchr(path, '/');
+        if (S_ISREG(st.st_mode))
+            add_file(src, path, name ? name + 1 : path);
+        return;
+    }
+
+    dir = opendir(path);
+    if (dir == NULL)
+        return;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        if (stat(child, &st) != 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+            scan_path(src, child, depth + 1);
+        else if (S_ISREG(st.st_mode))
+            add_file(src, child, entry->d_name);
+    }
+    closedir(dir);
+#endif
+}
+
+static int compare_files(const void *a, const void *b) {
+    double ta = ((const ArchiveFile*)a)->first_time;
+    double tb = ((const ArchiveFile*)b)->first_time;
+    return (ta > tb) - (ta < tb);
+}
+
+static int cursor_before(const ArchiveCursor *a, const ArchiveCursor *b) {
+    if (a->rec.hdr.start_time != b->rec.hdr.start_time)
+        return a->rec.hdr.start_time < b->rec.hdr.start_time;
+    return a->file_index < b->file_index;
+}
+
+static void heap_sift_down(ArchiveSource *src, size_t i) {
+    for (;;) {
+        size_t left = 2 * i + 1, right = left + 1, smallest = i;
+        ArchiveCursor *tmp;
+
+        if (left < src->heap_count && cursor_before(src->heap[left], src->heap[smallest]))
+            smallest = left;
+        if (right < src->heap_count && cursor_before(src->heap[right], src->heap[smallest]))
+            smallest = right;
+        if (smallest == i)
+            return;
+        tmp = src->heap[i];
+        src->heap[i] = src->heap[smallest];
+        src->heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+static int heap_push(ArchiveSource *src, ArchiveCursor *cursor) {
+    size_t i;
+
+    if (src->heap_count >= src->heap_capacity) {
+        size_t capacity = src->heap_capacity ? src->heap_capacity * 2 : 64;
+        ArchiveCursor **grown = (ArchiveCursor**)realloc(src->heap,
+                                                         capacity * sizeof(ArchiveCursor*));
+        if (grown == NULL)
+            return -1;
+        src->heap = grown;
+        src->heap_capacity = capacity;
+    }
+
+    i = src->heap_count++;
+    src->heap[i] = cursor;
+    while (i > 0 && cursor_before(src->heap[i], src->heap[(i - 1) / 2])) {
+        ArchiveCursor *tmp = src->heap[i];
+        src->heap[i] = src->heap[(i - 1) / 2];
+        src->heap[(i - 1) / 2] = tmp;
+        i = (i - 1) / 2;
+    }
+    return 0;
+}
+
+static void close_cursor(ArchiveCursor *cursor) {
+    if (cursor->fp)
+        fclose(cursor->fp);
+    free(cursor);
+}
+
+/* Open the next indexed file and queue its first record */
+static void open_next_file(ArchiveSource *src) {
+    int index = (int)src->next_file++;
+    ArchiveCursor *cursor = (ArchiveCursor*)calloc(1, sizeof(ArchiveCursor));
+
+    if (cursor == NULL)
+        return;
+    cursor->file_index = index;
+    cursor->fp = fopen(src->files[index].path, "rb");
+    if (cursor->fp == NULL) {
+        LOG_WARN(LOG_CAT_RINGCLIENT, "Replay: cannot open %s", src->files[index].path);
+        close_cursor(cursor);
+        return;
+    }
+    if (!read_record(src, cursor->fp, src->files[index].path, &cursor->rec) ||
+        heap_push(src, cursor) < 0)
+        close_cursor(cursor);
+}
+
+ArchiveSource* archive_source_open(const char *path, double start_time, double end_time) {
+    ArchiveSource *src = (ArchiveSource*)calloc(1, sizeof(ArchiveSource));
+
+    if (src == NULL)
+        return NULL;
+    src->start_time = start_time;
+    src->end_time = end_time;
+
+    scan_path(src, path, 0);
+    if (src->file_count == 0) {
+        LOG_ERROR(LOG_CAT_RINGCLIENT, "Replay: no miniSEED data found in %s", path);
+        archive_source_close(src);
+        return NULL;
+    }
+
+    qsort(src->files, src->file_count, sizeof(ArchiveFile), compare_files);
+    src->stats.files = (unsigned long)src->file_count;
+    src->stats.first_time = src->files[0].first_time;
+    /* Skips counted while indexing would be counted again on replay */
+    src->stats.skipped = 0;
+    return src;
+}
+
+int archive_source_next(ArchiveSource *src, ArchiveRecord *rec) {
+    ArchiveCursor *top;
+
+    /* Open every file that starts before the earliest queued record */
+    while (src->next_file < src->file_count &&
+           (src->heap_count == 0 ||
+            src->files[src->next_file].first_time <= src->heap[0]->rec.hdr.start_time))
+        open_next_file(src);
+
+    if (src->heap_count == 0)
+        return 0;
+
+    top = src->heap[0];
+    memcpy(rec, &top->rec, sizeof(ArchiveRecord));
+    src->stats.records++;
+
+    if (read_record(src, top->fp, src->files[top->file_index].path, &top->rec)) {
+        heap_sift_down(src, 0);
+    } else {
+        src->heap[0] = src->heap[--src->heap_count];
+        heap_sift_down(src, 0);
+        close_cursor(top);
+    }
+    return 1;
+}
+
+void archive_source_get_stats(const ArchiveSource *src, ArchiveSourceStats *stats) {
+    *stats = src->stats;
+}
+
+void archive_source_close(ArchiveSource *src) {
+    size_t i;
+
+    if (src == NULL)
+        return;
+    for (i = 0; i < src->heap_count; i++)
+        close_cursor(src->heap[i]);
+    for (i = 0; i < src->file_count; i++)
+        free(src->files[i].path);
+    free(src->heap);
+    free(src->files);
+    free(src);
+}
@@ -0,0 +1,53 @@
+#ifndef ARCHIVE_SOURCE_H
+#define ARCHIVE_SOURCE_H
+
+/*
+ * Time-ordered reader over a directory of miniSEED files (an SDS archive
+ * or any tree of record files), used to replay past data through the
+ * ringclient instead of a SeedLink connection.
+ *
+ * Files are indexed by their first record and opened only when the merge
+ * reaches that time, so the open file count is the number of files that
+ * overlap in time (about one per channel for SDS day files). Records are
+ * assumed to be time-ordered within each file.
+ */
+
+#include <stdint.h>
+#include "mseed_util.h"
+
+#define ARCHIVE_MAX_RECORD 8192
+
+typedef struct {
+    char data[ARCHIVE_MAX_RECORD];
+    uint32_t length;
+    MSeedHeader hdr;
+    char stationid[16];         /* NET_STA, as libslink reports it */
+} ArchiveRecord;
+
+typedef struct {
+    unsigned long files;        /* miniSEED files selected for the replay */
+    unsigned long long records; /* Records returned so far */
+    unsigned long long skipped; /* Outside the window, oversized or unreadable */
+    double first_time;          /* Start time of the earliest selected record */
+} ArchiveSourceStats;
+
+typedef struct ArchiveSource ArchiveSource;
+
+/*
+ * Index path (a directory, searched recursively, or a single file).
+ * Records ending before start_time or starting after end_time are skipped;
+ * pass 0 for an open bound. NULL if nothing readable was found.
+ */
+ArchiveSource* archive_source_open(const char *path, double start_time, double end_time);
+
+/* Next record in start time order; 1 on success, 0 at the end */
+int archive_source_next(ArchiveSource *src, ArchiveRecord *rec);
+
+void archive_source_get_stats(const ArchiveSource *src, ArchiveSourceStats *stats);
+
+void archive_source_close(ArchiveSource *src);
+
+/* Parse "YYYY-MM-DD[THH:MM:SS]" (UTC) into epoch seconds; 0 on success */
+int archive_parse_time(const char *text, double *epoch);
+
+#endif /* ARCHIVE_SOURCE_H */
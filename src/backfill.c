@@ -0,0 +1,467 @@
+#include "backfill.h"
+#include "ringclient.h"
+#include "netutil.h"
+#include "platform.h"
+#include "metrics.h"
+#include "logger.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define BACKFILL_MAX_JOBS 1024
+#define BACKFILL_TIMEOUT_MS 30000           /* Longest silence from the server */
+#define BACKFILL_MAX_RESPONSE (64 * 1024 * 1024)
+#define BACKFILL_RETRY_SEC 60.0             /* First retry wait, doubled per attempt */
+#define BACKFILL_RETRY_MAX_SEC 3600.0
+#define BACKFILL_BATCH_RECORDS 5000         /* Records per ringclient_backfill() call */
+
+typedef struct {
+    RingGap gap;
+    int attempts;
+    double next_try;                        /* Data clock */
+    int running;
+    int seen;                               /* Still reported by the last scan */
+} BackfillJob;
+
+static BackfillConfig g_config;
+static char g_address[300];                 /* host:port for net_connect() */
+static char g_host[256];
+static char g_path[512];
+
+static BackfillJob *g_jobs = NULL;
+static int g_job_count = 0;
+static RingGap *g_gaps = NULL;              /* Scan buffer, BACKFILL_MAX_JOBS */
+static long long g_last_scan_us = 0;
+
+static PlatformMutex g_lock;
+static PlatformCond g_cond;
+static PlatformThread g_threads[BACKFILL_MAX_CONNECTIONS];
+static int g_thread_count = 0;
+static volatile int g_running = 0;
+static int g_started = 0;
+
+static MetricCounter *g_requests_metric = NULL;
+static MetricCounter *g_failed_metric = NULL;
+static MetricCounter *g_records_metric = NULL;
+static MetricCounter *g_skipped_metric = NULL;
+static MetricGauge *g_jobs_metric = NULL;
+static MetricHistogram *g_request_metric = NULL;
+
+/* http://host[:port]/path into host:port, host and path; -1 if not http */
+static int parse_url(const char *url) {
+    const char *host = url + 7;
+    const char *slash;
+    const char *colon;
+    size_t host_len;
+
+    if (strncmp(url, "http://", 7) != 0)
+        return -1;
+    slash = strchr(host, '/');
+    if (slash == NULL)
+        slash = host + strlen(host);
+    host_len = (size_t)(slash - host);
+    if (host_len == 0 || host_len >= sizeof(g_host))
+        return -1;
+
+    memcpy(g_host, host, host_len);
+    g_host[host_len] = '\0';
+    colon = memchr(host, ':', host_len);
+    if (colon != NULL)
+        snprintf(g_address, sizeof(g_address), "%s", g_host);
+    else
+        snprintf(g_address, sizeof(g_address), "%s:80", g_host);
+    snprintf(g_path, sizeof(g_path), "%s", *slash ? slash : "/fdsnws/dataselect/1/query");
+    return 0;
+}
+
+/* Read the whole response into *data; its length, or -1 on error or timeout */
+static long read_response(NetSocket sock, char **data) {
+    char *buf = NULL;
+    size_t used = 0;
+    size_t cap = 0;
+    int idle_ms = 0;
+
+    while (g_running) {
+        long n;
+        int ready = net_wait_readable(sock, 1000);
+
+        if (ready < 0)
+            break;
+        if (ready == 0) {
+            idle_ms += 1000;
+            if (idle_ms >= BACKFILL_TIMEOUT_MS)
+                break;
+            continue;
+        }
+        idle_ms = 0;
+
+        if (cap - used < 65536) {
+            size_t grown_cap = cap ? cap * 2 : 262144;
+            char *grown;
+
+            if (grown_cap > BACKFILL_MAX_RESPONSE)
+                break;
+            grown = (char*)realloc(buf, grown_cap);
+            if (grown == NULL)
+                break;
+            buf = grown;
+            cap = grown_cap;
+        }
+
+        n = net_recv(sock, buf + used, cap - used);
+        if (n < 0)
+            break;
+        if (n == 0) {
+            *data = buf;
+            return (long)used;
+        }
+        used += (size_t)n;
+    }
+
+    free(buf);
+    return -1;
+}
+
+/*
+ * Keep the 512-byte records of the gap's channel from a dataselect body,
+ * packed at its start; returns how many
+ */
+static int extract_records(const RingGap *gap, const char *network, const char *station,
+                           char *body, size_t len) {
+    size_t offset = 0;
+    int kept = 0;
+
+    while (offset + MSEED_FIXED_HEADER_SIZE <= len) {
+        MSeedHeader hdr;
+
+        if (mseed_parse_header(body + offset, len - offset, &hdr) < 0 ||
+            hdr.record_length < MSEED_FIXED_HEADER_SIZE ||
+            offset + (size_t)hdr.record_length > len)
+            break;
+
+        if (hdr.record_length == MSEED_RECORD_SIZE &&
+            strcmp(hdr.network, network) == 0 && strcmp(hdr.station, station) == 0 &&
+            strcmp(hdr.location, gap->location) == 0 && strcmp(hdr.channel, gap->channel) == 0) {
+            memmove(body + (size_t)kept * MSEED_RECORD_SIZE, body + offset, MSEED_RECORD_SIZE);
+            kept++;
+        } else {
+            metrics_counter_add(g_skipped_metric, 1);
+        }
+        offset += (size_t)hdr.record_length;
+    }
+    return kept;
+}
+
+/* Hand records to the receive thread, waiting while its queue is full */
+static int queue_records(const char *streamid, const char *records, int count) {
+    int idle_ms = 0;
+
+    while (count > 0 && g_running) {
+        int n = count < BACKFILL_BATCH_RECORDS ? count : BACKFILL_BATCH_RECORDS;
+
+        if (ringclient_backfill(streamid, records, n) < 0) {
+            if (idle_ms >= BACKFILL_TIMEOUT_MS)
+                return -1;
+            platform_sleep_ms(200);
+            idle_ms += 200;
+            continue;
+        }
+        idle_ms = 0;
+        records += (size_t)n * MSEED_RECORD_SIZE;
+        count -= n;
+    }
+    return count == 0 ? 0 : -1;
+}
+
+/* Request one gap; records queued, 0 if the server has none, -1 on error */
+static int fetch_gap(const RingGap *gap) {
+    char network[8];
+    char station[8];
+    char start[MSEED_TIME_STRING_SIZE];
+    char end[MSEED_TIME_STRING_SIZE];
+    char request[1024];
+    char *response = NULL;
+    char *body;
+    const char *sep;
+    long long start_us = platform_monotonic_us();
+    NetSocket sock;
+    long len;
+    int status = 0;
+    int count;
+
+    sep = strchr(gap->streamid, '_');
+    if (sep == NULL || sep - gap->streamid >= (long)sizeof(network))
+        return -1;
+    memcpy(network, gap->streamid, (size_t)(sep - gap->streamid));
+    network[sep - gap->streamid] = '\0';
+    snprintf(station, sizeof(station), "%s", sep + 1);
+
+    mseed_format_time(gap->start, start, sizeof(start));
+    mseed_format_time(gap->end, end, sizeof(end));
+    snprintf(request, sizeof(request),
+             "GET %s%cnet=%s&sta=%s&loc=%s&cha=%s&start=%s&end=%s HTTP/1.0\r\n"
+             "Host: %s\r\nUser-Agent: ringclient-backfill\r\n\r\n",
+             g_path, strchr(g_path, '?') ? '&' : '?', network, station,
+             gap->location[0] ? gap->location : "--", gap->channel, start, end, g_host);
+
+    metrics_counter_add(g_requests_metric, 1);
+    sock = net_connect(g_address);
+    if (sock == NET_INVALID_SOCKET) {
+        LOG_WARN(LOG_CAT_BACKFILL, "Cannot connect to %s", g_address);
+        return -1;
+    }
+    net_set_send_timeout(sock, BACKFILL_TIMEOUT_MS);
+    if (net_send_all(sock, request, strlen(request)) < 0) {
+        net_close(sock);
+        return -1;
+    }
+    len = read_response(sock, &response);
+    net_close(sock);
+    metrics_histogram_record(g_request_metric, platform_monotonic_us() - start_us);
+    if (len < 0)
+        return -1;
+
+    /* Status line "HTTP/1.x NNN ...", then headers up to a blank line */
+    if (len > 12 && strncmp(response, "HTTP/", 5) == 0 && memchr(response, ' ', 12) != NULL)
+        status = atoi((const char*)memchr(response, ' ', 12) + 1);
+    body = NULL;
+    if (status == 200) {
+        long i;
+
+        for (i = 0; i + 3 < len; i++) {
+            if (memcmp(response + i, "\r\n\r\n", 4) == 0) {
+                body = response + i + 4;
+                break;
+            }
+        }
+    }
+    if (status == 204 || status == 404) {
+        free(response);
+        return 0;
+    }
+    if (body == NULL) {
+        LOG_WARN(LOG_CAT_BACKFILL, "%s %s.%s: HTTP status %d", gap->streamid,
+                 gap->location, gap->channel, status);
+        free(response);
+        return -1;
+    }
+
+    count = extract_records(gap, network, station, body, (size_t)(response + len - body));
+    if (count > 0 && queue_records(gap->streamid, body, count) < 0)
+        count = -1;
+    free(response);
+
+    if (count > 0) {
+        metrics_counter_add(g_records_metric, (unsigned long long)count);
+        LOG_INFO(LOG_CAT_BACKFILL, "%s %s.%s %s - %s: %d records", gap->streamid,
+                 gap->location, gap->channel, start, end, count);
+    }
+    return count;
+}
+
+/*
+ * A gap is identified by its channel and end. Its start moves: gaps are
+ * clamped to the ring buffer cutoff, and a partial fill extends the data
+ * before it.
+ */
+static int same_gap(const RingGap *a, const RingGap *b) {
+    return a->end == b->end &&
+           strcmp(a->streamid, b->streamid) == 0 && strcmp(a->channel, b->channel) == 0 &&
+           strcmp(a->location, b->location) == 0;
+}
+
+/* Match the current gaps against the jobs; called with g_lock held */
+static void scan_gaps(void) {
+    int count = ringclient_gaps(g_gaps, BACKFILL_MAX_JOBS);
+    int i, j;
+
+    if (count > BACKFILL_MAX_JOBS)
+        count = BACKFILL_MAX_JOBS;
+    for (j = 0; j < g_job_count; j++)
+        g_jobs[j].seen = 0;
+
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < g_job_count; j++) {
+            if (same_gap(&g_jobs[j].gap, &g_gaps[i]))
+                break;
+        }
+        if (j < g_job_count) {
+            g_jobs[j].seen = 1;
+            if (!g_jobs[j].running)
+                g_jobs[j].gap.start = g_gaps[i].start;
+        } else if (g_job_count < BACKFILL_MAX_JOBS) {
+            BackfillJob *job = &g_jobs[g_job_count++];
+
+            memset(job, 0, sizeof(*job));
+            job->gap = g_gaps[i];
+            job->seen = 1;
+        }
+    }
+
+    /* Filled or aged out; a request in flight keeps its job until it ends */
+    for (j = 0; j < g_job_count; ) {
+        if (!g_jobs[j].seen && !g_jobs[j].running)
+            g_jobs[j] = g_jobs[--g_job_count];
+        else
+            j++;
+    }
+    metrics_gauge_set(g_jobs_metric, (double)g_job_count);
+}
+
+/* Oldest gap that is due; -1 if none. Called with g_lock held */
+static int next_job(double now) {
+    int next = -1;
+    int i;
+
+    for (i = 0; i < g_job_count; i++) {
+        const BackfillJob *job = &g_jobs[i];
+
+        if (job->running || job->attempts >= g_config.retries || job->next_try > now ||
+            job->gap.end > now - g_config.delay)
+            continue;
+        if (next < 0 || job->gap.start < g_jobs[next].gap.start)
+            next = i;
+    }
+    return next;
+}
+
+static PLATFORM_THREAD_FUNC(backfill_thread_func) {
+    (void)arg;
+
+    trace_set_thread_name("backfill");
+
+    platform_mutex_lock(&g_lock);
+    while (g_running) {
+        long long now_us = platform_monotonic_us();
+        double now = ringclient_clock();
+        int next;
+
+        if (now_us - g_last_scan_us >= (long long)g_config.interval * 1000000) {
+            g_last_scan_us = now_us;
+            scan_gaps();
+        }
+
+        next = next_job(now);
+        if (next >= 0) {
+            BackfillJob *job = &g_jobs[next];
+            RingGap gap = job->gap;
+            int result;
+
+            job->running = 1;
+            platform_mutex_unlock(&g_lock);
+
+            result = fetch_gap(&gap);
+
+            platform_mutex_lock(&g_lock);
+            /* The job may have moved while the lock was released */
+            for (next = 0; next < g_job_count; next++) {
+                if (g_jobs[next].running && same_gap(&g_jobs[next].gap, &gap))
+                    break;
+            }
+            if (next < g_job_count) {
+                job = &g_jobs[next];
+                job->running = 0;
+                job->attempts++;
+                job->next_try = ringclient_clock() +
+                    fmin(BACKFILL_RETRY_SEC * pow(2.0, job->attempts - 1), BACKFILL_RETRY_MAX_SEC);
+            }
+            if (result < 0)
+                metrics_counter_add(g_failed_metric, 1);
+            continue;
+        }
+
+        platform_cond_timedwait_ms(&g_cond, &g_lock, 1000);
+    }
+    platform_mutex_unlock(&g_lock);
+
+    PLATFORM_THREAD_RETURN;
+}
+
+int backfill_start(const BackfillConfig *config) {
+    g_config = *config;
+
+    if (parse_url(g_config.url) < 0) {
+        fprintf(stderr, "[Backfill] Only http://host[:port]/path URLs are supported: %s\n",
+                g_config.url);
+        return -1;
+    }
+    if (g_config.max_connections < 1)
+        g_config.max_connections = 1;
+    if (g_config.max_connections > BACKFILL_MAX_CONNECTIONS)
+        g_config.max_connections = BACKFILL_MAX_CONNECTIONS;
+
+    g_jobs = (BackfillJob*)calloc(BACKFILL_MAX_JOBS, sizeof(BackfillJob));
+    g_gaps = (RingGap*)calloc(BACKFILL_MAX_JOBS, sizeof(RingGap));
+    if (g_jobs == NULL || g_gaps == NULL) {
+        free(g_jobs);
+        free(g_gaps);
+        g_jobs = NULL;
+        g_gaps = NULL;
+        return -1;
+    }
+
+    g_requests_metric = metrics_counter("backfill_requests_total", NULL,
+                                        "Dataselect requests made for gaps");
+    g_failed_metric = metrics_counter("backfill_failed_total", NULL,
+                                      "Gap requests that failed or timed out");
+    g_records_metric = metrics_counter("backfill_records_total", NULL,
+                                       "Records fetched and queued for merging");
+    g_skipped_metric = metrics_counter("backfill_skipped_records_total", NULL,
+                                       "Fetched records of another channel or length");
+    g_jobs_metric = metrics_gauge("backfill_jobs", NULL,
+                                  "Gaps tracked for backfill");
+    g_request_metric = metrics_histogram("backfill_request_seconds", NULL,
+                                         "Duration of one dataselect request");
+
+    platform_mutex_init(&g_lock);
+    platform_cond_init(&g_cond);
+    g_running = 1;
+    g_last_scan_us = 0;
+    while (g_thread_count < g_config.max_connections) {
+        if (platform_thread_create(&g_threads[g_thread_count], backfill_thread_func, NULL) < 0)
+            break;
+        g_thread_count++;
+    }
+    if (g_thread_count == 0) {
+        g_running = 0;
+        platform_cond_destroy(&g_cond);
+        platform_mutex_destroy(&g_lock);
+        free(g_jobs);
+        free(g_gaps);
+        g_jobs = NULL;
+        g_gaps = NULL;
+        return -1;
+    }
+    g_started = 1;
+
+    printf("[Backfill] Filling gaps from %s (%d connections, %d s after they close)\n",
+           g_config.url, g_thread_count, g_config.delay);
+    return 0;
+}
+
+void backfill_stop(void) {
+    int i;
+
+    if (!g_started)
+        return;
+    g_started = 0;
+
+    platform_mutex_lock(&g_lock);
+    g_running = 0;
+    platform_cond_broadcast(&g_cond);
+    platform_mutex_unlock(&g_lock);
+    for (i = 0; i < g_thread_count; i++)
+        platform_thread_join(g_threads[i]);
+    g_thread_count = 0;
+
+    platform_cond_destroy(&g_cond);
+    platform_mutex_destroy(&g_lock);
+    free(g_jobs);
+    free(g_gaps);
+    g_jobs = NULL;
+    g_gaps = NULL;
+    g_job_count = 0;
+}
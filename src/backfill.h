@@ -0,0 +1,41 @@
+#ifndef BACKFILL_H
+#define BACKFILL_H
+
+/*
+ * Gap backfill from an FDSNWS dataselect server. Every interval seconds the
+ * gaps of the ring buffer timelines (ringclient_gaps()) are turned into
+ * jobs; a pool of max_connections worker threads, which is also the limit
+ * of concurrent requests to the server, fetches exactly each missing
+ * window with a plain HTTP/1.0 GET
+ *
+ *   <url>?net=NET&sta=STA&loc=LOC&cha=CHA&start=...&end=...
+ *
+ * and hands the 512-byte records of the answer to ringclient_backfill(),
+ * which merges them into the ring file in time order on the receive
+ * thread, between packets. Records of other lengths are skipped, as in
+ * archive replay.
+ *
+ * A gap is first requested once it closed delay seconds ago (by the data
+ * clock), so the server has had time to receive the data. A gap the
+ * server cannot fill (no data, error) is retried with doubling waits up to
+ * retries times; gaps that disappear from the timeline drop their job.
+ * Only http:// URLs are supported.
+ */
+
+typedef struct {
+    char url[512];              /* http://host[:port]/fdsnws/dataselect/1/query */
+    int max_connections;        /* Worker threads = concurrent requests */
+    int interval;               /* Seconds between gap scans */
+    int delay;                  /* Seconds a gap must have been closed */
+    int retries;                /* Requests per gap before giving up */
+} BackfillConfig;
+
+#define BACKFILL_MAX_CONNECTIONS 16
+
+/* 0 on success, -1 for a bad URL or if no worker could start */
+int backfill_start(const BackfillConfig *config);
+
+/* Abandon queued jobs, wait for requests in flight (each times out) */
+void backfill_stop(void);
+
+#endif /* BACKFILL_H */
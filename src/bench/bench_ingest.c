@@ -0,0 +1,311 @@
+/*
+ * bench_ingest - offline benchmark of the ring buffer write path
+ *
+ * Feeds synthetic (or recorded) 512-byte miniSEED records for N streams
+ * through ringclient_ingest(), the path packet_handler() uses, without a
+ * SeedLink connection. Streams are interleaved round-robin and advance in
+ * data time, so cleanup starts once the simulated span exceeds
+ * ring_buffer_minutes. Point --dir at tmpfs or a real disk to compare.
+ *
+ * Build (from src/):
+ *   cc -O2 -I. -o bench_ingest bench/bench_ingest.c ringclient.c mseed_util.c steim.c \
+ *      archive_source.c reactor.c metrics.c httpd.c netutil.c logger.c trace.c config.c \
+ *      -lslink -lpthread -lm
+ *
+ * Usage:
+ *   bench_ingest [--streams 1,10,100] [--minutes 5,20] [--records N]
+ *                [--cleanup-interval N] [--dir PATH] [--file records.mseed]
+ *
+ * Every combination of --streams and --minutes is one run; each run writes
+ * into its own subdirectory of --dir, which is left in place.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "ringclient.h"
+#include "mseed_util.h"
+#include "metrics.h"
+#include "logger.h"
+#include "platform.h"
+
+#define MAX_RUN_VALUES 16
+#define SYNTH_RATE 100.0
+
+typedef struct {
+    int streams[MAX_RUN_VALUES];
+    int stream_count;
+    int minutes[MAX_RUN_VALUES];
+    int minutes_count;
+    long records;               /* Per stream, 0 = twice the ring span */
+    int cleanup_interval;
+    char dir[512];
+    const char *file;
+} BenchOptions;
+
+typedef struct {
+    char *records;              /* Record templates, MSEED_RECORD_SIZE each */
+    int count;
+    double span;                /* Seconds covered by one record */
+} RecordSource;
+
+static int parse_list(const char *arg, int *values, int max) {
+    char buf[256];
+    char *tok;
+    int n = 0;
+
+    strncpy(buf, arg, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    for (tok = strtok(buf, ","); tok != NULL && n < max; tok = strtok(NULL, ",")) {
+        values[n] = atoi(tok);
+        if (values[n] <= 0)
+            return -1;
+        n++;
+    }
+    return n;
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --streams LIST          Stream counts to run (default 1,10,100)\n");
+    printf("  --minutes LIST          ring_buffer_minutes values (default 5)\n");
+    printf("  --records N             Records per stream (default: 2x ring span)\n");
+    printf("  --cleanup-interval N    Cleanup every N packets (default %d)\n",
+           DEFAULT_CLEANUP_INTERVAL);
+    printf("  --dir PATH              Output directory (default bench_ingest.out)\n");
+    printf("  --file PATH             Replay 512-byte records from a miniSEED file\n");
+}
+
+static int parse_options(int argc, char **argv, BenchOptions *opt) {
+    int i;
+
+    memset(opt, 0, sizeof(*opt));
+    opt->streams[0] = 1;
+    opt->streams[1] = 10;
+    opt->streams[2] = 100;
+    opt->stream_count = 3;
+    opt->minutes[0] = DEFAULT_RING_BUFFER_MINUTES;
+    opt->minutes_count = 1;
+    opt->cleanup_interval = DEFAULT_CLEANUP_INTERVAL;
+    strcpy(opt->dir, "bench_ingest.out");
+
+    for (i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            exit(0);
+        }
+        if (value == NULL) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return -1;
+        }
+        if (strcmp(argv[i], "--streams") == 0) {
+            opt->stream_count = parse_list(value, opt->streams, MAX_RUN_VALUES);
+            if (opt->stream_count <= 0)
+                return -1;
+        } else if (strcmp(argv[i], "--minutes") == 0) {
+            opt->minutes_count = parse_list(value, opt->minutes, MAX_RUN_VALUES);
+            if (opt->minutes_count <= 0)
+                return -1;
+        } else if (strcmp(argv[i], "--records") == 0) {
+            opt->records = atol(value);
+        } else if (strcmp(argv[i], "--cleanup-interval") == 0) {
+            opt->cleanup_interval = atoi(value);
+        } else if (strcmp(argv[i], "--dir") == 0) {
+            strncpy(opt->dir, value, sizeof(opt->dir) - 1);
+        } else if (strcmp(argv[i], "--file") == 0) {
+            opt->file = value;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return -1;
+        }
+        i++;
+    }
+    return opt->cleanup_interval > 0 ? 0 : -1;
+}
+
+/* One synthetic INT32 record per stream: a slow sine with some noise */
+static int synthetic_source(RecordSource *src) {
+    int32_t samples[(MSEED_RECORD_SIZE - 64) / 4];
+    int i, count;
+
+    for (i = 0; i < (int)(sizeof(samples) / sizeof(samples[0])); i++)
+        samples[i] = (int32_t)(1000.0 * sin(i * 0.05)) + (rand() % 64);
+
+    src->records = (char*)malloc(MSEED_RECORD_SIZE);
+    if (src->records == NULL)
+        return -1;
+    count = mseed_build_record(src->records, MSEED_RECORD_SIZE, "XB", "B0000", "00", "HHZ",
+                               1, 0.0, SYNTH_RATE, samples,
+                               (int)(sizeof(samples) / sizeof(samples[0])));
+    src->count = 1;
+    src->span = count / SYNTH_RATE;
+    return 0;
+}
+
+static int file_source(RecordSource *src, const char *path) {
+    FILE *fp = fopen(path, "rb");
+    long size;
+    MSeedHeader hdr;
+
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    src->count = (int)(size / MSEED_RECORD_SIZE);
+    src->records = (char*)malloc((size_t)src->count * MSEED_RECORD_SIZE + 1);
+    if (src->count == 0 || src->records == NULL ||
+        fread(src->records, MSEED_RECORD_SIZE, (size_t)src->count, fp) != (size_t)src->count) {
+        fprintf(stderr, "%s holds no complete %d-byte records\n", path, MSEED_RECORD_SIZE);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    if (mseed_parse_header(src->records, MSEED_RECORD_SIZE, &hdr) < 0) {
+        fprintf(stderr, "%s does not start with a miniSEED record\n", path);
+        return -1;
+    }
+    src->span = hdr.end_time - hdr.start_time;
+    if (src->span <= 0.0)
+        src->span = 1.0;
+    return 0;
+}
+
+static int compare_uint(const void *a, const void *b) {
+    unsigned int x = *(const unsigned int *)a;
+    unsigned int y = *(const unsigned int *)b;
+    return x < y ? -1 : x > y;
+}
+
+static unsigned int percentile(const unsigned int *sorted, size_t n, double q) {
+    size_t idx = (size_t)(q * (double)(n - 1));
+    return n > 0 ? sorted[idx] : 0;
+}
+
+static int run_one(const BenchOptions *opt, const RecordSource *src,
+                   int streams, int minutes) {
+    RingClientConfig config;
+    RingClientStats stats;
+    char record[MSEED_RECORD_SIZE];
+    char stationid[64];
+    char station[8];
+    long records = opt->records;
+    unsigned int *latency;
+    size_t total, n = 0;
+    double start_time;
+    long long begin_us, elapsed_us;
+    long r;
+    int s;
+
+    if (records <= 0)
+        records = (long)ceil(2.0 * minutes * 60.0 / src->span);
+    total = (size_t)records * (size_t)streams;
+    latency = (unsigned int*)malloc(total * sizeof(unsigned int));
+    if (latency == NULL) {
+        fprintf(stderr, "Out of memory for %zu samples\n", total);
+        return -1;
+    }
+
+    ringclient_init_config(&config);
+    snprintf(config.output_dir, sizeof(config.output_dir), "%s/s%d_m%d",
+             opt->dir, streams, minutes);
+    config.ring_buffer_minutes = minutes;
+    config.cleanup_interval = opt->cleanup_interval;
+    config.latency_threshold = 0;
+    config.running = 1;
+    if (config_create_directory(config.output_dir) < 0) {
+        free(latency);
+        return -1;
+    }
+    ringclient_setup(&config);
+
+    /* Data ends "now" so the latency tracking sees realistic values */
+    start_time = floor(platform_time_now()) - records * src->span;
+
+    begin_us = platform_monotonic_us();
+    for (r = 0; r < records; r++) {
+        for (s = 0; s < streams; s++) {
+            long long t0;
+            int status;
+
+            memcpy(record, src->records + (size_t)(r % src->count) * MSEED_RECORD_SIZE,
+                   MSEED_RECORD_SIZE);
+            snprintf(station, sizeof(station), "B%04d", s % 10000);
+            memcpy(record + 8, station, 5);
+            mseed_set_start_time(record, start_time + r * src->span);
+            snprintf(stationid, sizeof(stationid), "%.2s_%s", record + 18, station);
+
+            t0 = platform_monotonic_us();
+            status = ringclient_ingest(stationid, record, MSEED_RECORD_SIZE,
+                                       (unsigned long long)r, t0);
+            latency[n++] = (unsigned int)(platform_monotonic_us() - t0);
+            if (status != 0) {
+                fprintf(stderr, "Ingest failed for %s record %ld\n", stationid, r);
+                ringclient_cleanup();
+                free(latency);
+                return -1;
+            }
+        }
+    }
+    elapsed_us = platform_monotonic_us() - begin_us;
+
+    ringclient_get_stats(&stats);
+    ringclient_cleanup();
+
+    qsort(latency, n, sizeof(unsigned int), compare_uint);
+    printf("%7d %7d %9zu %9.0f %7.1f %7u %7u %7u %8u %6.2f %8llu %10.1f %8.1f\n",
+           streams, minutes, n,
+           n / (elapsed_us / 1e6),
+           stats.bytes_ingested / (elapsed_us / 1e6) / 1e6,
+           percentile(latency, n, 0.50), percentile(latency, n, 0.99),
+           percentile(latency, n, 0.999), n > 0 ? latency[n - 1] : 0,
+           stats.bytes_ingested ? (double)stats.bytes_written / stats.bytes_ingested : 0.0,
+           stats.cleanup_runs,
+           stats.cleanup_runs ? stats.cleanup_us / 1e3 / stats.cleanup_runs : 0.0,
+           100.0 * stats.cleanup_us / (double)elapsed_us);
+    fflush(stdout);
+
+    free(latency);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opt;
+    RecordSource src;
+    int i, j, rc = 0;
+
+    if (parse_options(argc, argv, &opt) < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    memset(&src, 0, sizeof(src));
+    if ((opt.file ? file_source(&src, opt.file) : synthetic_source(&src)) < 0)
+        return 1;
+
+    /* Same registry the client uses, so per-stream metric costs are included */
+    metrics_init();
+    g_log_level = LOG_LEVEL_WARN;
+
+    printf("Records: %s, %.2f s per record, output under %s\n",
+           opt.file ? opt.file : "synthetic INT32", src.span, opt.dir);
+    printf("%7s %7s %9s %9s %7s %7s %7s %7s %8s %6s %8s %10s %8s\n",
+           "streams", "minutes", "packets", "pkts/s", "MB/s", "p50us", "p99us",
+           "p999us", "maxus", "wr/in", "cleanups", "cleanup_ms", "cleanup%");
+
+    for (i = 0; i < opt.minutes_count && rc == 0; i++) {
+        for (j = 0; j < opt.stream_count && rc == 0; j++)
+            rc = run_one(&opt, &src, opt.streams[j], opt.minutes[i]);
+    }
+
+    metrics_shutdown();
+    free(src.records);
+    return rc == 0 ? 0 : 1;
+}
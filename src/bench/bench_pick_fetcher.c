@@ -0,0 +1,464 @@
+/*
+ * bench_pick_fetcher - benchmark of get_picks() and write_picks_to_file()
+ *
+ * Seeds a SeisComP-shaped Pick table with N rows spread evenly over
+ * --span-hours ending now, then runs the fetcher's query and file
+ * publication for each --lookback window and reports query latency, rows
+ * per second, memory high-water and publication time.
+ *
+ * Against the in-process fake (no server needed):
+ *   cc -O2 -Ibench/fakedb -I. -o bench_pick_fetcher bench/bench_pick_fetcher.c \
+ *      bench/fakedb/fakedb.c pick_fetcher.c reactor.c netutil.c metrics.c httpd.c \
+ *      logger.c trace.c -lpthread -lm
+ *
+ * Against a local MariaDB (point --db at a scratch schema; --seed replaces
+ * the contents of its Pick table):
+ *   cc -O2 -I. $(mariadb_config --cflags) -o bench_pick_fetcher \
+ *      bench/bench_pick_fetcher.c pick_fetcher.c reactor.c netutil.c metrics.c \
+ *      httpd.c logger.c trace.c $(mariadb_config --libs) -lpthread -lm
+ *
+ * Usage:
+ *   bench_pick_fetcher [--rows 100000,1000000] [--lookback 60,600,3600,86400]
+ *                      [--span-hours H] [--stations N] [--iterations N]
+ *                      [--file PATH] [--db host:port:user:password:name] [--seed]
+ *
+ * The fake answers through a time-sorted table, like a server using the
+ * time_value index, so its query times are a lower bound: they measure
+ * the client side (result materialization, row copies, allocation) only.
+ */
+#ifdef _WIN32
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pick_fetcher.h"
+#include "metrics.h"
+#include "logger.h"
+#include "platform.h"
+
+#define MAX_RUN_VALUES 16
+#define MAX_ITERATIONS 64
+#define SEED_BATCH_ROWS 1000
+
+typedef struct {
+    unsigned long long rows[MAX_RUN_VALUES];
+    int row_count;
+    int lookbacks[MAX_RUN_VALUES];
+    int lookback_count;
+    double span_hours;
+    int stations;
+    int iterations;
+    char file[512];
+    char db_host[256];
+    char db_user[64];
+    char db_password[64];
+    char db_name[64];
+    int db_port;
+    int seed;
+} BenchOptions;
+
+static unsigned long long g_rng = 0x9E3779B97F4A7C15ULL;
+
+static unsigned long long next_random(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+static int parse_list(const char *arg, double *values, int max) {
+    char buf[256];
+    char *tok;
+    int n = 0;
+
+    strncpy(buf, arg, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    for (tok = strtok(buf, ","); tok != NULL && n < max; tok = strtok(NULL, ","))
+        values[n++] = atof(tok);
+    return n;
+}
+
+static int parse_db(const char *arg, BenchOptions *opts) {
+    char buf[512];
+    char *fields[5] = { NULL };
+    char *p = buf;
+    int n = 0;
+
+    strncpy(buf, arg, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    while (n < 5) {
+        fields[n++] = p;
+        p = strchr(p, ':');
+        if (p == NULL)
+            break;
+        *p++ = '\0';
+    }
+    if (n != 5)
+        return -1;
+
+    strncpy(opts->db_host, fields[0], sizeof(opts->db_host) - 1);
+    opts->db_port = atoi(fields[1]);
+    strncpy(opts->db_user, fields[2], sizeof(opts->db_user) - 1);
+    strncpy(opts->db_password, fields[3], sizeof(opts->db_password) - 1);
+    strncpy(opts->db_name, fields[4], sizeof(opts->db_name) - 1);
+    return 0;
+}
+
+/* Restart peak tracking where the platform allows it */
+static void reset_peak_memory(void) {
+#ifdef __linux__
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+    if (f) {
+        fputs("5", f);
+        fclose(f);
+    }
+#endif
+}
+
+/* Peak resident set size in bytes */
+static unsigned long long peak_memory(void) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return (unsigned long long)pmc.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage usage;
+#ifdef __linux__
+    char line[256];
+    unsigned long long kb = 0;
+    FILE *f = fopen("/proc/self/status", "r");
+
+    if (f) {
+        while (fgets(line, sizeof(line), f)) {
+            if (sscanf(line, "VmHWM: %llu kB", &kb) == 1)
+                break;
+        }
+        fclose(f);
+        if (kb > 0)
+            return kb * 1024;
+    }
+#endif
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (unsigned long long)usage.ru_maxrss;
+#else
+    return (unsigned long long)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+static unsigned long long file_size(const char *path) {
+    FILE *f = fopen(path, "rb");
+    long size;
+
+    if (f == NULL)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fclose(f);
+    return size > 0 ? (unsigned long long)size : 0;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double da = *(const double*)a, db = *(const double*)b;
+    return da < db ? -1 : da > db;
+}
+
+static double median(double *values, int count) {
+    qsort(values, count, sizeof(double), compare_doubles);
+    return count % 2 ? values[count / 2]
+                     : (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
+
+#ifdef FAKEDB_MYSQL
+static int seed_table(MYSQL *conn, const BenchOptions *opts, unsigned long long rows,
+                      time_t end) {
+    static const char *channels[3] = { "HHZ", "HHN", "HHE" };
+    long long span = (long long)(opts->span_hours * 3600.0);
+    char station[16];
+
+    (void)conn;
+    fakedb_reset();
+    for (unsigned long long i = 0; i < rows; i++) {
+        int sta = (int)(next_random() % (unsigned long long)opts->stations);
+
+        snprintf(station, sizeof(station), "S%04d", sta);
+        if (fakedb_add_pick("XX", station, channels[next_random() % 3],
+                            (long long)end - (long long)(next_random() % (unsigned long long)span),
+                            (int)(next_random() % 1000000)) < 0)
+            return -1;
+    }
+    fakedb_commit();
+    return 0;
+}
+#else
+static int seed_table(MYSQL *conn, const BenchOptions *opts, unsigned long long rows,
+                      time_t end) {
+    static const char *channels[3] = { "HHZ", "HHN", "HHE" };
+    long long span = (long long)(opts->span_hours * 3600.0);
+    size_t query_size = 256 + SEED_BATCH_ROWS * 96;
+    char *query;
+    size_t len = 0;
+    int batched = 0;
+
+    if (mysql_query(conn,
+            "CREATE TABLE IF NOT EXISTS Pick ("
+            "_oid BIGINT NOT NULL AUTO_INCREMENT PRIMARY KEY, "
+            "time_value DATETIME NOT NULL, "
+            "time_value_ms INT NOT NULL, "
+            "waveformID_networkCode CHAR(8) NOT NULL, "
+            "waveformID_stationCode CHAR(8) NOT NULL, "
+            "waveformID_locationCode CHAR(8), "
+            "waveformID_channelCode CHAR(8), "
+            "phaseHint_code VARCHAR(32), "
+            "evaluationMode VARCHAR(64), "
+            "INDEX(time_value), INDEX(time_value_ms))") ||
+        mysql_query(conn, "TRUNCATE TABLE Pick")) {
+        fprintf(stderr, "Seeding failed: %s\n", mysql_error(conn));
+        return -1;
+    }
+
+    query = (char*)malloc(query_size);
+    if (query == NULL)
+        return -1;
+
+    for (unsigned long long i = 0; i < rows; i++) {
+        char when[32];
+        time_t t = end - (time_t)(next_random() % (unsigned long long)span);
+        int sta = (int)(next_random() % (unsigned long long)opts->stations);
+
+        format_mysql_datetime(t, when, sizeof(when));
+        if (batched == 0) {
+            len = (size_t)snprintf(query, query_size,
+                "INSERT INTO Pick (time_value, time_value_ms, waveformID_networkCode, "
+                "waveformID_stationCode, waveformID_locationCode, waveformID_channelCode, "
+                "phaseHint_code, evaluationMode) VALUES ");
+        }
+        len += (size_t)snprintf(query + len, query_size - len,
+            "%s('%s',%d,'XX','S%04d','','%s','P','automatic')",
+            batched ? "," : "", when, (int)(next_random() % 1000000), sta,
+            channels[next_random() % 3]);
+
+        if (++batched == SEED_BATCH_ROWS || i + 1 == rows) {
+            if (mysql_query(conn, query)) {
+                fprintf(stderr, "Seeding failed: %s\n", mysql_error(conn));
+                free(query);
+                return -1;
+            }
+            batched = 0;
+        }
+    }
+
+    free(query);
+    return 0;
+}
+#endif
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --rows LIST         Table sizes to seed (default 100000,1000000)\n");
+    printf("  --lookback LIST     picks_lookback values in seconds (default 60,600,3600,86400)\n");
+    printf("  --span-hours H      Time range the rows are spread over (default 168)\n");
+    printf("  --stations N        Distinct stations (default 500)\n");
+    printf("  --iterations N      Repetitions per lookback, median reported (default 5)\n");
+    printf("  --file PATH         Picks file to publish (default bench_picks.txt)\n");
+#ifndef FAKEDB_MYSQL
+    printf("  --db H:P:U:PW:NAME  MariaDB to query (required)\n");
+    printf("  --seed              Replace the Pick table with synthetic rows\n");
+#endif
+}
+
+static int run(MYSQL *conn, const BenchOptions *opts, unsigned long long rows) {
+    time_t end = time(NULL);
+    long long seed_start = platform_monotonic_us();
+
+    if (opts->seed) {
+        if (seed_table(conn, opts, rows, end) < 0)
+            return -1;
+        printf("\nrows=%llu stations=%d span=%gh (seeded in %.1f s)\n", rows,
+               opts->stations, opts->span_hours,
+               (platform_monotonic_us() - seed_start) / 1e6);
+    } else {
+        printf("\nexisting Pick table, queries end now\n");
+    }
+    printf("%10s %10s %10s %12s %10s %10s %10s %10s\n", "lookback_s", "picks",
+           "query_ms", "rows/s", "peak_mb", "result_mb", "write_ms", "file_mb");
+
+    for (int l = 0; l < opts->lookback_count; l++) {
+        double query_ms[MAX_ITERATIONS], write_ms[MAX_ITERATIONS];
+        unsigned long long peak = 0, result_peak = 0;
+        size_t picks = 0;
+        time_t query_end = end + 1;
+        time_t query_start = query_end - opts->lookbacks[l];
+
+        for (int it = 0; it < opts->iterations; it++) {
+            PickResult *result;
+            long long t0, t1, t2;
+            unsigned long long mem;
+
+            reset_peak_memory();
+#ifdef FAKEDB_MYSQL
+            fakedb_take_result_peak();
+#endif
+            t0 = platform_monotonic_us();
+            result = get_picks(query_start, query_end, conn);
+            t1 = platform_monotonic_us();
+            if (result == NULL) {
+                fprintf(stderr, "get_picks() failed\n");
+                return -1;
+            }
+            if (write_picks_to_file(result, opts->file, query_start, query_end) < 0) {
+                free_pick_result(result);
+                return -1;
+            }
+            t2 = platform_monotonic_us();
+
+            mem = peak_memory();
+            if (mem > peak)
+                peak = mem;
+#ifdef FAKEDB_MYSQL
+            mem = fakedb_take_result_peak();
+            if (mem > result_peak)
+                result_peak = mem;
+#endif
+            picks = result->count;
+            query_ms[it] = (t1 - t0) / 1e3;
+            write_ms[it] = (t2 - t1) / 1e3;
+            free_pick_result(result);
+        }
+
+        {
+            double q = median(query_ms, opts->iterations);
+            double w = median(write_ms, opts->iterations);
+
+            printf("%10d %10zu %10.2f %12.0f %10.1f ", opts->lookbacks[l], picks, q,
+                   q > 0.0 ? picks / (q / 1e3) : 0.0, peak / 1048576.0);
+            if (result_peak > 0)
+                printf("%10.1f ", result_peak / 1048576.0);
+            else
+                printf("%10s ", "-");
+            printf("%10.2f %10.2f\n", w, file_size(opts->file) / 1048576.0);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opts;
+    double values[MAX_RUN_VALUES];
+    MYSQL *conn;
+    int rc = 0;
+    int i, n;
+
+    memset(&opts, 0, sizeof(opts));
+    opts.rows[0] = 100000;
+    opts.rows[1] = 1000000;
+    opts.row_count = 2;
+    opts.lookbacks[0] = 60;
+    opts.lookbacks[1] = 600;
+    opts.lookbacks[2] = 3600;
+    opts.lookbacks[3] = 86400;
+    opts.lookback_count = 4;
+    opts.span_hours = 168;
+    opts.stations = 500;
+    opts.iterations = 5;
+    strcpy(opts.file, "bench_picks.txt");
+    opts.db_port = 3306;
+#ifdef FAKEDB_MYSQL
+    opts.seed = 1;
+#endif
+
+    for (i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (strcmp(argv[i], "--seed") == 0) {
+            opts.seed = 1;
+            continue;
+        }
+        if (value == NULL) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--rows") == 0) {
+            opts.row_count = n = parse_list(value, values, MAX_RUN_VALUES);
+            for (int k = 0; k < n; k++)
+                opts.rows[k] = (unsigned long long)values[k];
+        } else if (strcmp(argv[i], "--lookback") == 0) {
+            opts.lookback_count = n = parse_list(value, values, MAX_RUN_VALUES);
+            for (int k = 0; k < n; k++)
+                opts.lookbacks[k] = (int)values[k];
+        } else if (strcmp(argv[i], "--span-hours") == 0) {
+            opts.span_hours = atof(value);
+        } else if (strcmp(argv[i], "--stations") == 0) {
+            opts.stations = atoi(value);
+        } else if (strcmp(argv[i], "--iterations") == 0) {
+            opts.iterations = atoi(value);
+        } else if (strcmp(argv[i], "--file") == 0) {
+            strncpy(opts.file, value, sizeof(opts.file) - 1);
+        } else if (strcmp(argv[i], "--db") == 0) {
+            if (parse_db(value, &opts) < 0) {
+                fprintf(stderr, "--db expects host:port:user:password:name\n");
+                return 1;
+            }
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    if (opts.iterations > MAX_ITERATIONS)
+        opts.iterations = MAX_ITERATIONS;
+    if (opts.row_count <= 0 || opts.lookback_count <= 0 || opts.iterations <= 0 ||
+        opts.stations <= 0 || opts.span_hours <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+#ifndef FAKEDB_MYSQL
+    if (opts.db_host[0] == '\0') {
+        fprintf(stderr, "--db is required when built against the MariaDB client\n");
+        return 1;
+    }
+    if (!opts.seed)
+        opts.row_count = 1;
+#endif
+
+    metrics_init();
+    g_log_level = LOG_LEVEL_WARN;
+    mysql_library_init(0, NULL, NULL);
+
+    conn = mysql_init(NULL);
+    if (conn == NULL ||
+        mysql_real_connect(conn, opts.db_host, opts.db_user, opts.db_password,
+                           opts.db_name, opts.db_port, NULL, 0) == NULL) {
+        fprintf(stderr, "Connect failed: %s\n", conn ? mysql_error(conn) : "mysql_init");
+        if (conn)
+            mysql_close(conn);
+        return 1;
+    }
+
+    printf("Picks file: %s, %d iterations per lookback (median)\n", opts.file,
+           opts.iterations);
+    for (i = 0; i < opts.row_count && rc == 0; i++)
+        rc = run(conn, &opts, opts.rows[i]) < 0 ? 1 : 0;
+
+    mysql_close(conn);
+    mysql_library_end();
+    metrics_shutdown();
+    return rc;
+}
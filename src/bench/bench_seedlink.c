@@ -0,0 +1,220 @@
+/*
+ * bench_seedlink - end-to-end load driver for the SeedLink client
+ *
+ * Starts the stand-in SeedLink server in-process (or uses --connect to
+ * drive an external one), runs the real ringclient against it over
+ * localhost TCP and steps the per-station record rate. For every step it
+ * reports the offered and ingested record rates and the generation-to-write
+ * latency of each record, then the highest step the client sustained.
+ *
+ * Build (from src/):
+ *   cc -O2 -I. -Itools -o bench_seedlink bench/bench_seedlink.c tools/slserver.c \
+ *      seedlink_proto.c ringclient.c archive_source.c reactor.c mseed_util.c steim.c \
+ *      metrics.c httpd.c netutil.c logger.c trace.c config.c -lslink -lpthread -lm
+ *
+ * Usage:
+ *   bench_seedlink [--streams N] [--rates 1,5,10,20] [--step-seconds S]
+ *                  [--port N] [--dir PATH] [--minutes M] [--connect HOST:PORT]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ringclient.h"
+#include "slserver.h"
+#include "metrics.h"
+#include "logger.h"
+#include "platform.h"
+
+#define MAX_STEPS 32
+#define SUSTAINED_RATIO 0.95        /* Ingested / offered to count as keeping up */
+#define SUSTAINED_P99_SEC 1.0
+
+/* Histogram of the step in progress; swapped by the main thread */
+static MetricHistogram * volatile g_step_latency = NULL;
+
+static void on_record(const char *streamid, const char *record, uint32_t length,
+                      const MSeedHeader *hdr, unsigned long long seqnum, void *ctx) {
+    double latency = platform_time_now() - hdr->end_time;
+
+    (void)streamid;
+    (void)record;
+    (void)length;
+    (void)seqnum;
+    (void)ctx;
+    metrics_histogram_record(g_step_latency, latency > 0.0 ? (long long)(latency * 1e6) : 0);
+}
+
+static int parse_rates(const char *arg, double *rates) {
+    char buf[256];
+    char *tok;
+    int n = 0;
+
+    strncpy(buf, arg, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    for (tok = strtok(buf, ","); tok != NULL && n < MAX_STEPS; tok = strtok(NULL, ","))
+        rates[n++] = atof(tok);
+    return n;
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --streams N         Synthetic stations (default 50)\n");
+    printf("  --rates LIST        Records/s per station for each step (default 1,5,10,20,50)\n");
+    printf("  --step-seconds S    Duration of each step (default 10)\n");
+    printf("  --port N            Server port (default 18500)\n");
+    printf("  --dir PATH          Ring buffer directory (default bench_seedlink.out)\n");
+    printf("  --minutes M         ring_buffer_minutes (default %d)\n", DEFAULT_RING_BUFFER_MINUTES);
+    printf("  --connect HOST:PORT Use an external server; rates are not controlled\n");
+}
+
+int main(int argc, char **argv) {
+    SlServerConfig server_config;
+    SlServer *server = NULL;
+    RingClientConfig rc_config;
+    RingClientThread rc_thread;
+    double rates[MAX_STEPS] = { 1, 5, 10, 20, 50 };
+    int step_count = 5;
+    int step_seconds = 10;
+    const char *connect = NULL;
+    double sustained = 0.0;
+    int i;
+
+    slserver_init_config(&server_config);
+    server_config.streams = 50;
+    server_config.port = 18500;
+    ringclient_init_config(&rc_config);
+    strcpy(rc_config.output_dir, "bench_seedlink.out");
+
+    for (i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (value == NULL) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--streams") == 0)
+            server_config.streams = atoi(value);
+        else if (strcmp(argv[i], "--rates") == 0)
+            step_count = parse_rates(value, rates);
+        else if (strcmp(argv[i], "--step-seconds") == 0)
+            step_seconds = atoi(value);
+        else if (strcmp(argv[i], "--port") == 0)
+            server_config.port = atoi(value);
+        else if (strcmp(argv[i], "--dir") == 0)
+            strncpy(rc_config.output_dir, value, sizeof(rc_config.output_dir) - 1);
+        else if (strcmp(argv[i], "--minutes") == 0)
+            rc_config.ring_buffer_minutes = atoi(value);
+        else if (strcmp(argv[i], "--connect") == 0)
+            connect = value;
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (step_count <= 0 || step_seconds <= 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    metrics_init();
+    g_log_level = LOG_LEVEL_WARN;
+    if (config_create_directory(rc_config.output_dir) < 0)
+        return 1;
+
+    if (connect) {
+        const char *colon = strrchr(connect, ':');
+        size_t host_len = colon ? (size_t)(colon - connect) : strlen(connect);
+
+        if (host_len >= sizeof(rc_config.server_address))
+            host_len = sizeof(rc_config.server_address) - 1;
+        memcpy(rc_config.server_address, connect, host_len);
+        rc_config.server_address[host_len] = '\0';
+        rc_config.port = colon ? atoi(colon + 1) : 18000;
+        step_count = 1;
+    } else {
+        server_config.rate = rates[0];
+        server = slserver_start(&server_config);
+        if (server == NULL)
+            return 1;
+        strcpy(rc_config.server_address, "127.0.0.1");
+        rc_config.port = server_config.port;
+    }
+
+    g_step_latency = metrics_histogram("bench_warmup_latency_seconds", NULL, "Warm-up");
+    ringclient_set_record_callback(on_record, NULL);
+    rc_config.latency_threshold = 0;
+    if (ringclient_start(&rc_config, &rc_thread) < 0) {
+        slserver_stop(server);
+        return 1;
+    }
+    platform_sleep_ms(2000);
+
+    printf("%8s %10s %10s %10s %9s %9s %9s %9s\n", "rate/sta", "offered/s", "sent/s",
+           "ingest/s", "p50_ms", "p99_ms", "p999_ms", "overruns");
+
+    for (i = 0; i < step_count; i++) {
+        SlServerStats before, after;
+        RingClientStats rc_before, rc_after;
+        MetricHistogram *latency;
+        char labels[64];
+        double elapsed, offered, ingested, p99;
+        long long start_us;
+
+        snprintf(labels, sizeof(labels), "rate=\"%g\"", rates[i]);
+        latency = metrics_histogram("bench_e2e_latency_seconds", labels,
+                                    "Generation to ring buffer write");
+        if (server) {
+            slserver_set_rate(server, rates[i]);
+            platform_sleep_ms(1000);    /* Let the new rate settle */
+            slserver_get_stats(server, &before);
+        } else {
+            memset(&before, 0, sizeof(before));
+        }
+        g_step_latency = latency;
+        ringclient_get_stats(&rc_before);
+        start_us = platform_monotonic_us();
+
+        platform_sleep_ms((unsigned int)step_seconds * 1000);
+
+        elapsed = (platform_monotonic_us() - start_us) / 1e6;
+        ringclient_get_stats(&rc_after);
+        if (server)
+            slserver_get_stats(server, &after);
+        else
+            memset(&after, 0, sizeof(after));
+
+        ingested = (rc_after.packets - rc_before.packets) / elapsed;
+        offered = server ? (after.generated - before.generated) / elapsed : ingested;
+        p99 = metrics_histogram_quantile(latency, 0.99) / 1e3;
+
+        printf("%8g %10.0f %10.0f %10.0f %9.1f %9.1f %9.1f %9llu\n",
+               rates[i], offered,
+               server ? (after.sent - before.sent) / elapsed : ingested,
+               ingested,
+               metrics_histogram_quantile(latency, 0.50) / 1e3, p99,
+               metrics_histogram_quantile(latency, 0.999) / 1e3,
+               after.overruns - before.overruns);
+        fflush(stdout);
+
+        if (ingested >= SUSTAINED_RATIO * offered && p99 < SUSTAINED_P99_SEC * 1e3)
+            sustained = ingested;
+    }
+
+    if (server) {
+        printf("Sustained: %.0f records/s (%d stations, ingest >= %.0f%% of offered, p99 < %.0f s)\n",
+               sustained, server_config.streams, SUSTAINED_RATIO * 100, SUSTAINED_P99_SEC);
+    }
+
+    ringclient_stop(&rc_config, rc_thread);
+    ringclient_set_record_callback(NULL, NULL);
+    slserver_stop(server);
+    metrics_shutdown();
+    return 0;
+}
@@ -0,0 +1,387 @@
+/*
+ * bench_steim - validation and throughput of the Steim decoders
+ *
+ * Encodes synthetic signals (quiet to large amplitudes, so every Steim1 and
+ * Steim2 word format occurs) into Steim records, or loads records from a
+ * file, then:
+ *   1. decodes every record with each path this CPU supports and checks
+ *      the samples against the encoder input (or, for --file, against the
+ *      scalar reference), and that a corrupted reverse integration
+ *      constant is rejected;
+ *   2. times each path and reports samples per second.
+ * Exits non-zero if any path disagrees.
+ *
+ * Build (from src/):
+ *   cc -O2 -I. -o bench_steim bench/bench_steim.c mseed_util.c steim.c -lm
+ *
+ * Usage:
+ *   bench_steim [--records N] [--record-size BYTES] [--seconds S] [--file records.mseed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "mseed_util.h"
+#include "steim.h"
+#include "platform.h"
+
+#define DATA_OFFSET 64
+#define MAX_SAMPLES 8192
+
+typedef struct {
+    long records;
+    int record_size;
+    double seconds;
+    const char *file;
+} BenchOptions;
+
+typedef struct {
+    char *records;              /* record_size bytes each */
+    int32_t *expected;          /* Encoder input, MAX_SAMPLES per record; NULL for --file */
+    int count;
+    int record_size;
+    long samples;
+} RecordSet;
+
+/* Steim word layouts, most differences per word first */
+typedef struct {
+    int count;
+    int bits;
+    int ctrl;
+    int dnib;                   /* -1: none (Steim1, and Steim2 4 x 8 bits) */
+} WordFormat;
+
+static const WordFormat g_steim1_words[] = {
+    { 4, 8, 1, -1 }, { 2, 16, 2, -1 }, { 1, 32, 3, -1 }
+};
+
+static const WordFormat g_steim2_words[] = {
+    { 7, 4, 3, 2 }, { 6, 5, 3, 1 }, { 5, 6, 3, 0 }, { 4, 8, 1, -1 },
+    { 3, 10, 2, 3 }, { 2, 15, 2, 2 }, { 1, 30, 2, 1 }
+};
+
+static void put_be32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static int fits(int64_t d, int bits) {
+    return bits == 32 ? d >= INT32_MIN && d <= INT32_MAX
+                      : d >= -((int64_t)1 << (bits - 1)) && d < ((int64_t)1 << (bits - 1));
+}
+
+/*
+ * Encode as many of x[0..count) as fit into nframes big-endian frames;
+ * prev is the sample before x[0]. Returns the number of samples stored.
+ */
+static int steim_encode(unsigned char *frames, int nframes, int steim2,
+                        const int32_t *x, int count, int32_t prev) {
+    const WordFormat *formats = steim2 ? g_steim2_words : g_steim1_words;
+    int format_count = steim2 ? 7 : 3;
+    int n = 0;
+    int f, w;
+
+    memset(frames, 0, (size_t)nframes * 64);
+    for (f = 0; f < nframes && n < count; f++) {
+        uint32_t nibbles = 0;
+
+        for (w = f == 0 ? 3 : 1; w < 16 && n < count; w++) {
+            const WordFormat *fmt = NULL;
+            uint32_t word = 0;
+            int k, i;
+
+            for (k = 0; k < format_count && fmt == NULL; k++) {
+                if (n + formats[k].count > count)
+                    continue;
+                for (i = 0; i < formats[k].count; i++) {
+                    int64_t d = (int64_t)x[n + i] - (n + i == 0 ? prev : x[n + i - 1]);
+                    if (!fits(d, formats[k].bits))
+                        break;
+                }
+                if (i == formats[k].count)
+                    fmt = &formats[k];
+            }
+            if (fmt == NULL)
+                return -1;
+
+            if (fmt->dnib >= 0)
+                word = (uint32_t)fmt->dnib << 30;
+            for (i = 0; i < fmt->count; i++) {
+                uint32_t d = (uint32_t)(x[n + i] - (n + i == 0 ? prev : x[n + i - 1]));
+                uint32_t mask = fmt->bits == 32 ? 0xffffffffu : (1u << fmt->bits) - 1;
+                word |= (d & mask) << ((fmt->count - 1 - i) * fmt->bits);
+            }
+            put_be32(frames + f * 64 + 4 * w, word);
+            nibbles |= (uint32_t)fmt->ctrl << (30 - 2 * w);
+            n += fmt->count;
+        }
+        put_be32(frames + f * 64, nibbles);
+    }
+
+    put_be32(frames + 4, (uint32_t)x[0]);
+    put_be32(frames + 8, (uint32_t)x[n - 1]);
+    return n;
+}
+
+/* Noise whose amplitude steps through 8, 16 and 30-bit differences */
+static void synthetic_signal(int32_t *x, long count) {
+    static const double amplitudes[] = { 3, 40, 600, 20000, 3e6, 1e8 };
+    long i;
+
+    for (i = 0; i < count; i++) {
+        double amp = amplitudes[(i / 5000) % 6];
+        double noise = ((rand() & 0xffff) / 32768.0 - 1.0) * amp;
+        x[i] = (int32_t)(amp * sin(i * 0.01) + noise);
+    }
+}
+
+static int synthetic_records(RecordSet *set, const BenchOptions *opt) {
+    int32_t *signal;
+    long per_record = (long)(opt->record_size - DATA_OFFSET) / 4 * 7;
+    long total = opt->records * per_record;
+    long pos = 0;
+    long r;
+
+    set->record_size = opt->record_size;
+    set->records = (char*)malloc((size_t)opt->records * (size_t)opt->record_size);
+    set->expected = (int32_t*)malloc((size_t)opt->records * MAX_SAMPLES * sizeof(int32_t));
+    signal = (int32_t*)malloc((size_t)total * sizeof(int32_t));
+    if (set->records == NULL || set->expected == NULL || signal == NULL) {
+        free(signal);
+        return -1;
+    }
+    synthetic_signal(signal, total);
+
+    /* Alternate Steim1 and Steim2 records along one continuous signal */
+    for (r = 0; r < opt->records && pos < total; r++) {
+        char *rec = set->records + r * opt->record_size;
+        unsigned char *urec = (unsigned char *)rec;
+        int steim2 = r % 2;
+        int32_t prev = pos > 0 ? signal[pos - 1] : 0;
+        int left = (int)(total - pos < MAX_SAMPLES ? total - pos : MAX_SAMPLES);
+        int n;
+
+        /* INT32 record for the header, then Steim frames as its data */
+        mseed_build_record(rec, (size_t)opt->record_size, "XB", "STEIM", "00", "HHZ",
+                           r + 1, 1.7e9 + pos / 100.0, 100.0, signal, 1);
+        n = steim_encode(urec + DATA_OFFSET, (opt->record_size - DATA_OFFSET) / 64, steim2,
+                         signal + pos, left, prev);
+        if (n <= 0) {
+            free(signal);
+            return -1;
+        }
+        urec[30] = (unsigned char)(n >> 8);
+        urec[31] = (unsigned char)n;
+        urec[52] = steim2 ? MSEED_ENC_STEIM2 : MSEED_ENC_STEIM1;
+        memcpy(set->expected + r * MAX_SAMPLES, signal + pos, (size_t)n * sizeof(int32_t));
+        pos += n;
+        set->samples += n;
+    }
+    set->count = (int)r;
+    free(signal);
+    return 0;
+}
+
+static int file_records(RecordSet *set, const char *path) {
+    FILE *fp = fopen(path, "rb");
+    MSeedHeader hdr;
+    long size;
+
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    set->records = (char*)malloc((size_t)size + 1);
+    if (set->records == NULL || fread(set->records, 1, (size_t)size, fp) != (size_t)size ||
+        mseed_parse_header(set->records, (size_t)size, &hdr) < 0) {
+        fprintf(stderr, "%s does not start with a miniSEED record\n", path);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    set->record_size = hdr.record_length;
+    set->count = (int)(size / hdr.record_length);
+    return 0;
+}
+
+/* Decode one record with a path; -1 if it is not Steim or fails */
+static int decode_record(SteimPath path, const char *rec, int size, int32_t *out) {
+    MSeedHeader hdr;
+    int count;
+
+    if (mseed_parse_header(rec, (size_t)size, &hdr) < 0 ||
+        (hdr.encoding != MSEED_ENC_STEIM1 && hdr.encoding != MSEED_ENC_STEIM2))
+        return -1;
+    count = hdr.sample_count < MAX_SAMPLES ? hdr.sample_count : MAX_SAMPLES;
+    return steim_decode_with(path, (const unsigned char *)rec + hdr.data_offset,
+                             (size_t)(hdr.record_length - hdr.data_offset),
+                             !hdr.big_endian_data, hdr.encoding == MSEED_ENC_STEIM2,
+                             out, count, count == hdr.sample_count);
+}
+
+static int validate(RecordSet *set, SteimPath best) {
+    static int32_t reference[MAX_SAMPLES];
+    static int32_t out[MAX_SAMPLES];
+    char *copy = (char*)malloc((size_t)set->record_size);
+    int failures = 0;
+    int p, r;
+
+    if (copy == NULL)
+        return -1;
+
+    for (r = 0; r < set->count; r++) {
+        const char *rec = set->records + (size_t)r * set->record_size;
+        int n = decode_record(STEIM_PATH_SCALAR, rec, set->record_size, reference);
+
+        if (n < 0)
+            continue;
+        if (set->expected == NULL)
+            set->samples += n;
+        else if (memcmp(reference, set->expected + r * MAX_SAMPLES, (size_t)n * 4) != 0) {
+            fprintf(stderr, "Record %d: scalar decoder differs from the encoded signal\n", r);
+            failures++;
+        }
+
+        for (p = STEIM_PATH_SCALAR; p <= (int)best; p++) {
+            MSeedHeader hdr;
+
+            if (decode_record((SteimPath)p, rec, set->record_size, out) != n ||
+                memcmp(out, reference, (size_t)n * 4) != 0) {
+                fprintf(stderr, "Record %d: %s decoder differs from scalar\n",
+                        r, steim_path_name((SteimPath)p));
+                failures++;
+            }
+
+            /* A wrong reverse integration constant must be rejected */
+            memcpy(copy, rec, (size_t)set->record_size);
+            mseed_parse_header(copy, (size_t)set->record_size, &hdr);
+            copy[hdr.data_offset + 11] ^= 1;
+            if (decode_record((SteimPath)p, copy, set->record_size, out) != -1) {
+                fprintf(stderr, "Record %d: %s decoder accepted a bad Xn\n",
+                        r, steim_path_name((SteimPath)p));
+                failures++;
+            }
+        }
+    }
+
+    free(copy);
+    return failures;
+}
+
+static double run_path(const RecordSet *set, SteimPath path, double seconds, double *rate) {
+    static int32_t out[MAX_SAMPLES];
+    long long begin = platform_monotonic_us();
+    long long elapsed;
+    long long samples = 0;
+    long passes = 0;
+
+    do {
+        int r;
+        for (r = 0; r < set->count; r++) {
+            int n = decode_record(path, set->records + (size_t)r * set->record_size,
+                                  set->record_size, out);
+            if (n > 0)
+                samples += n;
+        }
+        passes++;
+        elapsed = platform_monotonic_us() - begin;
+    } while (elapsed < (long long)(seconds * 1e6));
+
+    *rate = samples / (elapsed / 1e6);
+    return (double)passes;
+}
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --records N             Synthetic records (default 20000)\n");
+    printf("  --record-size BYTES     Synthetic record length, 128-4096 (default 512)\n");
+    printf("  --seconds S             Time per decoder path (default 2)\n");
+    printf("  --file PATH             Decode the Steim records of a miniSEED file\n");
+}
+
+static int parse_options(int argc, char **argv, BenchOptions *opt) {
+    int i;
+
+    opt->records = 20000;
+    opt->record_size = 512;
+    opt->seconds = 2.0;
+    opt->file = NULL;
+
+    for (i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            exit(0);
+        }
+        if (value == NULL) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return -1;
+        }
+        if (strcmp(argv[i], "--records") == 0) {
+            opt->records = atol(value);
+        } else if (strcmp(argv[i], "--record-size") == 0) {
+            opt->record_size = atoi(value);
+        } else if (strcmp(argv[i], "--seconds") == 0) {
+            opt->seconds = atof(value);
+        } else if (strcmp(argv[i], "--file") == 0) {
+            opt->file = value;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return -1;
+        }
+        i++;
+    }
+    if (opt->records <= 0 || opt->seconds <= 0.0 || opt->record_size < 128 ||
+        opt->record_size > 4096 || (opt->record_size & (opt->record_size - 1)) != 0)
+        return -1;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opt;
+    RecordSet set;
+    SteimPath best = steim_best_path();
+    double scalar_rate = 0.0;
+    int failures;
+    int p;
+
+    if (parse_options(argc, argv, &opt) < 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    memset(&set, 0, sizeof(set));
+    if (opt.file != NULL ? file_records(&set, opt.file) : synthetic_records(&set, &opt)) {
+        fprintf(stderr, "Cannot prepare records\n");
+        return 1;
+    }
+
+    failures = validate(&set, best);
+    printf("Validated %d records (%ld samples) on %d path(s): %s\n", set.count, set.samples,
+           (int)best + 1, failures == 0 ? "OK" : "FAILED");
+    if (failures != 0)
+        return 1;
+
+    printf("%-8s %14s %10s %8s\n", "path", "Msamples/s", "passes", "speedup");
+    for (p = STEIM_PATH_SCALAR; p <= (int)best; p++) {
+        double rate;
+        double passes = run_path(&set, (SteimPath)p, opt.seconds, &rate);
+
+        if (p == STEIM_PATH_SCALAR)
+            scalar_rate = rate;
+        printf("%-8s %14.1f %10.0f %7.2fx\n", steim_path_name((SteimPath)p), rate / 1e6,
+               passes, scalar_rate > 0.0 ? rate / scalar_rate : 0.0);
+    }
+
+    free(set.records);
+    free(set.expected);
+    return 0;
+}
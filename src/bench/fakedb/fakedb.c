@@ -0,0 +1,387 @@
+/*
+ * fakedb - in-memory Pick table behind the MariaDB client API subset in
+ * mysql.h. See that header for what is and is not emulated.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mysql.h"
+#include "platform.h"
+
+#define FAKEDB_COLUMNS 5
+#define FAKEDB_STREAM_BUCKETS 4096
+
+struct st_mysql {
+    char error[256];
+    unsigned int errnum;
+    long long start;            /* Window of the last query, exclusive */
+    long long end;
+    int has_query;
+    int allocated;              /* Created by mysql_init(NULL) */
+};
+
+struct st_mysql_res {
+    char **cells;               /* FAKEDB_COLUMNS pointers per row */
+    char *data;
+    my_ulonglong rows;
+    my_ulonglong next;
+    unsigned long long bytes;
+};
+
+typedef struct {
+    char network[8];
+    char station[8];
+    char channel[8];
+    int next;                   /* Hash chain */
+} FakeStream;
+
+typedef struct {
+    long long time_value;
+    int time_ms;
+    int stream;
+} FakePick;
+
+static FakeStream *g_streams = NULL;
+static int g_stream_count = 0;
+static int g_stream_capacity = 0;
+static int g_stream_buckets[FAKEDB_STREAM_BUCKETS];
+static int g_buckets_ready = 0;
+
+static FakePick *g_picks = NULL;
+static size_t g_pick_count = 0;
+static size_t g_pick_capacity = 0;
+
+static volatile unsigned long long g_result_bytes = 0;
+static volatile unsigned long long g_result_peak = 0;
+
+static unsigned int stream_hash(const char *net, const char *sta, const char *cha) {
+    unsigned int h = 2166136261u;
+    const char *parts[3] = { net, sta, cha };
+
+    for (int i = 0; i < 3; i++) {
+        for (const char *p = parts[i]; *p; p++)
+            h = (h ^ (unsigned char)*p) * 16777619u;
+        h = (h ^ '.') * 16777619u;
+    }
+    return h % FAKEDB_STREAM_BUCKETS;
+}
+
+static int find_or_add_stream(const char *net, const char *sta, const char *cha) {
+    unsigned int bucket = stream_hash(net, sta, cha);
+    int i;
+
+    if (!g_buckets_ready) {
+        for (i = 0; i < FAKEDB_STREAM_BUCKETS; i++)
+            g_stream_buckets[i] = -1;
+        g_buckets_ready = 1;
+    }
+
+    for (i = g_stream_buckets[bucket]; i >= 0; i = g_streams[i].next) {
+        if (strcmp(g_streams[i].network, net) == 0 &&
+            strcmp(g_streams[i].station, sta) == 0 &&
+            strcmp(g_streams[i].channel, cha) == 0)
+            return i;
+    }
+
+    if (g_stream_count >= g_stream_capacity) {
+        int capacity = g_stream_capacity ? g_stream_capacity * 2 : 256;
+        FakeStream *grown = (FakeStream*)realloc(g_streams, capacity * sizeof(FakeStream));
+        if (grown == NULL)
+            return -1;
+        g_streams = grown;
+        g_stream_capacity = capacity;
+    }
+
+    i = g_stream_count++;
+    memset(&g_streams[i], 0, sizeof(FakeStream));
+    strncpy(g_streams[i].network, net, sizeof(g_streams[i].network) - 1);
+    strncpy(g_streams[i].station, sta, sizeof(g_streams[i].station) - 1);
+    strncpy(g_streams[i].channel, cha, sizeof(g_streams[i].channel) - 1);
+    g_streams[i].next = g_stream_buckets[bucket];
+    g_stream_buckets[bucket] = i;
+    return i;
+}
+
+int fakedb_add_pick(const char *network, const char *station, const char *channel,
+                    long long time_value, int time_ms) {
+    int stream = find_or_add_stream(network, station, channel);
+
+    if (stream < 0)
+        return -1;
+
+    if (g_pick_count >= g_pick_capacity) {
+        size_t capacity = g_pick_capacity ? g_pick_capacity * 2 : 4096;
+        FakePick *grown = (FakePick*)realloc(g_picks, capacity * sizeof(FakePick));
+        if (grown == NULL)
+            return -1;
+        g_picks = grown;
+        g_pick_capacity = capacity;
+    }
+
+    g_picks[g_pick_count].time_value = time_value;
+    g_picks[g_pick_count].time_ms = time_ms;
+    g_picks[g_pick_count].stream = stream;
+    g_pick_count++;
+    return 0;
+}
+
+static int compare_fake_picks(const void *a, const void *b) {
+    const FakePick *pa = (const FakePick*)a;
+    const FakePick *pb = (const FakePick*)b;
+
+    if (pa->time_value != pb->time_value)
+        return pa->time_value < pb->time_value ? -1 : 1;
+    return pa->time_ms - pb->time_ms;
+}
+
+void fakedb_commit(void) {
+    qsort(g_picks, g_pick_count, sizeof(FakePick), compare_fake_picks);
+}
+
+void fakedb_reset(void) {
+    free(g_picks);
+    free(g_streams);
+    g_picks = NULL;
+    g_streams = NULL;
+    g_pick_count = g_pick_capacity = 0;
+    g_stream_count = g_stream_capacity = 0;
+    g_buckets_ready = 0;
+}
+
+unsigned long long fakedb_row_count(void) {
+    return g_pick_count;
+}
+
+unsigned long long fakedb_take_result_peak(void) {
+    unsigned long long peak = platform_atomic_load_u64(&g_result_peak);
+
+    platform_atomic_store_u64(&g_result_peak, platform_atomic_load_u64(&g_result_bytes));
+    return peak;
+}
+
+static void track_result_bytes(long long delta) {
+    unsigned long long now = platform_atomic_add_u64(&g_result_bytes,
+                                                     (unsigned long long)delta) + delta;
+    unsigned long long peak = platform_atomic_load_u64(&g_result_peak);
+
+    while (now > peak && !platform_atomic_cas_u64(&g_result_peak, peak, now))
+        peak = platform_atomic_load_u64(&g_result_peak);
+}
+
+/* First index with time_value > t (sorted table) */
+static size_t upper_bound(long long t) {
+    size_t lo = 0, hi = g_pick_count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (g_picks[mid].time_value <= t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Local-time "YYYY-MM-DD HH:MM:SS" after marker, as format_mysql_datetime writes it */
+static int parse_bound(const char *query, const char *marker, long long *out) {
+    const char *p = strstr(query, marker);
+    struct tm tm;
+
+    if (p == NULL)
+        return -1;
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(p + strlen(marker), "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon,
+               &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+        return -1;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    tm.tm_isdst = -1;
+    *out = (long long)mktime(&tm);
+    return 0;
+}
+
+static void set_error(MYSQL *mysql, unsigned int errnum, const char *message) {
+    mysql->errnum = errnum;
+    snprintf(mysql->error, sizeof(mysql->error), "%s", message);
+}
+
+MYSQL *mysql_init(MYSQL *mysql) {
+    if (mysql == NULL) {
+        mysql = (MYSQL*)calloc(1, sizeof(MYSQL));
+        if (mysql != NULL)
+            mysql->allocated = 1;
+    } else {
+        memset(mysql, 0, sizeof(MYSQL));
+    }
+    return mysql;
+}
+
+int mysql_optionsv(MYSQL *mysql, enum mysql_option option, ...) {
+    (void)mysql;
+    (void)option;
+    return 0;
+}
+
+MYSQL *mysql_real_connect(MYSQL *mysql, const char *host, const char *user,
+                          const char *passwd, const char *db, unsigned int port,
+                          const char *unix_socket, unsigned long flags) {
+    (void)host;
+    (void)user;
+    (void)passwd;
+    (void)db;
+    (void)port;
+    (void)unix_socket;
+    (void)flags;
+    return mysql;
+}
+
+int mysql_query(MYSQL *mysql, const char *query) {
+    mysql->has_query = 0;
+    if (strstr(query, "FROM Pick") == NULL ||
+        parse_bound(query, "time_value > '", &mysql->start) < 0 ||
+        parse_bound(query, "time_value < '", &mysql->end) < 0) {
+        set_error(mysql, 1064, "fakedb: only the get_picks() time window query is supported");
+        return 1;
+    }
+    set_error(mysql, 0, "");
+    mysql->has_query = 1;
+    return 0;
+}
+
+MYSQL_RES *mysql_store_result(MYSQL *mysql) {
+    MYSQL_RES *res;
+    size_t first, last, i;
+    size_t data_size = 0;
+    char *cursor;
+
+    if (!mysql->has_query) {
+        set_error(mysql, 2014, "fakedb: no query to store");
+        return NULL;
+    }
+    mysql->has_query = 0;
+
+    first = upper_bound(mysql->start);
+    last = mysql->end > mysql->start ? upper_bound(mysql->end - 1) : first;
+
+    res = (MYSQL_RES*)calloc(1, sizeof(MYSQL_RES));
+    if (res == NULL) {
+        set_error(mysql, 2008, "fakedb: out of memory");
+        return NULL;
+    }
+    res->rows = last - first;
+
+    /* Exact string sizes, like the server's result packets */
+    for (i = first; i < last; i++) {
+        const FakeStream *s = &g_streams[g_picks[i].stream];
+        data_size += strlen(s->network) + strlen(s->station) + strlen(s->channel) + 3;
+        data_size += 20 + 7;
+    }
+
+    res->cells = (char**)malloc((res->rows ? res->rows : 1) * FAKEDB_COLUMNS * sizeof(char*));
+    res->data = (char*)malloc(data_size ? data_size : 1);
+    if (res->cells == NULL || res->data == NULL) {
+        mysql_free_result(res);
+        set_error(mysql, 2008, "fakedb: out of memory");
+        return NULL;
+    }
+    res->bytes = sizeof(MYSQL_RES) + res->rows * FAKEDB_COLUMNS * sizeof(char*) + data_size;
+    track_result_bytes((long long)res->bytes);
+
+    cursor = res->data;
+    for (i = first; i < last; i++) {
+        const FakePick *pick = &g_picks[i];
+        const FakeStream *s = &g_streams[pick->stream];
+        char **row = &res->cells[(i - first) * FAKEDB_COLUMNS];
+        time_t t = (time_t)pick->time_value;
+        struct tm tm;
+
+        row[0] = cursor;
+        cursor += sprintf(cursor, "%s", s->network) + 1;
+        row[1] = cursor;
+        cursor += sprintf(cursor, "%s", s->station) + 1;
+        row[2] = cursor;
+        cursor += sprintf(cursor, "%s", s->channel) + 1;
+        row[3] = cursor;
+        if (platform_localtime(&t, &tm) != NULL)
+            strftime(cursor, 20, "%Y-%m-%d %H:%M:%S", &tm);
+        else
+            cursor[0] = '\0';
+        cursor += 20;
+        row[4] = cursor;
+        snprintf(cursor, 7, "%d", pick->time_ms);
+        cursor += 7;
+    }
+
+    return res;
+}
+
+MYSQL_ROW mysql_fetch_row(MYSQL_RES *result) {
+    if (result == NULL || result->next >= result->rows)
+        return NULL;
+    return &result->cells[result->next++ * FAKEDB_COLUMNS];
+}
+
+unsigned int mysql_num_fields(MYSQL_RES *result) {
+    (void)result;
+    return FAKEDB_COLUMNS;
+}
+
+my_ulonglong mysql_num_rows(MYSQL_RES *result) {
+    return result ? result->rows : 0;
+}
+
+void mysql_free_result(MYSQL_RES *result) {
+    if (result == NULL)
+        return;
+    if (result->bytes)
+        track_result_bytes(-(long long)result->bytes);
+    free(result->cells);
+    free(result->data);
+    free(result);
+}
+
+const char *mysql_error(MYSQL *mysql) {
+    return mysql ? mysql->error : "fakedb: no connection";
+}
+
+unsigned int mysql_errno(MYSQL *mysql) {
+    return mysql ? mysql->errnum : 0;
+}
+
+void mysql_close(MYSQL *mysql) {
+    if (mysql && mysql->allocated)
+        free(mysql);
+}
+
+unsigned long mysql_real_escape_string(MYSQL *mysql, char *to, const char *from,
+                                       unsigned long length) {
+    unsigned long n = 0;
+
+    (void)mysql;
+    for (unsigned long i = 0; i < length; i++) {
+        if (from[i] == '\'' || from[i] == '\\' || from[i] == '"')
+            to[n++] = '\\';
+        to[n++] = from[i];
+    }
+    to[n] = '\0';
+    return n;
+}
+
+my_bool mysql_thread_init(void) {
+    return 0;
+}
+
+void mysql_thread_end(void) {
+}
+
+int mysql_library_init(int argc, char **argv, char **groups) {
+    (void)argc;
+    (void)argv;
+    (void)groups;
+    return 0;
+}
+
+void mysql_library_end(void) {
+}
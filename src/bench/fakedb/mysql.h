@@ -0,0 +1,70 @@
+#ifndef MYSQL_H
+#define MYSQL_H
+
+/*
+ * In-process stand-in for the subset of the MariaDB client API the pick
+ * fetcher uses. Put this directory ahead of the real include path to build
+ * the fetcher against a table held in memory instead of a server:
+ *
+ *   cc -Ibench/fakedb -I. ... bench/fakedb/fakedb.c pick_fetcher.c ...
+ *
+ * Only the time-window query issued by get_picks() is understood. The
+ * table is a SeisComP-shaped Pick table kept sorted by time_value, which
+ * matches the server answering through its time_value index; results are
+ * materialized as strings like mysql_store_result() does, so the client
+ * side (row copy, allocations, file writing) costs what it costs against
+ * a real server.
+ */
+
+#define FAKEDB_MYSQL 1
+
+typedef char my_bool;
+typedef unsigned long long my_ulonglong;
+typedef struct st_mysql MYSQL;
+typedef struct st_mysql_res MYSQL_RES;
+typedef char **MYSQL_ROW;
+
+enum mysql_option {
+    MYSQL_OPT_CONNECT_TIMEOUT,
+    MYSQL_OPT_READ_TIMEOUT,
+    MYSQL_OPT_SSL_VERIFY_SERVER_CERT,
+    MYSQL_OPT_SSL_ENFORCE
+};
+
+MYSQL *mysql_init(MYSQL *mysql);
+int mysql_optionsv(MYSQL *mysql, enum mysql_option option, ...);
+MYSQL *mysql_real_connect(MYSQL *mysql, const char *host, const char *user,
+                          const char *passwd, const char *db, unsigned int port,
+                          const char *unix_socket, unsigned long flags);
+int mysql_query(MYSQL *mysql, const char *query);
+MYSQL_RES *mysql_store_result(MYSQL *mysql);
+MYSQL_ROW mysql_fetch_row(MYSQL_RES *result);
+unsigned int mysql_num_fields(MYSQL_RES *result);
+my_ulonglong mysql_num_rows(MYSQL_RES *result);
+void mysql_free_result(MYSQL_RES *result);
+const char *mysql_error(MYSQL *mysql);
+unsigned int mysql_errno(MYSQL *mysql);
+void mysql_close(MYSQL *mysql);
+unsigned long mysql_real_escape_string(MYSQL *mysql, char *to, const char *from,
+                                       unsigned long length);
+my_bool mysql_thread_init(void);
+void mysql_thread_end(void);
+int mysql_library_init(int argc, char **argv, char **groups);
+void mysql_library_end(void);
+
+/* Table access for seeding; not part of the client API */
+
+/* Append one Pick row; time_ms is time_value_ms (microseconds) */
+int fakedb_add_pick(const char *network, const char *station, const char *channel,
+                    long long time_value, int time_ms);
+
+/* Sort the table by time_value; call after seeding */
+void fakedb_commit(void);
+
+void fakedb_reset(void);
+unsigned long long fakedb_row_count(void);
+
+/* Largest total size of live result sets since the last call (bytes) */
+unsigned long long fakedb_take_result_peak(void);
+
+#endif /* MYSQL_H */
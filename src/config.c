@@ -1,4 +1,5 @@
 #include "config.h"
+#include "archive_source.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -43,6 +44,85 @@ static int parse_bool(const char *value) {
     return 0;
 }
 
+/* Helper: parse a comma-separated list of integers; returns the count, -1 if malformed */
+static int parse_int_list(const char *value, int *out, int max) {
+    int count = 0;
+    char *end;
+
+    while (*value != '\0') {
+        long v = strtol(value, &end, 10);
+        if (end == value || count == max)
+            return -1;
+        out[count++] = (int)v;
+        while (*end == ' ' || *end == '\t')
+            end++;
+        if (*end == ',')
+            end++;
+        else if (*end != '\0')
+            return -1;
+        value = end;
+    }
+    return count;
+}
+
+/* Helper: copy one db_source field; -1 if it is too long */
+static int copy_db_field(char *dst, const char *value) {
+    size_t len = strlen(value);
+
+    if (len >= MAX_CONFIG_STRING)
+        return -1;
+    memcpy(dst, value, len + 1);
+    return 0;
+}
+
+/*
+ * Helper: parse "user:password@host:port/name" into a database source.
+ * The last '@' separates credentials so passwords may contain '@'.
+ */
+static int parse_db_source(const char *value, DbSourceConfig *src) {
+    char buf[MAX_CONFIG_STRING * 2];
+    char *at, *colon, *slash, *host;
+
+    memset(src, 0, sizeof(*src));
+    src->port = 3306;
+    strcpy(src->name, "seiscomp");
+
+    strncpy(buf, value, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    at = strrchr(buf, '@');
+    if (at == NULL)
+        return -1;
+    *at = '\0';
+    host = at + 1;
+
+    colon = strchr(buf, ':');
+    if (colon) {
+        *colon = '\0';
+        if (copy_db_field(src->password, colon + 1) < 0)
+            return -1;
+    }
+    if (copy_db_field(src->user, buf) < 0)
+        return -1;
+
+    slash = strchr(host, '/');
+    if (slash) {
+        *slash = '\0';
+        if (slash[1] != '\0' && copy_db_field(src->name, slash + 1) < 0)
+            return -1;
+    }
+
+    colon = strchr(host, ':');
+    if (colon) {
+        *colon = '\0';
+        src->port = atoi(colon + 1);
+    }
+    if (copy_db_field(src->host, host) < 0)
+        return -1;
+
+    return (src->host[0] != '\0' && src->user[0] != '\0') ? 0 : -1;
+}
+
 /* Check if a path exists and is a directory */
 static int directory_exists(const char *path) {
     struct stat st;
@@ -155,9 +235,47 @@ void config_init_defaults(AppConfig *config) {
     config->seedlink_port = 18000;
     strcpy(config->stream_file, "streams.txt");
     config->verbose = 0;
+    strcpy(config->log_level, "info");
+    config->log_rate_limit = 0;
+    config->log_debug_sample = 1;
+    config->log_ring_records = 4096;
     config->ring_buffer_minutes = 5;
     config->state_file[0] = '\0';
     config->cleanup_interval = 100;
+    config->latency_threshold = 60;
+    config->reorder_seconds = 0;
+    config->gap_file[0] = '\0';
+    config->gap_file_interval = 30;
+    config->backfill_url[0] = '\0';
+    config->backfill_max_connections = 4;
+    config->backfill_interval = 30;
+    config->backfill_delay = 60;
+    config->backfill_retries = 3;
+    config->replay_archive[0] = '\0';
+    config->replay_speed = 1.0;
+    config->dataselect_port = 0;
+    config->shm_export = 0;
+    strcpy(config->shm_prefix, "ringclient");
+    config->shm_slots = 256;
+    config->relay_port = 0;
+    config->relay_bind[0] = '\0';
+    config->relay_history = 600;
+    config->relay_max_clients = 16;
+    config->envelope_dir[0] = '\0';
+    config->envelope_levels[0] = 1;
+    config->envelope_levels[1] = 10;
+    config->envelope_levels[2] = 60;
+    config->envelope_level_count = 3;
+    config->archive_dir[0] = '\0';
+    config->segment_dir[0] = '\0';
+    config->segment_minutes = 60;
+    config->forward_address[0] = '\0';
+    config->sink_queue = 10000;
+    config->sink_max_files = 256;
+    config->snapshot_dir[0] = '\0';
+    config->snapshot_pre_sec = 60;
+    config->snapshot_post_sec = 120;
+    config->snapshot_neighbours[0] = '\0';
     
     /* Database defaults */
     config->pickfetcher_enabled = 0;
@@ -169,9 +287,23 @@ void config_init_defaults(AppConfig *config) {
     strcpy(config->picks_file, "picks.txt");
     config->picks_update_interval = 60;
     config->picks_lookback = 7200;
+    config->db_source_count = 0;
+    config->pick_query_threads = 4;
+    config->pick_dedup_tolerance_ms = 500;
+    strcpy(config->picks_shard, "none");
     
     /* Output */
     strcpy(config->output_dir, ".");
+
+    /* Metrics */
+    config->metrics_port = 0;
+    config->metrics_file[0] = '\0';
+    config->metrics_file_interval = 10;
+
+    /* Tracing */
+    config->trace_enabled = 0;
+    strcpy(config->trace_file, "trace.json");
+    config->trace_buffer_events = 65536;
 }
 
 int config_load(AppConfig *config, const char *filepath) {
@@ -221,6 +353,18 @@ int config_load(AppConfig *config, const char *filepath) {
         else if (strcasecmp(key, "verbose") == 0) {
             config->verbose = atoi(value);
         }
+        else if (strcasecmp(key, "log_level") == 0) {
+            strncpy(config->log_level, value, MAX_CONFIG_STRING - 1);
+        }
+        else if (strcasecmp(key, "log_rate_limit") == 0) {
+            config->log_rate_limit = atoi(value);
+        }
+        else if (strcasecmp(key, "log_debug_sample") == 0) {
+            config->log_debug_sample = atoi(value);
+        }
+        else if (strcasecmp(key, "log_ring_records") == 0) {
+            config->log_ring_records = atoi(value);
+        }
         else if (strcasecmp(key, "ring_buffer_minutes") == 0) {
             config->ring_buffer_minutes = atoi(value);
         }
@@ -230,6 +374,105 @@ int config_load(AppConfig *config, const char *filepath) {
         else if (strcasecmp(key, "cleanup_interval") == 0) {
             config->cleanup_interval = atoi(value);
         }
+        else if (strcasecmp(key, "latency_threshold") == 0) {
+            config->latency_threshold = atoi(value);
+        }
+        else if (strcasecmp(key, "reorder_seconds") == 0) {
+            config->reorder_seconds = atoi(value);
+        }
+        else if (strcasecmp(key, "gap_file") == 0) {
+            strncpy(config->gap_file, value, MAX_CONFIG_PATH - 1);
+        }
+        else if (strcasecmp(key, "gap_file_interval") == 0) {
+            config->gap_file_interval = atoi(value);
+        }
+        else if (strcasecmp(key, "backfill_url") == 0) {
+            strncpy(config->backfill_url, value, MAX_CONFIG_PATH - 1);
+        }
+        else if (strcasecmp(key, "backfill_max_connections") == 0) {
+            config->backfill_max_connections = atoi(value);
+        }
+        else if (strcasecmp(key, "backfill_interval") == 0) {
+            config->backfill_interval = atoi(value);
+        }
+        else if (strcasecmp(key, "backfill_delay") == 0) {
+            config->backfill_delay = atoi(value);
+        }
+        else if (strcasecmp(key, "backfill_retries") == 0) {
+            config->backfill_retries = atoi(value);
+        }
+        else if (strcasecmp(key, "replay_archive") == 0) {
+            strncpy(config->replay_archive, value, MAX_CONFIG_PATH - 1);
+        }
+        else if (strcasecmp(key, "replay_speed") == 0) {
+            config->replay_speed = atof(value);
+        }
+        else if (strcasecmp(key, "replay_start") == 0) {
+            strncpy(config->replay_start, value, MAX_CONFIG_STRING - 1);
+        }
+        else if (strcasecmp(key, "replay_end") == 0) {
+            strncpy(config->replay_end, value, MAX_CONFIG_STRING - 1);
+        }
+        else if (strcasecmp(key, "dataselect_port") == 0) {
+            config->dataselect_port = atoi(value);
+        }
+        else if (strcasecmp(key, "shm_export") == 0) {
+            config->shm_export = parse_bool(value);
+        }
+        else if (strcasecmp(key, "shm_prefix") == 0) {
+            strncpy(config->shm_prefix, value, MAX_CONFIG_STRING - 1);
+        }
+        else if (strcasecmp(key, "shm_slots") == 0) {
+            config->shm_slots = atoi(value);
+        }
+        else if (strcasecmp(key, "relay_port") == 0) {
+            config->relay_port = atoi(value);
+        }
+        else if (strcasecmp(key, "relay_bind") == 0) {
+            strncpy(config->relay_bind, value, MAX_CONFIG_STRING - 1);
+        }
+        else if (strcasecmp(key, "relay_history") == 0) {
+            config->relay_history = atoi(value);
+        }
+        else if (strcasecmp(key, "relay_max_clients") == 0) {
+            config->relay_max_clients = atoi(value);
+        }
+        else if (strcasecmp(key, "envelope_dir") == 0) {
+            strncpy(config->envelope_dir, value, MAX_CONFIG_PATH - 1);
+        }
+        else if (strcasecmp(key, "envelope_levels") == 0) {
+            config->envelope_level_count = parse_int_list(value, config->envelope_levels, 4);
+        }
+        else if (strcasecmp(key, "archive_dir") == 0) {
+            strncpy(config->archive_dir, value, MAX_CONFIG_PATH - 1);
+        }
+        else if (strcasecmp(key, "segment_dir") == 0) {
+            strncpy(config->segment_dir, value, MAX_CONFIG_PATH - 1);
+        }
+        else if (strcasecmp(key, "segment_minutes") == 0) {
+            config->segment_minutes = atoi(value);
+        }
+        else if (strcasecmp(key, "forward_address") == 0) {
+            strncpy(config->forward_address, value, MAX_CONFIG_STRING - 1);
+        }
+        else if (strcasecmp(key, "sink_queue") == 0) {
+            config->sink_queue = atoi(value);
+        }
+        else if (strcasecmp(key, "sink_max_files") == 0) {
+            config->sink_max_files = atoi(value);
+        }
+        else if (strcasecmp(key, "snapshot_dir") == 0) {
+            strncpy(config->snapshot_dir, value, MAX_CONFIG_PATH - 1);
+        }
+        else if (strcasecmp(key, "snapshot_pre_sec") == 0) {
+            config->snapshot_pre_sec = atoi(value);
+        }
+        else if (strcasecmp(key, "snapshot_post_sec") == 0) {
+            config->snapshot_post_sec = atoi(value);
+        }
+        else if (strcasecmp(key, "snapshot_neighbours") == 0) {
+            strncpy(config->snapshot_neighbours, value, MAX_CONFIG_PATH - 1);
+        }
         
         /* Database settings */
         else if (strcasecmp(key, "pickfetcher_enabled") == 0) {
@@ -256,15 +499,76 @@ int config_load(AppConfig *config, const char *filepath) {
         else if (strcasecmp(key, "picks_update_interval") == 0) {
             config->picks_update_interval = atoi(value);
         }
+        else if (strcasecmp(key, "picks_interval_min") == 0) {
+            config->picks_interval_min = atoi(value);
+        }
+        else if (strcasecmp(key, "picks_interval_max") == 0) {
+            config->picks_interval_max = atoi(value);
+        }
         else if (strcasecmp(key, "picks_lookback") == 0) {
             config->picks_lookback = atoi(value);
         }
+        else if (strcasecmp(key, "db_source") == 0) {
+            if (config->db_source_count >= MAX_DB_SOURCES - 1) {
+                fprintf(stderr, "Warning: Too many db_source entries, ignoring line %d\n",
+                        line_number);
+            } else if (parse_db_source(value,
+                           &config->db_sources[config->db_source_count]) < 0) {
+                fprintf(stderr, "Warning: Invalid db_source on line %d "
+                        "(expected user:password@host:port/name)\n", line_number);
+            } else {
+                config->db_source_count++;
+            }
+        }
+        else if (strcasecmp(key, "picks_mode") == 0) {
+            if (strcasecmp(value, "event") == 0) {
+                config->picks_event_mode = 1;
+            } else if (strcasecmp(value, "all") == 0) {
+                config->picks_event_mode = 0;
+            } else {
+                fprintf(stderr, "Warning: Unknown picks_mode '%s' on line %d\n",
+                        value, line_number);
+            }
+        }
+        else if (strcasecmp(key, "picks_shard") == 0) {
+            strncpy(config->picks_shard, value, MAX_CONFIG_STRING - 1);
+        }
+        else if (strcasecmp(key, "pick_feed") == 0) {
+            strncpy(config->pick_feed, value, MAX_CONFIG_STRING - 1);
+        }
+        else if (strcasecmp(key, "pick_query_threads") == 0) {
+            config->pick_query_threads = atoi(value);
+        }
+        else if (strcasecmp(key, "pick_dedup_tolerance_ms") == 0) {
+            config->pick_dedup_tolerance_ms = atoi(value);
+        }
         
         /* Output settings */
         else if (strcasecmp(key, "output_dir") == 0) {
             strncpy(config->output_dir, value, MAX_CONFIG_PATH - 1);
         }
         
+        /* Metrics */
+        else if (strcasecmp(key, "metrics_port") == 0) {
+            config->metrics_port = atoi(value);
+        }
+        else if (strcasecmp(key, "metrics_file") == 0) {
+            strncpy(config->metrics_file, value, MAX_CONFIG_PATH - 1);
+        }
+        else if (strcasecmp(key, "metrics_file_interval") == 0) {
+            config->metrics_file_interval = atoi(value);
+        }
+        
+        /* Tracing */
+        else if (strcasecmp(key, "trace_enabled") == 0) {
+            config->trace_enabled = parse_bool(value);
+        }
+        else if (strcasecmp(key, "trace_file") == 0) {
+            strncpy(config->trace_file, value, MAX_CONFIG_PATH - 1);
+        }
+        else if (strcasecmp(key, "trace_buffer_events") == 0) {
+            config->trace_buffer_events = atoi(value);
+        }
         else {
             fprintf(stderr, "Warning: Unknown config key '%s' on line %d\n", 
                     key, line_number);
@@ -285,10 +589,66 @@ void config_print(const AppConfig *config) {
     else if (config->verbose == 1) printf(" (normal)\n");
     else if (config->verbose >= 2) printf(" (debug)\n");
     else printf("\n");
+    printf("  log_level:         %s\n", config->log_level);
+    if (config->log_rate_limit > 0)
+        printf("  log_rate_limit:    %d/s per category\n", config->log_rate_limit);
+    if (config->log_debug_sample > 1) {
+        printf("  log_debug_sample:  1 in %d\n", config->log_debug_sample);
+    }
     printf("  ring_buffer_min:   %d\n", config->ring_buffer_minutes);
     printf("  cleanup_interval:  %d packets\n", config->cleanup_interval);
+    printf("  latency_threshold: %d sec\n", config->latency_threshold);
+    if (config->reorder_seconds > 0)
+        printf("  reorder_seconds:   %d\n", config->reorder_seconds);
+    if (config->gap_file[0])
+        printf("  gap_file:          %s (every %d sec)\n",
+               config->gap_file, config->gap_file_interval);
+    if (config->backfill_url[0])
+        printf("  backfill:          %s (%d connections, %d s delay, %d tries)\n",
+               config->backfill_url, config->backfill_max_connections,
+               config->backfill_delay, config->backfill_retries);
     printf("  state_file:        %s\n", 
            config->state_file[0] ? config->state_file : "(none)");
+    if (config->replay_archive[0]) {
+        printf("  replay_archive:    %s\n", config->replay_archive);
+        if (config->replay_speed > 0)
+            printf("  replay_speed:      %gx\n", config->replay_speed);
+        else
+            printf("  replay_speed:      max\n");
+        printf("  replay_window:     %s - %s\n",
+               config->replay_start[0] ? config->replay_start : "(start)",
+               config->replay_end[0] ? config->replay_end : "(end)");
+    }
+    if (config->dataselect_port > 0)
+        printf("  dataselect:        127.0.0.1:%d/fdsnws/dataselect/1/query\n",
+               config->dataselect_port);
+    if (config->shm_export)
+        printf("  shm_export:        %s.NET.STA.LOC.CHA, %d slots\n",
+               config->shm_prefix, config->shm_slots);
+    if (config->relay_port > 0)
+        printf("  seedlink relay:    %s:%d, %d records/station, %d clients\n",
+               config->relay_bind[0] ? config->relay_bind : "127.0.0.1",
+               config->relay_port, config->relay_history, config->relay_max_clients);
+    if (config->envelope_dir[0]) {
+        printf("  envelopes:         %s (", config->envelope_dir);
+        for (int i = 0; i < config->envelope_level_count; i++)
+            printf("%s%ds", i > 0 ? "/" : "", config->envelope_levels[i]);
+        printf(" bins)\n");
+    }
+    if (config->archive_dir[0])
+        printf("  archive sink:      %s (SDS)\n", config->archive_dir);
+    if (config->segment_dir[0])
+        printf("  segment sink:      %s (%d min)\n", config->segment_dir, config->segment_minutes);
+    if (config->forward_address[0])
+        printf("  forward sink:      %s\n", config->forward_address);
+    if (config->archive_dir[0] || config->segment_dir[0] || config->forward_address[0])
+        printf("  sink_queue:        %d records\n", config->sink_queue);
+    if (config->archive_dir[0] || config->segment_dir[0])
+        printf("  sink_max_files:    %d per file sink\n", config->sink_max_files);
+    if (config->snapshot_dir[0])
+        printf("  snapshots:         %s (-%ds/+%ds around picks%s)\n", config->snapshot_dir,
+               config->snapshot_pre_sec, config->snapshot_post_sec,
+               config->snapshot_neighbours[0] ? ", with neighbours" : "");
     
     printf("\n[PickFetcher]\n");
     printf("  enabled:           %s\n", config->pickfetcher_enabled ? "yes" : "no");
@@ -297,12 +657,49 @@ void config_print(const AppConfig *config) {
         printf("  db_user:           %s\n", config->db_user);
         printf("  db_name:           %s\n", config->db_name);
         printf("  picks_file:        %s\n", config->picks_file);
-        printf("  update_interval:   %d sec\n", config->picks_update_interval);
+        if (config->picks_interval_max > config->picks_interval_min &&
+            config->picks_interval_min > 0) {
+            printf("  update_interval:   %d-%d sec (adaptive)\n",
+                   config->picks_interval_min, config->picks_interval_max);
+        } else {
+            printf("  update_interval:   %d sec\n", config->picks_update_interval);
+        }
         printf("  lookback:          %d sec\n", config->picks_lookback);
+        printf("  picks_mode:        %s\n", config->picks_event_mode ? "event" : "all");
+        printf("  picks_shard:       %s\n", config->picks_shard);
+        printf("  pick_feed:         %s\n",
+               config->pick_feed[0] ? config->pick_feed : "(none)");
+        for (int i = 0; i < config->db_source_count; i++) {
+            printf("  db_source:         %s@%s:%d/%s\n", config->db_sources[i].user,
+                   config->db_sources[i].host, config->db_sources[i].port,
+                   config->db_sources[i].name);
+        }
+        if (config->db_source_count > 0) {
+            printf("  query_threads:     %d\n", config->pick_query_threads);
+            printf("  dedup_tolerance:   %d ms\n", config->pick_dedup_tolerance_ms);
+        }
     }
     
     printf("\n[Output]\n");
     printf("  output_dir:        %s\n", config->output_dir);
+
+    printf("\n[Metrics]\n");
+    if (config->metrics_port > 0)
+        printf("  http:              127.0.0.1:%d/metrics\n", config->metrics_port);
+    else
+        printf("  http:              (disabled)\n");
+    if (config->metrics_file[0])
+        printf("  file:              %s (every %d sec)\n",
+               config->metrics_file, config->metrics_file_interval);
+    else
+        printf("  file:              (disabled)\n");
+
+    printf("\n[Trace]\n");
+    printf("  enabled:           %s\n", config->trace_enabled ? "yes" : "no");
+    if (config->trace_enabled) {
+        printf("  trace_file:        %s\n", config->trace_file);
+        printf("  buffer_events:     %d per thread\n", config->trace_buffer_events);
+    }
     printf("=====================\n\n");
 }
 
@@ -329,6 +726,49 @@ int config_validate(const AppConfig *config) {
         errors++;
     }
     
+    if (config->reorder_seconds < 0 || config->reorder_seconds > 300) {
+        fprintf(stderr, "Error: reorder_seconds must be 0-300\n");
+        errors++;
+    }
+    else if (config->reorder_seconds >= config->ring_buffer_minutes * 60) {
+        fprintf(stderr, "Error: reorder_seconds must be shorter than ring_buffer_minutes\n");
+        errors++;
+    }
+    
+    if (config->gap_file[0] != '\0' && config->gap_file_interval <= 0) {
+        fprintf(stderr, "Error: gap_file_interval must be positive\n");
+        errors++;
+    }
+    
+    if (config->backfill_url[0] != '\0') {
+        if (strncmp(config->backfill_url, "http://", 7) != 0) {
+            fprintf(stderr, "Error: backfill_url must start with http://\n");
+            errors++;
+        }
+        if (config->backfill_max_connections < 1 || config->backfill_max_connections > 16) {
+            fprintf(stderr, "Error: backfill_max_connections must be 1-16\n");
+            errors++;
+        }
+        if (config->backfill_interval <= 0 || config->backfill_delay < 0 ||
+            config->backfill_retries <= 0) {
+            fprintf(stderr, "Error: backfill_interval and backfill_retries must be positive, backfill_delay >= 0\n");
+            errors++;
+        }
+    }
+    
+    if (config->replay_archive[0] != '\0') {
+        double t;
+        if (config->replay_speed < 0) {
+            fprintf(stderr, "Error: replay_speed cannot be negative\n");
+            errors++;
+        }
+        if ((config->replay_start[0] && archive_parse_time(config->replay_start, &t) < 0) ||
+            (config->replay_end[0] && archive_parse_time(config->replay_end, &t) < 0)) {
+            fprintf(stderr, "Error: replay_start/replay_end must be YYYY-MM-DD or YYYY-MM-DDTHH:MM:SS\n");
+            errors++;
+        }
+    }
+    
     /* Validate and create output directory */
     if (config_validate_path(config->output_dir) < 0) {
         errors++;
@@ -340,6 +780,119 @@ int config_validate(const AppConfig *config) {
         }
     }
     
+    if (strcasecmp(config->log_level, "error") != 0 &&
+        strcasecmp(config->log_level, "warn") != 0 &&
+        strcasecmp(config->log_level, "warning") != 0 &&
+        strcasecmp(config->log_level, "info") != 0 &&
+        strcasecmp(config->log_level, "debug") != 0) {
+        fprintf(stderr, "Error: log_level must be error, warn, info or debug\n");
+        errors++;
+    }
+    
+    if (config->log_rate_limit < 0 || config->log_ring_records <= 0) {
+        fprintf(stderr, "Error: log_rate_limit cannot be negative and log_ring_records must be positive\n");
+        errors++;
+    }
+    
+    if (config->metrics_port < 0 || config->metrics_port > 65535) {
+        fprintf(stderr, "Error: metrics_port must be 0-65535\n");
+        errors++;
+    }
+    
+    if (config->dataselect_port < 0 || config->dataselect_port > 65535) {
+        fprintf(stderr, "Error: dataselect_port must be 0-65535\n");
+        errors++;
+    }
+    else if (config->dataselect_port > 0 && config->dataselect_port == config->metrics_port) {
+        fprintf(stderr, "Error: dataselect_port and metrics_port must differ\n");
+        errors++;
+    }
+    
+    if (config->shm_export) {
+        if (config->shm_slots < 16 || config->shm_slots > 65536) {
+            fprintf(stderr, "Error: shm_slots must be 16-65536\n");
+            errors++;
+        }
+        if (config->shm_prefix[0] == '\0' || strpbrk(config->shm_prefix, "/\\") != NULL) {
+            fprintf(stderr, "Error: shm_prefix must be a plain name without slashes\n");
+            errors++;
+        }
+    }
+    
+    if (config->relay_port < 0 || config->relay_port > 65535) {
+        fprintf(stderr, "Error: relay_port must be 0-65535\n");
+        errors++;
+    }
+    else if (config->relay_port > 0) {
+        if (config->relay_port == config->metrics_port ||
+            config->relay_port == config->dataselect_port) {
+            fprintf(stderr, "Error: relay_port must differ from metrics_port and dataselect_port\n");
+            errors++;
+        }
+        if (config->relay_history < 10 || config->relay_history > 100000) {
+            fprintf(stderr, "Error: relay_history must be 10-100000\n");
+            errors++;
+        }
+        if (config->relay_max_clients < 1 || config->relay_max_clients > 64) {
+            fprintf(stderr, "Error: relay_max_clients must be 1-64\n");
+            errors++;
+        }
+    }
+    
+    if (config->envelope_dir[0]) {
+        int ok = config->envelope_level_count >= 1 && config->envelope_levels[0] >= 1;
+        for (int i = 1; ok && i < config->envelope_level_count; i++)
+            ok = config->envelope_levels[i] > config->envelope_levels[i - 1] &&
+                 config->envelope_levels[i] % config->envelope_levels[i - 1] == 0;
+        if (!ok) {
+            fprintf(stderr, "Error: envelope_levels must be 1-4 increasing bin widths in seconds, "
+                            "each a multiple of the one before\n");
+            errors++;
+        }
+        else if (config->envelope_levels[config->envelope_level_count - 1] >
+                 config->ring_buffer_minutes * 60) {
+            fprintf(stderr, "Error: envelope_levels must not exceed ring_buffer_minutes\n");
+            errors++;
+        }
+    }
+    
+    if (config->segment_dir[0] && (config->segment_minutes < 1 || config->segment_minutes > 1440 ||
+                                   1440 % config->segment_minutes != 0)) {
+        fprintf(stderr, "Error: segment_minutes must divide a day (1-1440)\n");
+        errors++;
+    }
+    if (config->sink_queue < 16 || config->sink_queue > 1000000) {
+        fprintf(stderr, "Error: sink_queue must be 16-1000000\n");
+        errors++;
+    }
+    if (config->sink_max_files < 1 || config->sink_max_files > 100000) {
+        fprintf(stderr, "Error: sink_max_files must be 1-100000\n");
+        errors++;
+    }
+    
+    if (config->snapshot_dir[0]) {
+        if (!config->pickfetcher_enabled) {
+            fprintf(stderr, "Error: snapshot_dir needs pickfetcher_enabled\n");
+            errors++;
+        }
+        if (config->snapshot_pre_sec < 0 || config->snapshot_post_sec < 0 ||
+            config->snapshot_pre_sec + config->snapshot_post_sec <= 0) {
+            fprintf(stderr, "Error: snapshot_pre_sec and snapshot_post_sec must be >= 0, not both 0\n");
+            errors++;
+        }
+        /* The job runs after the post window, so the pre window must still be held */
+        else if (config->snapshot_pre_sec + config->snapshot_post_sec + 10 >=
+                 config->ring_buffer_minutes * 60) {
+            fprintf(stderr, "Error: snapshot_pre_sec + snapshot_post_sec must fit in ring_buffer_minutes\n");
+            errors++;
+        }
+    }
+    
+    if (config->metrics_file[0] != '\0' && config->metrics_file_interval <= 0) {
+        fprintf(stderr, "Error: metrics_file_interval must be positive\n");
+        errors++;
+    }
+    
     if (config->pickfetcher_enabled) {
         if (config->db_host[0] == '\0') {
             fprintf(stderr, "Error: db_host is required when pickfetcher is enabled\n");
@@ -353,6 +906,31 @@ int config_validate(const AppConfig *config) {
             fprintf(stderr, "Error: picks_update_interval must be positive\n");
             errors++;
         }
+        if (config->picks_interval_min < 0 || config->picks_interval_max < 0) {
+            fprintf(stderr, "Error: picks_interval_min/max cannot be negative\n");
+            errors++;
+        }
+        if ((config->picks_interval_min > 0 || config->picks_interval_max > 0) &&
+            config->picks_interval_min > config->picks_interval_max) {
+            fprintf(stderr, "Error: picks_interval_min (%d) must not exceed picks_interval_max (%d)\n",
+                    config->picks_interval_min, config->picks_interval_max);
+            errors++;
+        }
+        if (strcasecmp(config->picks_shard, "none") != 0 &&
+            strcasecmp(config->picks_shard, "station") != 0 &&
+            strcasecmp(config->picks_shard, "hour") != 0 &&
+            strcasecmp(config->picks_shard, "day") != 0) {
+            fprintf(stderr, "Error: picks_shard must be none, station, hour or day\n");
+            errors++;
+        }
+        if (config->pick_query_threads <= 0) {
+            fprintf(stderr, "Error: pick_query_threads must be positive\n");
+            errors++;
+        }
+        if (config->pick_dedup_tolerance_ms < 0) {
+            fprintf(stderr, "Error: pick_dedup_tolerance_ms cannot be negative\n");
+            errors++;
+        }
     }
     
     return errors == 0 ? 0 : -1;
@@ -6,6 +6,7 @@
 
 #define MAX_CONFIG_STRING 256
 #define MAX_CONFIG_PATH 512
+#define MAX_DB_SOURCES 8
 
 #include <stddef.h>
 
@@ -14,6 +15,15 @@
     #define strcasecmp _stricmp
 #endif
 
+/* Additional pick database, given as db_source = user:password@host:port/name */
+typedef struct {
+    char host[MAX_CONFIG_STRING];
+    int port;
+    char user[MAX_CONFIG_STRING];
+    char password[MAX_CONFIG_STRING];
+    char name[MAX_CONFIG_STRING];
+} DbSourceConfig;
+
 /* Main application configuration */
 typedef struct {
     /* SeedLink server settings */
@@ -24,6 +34,62 @@ typedef struct {
     int ring_buffer_minutes;
     char state_file[MAX_CONFIG_PATH];
     int cleanup_interval;  /* Clean old records every N packets */
+    int latency_threshold; /* Warn when a stream is staler than N seconds */
+    int reorder_seconds;   /* Hold records to write them in time order, 0 = off */
+    char gap_file[MAX_CONFIG_PATH];  /* Periodic list of gaps, empty = disabled */
+    int gap_file_interval; /* Seconds between writes */
+
+    /* Gap backfill from an FDSNWS dataselect server */
+    char backfill_url[MAX_CONFIG_PATH];  /* Query URL, empty = disabled */
+    int backfill_max_connections;
+    int backfill_interval; /* Seconds between gap scans */
+    int backfill_delay;    /* Seconds a gap must have been closed */
+    int backfill_retries;
+
+    /* Archive replay instead of SeedLink */
+    char replay_archive[MAX_CONFIG_PATH];  /* miniSEED directory, empty = live */
+    double replay_speed;   /* Multiple of real time, 0 = as fast as possible */
+    char replay_start[MAX_CONFIG_STRING];  /* UTC window, empty = open */
+    char replay_end[MAX_CONFIG_STRING];
+
+    /* FDSNWS dataselect served from the ring buffers */
+    int dataselect_port;   /* Localhost HTTP port, 0 = disabled */
+
+    /* Shared-memory export for same-host consumers */
+    int shm_export;
+    char shm_prefix[MAX_CONFIG_STRING];    /* Segment names <prefix>.NET.STA.LOC.CHA */
+    int shm_slots;         /* Records per channel ring, rounded to a power of two */
+
+    /* SeedLink server relaying the received records */
+    int relay_port;        /* 0 = disabled */
+    char relay_bind[MAX_CONFIG_STRING];    /* Listen address, empty = 127.0.0.1 */
+    int relay_history;     /* Records kept per station for backfill */
+    int relay_max_clients;
+
+    /* Min/max envelope sidecars for viewers */
+    char envelope_dir[MAX_CONFIG_PATH];    /* NET.STA.LOC.CHA.env files, empty = disabled */
+    int envelope_levels[4];                /* Bin widths in seconds, finest first */
+    int envelope_level_count;
+
+    /* Extra output sinks, each on its own thread with its own queue */
+    char archive_dir[MAX_CONFIG_PATH];     /* SDS archive, empty = disabled */
+    char segment_dir[MAX_CONFIG_PATH];     /* Per-channel segment files, empty = disabled */
+    int segment_minutes;
+    char forward_address[MAX_CONFIG_STRING];   /* host:port, empty = disabled */
+    int sink_queue;        /* Records queued per sink before it drops */
+    int sink_max_files;    /* Open files per file sink */
+
+    /* Waveform snapshots around new picks */
+    char snapshot_dir[MAX_CONFIG_PATH];    /* Event directories, empty = disabled */
+    int snapshot_pre_sec;
+    int snapshot_post_sec;
+    char snapshot_neighbours[MAX_CONFIG_PATH];  /* Optional station neighbours file */
+
+    /* Logging */
+    char log_level[MAX_CONFIG_STRING];  /* error, warn, info or debug */
+    int log_rate_limit;    /* Messages per category per second, 0 = unlimited */
+    int log_debug_sample;  /* Keep 1 of every N debug messages */
+    int log_ring_records;  /* Records queued for the logger thread */
     
     /* Database settings for pick fetcher */
     int pickfetcher_enabled;
@@ -34,10 +100,29 @@ typedef struct {
     char db_name[MAX_CONFIG_STRING];
     char picks_file[MAX_CONFIG_PATH];
     int picks_update_interval;
+    int picks_interval_min;    /* Adaptive polling bounds (seconds), */
+    int picks_interval_max;    /* enabled when max > min */
     int picks_lookback;
+    DbSourceConfig db_sources[MAX_DB_SOURCES - 1];  /* In addition to db_host */
+    int db_source_count;
+    int pick_query_threads;
+    int pick_dedup_tolerance_ms;
+    int picks_event_mode;      /* picks_mode = event: only associated picks */
+    char picks_shard[MAX_CONFIG_STRING];  /* none, station, hour or day */
+    char pick_feed[MAX_CONFIG_STRING];  /* Push feed, unix:/path or tcp:host:port */
     
     /* Output directory */
     char output_dir[MAX_CONFIG_PATH];
+
+    /* Metrics */
+    int metrics_port;          /* Localhost HTTP port, 0 = disabled */
+    char metrics_file[MAX_CONFIG_PATH];  /* Periodic dump, empty = disabled */
+    int metrics_file_interval; /* Seconds between dumps */
+
+    /* Tracing */
+    int trace_enabled;
+    char trace_file[MAX_CONFIG_PATH];   /* Chrome trace JSON output */
+    int trace_buffer_events;   /* Span ring size per thread */
 } AppConfig;
 
 /* Initialize configuration with defaults */
@@ -52,4 +137,7 @@ void config_print(const AppConfig *config);
 /* Validate configuration */
 int config_validate(const AppConfig *config);
 
+/* Create a directory and its parents; 0 if it exists afterwards */
+int config_create_directory(const char *path);
+
 #endif /* CONFIG_H */
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include "dataselect.h"
+#include "ringclient.h"
+#include "archive_source.h"
+#include "httpd.h"
+#include "metrics.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define DS_MAX_PATTERNS 16
+#define DS_PATTERN_LEN 16
+
+#define DS_PREFIX "/fdsnws/dataselect/1/"
+#define DS_VERSION "1.1.0"
+
+/* One comma separated code list; count 0 matches everything */
+typedef struct {
+    char patterns[DS_MAX_PATTERNS][DS_PATTERN_LEN];
+    int count;
+} CodeList;
+
+typedef struct {
+    CodeList network;
+    CodeList station;
+    CodeList location;
+    CodeList channel;
+    double start_time;
+    double end_time;
+    int nodata_status;
+} DataselectQuery;
+
+static HttpServer *g_http = NULL;
+static MetricCounter *g_requests_metric = NULL;
+static MetricCounter *g_bytes_metric = NULL;
+static MetricHistogram *g_select_metric = NULL;
+
+/* Case-insensitive glob with * and ? */
+static int glob_match(const char *pattern, const char *text) {
+    const char *star = NULL;
+    const char *resume = NULL;
+
+    while (*text) {
+        if (*pattern == '*') {
+            star = pattern++;
+            resume = text;
+        } else if (*pattern == '?' ||
+                   toupper((unsigned char)*pattern) == toupper((unsigned char)*text)) {
+            pattern++;
+            text++;
+        } else if (star != NULL) {
+            pattern = star + 1;
+            text = ++resume;
+        } else {
+            return 0;
+        }
+    }
+    while (*pattern == '*')
+        pattern++;
+    return *pattern == '\0';
+}
+
+static int list_match(const CodeList *list, const char *code) {
+    int i;
+
+    if (list->count == 0)
+        return 1;
+    for (i = 0; i < list->count; i++) {
+        if (glob_match(list->patterns[i], code))
+            return 1;
+    }
+    return 0;
+}
+
+/* Parse "a,b,c"; an empty location is written "--"; -1 if malformed */
+static int parse_list(const char *value, CodeList *list, int is_location) {
+    const char *p = value;
+
+    list->count = 0;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        char *dst;
+
+        if (len == 0 || len >= DS_PATTERN_LEN || list->count == DS_MAX_PATTERNS)
+            return -1;
+
+        dst = list->patterns[list->count++];
+        memcpy(dst, p, len);
+        dst[len] = '\0';
+        if (is_location && strcmp(dst, "--") == 0)
+            dst[0] = '\0';
+
+        p += len;
+        if (*p == ',')
+            p++;
+    }
+    return 0;
+}
+
+/* Look up a parameter by its long or short FDSN name */
+static int query_param(const char *query, const char *name, const char *alias,
+                       char *value, size_t len) {
+    if (httpd_query_param(query, name, value, len) == 0)
+        return 0;
+    return httpd_query_param(query, alias, value, len);
+}
+
+/* Fill q from the query string; returns NULL or an error message */
+static const char* parse_query(const char *query, DataselectQuery *q) {
+    char value[512];
+
+    memset(q, 0, sizeof(*q));
+    q->nodata_status = 204;
+
+    if (query_param(query, "network", "net", value, sizeof(value)) == 0 &&
+        parse_list(value, &q->network, 0) < 0)
+        return "Bad network list\n";
+    if (query_param(query, "station", "sta", value, sizeof(value)) == 0 &&
+        parse_list(value, &q->station, 0) < 0)
+        return "Bad station list\n";
+    if (query_param(query, "location", "loc", value, sizeof(value)) == 0 &&
+        parse_list(value, &q->location, 1) < 0)
+        return "Bad location list\n";
+    if (query_param(query, "channel", "cha", value, sizeof(value)) == 0 &&
+        parse_list(value, &q->channel, 0) < 0)
+        return "Bad channel list\n";
+
+    if (query_param(query, "starttime", "start", value, sizeof(value)) == 0 &&
+        archive_parse_time(value, &q->start_time) < 0)
+        return "Bad starttime, expected YYYY-MM-DDThh:mm:ss[.ssssss]\n";
+    if (query_param(query, "endtime", "end", value, sizeof(value)) == 0 &&
+        archive_parse_time(value, &q->end_time) < 0)
+        return "Bad endtime, expected YYYY-MM-DDThh:mm:ss[.ssssss]\n";
+    if (q->start_time > 0.0 && q->end_time > 0.0 && q->end_time <= q->start_time)
+        return "endtime must be after starttime\n";
+
+    if (httpd_query_param(query, "nodata", value, sizeof(value)) == 0) {
+        if (strcmp(value, "204") != 0 && strcmp(value, "404") != 0)
+            return "nodata must be 204 or 404\n";
+        q->nodata_status = atoi(value);
+    }
+    if (httpd_query_param(query, "format", value, sizeof(value)) == 0 &&
+        strcmp(value, "miniseed") != 0)
+        return "Only format=miniseed is supported\n";
+
+    return NULL;
+}
+
+static int record_filter(const char *network, const char *station,
+                         const char *location, const char *channel, void *ctx) {
+    const DataselectQuery *q = (const DataselectQuery*)ctx;
+
+    return list_match(&q->network, network) && list_match(&q->station, station) &&
+           list_match(&q->location, location) && list_match(&q->channel, channel);
+}
+
+static int handle_query(NetSocket client, const HttpRequest *req) {
+    DataselectQuery q;
+    RingSelection selection;
+    const char *error;
+    long long start_us;
+    int i;
+
+    error = parse_query(req->query, &q);
+    if (error != NULL)
+        return httpd_send_response(client, 400, "text/plain", error, strlen(error));
+
+    memset(&selection, 0, sizeof(selection));
+    start_us = platform_monotonic_us();
+    if (ringclient_select(record_filter, &q, q.start_time, q.end_time, &selection) < 0) {
+        const char *msg = "Out of memory selecting records\n";
+        ringclient_selection_free(&selection);
+        return httpd_send_response(client, 500, "text/plain", msg, strlen(msg));
+    }
+    metrics_histogram_record(g_select_metric, platform_monotonic_us() - start_us);
+
+    if (selection.total_bytes == 0) {
+        ringclient_selection_free(&selection);
+        if (q.nodata_status == 404) {
+            const char *msg = "No data matches the request\n";
+            return httpd_send_response(client, 404, "text/plain", msg, strlen(msg));
+        }
+        return httpd_send_header(client, 204, "text/plain", 0);
+    }
+
+    if (httpd_send_header(client, 200, "application/vnd.fdsn.mseed",
+                          selection.total_bytes) == 0 &&
+        strcmp(req->method, "HEAD") != 0) {
+        for (i = 0; i < selection.extent_count; i++) {
+            const RingExtent *extent = &selection.extents[i];
+            if (net_send_file(client, selection.fds[extent->file],
+                              extent->offset, extent->length) < 0)
+                break;
+        }
+        metrics_counter_add(g_bytes_metric, (unsigned long long)selection.total_bytes);
+    }
+
+    ringclient_selection_free(&selection);
+    return 0;
+}
+
+static int dataselect_http_handler(NetSocket client, const HttpRequest *req, void *ctx) {
+    (void)ctx;
+
+    metrics_counter_add(g_requests_metric, 1);
+
+    if (strcmp(req->path, DS_PREFIX "query") == 0)
+        return handle_query(client, req);
+
+    if (strcmp(req->path, DS_PREFIX "version") == 0)
+        return httpd_send_response(client, 200, "text/plain", DS_VERSION "\n",
+                                   strlen(DS_VERSION "\n"));
+
+    {
+        const char *msg = "Not found, try " DS_PREFIX "query?net=..&sta=..&start=..&end=..\n";
+        return httpd_send_response(client, 404, "text/plain", msg, strlen(msg));
+    }
+}
+
+int dataselect_start(const char *host, int port) {
+    g_requests_metric = metrics_counter("dataselect_requests_total", NULL,
+                                        "HTTP requests to the dataselect endpoint");
+    g_bytes_metric = metrics_counter("dataselect_bytes_total", NULL,
+                                     "miniSEED bytes sent by the dataselect endpoint");
+    g_select_metric = metrics_histogram("dataselect_select_seconds", NULL,
+                                        "Time to select records under the index lock");
+
+    g_http = httpd_start(host, port, dataselect_http_handler, NULL);
+    if (g_http == NULL) {
+        fprintf(stderr, "[Dataselect] Failed to start HTTP endpoint on port %d\n", port);
+        return -1;
+    }
+    printf("[Dataselect] Serving http://%s:%d" DS_PREFIX "query\n",
+           (host && host[0]) ? host : "127.0.0.1", port);
+    return 0;
+}
+
+void dataselect_stop(void) {
+    httpd_stop(g_http);
+    g_http = NULL;
+}
@@ -0,0 +1,21 @@
+#ifndef DATASELECT_H
+#define DATASELECT_H
+
+/*
+ * Localhost FDSNWS-dataselect endpoint answered from the ring buffers.
+ *
+ *   GET /fdsnws/dataselect/1/query?net=XX&sta=ABC&cha=HH?&start=...&end=...
+ *
+ * Supports net/sta/loc/cha (comma lists, * and ? wildcards, "--" for an
+ * empty location), start/end (starttime/endtime), nodata=204|404 and
+ * format=miniseed. Matching records are sent straight from the ring files
+ * using the ringclient record index, so the ringclient must run with
+ * record_index enabled.
+ */
+
+/* Start serving on host:port (empty host = 127.0.0.1); 0 on success */
+int dataselect_start(const char *host, int port);
+
+void dataselect_stop(void);
+
+#endif /* DATASELECT_H */
@@ -0,0 +1,346 @@
+#include "envelope.h"
+#include "config.h"
+#include "platform.h"
+#include "metrics.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+#define ENVELOPE_BUCKETS 4096
+
+typedef struct EnvelopeFile {
+    char key[32];               /* NET.STA.LOC.CHA */
+    EnvelopeHeader *env;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+    struct EnvelopeFile *next;
+} EnvelopeFile;
+
+static char g_dir[512];
+static int g_levels[ENVELOPE_MAX_LEVELS];
+static int g_level_count = 0;
+static int g_ring_seconds = 0;
+static EnvelopeFile *g_buckets[ENVELOPE_BUCKETS];
+static int g_started = 0;
+
+/* Decode buffer, only touched by the sink thread */
+static int32_t *g_samples = NULL;
+static int g_samples_capacity = 0;
+
+static MetricCounter *g_records_metric = NULL;
+static MetricCounter *g_skipped_metric = NULL;
+static MetricGauge *g_files_metric = NULL;
+
+static unsigned int hash_key(const char *key) {
+    unsigned int h = 2166136261u;
+
+    while (*key)
+        h = (h ^ (unsigned char)*key++) * 16777619u;
+    return h;
+}
+
+static size_t envelope_size(void) {
+    size_t size = sizeof(EnvelopeHeader);
+    int i;
+
+    for (i = 0; i < g_level_count; i++)
+        size += (size_t)(g_ring_seconds / g_levels[i] + 2) * sizeof(EnvelopeBin);
+    return size;
+}
+
+static EnvelopeBin* level_bins(EnvelopeHeader *env, int level) {
+    return (EnvelopeBin*)((char*)env + env->levels[level].offset);
+}
+
+/* Map (creating or resizing if needed) the sidecar of one channel; NULL on failure */
+static EnvelopeHeader* map_file(EnvelopeFile *ef, const char *path, size_t size) {
+    EnvelopeHeader *env;
+
+#ifdef _WIN32
+    ef->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                           NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (ef->file == INVALID_HANDLE_VALUE)
+        return NULL;
+    /* Mapping grows the file to size */
+    ef->mapping = CreateFileMappingA(ef->file, NULL, PAGE_READWRITE,
+                                     (DWORD)((unsigned long long)size >> 32),
+                                     (DWORD)(size & 0xffffffffu), NULL);
+    if (ef->mapping == NULL) {
+        CloseHandle(ef->file);
+        return NULL;
+    }
+    env = (EnvelopeHeader*)MapViewOfFile(ef->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (env == NULL) {
+        CloseHandle(ef->mapping);
+        CloseHandle(ef->file);
+        return NULL;
+    }
+#else
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if (fd < 0)
+        return NULL;
+    if (ftruncate(fd, (off_t)size) < 0) {
+        close(fd);
+        return NULL;
+    }
+    env = (EnvelopeHeader*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (env == MAP_FAILED)
+        return NULL;
+#endif
+
+    ef->size = size;
+    return env;
+}
+
+/* Same levels and retention as an earlier run: its bins are still valid */
+static int layout_matches(const EnvelopeHeader *env) {
+    int i;
+
+    if (env->magic != ENVELOPE_MAGIC || env->version != ENVELOPE_VERSION ||
+        env->level_count != (uint32_t)g_level_count ||
+        env->ring_seconds != (uint32_t)g_ring_seconds)
+        return 0;
+    for (i = 0; i < g_level_count; i++) {
+        if (env->levels[i].bin_seconds != (uint32_t)g_levels[i])
+            return 0;
+    }
+    return 1;
+}
+
+static EnvelopeFile* find_or_create(const MSeedHeader *hdr) {
+    char key[32];
+    char path[600];
+    unsigned int b;
+    EnvelopeFile *ef;
+    EnvelopeHeader *env;
+    size_t size = envelope_size();
+    unsigned long long offset;
+    int i;
+
+    snprintf(key, sizeof(key), "%s.%s.%s.%s", hdr->network, hdr->station,
+             hdr->location, hdr->channel);
+    b = hash_key(key) & (ENVELOPE_BUCKETS - 1);
+    for (ef = g_buckets[b]; ef != NULL; ef = ef->next) {
+        if (strcmp(ef->key, key) == 0)
+            return ef;
+    }
+
+    ef = (EnvelopeFile*)calloc(1, sizeof(EnvelopeFile));
+    if (ef == NULL)
+        return NULL;
+    strcpy(ef->key, key);
+
+    snprintf(path, sizeof(path), "%s/%s.env", g_dir, key);
+    env = map_file(ef, path, size);
+    if (env == NULL) {
+        LOG_ERROR(LOG_CAT_SINK, "Cannot map envelope file %s", path);
+        free(ef);
+        return NULL;
+    }
+
+    if (!layout_matches(env)) {
+        memset(env, 0, size);
+        env->version = ENVELOPE_VERSION;
+        env->level_count = (uint32_t)g_level_count;
+        env->ring_seconds = (uint32_t)g_ring_seconds;
+        offset = sizeof(EnvelopeHeader);
+        for (i = 0; i < g_level_count; i++) {
+            env->levels[i].bin_seconds = (uint32_t)g_levels[i];
+            env->levels[i].slot_count = (uint32_t)(g_ring_seconds / g_levels[i] + 2);
+            env->levels[i].offset = offset;
+            offset += env->levels[i].slot_count * sizeof(EnvelopeBin);
+        }
+        memcpy(env->network, hdr->network, sizeof(hdr->network));
+        memcpy(env->station, hdr->station, sizeof(hdr->station));
+        memcpy(env->location, hdr->location, sizeof(hdr->location));
+        memcpy(env->channel, hdr->channel, sizeof(hdr->channel));
+        platform_atomic_fence();
+        env->magic = ENVELOPE_MAGIC;
+    }
+    env->sample_rate = hdr->sample_rate;
+
+    ef->env = env;
+    ef->next = g_buckets[b];
+    g_buckets[b] = ef;
+    metrics_gauge_set(g_files_metric, metrics_gauge_value(g_files_metric) + 1);
+    return ef;
+}
+
+/* Widen bin b of a level, or start it in the slot of a bin that aged out */
+static void update_bin(EnvelopeHeader *env, int level, unsigned long long b,
+                       int32_t min, int32_t max) {
+    EnvelopeBin *slot = level_bins(env, level) + b % env->levels[level].slot_count;
+    unsigned long long current = slot->bin;
+
+    if (current == b) {
+        if (min < slot->min)
+            slot->min = min;
+        if (max > slot->max)
+            slot->max = max;
+        return;
+    }
+    if (current > b)
+        return;                 /* Older than the retention: the slot moved on */
+
+    platform_atomic_store_u64(&slot->bin, 0);
+    platform_atomic_fence();
+    slot->min = min;
+    slot->max = max;
+    platform_atomic_store_release_u64(&slot->bin, b);
+}
+
+/*
+ * Fold samples starting at start_time into every level, one finest bin at a
+ * time. Epoch times carry ~1e-7 s of rounding, so a sample within 1/1000
+ * of a sample interval of a bin edge counts as on the edge.
+ */
+static void fold_samples(EnvelopeHeader *env, double start_time, double sample_rate,
+                         const int32_t *samples, int count) {
+    const double width = g_levels[0];
+    int i = 0;
+
+    while (i < count) {
+        double t = start_time + (i + 0.001) / sample_rate;
+        unsigned long long b = (unsigned long long)floor(t / width);
+        int end = (int)ceil(((double)(b + 1) * width - start_time) * sample_rate - 0.001);
+        int32_t min = samples[i];
+        int32_t max = samples[i];
+        int level;
+
+        if (end <= i)
+            end = i + 1;
+        if (end > count)
+            end = count;
+        for (i++; i < end; i++) {
+            if (samples[i] < min)
+                min = samples[i];
+            if (samples[i] > max)
+                max = samples[i];
+        }
+
+        for (level = 0; level < g_level_count; level++)
+            update_bin(env, level, b / (unsigned long long)(g_levels[level] / g_levels[0]),
+                       min, max);
+    }
+}
+
+static int envelope_write(const SinkRecord *rec, void *ctx) {
+    const MSeedHeader *hdr = &rec->hdr;
+    EnvelopeFile *ef;
+    int count;
+
+    (void)ctx;
+
+    /* Bin index 0 means empty, so times before the first coarsest bin are skipped */
+    if (!g_started || hdr->sample_count <= 0 || hdr->sample_rate <= 0.0 ||
+        hdr->start_time < g_levels[g_level_count - 1])
+        return 0;
+
+    if (hdr->sample_count > g_samples_capacity) {
+        int32_t *grown = (int32_t*)realloc(g_samples, (size_t)hdr->sample_count * sizeof(int32_t));
+        if (grown == NULL)
+            return -1;
+        g_samples = grown;
+        g_samples_capacity = hdr->sample_count;
+    }
+
+    count = mseed_decode_samples(rec->record, rec->length, hdr, g_samples, g_samples_capacity);
+    if (count <= 0) {
+        metrics_counter_add(g_skipped_metric, 1);
+        return 0;
+    }
+
+    ef = find_or_create(hdr);
+    if (ef == NULL) {
+        metrics_counter_add(g_skipped_metric, 1);
+        return -1;
+    }
+
+    fold_samples(ef->env, hdr->start_time, hdr->sample_rate, g_samples, count);
+    if (hdr->end_time > ef->env->newest_time)
+        ef->env->newest_time = hdr->end_time;
+
+    metrics_counter_add(g_records_metric, 1);
+    return 0;
+}
+
+const SinkOps envelope_ops = { envelope_write, NULL, NULL };
+
+int envelope_start(const char *dir, const int *levels, int level_count, int ring_seconds) {
+    int i;
+
+    if (dir == NULL || dir[0] == '\0' || level_count < 1 || level_count > ENVELOPE_MAX_LEVELS ||
+        ring_seconds <= 0)
+        return -1;
+    for (i = 0; i < level_count; i++) {
+        if (levels[i] <= 0 || (i > 0 && levels[i] % levels[i - 1] != 0))
+            return -1;
+        g_levels[i] = levels[i];
+    }
+    g_level_count = level_count;
+    g_ring_seconds = ring_seconds;
+    strncpy(g_dir, dir, sizeof(g_dir) - 1);
+    g_dir[sizeof(g_dir) - 1] = '\0';
+
+    if (config_create_directory(g_dir) != 0) {
+        LOG_ERROR(LOG_CAT_SINK, "Cannot create envelope directory %s", g_dir);
+        return -1;
+    }
+
+    g_records_metric = metrics_counter("envelope_records_total", NULL,
+                                       "Records folded into envelope sidecars");
+    g_skipped_metric = metrics_counter("envelope_skipped_total", NULL,
+                                       "Records not folded (undecodable or unmappable)");
+    g_files_metric = metrics_gauge("envelope_files", NULL,
+                                   "Envelope sidecar files mapped");
+
+    g_started = 1;
+    LOG_INFO(LOG_CAT_SINK, "Envelopes in %s/NET.STA.LOC.CHA.env, %d levels (%.1f KB each)",
+             g_dir, g_level_count, envelope_size() / 1024.0);
+    return 0;
+}
+
+void envelope_stop(void) {
+    int i;
+
+    if (!g_started)
+        return;
+    g_started = 0;
+
+    for (i = 0; i < ENVELOPE_BUCKETS; i++) {
+        EnvelopeFile *ef = g_buckets[i];
+        while (ef != NULL) {
+            EnvelopeFile *next = ef->next;
+#ifdef _WIN32
+            UnmapViewOfFile(ef->env);
+            CloseHandle(ef->mapping);
+            CloseHandle(ef->file);
+#else
+            munmap(ef->env, ef->size);
+#endif
+            free(ef);
+            ef = next;
+        }
+        g_buckets[i] = NULL;
+    }
+
+    free(g_samples);
+    g_samples = NULL;
+    g_samples_capacity = 0;
+}
@@ -0,0 +1,76 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+/*
+ * Min/max envelope pyramid for overview drawing. Every record the
+ * ringclient writes is decoded and folded into per-channel min/max bins at
+ * a few resolutions (default 1 s, 10 s and 60 s), kept in a memory-mapped
+ * sidecar file DIR/NET.STA.LOC.CHA.env. A viewer maps the file read-only
+ * and draws a window from the coarsest level with enough bins per pixel,
+ * instead of decoding every record in the ring.
+ *
+ * Each level is a circular array sized to the ring buffer duration: the bin
+ * starting at time t (epoch seconds, a multiple of bin_seconds) has index
+ * b = t / bin_seconds and lives in slot b % slot_count, so the file keeps
+ * the same retention as the ring without any trimming pass. A slot whose
+ * bin field differs from the wanted index holds no data for that bin
+ * (gap, aged out, or not yet written); 0 marks an empty slot.
+ *
+ * Single writer, no locks. The writer stores bin = 0 before reusing a
+ * slot and the new index after setting min and max; a reader that sees the
+ * expected index before and after copying a slot has a usable value (min
+ * and max only widen while a bin is open). All fields are in host byte
+ * order.
+ *
+ * envelope_ops is a queued sink (see sink.h) and runs on its own sink
+ * thread, so decoding and page faults stay off the receive thread; start
+ * before the ringclient thread and stop after sink_stop_all().
+ */
+
+#include <stdint.h>
+#include "sink.h"
+
+#define ENVELOPE_MAGIC 0x454e564cu      /* "ENVL" */
+#define ENVELOPE_VERSION 1
+#define ENVELOPE_MAX_LEVELS 4
+
+typedef struct {
+    uint32_t bin_seconds;
+    uint32_t slot_count;
+    uint64_t offset;                    /* File offset of the level's first EnvelopeBin */
+} EnvelopeLevel;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t level_count;
+    uint32_t ring_seconds;              /* Retention the levels were sized for */
+    EnvelopeLevel levels[ENVELOPE_MAX_LEVELS];
+    char network[4];
+    char station[8];
+    char location[4];
+    char channel[4];
+    uint32_t reserved0;
+    double sample_rate;
+    volatile double newest_time;        /* End of the newest record folded in */
+    char reserved[8];                   /* Pads the header to 128 bytes */
+} EnvelopeHeader;
+
+typedef struct {
+    volatile unsigned long long bin;    /* Bin index, 0 = empty or being reused */
+    int32_t min;
+    int32_t max;
+} EnvelopeBin;
+
+/*
+ * levels: bin widths in seconds, finest first, each a multiple of the one
+ * before; ring_seconds: retention of the ring buffers. 0 on success.
+ */
+int envelope_start(const char *dir, const int *levels, int level_count, int ring_seconds);
+
+extern const SinkOps envelope_ops;
+
+/* Unmap every sidecar; the files stay for viewers and the next run */
+void envelope_stop(void);
+
+#endif /* ENVELOPE_H */
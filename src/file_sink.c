@@ -0,0 +1,316 @@
+#include "file_sink.h"
+#include "platform.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+    #include <direct.h>
+    #define mkdir(path, mode) _mkdir(path)
+#else
+    #include <sys/types.h>
+#endif
+
+#define FILE_SINK_BUCKETS 1024
+#define FILE_SINK_PATH 1024
+#define FILE_SINK_IDLE_US (300LL * 1000000LL)  /* Close files unused this long */
+#define FILE_SINK_FLUSH_US 1000000LL            /* At most one fflush pass per second */
+
+typedef struct OpenFile {
+    char key[40];                   /* NET.STA.LOC.CHA */
+    long period;                    /* Day or segment number of the open file */
+    FILE *fp;
+    int dirty;
+    long long last_write_us;
+    struct OpenFile *next;
+    struct OpenFile *lru_prev;      /* Open files, most recently written first */
+    struct OpenFile *lru_next;
+} OpenFile;
+
+/* A record's codes as they appear in file names, see clean_codes() */
+typedef struct {
+    char network[8];
+    char station[8];
+    char location[8];
+    char channel[8];
+} ChannelCodes;
+
+struct FileSink {
+    char root[FILE_SINK_PATH];
+    FileSinkLayout layout;
+    long period_seconds;
+    OpenFile *buckets[FILE_SINK_BUCKETS];
+    OpenFile *lru_head;
+    OpenFile *lru_tail;
+    int open_count;
+    int max_open;                   /* Least recently written file closed beyond this */
+    long long last_flush_us;
+    long long last_sweep_us;
+    int failing;                    /* Last open failed; warn once per episode */
+    long refused;                   /* Records with codes unfit for a path */
+};
+
+static unsigned int hash_key(const char *key) {
+    unsigned int h = 2166136261u;
+
+    while (*key)
+        h = (h ^ (unsigned char)*key++) * 16777619u;
+    return h;
+}
+
+/* mkdir -p for the directory part of path */
+static int make_parent_dirs(const char *path) {
+    char tmp[FILE_SINK_PATH];
+    char *p;
+
+    strncpy(tmp, path, sizeof(tmp) - 1);
+    tmp[sizeof(tmp) - 1] = '\0';
+    p = strrchr(tmp, '/');
+    if (p == NULL)
+        return 0;
+    *p = '\0';
+
+    for (p = tmp + 1; *p; p++) {
+        if (*p != '/')
+            continue;
+        *p = '\0';
+        if (tmp[strlen(tmp) - 1] != ':' && mkdir(tmp, 0755) != 0 && errno != EEXIST)
+            return -1;
+        *p = '/';
+    }
+    return (mkdir(tmp, 0755) != 0 && errno != EEXIST) ? -1 : 0;
+}
+
+/* Codes end up in file names; refuse anything that could leave the directory */
+static int safe_code(const char *code, int required) {
+    return (code[0] != '\0' || !required) && strchr(code, '/') == NULL &&
+           strchr(code, '\\') == NULL && strstr(code, "..") == NULL;
+}
+
+static void clean_code(char *dst, size_t len, const char *src) {
+    size_t i;
+
+    for (i = 0; src[i] && i + 1 < len; i++)
+        dst[i] = isalnum((unsigned char)src[i]) || src[i] == '-' ? src[i] : '_';
+    dst[i] = '\0';
+}
+
+/* Copy a header's codes for use in paths; -1 if they are unsafe (empty location is fine) */
+static int clean_codes(const MSeedHeader *hdr, ChannelCodes *codes) {
+    if (!safe_code(hdr->network, 1) || !safe_code(hdr->station, 1) ||
+        !safe_code(hdr->location, 0) || !safe_code(hdr->channel, 1))
+        return -1;
+    clean_code(codes->network, sizeof(codes->network), hdr->network);
+    clean_code(codes->station, sizeof(codes->station), hdr->station);
+    clean_code(codes->location, sizeof(codes->location), hdr->location);
+    clean_code(codes->channel, sizeof(codes->channel), hdr->channel);
+    return 0;
+}
+
+/* -1 if the path does not fit in len */
+static int build_path(const FileSink *fs, const ChannelCodes *codes, long period,
+                      char *path, size_t len) {
+    time_t t = (time_t)period * fs->period_seconds;
+    struct tm tm_info;
+    int n;
+
+    memset(&tm_info, 0, sizeof(tm_info));
+    platform_gmtime(&t, &tm_info);
+
+    if (fs->layout == FILE_SINK_SDS) {
+        n = snprintf(path, len, "%s/%04d/%s/%s/%s.D/%s.%s.%s.%s.D.%04d.%03d",
+                 fs->root, tm_info.tm_year + 1900, codes->network, codes->station, codes->channel,
+                 codes->network, codes->station, codes->location, codes->channel,
+                 tm_info.tm_year + 1900, tm_info.tm_yday + 1);
+    } else {
+        n = snprintf(path, len, "%s/%s.%s.%s.%s/%s.%s.%s.%s.%04d%02d%02dT%02d%02d%02d.mseed",
+                 fs->root, codes->network, codes->station, codes->location, codes->channel,
+                 codes->network, codes->station, codes->location, codes->channel,
+                 tm_info.tm_year + 1900, tm_info.tm_mon + 1, tm_info.tm_mday,
+                 tm_info.tm_hour, tm_info.tm_min, tm_info.tm_sec);
+    }
+    return n < 0 || (size_t)n >= len ? -1 : 0;
+}
+
+static void lru_unlink(FileSink *fs, OpenFile *of) {
+    if (of->lru_prev != NULL)
+        of->lru_prev->lru_next = of->lru_next;
+    else
+        fs->lru_head = of->lru_next;
+    if (of->lru_next != NULL)
+        of->lru_next->lru_prev = of->lru_prev;
+    else
+        fs->lru_tail = of->lru_prev;
+    of->lru_prev = of->lru_next = NULL;
+}
+
+static void lru_push(FileSink *fs, OpenFile *of) {
+    of->lru_prev = NULL;
+    of->lru_next = fs->lru_head;
+    if (fs->lru_head != NULL)
+        fs->lru_head->lru_prev = of;
+    else
+        fs->lru_tail = of;
+    fs->lru_head = of;
+}
+
+static void close_file(FileSink *fs, OpenFile *of) {
+    fclose(of->fp);
+    of->fp = NULL;
+    of->dirty = 0;
+    lru_unlink(fs, of);
+    fs->open_count--;
+}
+
+static OpenFile* find_or_add(FileSink *fs, const char *key) {
+    unsigned int b = hash_key(key) & (FILE_SINK_BUCKETS - 1);
+    OpenFile *of;
+
+    for (of = fs->buckets[b]; of != NULL; of = of->next) {
+        if (strcmp(of->key, key) == 0)
+            return of;
+    }
+
+    of = (OpenFile*)calloc(1, sizeof(OpenFile));
+    if (of == NULL)
+        return NULL;
+    snprintf(of->key, sizeof(of->key), "%s", key);
+    of->next = fs->buckets[b];
+    fs->buckets[b] = of;
+    return of;
+}
+
+static int file_sink_write(const SinkRecord *rec, void *ctx) {
+    FileSink *fs = (FileSink*)ctx;
+    const MSeedHeader *hdr = &rec->hdr;
+    ChannelCodes codes;
+    char key[40];
+    long period = (long)floor(hdr->start_time / (double)fs->period_seconds);
+    OpenFile *of;
+
+    if (clean_codes(hdr, &codes) < 0) {
+        if (++fs->refused == 1 || fs->refused % 1000 == 0)
+            LOG_WARN(LOG_CAT_SINK, "Refused %ld records with unsafe codes, last %s.%s.%s.%s",
+                     fs->refused, hdr->network, hdr->station, hdr->location, hdr->channel);
+        return -1;
+    }
+    snprintf(key, sizeof(key), "%s.%s.%s.%s", codes.network, codes.station,
+             codes.location, codes.channel);
+    of = find_or_add(fs, key);
+    if (of == NULL)
+        return -1;
+
+    if (of->fp == NULL || of->period != period) {
+        char path[FILE_SINK_PATH];
+
+        if (of->fp != NULL)
+            close_file(fs, of);
+        /* Thousands of channels must not run the process out of descriptors */
+        if (fs->open_count >= fs->max_open)
+            close_file(fs, fs->lru_tail);
+        if (build_path(fs, &codes, period, path, sizeof(path)) < 0)
+            errno = ENAMETOOLONG;
+        else if (make_parent_dirs(path) == 0)
+            of->fp = fopen(path, "ab");
+        if (of->fp == NULL) {
+            /* path may be half built here; the key names the channel */
+            if (!fs->failing)
+                LOG_ERROR(LOG_CAT_SINK, "Cannot open the file for %s: %s", key, strerror(errno));
+            fs->failing = 1;
+            return -1;
+        }
+        fs->failing = 0;
+        of->period = period;
+        lru_push(fs, of);
+        fs->open_count++;
+    } else if (fs->lru_head != of) {
+        lru_unlink(fs, of);
+        lru_push(fs, of);
+    }
+
+    if (fwrite(rec->record, 1, rec->length, of->fp) != rec->length)
+        return -1;
+    of->dirty = 1;
+    of->last_write_us = platform_monotonic_us();
+    return 0;
+}
+
+/* fflush written files once a second and close the ones gone quiet */
+static void file_sink_flush(void *ctx) {
+    FileSink *fs = (FileSink*)ctx;
+    long long now = platform_monotonic_us();
+    int sweep;
+    int i;
+
+    if (now - fs->last_flush_us < FILE_SINK_FLUSH_US)
+        return;
+    fs->last_flush_us = now;
+    sweep = now - fs->last_sweep_us >= FILE_SINK_IDLE_US / 10;
+    if (sweep)
+        fs->last_sweep_us = now;
+
+    for (i = 0; i < FILE_SINK_BUCKETS; i++) {
+        OpenFile *of;
+        for (of = fs->buckets[i]; of != NULL; of = of->next) {
+            if (of->fp == NULL)
+                continue;
+            if (sweep && now - of->last_write_us > FILE_SINK_IDLE_US) {
+                close_file(fs, of);
+            } else if (of->dirty) {
+                fflush(of->fp);
+                of->dirty = 0;
+            }
+        }
+    }
+}
+
+static void file_sink_close(void *ctx) {
+    FileSink *fs = (FileSink*)ctx;
+    int i;
+
+    for (i = 0; i < FILE_SINK_BUCKETS; i++) {
+        OpenFile *of = fs->buckets[i];
+        while (of != NULL) {
+            OpenFile *next = of->next;
+            if (of->fp != NULL)
+                fclose(of->fp);
+            free(of);
+            of = next;
+        }
+    }
+    free(fs);
+}
+
+const SinkOps file_sink_ops = { file_sink_write, file_sink_flush, file_sink_close };
+
+FileSink* file_sink_create(const char *root, FileSinkLayout layout, int segment_minutes,
+                           int max_open) {
+    FileSink *fs;
+    size_t len;
+
+    if (root == NULL || root[0] == '\0')
+        return NULL;
+    if (layout == FILE_SINK_SEGMENTS && segment_minutes <= 0)
+        return NULL;
+    if (max_open < 1)
+        return NULL;
+
+    fs = (FileSink*)calloc(1, sizeof(FileSink));
+    if (fs == NULL)
+        return NULL;
+    strncpy(fs->root, root, sizeof(fs->root) - 1);
+    len = strlen(fs->root);
+    while (len > 1 && (fs->root[len - 1] == '/' || fs->root[len - 1] == '\\'))
+        fs->root[--len] = '\0';
+    fs->layout = layout;
+    fs->max_open = max_open;
+    fs->period_seconds = layout == FILE_SINK_SDS ? 86400L : (long)segment_minutes * 60L;
+    fs->last_sweep_us = platform_monotonic_us();
+    return fs;
+}
@@ -0,0 +1,35 @@
+#ifndef FILE_SINK_H
+#define FILE_SINK_H
+
+/*
+ * Sinks that append records to miniSEED files, one open file per channel:
+ *
+ *   FILE_SINK_SDS       day files in an SDS archive,
+ *                       ROOT/YYYY/NET/STA/CHA.D/NET.STA.LOC.CHA.D.YYYY.DDD
+ *                       (readable again with replay_archive)
+ *   FILE_SINK_SEGMENTS  fixed-length segments per channel,
+ *                       ROOT/NET.STA.LOC.CHA/NET.STA.LOC.CHA.YYYYMMDDThhmmss.mseed
+ *
+ * Records go to the file of their own start time, so late records land
+ * in the right day or segment. Files idle for a few minutes are closed,
+ * and at most max_open are open at once: opening one more closes the
+ * least recently written.
+ * Register with sink_add(name, &file_sink_ops, ctx, depth).
+ */
+
+#include "sink.h"
+
+typedef enum {
+    FILE_SINK_SDS = 0,
+    FILE_SINK_SEGMENTS
+} FileSinkLayout;
+
+typedef struct FileSink FileSink;
+
+/* segment_minutes is used by FILE_SINK_SEGMENTS only; NULL on failure */
+FileSink* file_sink_create(const char *root, FileSinkLayout layout, int segment_minutes,
+                           int max_open);
+
+extern const SinkOps file_sink_ops;
+
+#endif /* FILE_SINK_H */
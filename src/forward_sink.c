@@ -0,0 +1,121 @@
+#include "forward_sink.h"
+#include "netutil.h"
+#include "platform.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FORWARD_BUFFER (64 * 1024)
+#define FORWARD_RETRY_MIN_MS 1000
+#define FORWARD_RETRY_MAX_MS 30000
+#define FORWARD_SEND_TIMEOUT_MS 10000   /* A peer stalled this long is dropped */
+
+struct ForwardSink {
+    char address[256];
+    NetSocket sock;
+    char buffer[FORWARD_BUFFER];
+    size_t used;
+    long long next_attempt_us;      /* Monotonic; 0 = connect now */
+    int retry_ms;
+    int was_connected;
+};
+
+static void disconnect(ForwardSink *fw) {
+    net_close(fw->sock);
+    fw->sock = NET_INVALID_SOCKET;
+    fw->used = 0;
+    fw->next_attempt_us = platform_monotonic_us() + (long long)fw->retry_ms * 1000;
+    LOG_WARN(LOG_CAT_SINK, "Forward connection to %s lost, retrying in %d ms",
+             fw->address, fw->retry_ms);
+}
+
+static int ensure_connected(ForwardSink *fw) {
+    if (fw->sock != NET_INVALID_SOCKET)
+        return 0;
+    if (platform_monotonic_us() < fw->next_attempt_us)
+        return -1;
+
+    fw->sock = net_connect(fw->address);
+    if (fw->sock == NET_INVALID_SOCKET) {
+        if (fw->was_connected || fw->retry_ms == FORWARD_RETRY_MIN_MS)
+            LOG_WARN(LOG_CAT_SINK, "Cannot connect to %s, retrying", fw->address);
+        fw->was_connected = 0;
+        fw->next_attempt_us = platform_monotonic_us() + (long long)fw->retry_ms * 1000;
+        fw->retry_ms = fw->retry_ms * 2 > FORWARD_RETRY_MAX_MS ? FORWARD_RETRY_MAX_MS
+                                                               : fw->retry_ms * 2;
+        return -1;
+    }
+
+    net_set_send_timeout(fw->sock, FORWARD_SEND_TIMEOUT_MS);
+    LOG_INFO(LOG_CAT_SINK, "Forwarding records to %s", fw->address);
+    fw->was_connected = 1;
+    fw->retry_ms = FORWARD_RETRY_MIN_MS;
+    return 0;
+}
+
+static int send_buffer(ForwardSink *fw) {
+    if (fw->used == 0)
+        return 0;
+    if (net_send_all(fw->sock, fw->buffer, fw->used) < 0) {
+        disconnect(fw);
+        return -1;
+    }
+    fw->used = 0;
+    return 0;
+}
+
+static int forward_sink_write(const SinkRecord *rec, void *ctx) {
+    ForwardSink *fw = (ForwardSink*)ctx;
+
+    if (ensure_connected(fw) < 0)
+        return -1;
+
+    if (fw->used + rec->length > sizeof(fw->buffer) && send_buffer(fw) < 0)
+        return -1;
+    if (rec->length > sizeof(fw->buffer)) {
+        if (net_send_all(fw->sock, rec->record, rec->length) < 0) {
+            disconnect(fw);
+            return -1;
+        }
+        return 0;
+    }
+
+    memcpy(fw->buffer + fw->used, rec->record, rec->length);
+    fw->used += rec->length;
+    return 0;
+}
+
+static void forward_sink_flush(void *ctx) {
+    ForwardSink *fw = (ForwardSink*)ctx;
+
+    if (fw->sock != NET_INVALID_SOCKET)
+        send_buffer(fw);
+}
+
+static void forward_sink_close(void *ctx) {
+    ForwardSink *fw = (ForwardSink*)ctx;
+
+    if (fw->sock != NET_INVALID_SOCKET) {
+        send_buffer(fw);
+        net_close(fw->sock);
+    }
+    free(fw);
+}
+
+const SinkOps forward_sink_ops = { forward_sink_write, forward_sink_flush, forward_sink_close };
+
+ForwardSink* forward_sink_create(const char *address) {
+    ForwardSink *fw;
+
+    if (address == NULL || address[0] == '\0' || net_init() < 0)
+        return NULL;
+
+    fw = (ForwardSink*)calloc(1, sizeof(ForwardSink));
+    if (fw == NULL)
+        return NULL;
+    strncpy(fw->address, address, sizeof(fw->address) - 1);
+    fw->sock = NET_INVALID_SOCKET;
+    fw->retry_ms = FORWARD_RETRY_MIN_MS;
+    return fw;
+}
@@ -0,0 +1,23 @@
+#ifndef FORWARD_SINK_H
+#define FORWARD_SINK_H
+
+/*
+ * Sink that forwards every record as a plain stream of miniSEED records
+ * over one TCP connection (e.g. to a ringserver miniSEED listener, or
+ * `nc -l` into a file). Records are batched and sent when the queue runs
+ * empty or the buffer fills. A peer that stops reading for 10 s, or a
+ * lost connection, is reconnected with backoff up to 30 s; records
+ * arriving meanwhile count as sink errors.
+ * Register with sink_add(name, &forward_sink_ops, ctx, depth).
+ */
+
+#include "sink.h"
+
+typedef struct ForwardSink ForwardSink;
+
+/* address as for net_connect(): "host:port" or "tcp:host:port"; NULL on failure */
+ForwardSink* forward_sink_create(const char *address);
+
+extern const SinkOps forward_sink_ops;
+
+#endif /* FORWARD_SINK_H */
@@ -0,0 +1,200 @@
+#include "httpd.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define HTTPD_SEND_TIMEOUT_MS 10000     /* A client that stops reading this long is dropped */
+
+/* Set while the handler of a HEAD request runs; responses then omit the body */
+static PLATFORM_THREAD_LOCAL int g_head_request = 0;
+
+struct HttpServer {
+    NetSocket listener;
+    HttpHandler handler;
+    void *ctx;
+    PlatformThread thread;
+    volatile int running;
+    int port;
+};
+
+static const char* status_text(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 413: return "Payload Too Large";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default:  return "Unknown";
+    }
+}
+
+int httpd_send_header(NetSocket client, int status, const char *content_type,
+                      long long content_length) {
+    char header[512];
+    int n;
+
+    n = snprintf(header, sizeof(header),
+                 "HTTP/1.0 %d %s\r\n"
+                 "Content-Type: %s\r\n"
+                 "Connection: close\r\n",
+                 status, status_text(status), content_type);
+    if (content_length >= 0) {
+        n += snprintf(header + n, sizeof(header) - n,
+                      "Content-Length: %lld\r\n", content_length);
+    }
+    n += snprintf(header + n, sizeof(header) - n, "\r\n");
+
+    return net_send_all(client, header, (size_t)n);
+}
+
+int httpd_send_response(NetSocket client, int status, const char *content_type,
+                        const char *body, size_t len) {
+    if (httpd_send_header(client, status, content_type, (long long)len) < 0)
+        return -1;
+    return len > 0 && !g_head_request ? net_send_all(client, body, len) : 0;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+int httpd_query_param(const char *query, const char *name, char *value, size_t len) {
+    size_t name_len = strlen(name);
+    const char *p = query;
+
+    while (p && *p) {
+        if (strncmp(p, name, name_len) == 0 && p[name_len] == '=') {
+            const char *v = p + name_len + 1;
+            size_t out = 0;
+
+            while (*v && *v != '&' && out + 1 < len) {
+                if (*v == '%' && hex_value(v[1]) >= 0 && hex_value(v[2]) >= 0) {
+                    value[out++] = (char)(hex_value(v[1]) * 16 + hex_value(v[2]));
+                    v += 3;
+                } else {
+                    value[out++] = (*v == '+') ? ' ' : *v;
+                    v++;
+                }
+            }
+            value[out] = '\0';
+            return 0;
+        }
+        p = strchr(p, '&');
+        if (p)
+            p++;
+    }
+    return -1;
+}
+
+/* Read the request head and parse "METHOD /path?query HTTP/x.y" */
+static int read_request(NetSocket client, HttpRequest *req) {
+    char buffer[4096];
+    size_t used = 0;
+    char *target, *q;
+
+    memset(req, 0, sizeof(*req));
+
+    while (used < sizeof(buffer) - 1) {
+        if (net_wait_readable(client, 2000) <= 0)
+            return -1;
+        long n = net_recv(client, buffer + used, sizeof(buffer) - 1 - used);
+        if (n <= 0)
+            return -1;
+        used += (size_t)n;
+        buffer[used] = '\0';
+        if (strstr(buffer, "\r\n\r\n") || strstr(buffer, "\n\n"))
+            break;
+    }
+
+    if (sscanf(buffer, "%7s", req->method) != 1)
+        return -1;
+    target = buffer + strlen(req->method);
+    while (*target == ' ')
+        target++;
+    target[strcspn(target, " \r\n")] = '\0';
+
+    q = strchr(target, '?');
+    if (q) {
+        *q++ = '\0';
+        strncpy(req->query, q, sizeof(req->query) - 1);
+    }
+    strncpy(req->path, target, sizeof(req->path) - 1);
+
+    return 0;
+}
+
+static PLATFORM_THREAD_FUNC(httpd_thread_func) {
+    HttpServer *server = (HttpServer*)arg;
+
+    while (server->running) {
+        if (net_wait_readable(server->listener, 500) <= 0)
+            continue;
+
+        NetSocket client = net_accept(server->listener);
+        if (client == NET_INVALID_SOCKET)
+            continue;
+        net_set_send_timeout(client, HTTPD_SEND_TIMEOUT_MS);
+
+        HttpRequest req;
+        if (read_request(client, &req) == 0) {
+            if (strcmp(req.method, "GET") != 0 && strcmp(req.method, "HEAD") != 0) {
+                const char *msg = "Only GET is supported\n";
+                httpd_send_response(client, 400, "text/plain", msg, strlen(msg));
+            } else {
+                g_head_request = strcmp(req.method, "HEAD") == 0;
+                server->handler(client, &req, server->ctx);
+                g_head_request = 0;
+            }
+        }
+        net_close(client);
+    }
+
+    PLATFORM_THREAD_RETURN;
+}
+
+HttpServer* httpd_start(const char *host, int port, HttpHandler handler, void *ctx) {
+    HttpServer *server;
+
+    if (net_init() < 0)
+        return NULL;
+
+    server = (HttpServer*)calloc(1, sizeof(HttpServer));
+    if (server == NULL)
+        return NULL;
+
+    server->listener = net_listen_tcp(host, port, 16);
+    if (server->listener == NET_INVALID_SOCKET) {
+        free(server);
+        return NULL;
+    }
+
+    server->handler = handler;
+    server->ctx = ctx;
+    server->port = port;
+    server->running = 1;
+
+    if (platform_thread_create(&server->thread, httpd_thread_func, server) < 0) {
+        net_close(server->listener);
+        free(server);
+        return NULL;
+    }
+
+    return server;
+}
+
+void httpd_stop(HttpServer *server) {
+    if (server == NULL)
+        return;
+
+    server->running = 0;
+    platform_thread_join(server->thread);
+    net_close(server->listener);
+    free(server);
+}
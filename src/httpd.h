@@ -0,0 +1,39 @@
+#ifndef HTTPD_H
+#define HTTPD_H
+
+/*
+ * Tiny HTTP/1.0 server for localhost endpoints (metrics, dataselect).
+ * One accept thread, one request per connection, handler writes the reply.
+ */
+
+#include "netutil.h"
+
+typedef struct {
+    char method[8];
+    char path[256];
+    char query[1024];           /* Raw query string without '?' */
+} HttpRequest;
+
+/* Handler writes the full response to client; return value is ignored */
+typedef int (*HttpHandler)(NetSocket client, const HttpRequest *req, void *ctx);
+
+typedef struct HttpServer HttpServer;
+
+/* Start serving on host:port (empty host = 127.0.0.1); NULL on failure */
+HttpServer* httpd_start(const char *host, int port, HttpHandler handler, void *ctx);
+
+/* Stop the accept thread and close the listener */
+void httpd_stop(HttpServer *server);
+
+/* Send status line and headers; content_length < 0 omits the header */
+int httpd_send_header(NetSocket client, int status, const char *content_type,
+                      long long content_length);
+
+/* Send a complete response with body (headers only for HEAD requests) */
+int httpd_send_response(NetSocket client, int status, const char *content_type,
+                        const char *body, size_t len);
+
+/* Copy query parameter "name" into value; 0 if found, -1 otherwise */
+int httpd_query_param(const char *query, const char *name, char *value, size_t len);
+
+#endif /* HTTPD_H */
@@ -0,0 +1,588 @@
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_MAX_ARGS 8
+#define LOG_STRING_BYTES 192
+#define LOG_LINE_BYTES 1024
+#define LOG_IDLE_WAIT_MS 1000      /* Parked wait; also paces loss reports */
+#define LOG_REPORT_INTERVAL_US 1000000LL
+
+/* Arguments as captured by the producer; strings are copied into the record */
+typedef union {
+    long long i;
+    unsigned long long u;
+    double d;
+    const void *p;
+} LogArg;
+
+typedef struct {
+    volatile unsigned long long seq;    /* Slot sequence (bounded MPMC ring) */
+    const char *fmt;
+    unsigned char level;
+    unsigned char category;
+    unsigned char nargs;
+    LogArg args[LOG_MAX_ARGS];
+    char strings[LOG_STRING_BYTES];
+} LogRecord;
+
+typedef struct {
+    volatile unsigned long long window;     /* Current one-second window */
+    volatile unsigned long long count;      /* Records admitted in the window */
+    volatile unsigned long long suppressed; /* Rate limited since last report */
+    volatile unsigned long long sampled;    /* Debug records seen, for sampling */
+} LogBucket;
+
+enum { LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_Z, LEN_J, LEN_T, LEN_BIGL };
+
+typedef struct {
+    char conv;
+    int length;
+    int stars;
+} LogSpec;
+
+volatile int g_log_level = LOG_LEVEL_INFO;
+
+static LogRecord *g_ring = NULL;
+static unsigned long long g_mask = 0;
+static volatile unsigned long long g_head = 0;  /* Next slot for producers */
+static unsigned long long g_tail = 0;           /* Next slot for the logger thread */
+static volatile unsigned long long g_dropped = 0;
+static volatile int g_logger_running = 0;
+static PlatformThread g_logger_thread;
+static PlatformMutex g_wake_lock;
+static PlatformCond g_wake_cond;
+static volatile unsigned long long g_parked = 0;   /* Logger thread waiting */
+static int g_rate_limit = 0;
+static int g_debug_sample = 1;
+static LogBucket g_buckets[LOG_CAT_COUNT];
+
+static const char *g_category_prefix[LOG_CAT_COUNT] = {
+    "",
+    "[RingClient] ",
+    "[PickFetcher] ",
+    "[Sink] ",
+    "[Snapshot] ",
+    "[Backfill] "
+};
+
+static const char *g_level_names[] = { "error", "warn", "info", "debug" };
+
+int logger_parse_level(const char *name) {
+    int i;
+
+    for (i = 0; i <= LOG_LEVEL_DEBUG; i++) {
+        if (strcasecmp(name, g_level_names[i]) == 0)
+            return i;
+    }
+    if (strcasecmp(name, "warning") == 0)
+        return LOG_LEVEL_WARN;
+    return -1;
+}
+
+const char* logger_level_name(int level) {
+    if (level < 0 || level > LOG_LEVEL_DEBUG)
+        return "unknown";
+    return g_level_names[level];
+}
+
+/* Parse the conversion at fmt[0] == '%'; returns the number of chars used */
+static size_t parse_spec(const char *fmt, LogSpec *spec) {
+    const char *p = fmt + 1;
+
+    spec->length = LEN_NONE;
+    spec->stars = 0;
+
+    while (*p && strchr("-+ #0", *p))
+        p++;
+    if (*p == '*') {
+        spec->stars++;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9')
+        p++;
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->stars++;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9')
+            p++;
+    }
+
+    switch (*p) {
+    case 'h':
+        p++;
+        spec->length = LEN_H;
+        if (*p == 'h') {
+            spec->length = LEN_HH;
+            p++;
+        }
+        break;
+    case 'l':
+        p++;
+        spec->length = LEN_L;
+        if (*p == 'l') {
+            spec->length = LEN_LL;
+            p++;
+        }
+        break;
+    case 'z': spec->length = LEN_Z; p++; break;
+    case 'j': spec->length = LEN_J; p++; break;
+    case 't': spec->length = LEN_T; p++; break;
+    case 'L': spec->length = LEN_BIGL; p++; break;
+    default: break;
+    }
+
+    spec->conv = *p;
+    if (*p)
+        p++;
+    return (size_t)(p - fmt);
+}
+
+static long long read_signed(va_list *ap, int length) {
+    switch (length) {
+    case LEN_HH: return (signed char)va_arg(*ap, int);
+    case LEN_H:  return (short)va_arg(*ap, int);
+    case LEN_L:  return va_arg(*ap, long);
+    case LEN_LL: return va_arg(*ap, long long);
+    case LEN_Z:
+    case LEN_T:  return va_arg(*ap, ptrdiff_t);
+    case LEN_J:  return va_arg(*ap, intmax_t);
+    default:     return va_arg(*ap, int);
+    }
+}
+
+static unsigned long long read_unsigned(va_list *ap, int length) {
+    switch (length) {
+    case LEN_HH: return (unsigned char)va_arg(*ap, unsigned int);
+    case LEN_H:  return (unsigned short)va_arg(*ap, unsigned int);
+    case LEN_L:  return va_arg(*ap, unsigned long);
+    case LEN_LL: return va_arg(*ap, unsigned long long);
+    case LEN_Z:  return va_arg(*ap, size_t);
+    case LEN_T:  return (unsigned long long)va_arg(*ap, ptrdiff_t);
+    case LEN_J:  return va_arg(*ap, uintmax_t);
+    default:     return va_arg(*ap, unsigned int);
+    }
+}
+
+/* Copy the raw arguments the format refers to; no formatting happens here */
+static void capture_args(LogRecord *rec, const char *fmt, va_list *ap) {
+    const char *p = fmt;
+    unsigned int n = 0;
+    size_t used = 0;
+    LogSpec spec;
+    int i;
+
+    while ((p = strchr(p, '%')) != NULL) {
+        p += parse_spec(p, &spec);
+        if (spec.conv == '%')
+            continue;
+        if (spec.conv == '\0' || n + spec.stars + 1 > LOG_MAX_ARGS)
+            break;
+
+        for (i = 0; i < spec.stars; i++)
+            rec->args[n++].i = va_arg(*ap, int);
+
+        switch (spec.conv) {
+        case 'd': case 'i':
+            rec->args[n++].i = read_signed(ap, spec.length);
+            break;
+        case 'u': case 'o': case 'x': case 'X':
+            rec->args[n++].u = read_unsigned(ap, spec.length);
+            break;
+        case 'c':
+            rec->args[n++].i = va_arg(*ap, int);
+            break;
+        case 'e': case 'E': case 'f': case 'F':
+        case 'g': case 'G': case 'a': case 'A': case 'T':
+            if (spec.length == LEN_BIGL)
+                rec->args[n++].d = (double)va_arg(*ap, long double);
+            else
+                rec->args[n++].d = va_arg(*ap, double);
+            break;
+        case 's': {
+            const char *s = va_arg(*ap, const char *);
+            size_t len;
+
+            if (s == NULL)
+                s = "(null)";
+            len = strlen(s);
+            if (used >= LOG_STRING_BYTES) {
+                rec->args[n++].i = -1;
+                break;
+            }
+            if (len > LOG_STRING_BYTES - used - 1)
+                len = LOG_STRING_BYTES - used - 1;
+            memcpy(rec->strings + used, s, len);
+            rec->strings[used + len] = '\0';
+            rec->args[n++].i = (long long)used;
+            used += len + 1;
+            break;
+        }
+        case 'p':
+            rec->args[n++].p = va_arg(*ap, void *);
+            break;
+        default:
+            /* %n and unknown conversions end the capture */
+            rec->nargs = (unsigned char)n;
+            return;
+        }
+    }
+    rec->nargs = (unsigned char)n;
+}
+
+static void append(char *out, size_t size, size_t *pos, const char *s, size_t len) {
+    if (*pos + len >= size)
+        len = size - *pos - 1;
+    memcpy(out + *pos, s, len);
+    *pos += len;
+    out[*pos] = '\0';
+}
+
+static void append_formatted(size_t size, size_t *pos, int written) {
+    if (written < 0)
+        return;
+    *pos += (size_t)written;
+    if (*pos >= size)
+        *pos = size - 1;
+}
+
+/* Re-walk the format and print each conversion with its captured argument */
+static void format_record(const LogRecord *rec, char *out, size_t size) {
+    const char *p = rec->fmt;
+    const char *pct;
+    size_t pos = 0;
+    unsigned int n = 0;
+    LogSpec spec;
+
+    out[0] = '\0';
+    append(out, size, &pos, g_category_prefix[rec->category],
+           strlen(g_category_prefix[rec->category]));
+
+    while (*p && pos < size - 1) {
+        char conv[48];
+        size_t conv_len = 0;
+        size_t spec_len;
+        const char *c;
+
+        pct = strchr(p, '%');
+        if (pct == NULL) {
+            append(out, size, &pos, p, strlen(p));
+            break;
+        }
+        append(out, size, &pos, p, (size_t)(pct - p));
+        spec_len = parse_spec(pct, &spec);
+        p = pct + spec_len;
+
+        if (spec.conv == '%') {
+            append(out, size, &pos, "%", 1);
+            continue;
+        }
+        if (spec.conv == '\0' || n + spec.stars + 1 > rec->nargs) {
+            append(out, size, &pos, pct, spec_len);
+            continue;
+        }
+
+        /* Rebuild the spec with '*' expanded and a uniform length modifier */
+        for (c = pct; c < pct + spec_len - 1 && conv_len < sizeof(conv) - 24; c++) {
+            if (*c == '*')
+                conv_len += (size_t)snprintf(conv + conv_len, sizeof(conv) - conv_len,
+                                             "%d", (int)rec->args[n++].i);
+            else if (!strchr("hlzjtL", *c))
+                conv[conv_len++] = *c;
+        }
+        conv[conv_len] = '\0';
+
+        switch (spec.conv) {
+        case 'd': case 'i':
+            strcat(conv, "lld");
+            append_formatted(size, &pos,
+                             snprintf(out + pos, size - pos, conv, rec->args[n++].i));
+            break;
+        case 'u': case 'o': case 'x': case 'X':
+            conv_len = strlen(conv);
+            conv[conv_len] = 'l';
+            conv[conv_len + 1] = 'l';
+            conv[conv_len + 2] = spec.conv;
+            conv[conv_len + 3] = '\0';
+            append_formatted(size, &pos,
+                             snprintf(out + pos, size - pos, conv, rec->args[n++].u));
+            break;
+        case 'c':
+            strcat(conv, "c");
+            append_formatted(size, &pos,
+                             snprintf(out + pos, size - pos, conv, (int)rec->args[n++].i));
+            break;
+        case 'T': {
+            time_t t = (time_t)rec->args[n++].d;
+            struct tm tm_info;
+            char time_str[32] = "";
+
+            if (platform_gmtime(&t, &tm_info))
+                strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", &tm_info);
+            append(out, size, &pos, time_str, strlen(time_str));
+            break;
+        }
+        case 's': {
+            long long offset = rec->args[n++].i;
+            const char *s = offset >= 0 ? rec->strings + offset : "";
+
+            strcat(conv, "s");
+            append_formatted(size, &pos, snprintf(out + pos, size - pos, conv, s));
+            break;
+        }
+        case 'p':
+            strcat(conv, "p");
+            append_formatted(size, &pos,
+                             snprintf(out + pos, size - pos, conv, rec->args[n++].p));
+            break;
+        default:
+            conv_len = strlen(conv);
+            conv[conv_len] = spec.conv;
+            conv[conv_len + 1] = '\0';
+            append_formatted(size, &pos,
+                             snprintf(out + pos, size - pos, conv, rec->args[n++].d));
+            break;
+        }
+    }
+}
+
+static void emit(const LogRecord *rec) {
+    char line[LOG_LINE_BYTES];
+    FILE *stream = rec->level <= LOG_LEVEL_WARN ? stderr : stdout;
+
+    format_record(rec, line, sizeof(line));
+    fputs(line, stream);
+    fputc('\n', stream);
+}
+
+/* Sampling and per-category rate limiting, before anything is captured */
+static int admit(int level, int category) {
+    LogBucket *bucket = &g_buckets[category];
+
+    if (level == LOG_LEVEL_DEBUG && g_debug_sample > 1 &&
+        platform_atomic_add_u64(&bucket->sampled, 1) % (unsigned long long)g_debug_sample != 0)
+        return 0;
+
+    if (g_rate_limit > 0) {
+        unsigned long long now = (unsigned long long)(platform_monotonic_us() / 1000000);
+        unsigned long long window = platform_atomic_load_u64(&bucket->window);
+
+        if (window != now && platform_atomic_cas_u64(&bucket->window, window, now))
+            platform_atomic_store_u64(&bucket->count, 0);
+        if (platform_atomic_add_u64(&bucket->count, 1) >= (unsigned long long)g_rate_limit) {
+            platform_atomic_add_u64(&bucket->suppressed, 1);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void logger_write(int level, int category, const char *fmt, ...) {
+    LogRecord local;
+    LogRecord *rec;
+    unsigned long long pos;
+    va_list ap;
+
+    if (category < 0 || category >= LOG_CAT_COUNT)
+        category = LOG_CAT_GENERAL;
+    if (!admit(level, category))
+        return;
+
+    if (!g_logger_running) {
+        local.fmt = fmt;
+        local.level = (unsigned char)level;
+        local.category = (unsigned char)category;
+        va_start(ap, fmt);
+        capture_args(&local, fmt, &ap);
+        va_end(ap);
+        emit(&local);
+        return;
+    }
+
+    /* Claim a slot: its sequence equals our position when it is free */
+    pos = platform_atomic_load_u64(&g_head);
+    for (;;) {
+        long long diff;
+
+        rec = &g_ring[pos & g_mask];
+        diff = (long long)(platform_atomic_load_acquire_u64(&rec->seq) - pos);
+        if (diff == 0) {
+            if (platform_atomic_cas_u64(&g_head, pos, pos + 1))
+                break;
+            pos = platform_atomic_load_u64(&g_head);
+        } else if (diff < 0) {
+            platform_atomic_add_u64(&g_dropped, 1);
+            return;
+        } else {
+            pos = platform_atomic_load_u64(&g_head);
+        }
+    }
+
+    rec->fmt = fmt;
+    rec->level = (unsigned char)level;
+    rec->category = (unsigned char)category;
+    va_start(ap, fmt);
+    capture_args(rec, fmt, &ap);
+    va_end(ap);
+    platform_atomic_store_release_u64(&rec->seq, pos + 1);
+
+    /* Wake the logger thread only if it parked on an empty ring */
+    platform_atomic_fence();
+    if (platform_atomic_load_u64(&g_parked) && platform_atomic_cas_u64(&g_parked, 1, 0)) {
+        platform_mutex_lock(&g_wake_lock);
+        platform_cond_signal(&g_wake_cond);
+        platform_mutex_unlock(&g_wake_lock);
+    }
+}
+
+static unsigned long long take_counter(volatile unsigned long long *counter) {
+    unsigned long long value;
+
+    do {
+        value = platform_atomic_load_u64(counter);
+    } while (value != 0 && !platform_atomic_cas_u64(counter, value, 0));
+    return value;
+}
+
+static void report_losses(void) {
+    unsigned long long count;
+    int i;
+
+    for (i = 0; i < LOG_CAT_COUNT; i++) {
+        count = take_counter(&g_buckets[i].suppressed);
+        if (count > 0)
+            fprintf(stderr, "%s%llu log records suppressed by rate limit\n",
+                    g_category_prefix[i], count);
+    }
+    count = take_counter(&g_dropped);
+    if (count > 0)
+        fprintf(stderr, "[Logger] %llu log records dropped, ring full\n", count);
+}
+
+static int drain(void) {
+    int drained = 0;
+
+    for (;;) {
+        LogRecord *rec = &g_ring[g_tail & g_mask];
+
+        if (platform_atomic_load_acquire_u64(&rec->seq) != g_tail + 1)
+            break;
+        emit(rec);
+        platform_atomic_store_release_u64(&rec->seq, g_tail + g_mask + 1);
+        g_tail++;
+        drained++;
+    }
+    if (drained > 0) {
+        fflush(stdout);
+        fflush(stderr);
+    }
+    return drained;
+}
+
+static int ring_has_record(void) {
+    return platform_atomic_load_acquire_u64(&g_ring[g_tail & g_mask].seq) == g_tail + 1;
+}
+
+/*
+ * Park until a producer publishes a record. Producers publish, fence, then
+ * check g_parked; we set g_parked, fence, then check the ring, so one of
+ * the two always sees the other.
+ */
+static void wait_for_records(void) {
+    platform_mutex_lock(&g_wake_lock);
+    platform_atomic_store_u64(&g_parked, 1);
+    platform_atomic_fence();
+    if (g_logger_running && !ring_has_record())
+        platform_cond_timedwait_ms(&g_wake_cond, &g_wake_lock, LOG_IDLE_WAIT_MS);
+    platform_atomic_store_u64(&g_parked, 0);
+    platform_mutex_unlock(&g_wake_lock);
+}
+
+static PLATFORM_THREAD_FUNC(logger_thread_func) {
+    long long last_report = platform_monotonic_us();
+
+    (void)arg;
+
+    while (g_logger_running) {
+        long long now;
+
+        if (drain() == 0)
+            wait_for_records();
+
+        now = platform_monotonic_us();
+        if (now - last_report >= LOG_REPORT_INTERVAL_US) {
+            report_losses();
+            last_report = now;
+        }
+    }
+
+    PLATFORM_THREAD_RETURN;
+}
+
+int logger_start(const LoggerConfig *config) {
+    unsigned long long capacity = 64;
+    unsigned long long i;
+
+    if (g_logger_running)
+        return 0;
+
+    while (capacity < (unsigned long long)config->ring_records)
+        capacity <<= 1;
+
+    g_ring = (LogRecord*)calloc((size_t)capacity, sizeof(LogRecord));
+    if (g_ring == NULL) {
+        fprintf(stderr, "[Logger] Failed to allocate log ring\n");
+        return -1;
+    }
+    for (i = 0; i < capacity; i++)
+        g_ring[i].seq = i;
+    g_mask = capacity - 1;
+    g_head = 0;
+    g_tail = 0;
+
+    g_log_level = config->level;
+    g_rate_limit = config->rate_limit;
+    g_debug_sample = config->debug_sample > 1 ? config->debug_sample : 1;
+
+    platform_mutex_init(&g_wake_lock);
+    platform_cond_init(&g_wake_cond);
+    g_parked = 0;
+
+    g_logger_running = 1;
+    if (platform_thread_create(&g_logger_thread, logger_thread_func, NULL) != 0) {
+        fprintf(stderr, "[Logger] Failed to create logger thread\n");
+        g_logger_running = 0;
+        platform_cond_destroy(&g_wake_cond);
+        platform_mutex_destroy(&g_wake_lock);
+        free(g_ring);
+        g_ring = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/* Call after every thread that logs has stopped */
+void logger_stop(void) {
+    if (!g_logger_running)
+        return;
+
+    platform_mutex_lock(&g_wake_lock);
+    g_logger_running = 0;
+    platform_cond_signal(&g_wake_cond);
+    platform_mutex_unlock(&g_wake_lock);
+    platform_thread_join(g_logger_thread);
+    drain();
+    report_losses();
+    platform_cond_destroy(&g_wake_cond);
+    platform_mutex_destroy(&g_wake_lock);
+
+    free(g_ring);
+    g_ring = NULL;
+}
@@ -0,0 +1,70 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+/*
+ * Asynchronous logging for the receive and pick threads.
+ *
+ * LOG_* calls capture the format pointer and raw arguments into a
+ * fixed-size record in a lock-free ring; a background thread does the
+ * formatting and the stdio writes. Records below the configured level cost
+ * one branch. Rate limiting (per category, per second) and sampling of
+ * debug records happen before anything is copied. If the ring is full the
+ * record is dropped and counted rather than blocking the caller.
+ *
+ * The format string must be a literal (only its pointer is kept). Besides
+ * the usual printf conversions, %T prints an epoch double as
+ * "YYYY-MM-DD HH:MM:SS" UTC, formatted on the logger thread.
+ *
+ * Before logger_start() and after logger_stop() records are written
+ * synchronously.
+ */
+
+#include "platform.h"
+
+typedef enum {
+    LOG_LEVEL_ERROR = 0,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG
+} LogLevel;
+
+/* Categories select the message prefix and the rate limit bucket */
+typedef enum {
+    LOG_CAT_GENERAL = 0,
+    LOG_CAT_RINGCLIENT,
+    LOG_CAT_PICKFETCHER,
+    LOG_CAT_SINK,
+    LOG_CAT_SNAPSHOT,
+    LOG_CAT_BACKFILL,
+    LOG_CAT_COUNT
+} LogCategory;
+
+#define DEFAULT_LOG_RING_RECORDS 4096
+
+typedef struct {
+    int level;              /* Highest LogLevel written */
+    int rate_limit;         /* Records per category per second, 0 = unlimited */
+    int debug_sample;       /* Keep 1 of every N debug records, <= 1 keeps all */
+    int ring_records;       /* Ring capacity, rounded up to a power of two */
+} LoggerConfig;
+
+extern volatile int g_log_level;
+
+int logger_start(const LoggerConfig *config);
+void logger_stop(void);
+
+/* Parse "error", "warn", "info" or "debug"; -1 if unknown */
+int logger_parse_level(const char *name);
+const char* logger_level_name(int level);
+
+void logger_write(int level, int category, const char *fmt, ...);
+
+#define LOG_AT(level, category, ...) \
+    do { if ((level) <= g_log_level) logger_write(level, category, __VA_ARGS__); } while (0)
+
+#define LOG_ERROR(category, ...) LOG_AT(LOG_LEVEL_ERROR, category, __VA_ARGS__)
+#define LOG_WARN(category, ...)  LOG_AT(LOG_LEVEL_WARN, category, __VA_ARGS__)
+#define LOG_INFO(category, ...)  LOG_AT(LOG_LEVEL_INFO, category, __VA_ARGS__)
+#define LOG_DEBUG(category, ...) LOG_AT(LOG_LEVEL_DEBUG, category, __VA_ARGS__)
+
+#endif /* LOGGER_H */
@@ -5,10 +5,10 @@
     #include <winsock2.h>
     #include <windows.h>
 #else
-    #include <signal.h>
     #include <unistd.h>
 #endif
 
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,52 +16,79 @@
 #include "config.h"
 #include "ringclient.h"
 #include "pick_fetcher.h"
+#include "metrics.h"
+#include "trace.h"
+#include "logger.h"
+#include "archive_source.h"
+#include "reactor.h"
+#include "dataselect.h"
+#include "shm_export.h"
+#include "slrelay.h"
+#include "sink.h"
+#include "file_sink.h"
+#include "forward_sink.h"
+#include "snapshot.h"
+#include "envelope.h"
+#include "backfill.h"
 
 #define DEFAULT_CONFIG_FILE "config.txt"
 
-/* Global flag for graceful shutdown */
-static volatile int g_running = 1;
-
 /* Pointers to configs so signal handler can stop both threads */
 static RingClientConfig *g_rc_config = NULL;
 static PickFetcherConfig *g_pf_config = NULL;
 
-/* Signal handler for graceful shutdown */
-#ifdef _WIN32
-static BOOL WINAPI console_handler(DWORD signal) {
-    if (signal == CTRL_C_EVENT || signal == CTRL_BREAK_EVENT) {
-        printf("\n[Main] Shutdown signal received (Ctrl+C)...\n");
-        
-        /* Stop all threads */
-        g_running = 0;
-        
-        if (g_rc_config) {
-            g_rc_config->running = 0;
-        }
-        if (g_pf_config) {
-            g_pf_config->running = 0;
-        }
-        
-        return TRUE;
-    }
-    return FALSE;
-}
-#else
-static void signal_handler(int sig) {
-    (void)sig;
+/* Owns signals and periodic work on the main thread */
+static Reactor *g_reactor = NULL;
+
+/* SIGINT/SIGTERM (Ctrl+C on Windows): stop all threads */
+static void on_shutdown_signal(Reactor *reactor, void *ctx) {
+    (void)ctx;
     printf("\n[Main] Shutdown signal received...\n");
     
-    g_running = 0;
-    
     if (g_rc_config) {
         g_rc_config->running = 0;
     }
     if (g_pf_config) {
         g_pf_config->running = 0;
     }
+    
+    /* Wakes every thread waiting on the reactor */
+    reactor_stop(reactor);
+}
+
+#ifndef _WIN32
+/* SIGUSR1: dump the trace rings without stopping */
+static void on_trace_signal(Reactor *reactor, void *ctx) {
+    (void)reactor;
+    (void)ctx;
+    trace_request_flush();
+    trace_poll();
 }
 #endif
 
+static void on_metrics_timer(Reactor *reactor, void *ctx) {
+    (void)reactor;
+    metrics_dump_file((const char*)ctx);
+}
+
+static void on_gap_timer(Reactor *reactor, void *ctx) {
+    (void)reactor;
+    ringclient_write_gap_file((const char*)ctx);
+}
+
+/* New picks from the fetcher queue waveform snapshots */
+static void on_new_pick(const PickData *pick, void *ctx) {
+    (void)ctx;
+    snapshot_enqueue(pick->network, pick->station, pick->epoch, pick->event_id);
+}
+
+/* Copy a setting into a component's fixed-size field; say so if it is cut */
+static void copy_setting(char *dst, size_t size, const char *value, const char *name) {
+    if ((size_t)snprintf(dst, size, "%s", value) >= size)
+        fprintf(stderr, "[Main] Warning: %s is too long, truncated to %zu characters\n",
+                name, size - 1);
+}
+
 static void print_usage(const char *progname) {
     printf("\nUsage: %s [config_file]\n\n", progname);
     printf("  config_file   Path to configuration file (default: %s)\n\n", 
@@ -75,6 +102,7 @@ static void print_usage(const char *progname) {
     printf("  ring_buffer_minutes = 5\n");
     printf("  cleanup_interval = 100\n");
     printf("  output_dir = ./data\n");
+    printf("  metrics_port = 9180\n");
     printf("\n");
     printf("  # Pick fetcher settings\n");
     printf("  pickfetcher_enabled = true\n");
@@ -86,6 +114,8 @@ static void print_usage(const char *progname) {
     printf("  picks_file = picks.txt\n");
     printf("  picks_update_interval = 60\n");
     printf("  picks_lookback = 7200\n");
+    printf("  # Extra databases (repeatable), queried concurrently and merged\n");
+    printf("  db_source = sysop:sysop@10.0.0.2:3306/seiscomp\n");
     printf("\n");
 }
 
@@ -93,6 +123,7 @@ int main(int argc, char **argv) {
     AppConfig config;
     RingClientConfig rc_config;
     PickFetcherConfig pf_config;
+    LoggerConfig log_config;
     RingClientThread rc_thread;
     PickFetcherThread pf_thread;
     const char *config_file = DEFAULT_CONFIG_FILE;
@@ -126,60 +157,186 @@ int main(int argc, char **argv) {
     /* Print configuration */
     config_print(&config);
 
+    /*
+     * Signals are routed to the event loop before any thread exists, so
+     * every thread inherits the blocked mask (see reactor.h)
+     */
+    g_reactor = reactor_create();
+    if (g_reactor == NULL) {
+        fprintf(stderr, "Failed to create event loop\n");
+        return 1;
+    }
+    reactor_add_signal(g_reactor, SIGINT, on_shutdown_signal, NULL);
+    reactor_add_signal(g_reactor, SIGTERM, on_shutdown_signal, NULL);
+#ifndef _WIN32
+    reactor_add_signal(g_reactor, SIGUSR1, on_trace_signal, NULL);
+    /* sendfile() to a client that went away must fail, not kill the process */
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    /* Metrics registry must exist before any thread registers into it */
+    metrics_init();
+    if (config.metrics_port > 0)
+        metrics_http_start(NULL, config.metrics_port);
+
+    if (config.trace_enabled)
+        trace_init(config.trace_file, config.trace_buffer_events);
+
+    /* Runtime messages go through the logger thread; verbose >= 2 implies debug */
+    log_config.level = logger_parse_level(config.log_level);
+    if (config.verbose >= 2 && log_config.level < LOG_LEVEL_DEBUG)
+        log_config.level = LOG_LEVEL_DEBUG;
+    log_config.rate_limit = config.log_rate_limit;
+    log_config.debug_sample = config.log_debug_sample;
+    log_config.ring_records = config.log_ring_records;
+    logger_start(&log_config);
+
     /* Initialize RingClient configuration */
     ringclient_init_config(&rc_config);
-    strncpy(rc_config.server_address, config.seedlink_server, 
-            sizeof(rc_config.server_address) - 1);
+    copy_setting(rc_config.server_address, sizeof(rc_config.server_address),
+                 config.seedlink_server, "seedlink_server");
     rc_config.port = config.seedlink_port;
-    strncpy(rc_config.stream_file, config.stream_file, 
-            sizeof(rc_config.stream_file) - 1);
-    strncpy(rc_config.state_file, config.state_file, 
-            sizeof(rc_config.state_file) - 1);
-    strncpy(rc_config.output_dir, config.output_dir, 
-            sizeof(rc_config.output_dir) - 1);
+    copy_setting(rc_config.stream_file, sizeof(rc_config.stream_file),
+                 config.stream_file, "stream_file");
+    copy_setting(rc_config.state_file, sizeof(rc_config.state_file),
+                 config.state_file, "state_file");
+    copy_setting(rc_config.output_dir, sizeof(rc_config.output_dir),
+                 config.output_dir, "output_dir");
     rc_config.verbose = config.verbose;
     rc_config.ring_buffer_minutes = config.ring_buffer_minutes;
     rc_config.cleanup_interval = config.cleanup_interval;
+    rc_config.latency_threshold = config.latency_threshold;
+    rc_config.reorder_seconds = config.reorder_seconds;
+    rc_config.record_index = config.dataselect_port > 0 || config.snapshot_dir[0] != '\0';
+    rc_config.reactor = g_reactor;
+    copy_setting(rc_config.replay_path, sizeof(rc_config.replay_path),
+                 config.replay_archive, "replay_archive");
+    rc_config.replay_speed = config.replay_speed;
+    if (config.replay_start[0])
+        archive_parse_time(config.replay_start, &rc_config.replay_start);
+    if (config.replay_end[0])
+        archive_parse_time(config.replay_end, &rc_config.replay_end);
 
     /* Set global pointer for signal handler */
     g_rc_config = &rc_config;
 
+    /* Served from the ring index, which ringclient_init_config() set up */
+    if (config.dataselect_port > 0)
+        dataselect_start(NULL, config.dataselect_port);
+
+    /* Sinks behind the ring buffers: non-blocking ones inline, the rest queued */
+    if (config.shm_export && shm_export_start(config.shm_prefix, (unsigned int)config.shm_slots) == 0)
+        sink_add("shm", &shm_export_ops, NULL, 0);
+    if (config.relay_port > 0 &&
+        slrelay_start(config.relay_bind, config.relay_port, config.relay_history,
+                      config.relay_max_clients) == 0)
+        sink_add("relay", &slrelay_ops, NULL, 0);
+    if (config.envelope_dir[0] &&
+        envelope_start(config.envelope_dir, config.envelope_levels, config.envelope_level_count,
+                       config.ring_buffer_minutes * 60) == 0)
+        sink_add("envelope", &envelope_ops, NULL, config.sink_queue);
+    if (config.archive_dir[0]) {
+        FileSink *fs = file_sink_create(config.archive_dir, FILE_SINK_SDS, 0,
+                                        config.sink_max_files);
+        if (fs != NULL)
+            sink_add("archive", &file_sink_ops, fs, config.sink_queue);
+    }
+    if (config.segment_dir[0]) {
+        FileSink *fs = file_sink_create(config.segment_dir, FILE_SINK_SEGMENTS,
+                                        config.segment_minutes, config.sink_max_files);
+        if (fs != NULL)
+            sink_add("segments", &file_sink_ops, fs, config.sink_queue);
+    }
+    if (config.forward_address[0]) {
+        ForwardSink *fw = forward_sink_create(config.forward_address);
+        if (fw != NULL)
+            sink_add("forward", &forward_sink_ops, fw, config.sink_queue);
+    }
+    if (sink_count() > 0)
+        ringclient_add_record_callback(sink_dispatch, NULL);
+
     /* Initialize PickFetcher configuration if enabled */
     if (config.pickfetcher_enabled) {
         memset(&pf_config, 0, sizeof(pf_config));
-        strncpy(pf_config.db_host, config.db_host, sizeof(pf_config.db_host) - 1);
-        pf_config.db_port = config.db_port;
-        strncpy(pf_config.db_user, config.db_user, sizeof(pf_config.db_user) - 1);
-        strncpy(pf_config.db_password, config.db_password, 
-                sizeof(pf_config.db_password) - 1);
-        strncpy(pf_config.db_name, config.db_name, sizeof(pf_config.db_name) - 1);
+
+        /* db_host/db_* is the primary source, db_source lines add more */
+        PickSource *src = &pf_config.sources[pf_config.source_count++];
+        copy_setting(src->db_host, sizeof(src->db_host), config.db_host, "db_host");
+        src->db_port = config.db_port;
+        copy_setting(src->db_user, sizeof(src->db_user), config.db_user, "db_user");
+        copy_setting(src->db_password, sizeof(src->db_password),
+                     config.db_password, "db_password");
+        copy_setting(src->db_name, sizeof(src->db_name), config.db_name, "db_name");
+
+        for (int i = 0; i < config.db_source_count; i++) {
+            src = &pf_config.sources[pf_config.source_count++];
+            copy_setting(src->db_host, sizeof(src->db_host),
+                         config.db_sources[i].host, "db_source host");
+            src->db_port = config.db_sources[i].port;
+            copy_setting(src->db_user, sizeof(src->db_user),
+                         config.db_sources[i].user, "db_source user");
+            copy_setting(src->db_password, sizeof(src->db_password),
+                         config.db_sources[i].password, "db_source password");
+            copy_setting(src->db_name, sizeof(src->db_name),
+                         config.db_sources[i].name, "db_source name");
+        }
+        pf_config.query_threads = config.pick_query_threads;
+        pf_config.dedup_tolerance_ms = config.pick_dedup_tolerance_ms;
+        copy_setting(pf_config.feed_address, sizeof(pf_config.feed_address),
+                     config.pick_feed, "pick_feed");
+        if (strcasecmp(config.picks_shard, "station") == 0)
+            pf_config.shard_mode = PICKS_SHARD_STATION;
+        else if (strcasecmp(config.picks_shard, "hour") == 0)
+            pf_config.shard_mode = PICKS_SHARD_HOUR;
+        else if (strcasecmp(config.picks_shard, "day") == 0)
+            pf_config.shard_mode = PICKS_SHARD_DAY;
+        pf_config.picks_mode = config.picks_event_mode ? PICKS_MODE_EVENT
+                                                       : PICKS_MODE_ALL;
         
         /* Build full path for picks file */
         if (config.output_dir[0] != '\0' && 
             config.picks_file[0] != '/' && 
             config.picks_file[0] != '\\' &&
             !(config.picks_file[1] == ':')) {
-            snprintf(pf_config.output_filepath, sizeof(pf_config.output_filepath),
-                     "%s/%s", config.output_dir, config.picks_file);
+            if ((size_t)snprintf(pf_config.output_filepath, sizeof(pf_config.output_filepath),
+                                 "%s/%s", config.output_dir, config.picks_file) >=
+                sizeof(pf_config.output_filepath))
+                fprintf(stderr, "[Main] Warning: picks_file path is too long, truncated\n");
         } else {
-            strncpy(pf_config.output_filepath, config.picks_file,
-                    sizeof(pf_config.output_filepath) - 1);
+            copy_setting(pf_config.output_filepath, sizeof(pf_config.output_filepath),
+                         config.picks_file, "picks_file");
         }
         
         pf_config.update_interval_sec = config.picks_update_interval;
+        pf_config.interval_min_sec = config.picks_interval_min;
+        pf_config.interval_max_sec = config.picks_interval_max;
         pf_config.lookback_sec = config.picks_lookback;
+        pf_config.reactor = g_reactor;
+
+        if (config.snapshot_dir[0] != '\0') {
+            SnapshotConfig snap_config;
+
+            memset(&snap_config, 0, sizeof(snap_config));
+            copy_setting(snap_config.dir, sizeof(snap_config.dir),
+                         config.snapshot_dir, "snapshot_dir");
+            snap_config.pre_sec = config.snapshot_pre_sec;
+            snap_config.post_sec = config.snapshot_post_sec;
+            copy_setting(snap_config.neighbours_file, sizeof(snap_config.neighbours_file),
+                         config.snapshot_neighbours, "snapshot_neighbours");
+            if (snapshot_start(&snap_config) == 0)
+                pf_config.pick_callback = on_new_pick;
+        }
         
         /* Set global pointer for signal handler */
         g_pf_config = &pf_config;
     }
 
-    /* Set up signal handlers BEFORE starting threads */
-#ifdef _WIN32
-    SetConsoleCtrlHandler(console_handler, TRUE);
-#else
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
-#endif
+    if (config.metrics_file[0] != '\0' && config.metrics_file_interval > 0)
+        reactor_add_timer(g_reactor, (unsigned int)config.metrics_file_interval * 1000,
+                          on_metrics_timer, config.metrics_file);
+    if (config.gap_file[0] != '\0' && config.gap_file_interval > 0)
+        reactor_add_timer(g_reactor, (unsigned int)config.gap_file_interval * 1000,
+                          on_gap_timer, config.gap_file);
 
     /* Start RingClient thread */
     printf("[Main] Starting RingClient...\n");
@@ -189,6 +346,20 @@ int main(int argc, char **argv) {
     }
     rc_started = 1;
 
+    /* Gaps come from the ring timelines, so the ringclient runs first */
+    if (config.backfill_url[0] != '\0') {
+        BackfillConfig bf_config;
+
+        memset(&bf_config, 0, sizeof(bf_config));
+        copy_setting(bf_config.url, sizeof(bf_config.url),
+                     config.backfill_url, "backfill_url");
+        bf_config.max_connections = config.backfill_max_connections;
+        bf_config.interval = config.backfill_interval;
+        bf_config.delay = config.backfill_delay;
+        bf_config.retries = config.backfill_retries;
+        backfill_start(&bf_config);
+    }
+
     /* Start PickFetcher thread if enabled */
     if (config.pickfetcher_enabled) {
         printf("[Main] Starting PickFetcher...\n");
@@ -201,14 +372,8 @@ int main(int argc, char **argv) {
 
     printf("\n[Main] Running... Press Ctrl+C to stop.\n\n");
 
-    /* Main loop - just wait for shutdown signal */
-    while (g_running && rc_config.running) {
-#ifdef _WIN32
-        Sleep(1000);  /* Check every second */
-#else
-        sleep(1);
-#endif
-    }
+    /* Main loop - timers and signals until a shutdown signal stops it */
+    reactor_run(g_reactor);
 
     /* Shutdown */
     printf("\n[Main] Initiating shutdown...\n");
@@ -226,15 +391,45 @@ int main(int argc, char **argv) {
         printf("[Main] PickFetcher stopped\n");
     }
 
+    /* No readers of the ring files once the ringclient frees its index */
+    if (config.dataselect_port > 0)
+        dataselect_stop();
+    snapshot_stop();
+    backfill_stop();
+
     if (rc_started) {
         printf("[Main] Waiting for RingClient to stop...\n");
         ringclient_stop(&rc_config, rc_thread);
         printf("[Main] RingClient stopped\n");
     }
 
+    /* The receive thread was the only producer; drain queued sinks */
+    sink_stop_all();
+    if (config.shm_export)
+        shm_export_stop();
+    if (config.relay_port > 0)
+        slrelay_stop();
+    if (config.envelope_dir[0])
+        envelope_stop();
+
+    /* Flush queued log records before the final messages */
+    logger_stop();
+
+    /* Final metrics dump once every thread has stopped */
+    if (config.metrics_port > 0)
+        metrics_http_stop();
+    if (config.metrics_file[0] != '\0')
+        metrics_dump_file(config.metrics_file);
+    metrics_shutdown();
+
+    trace_flush();
+    trace_shutdown();
+
     /* Clear global pointers */
     g_rc_config = NULL;
     g_pf_config = NULL;
+    reactor_destroy(g_reactor);
+    g_reactor = NULL;
 
     printf("[Main] Shutdown complete.\n");
     return 0;
@@ -0,0 +1,434 @@
+#include "metrics.h"
+#include "platform.h"
+#include "httpd.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#define METRICS_SHARDS 8
+#define HIST_SUB_BITS 3
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_EXPONENT 40                /* ~12.7 days in microseconds */
+#define HIST_BUCKETS (HIST_SUB_COUNT + (HIST_MAX_EXPONENT - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+#define METRIC_COUNTER   0
+#define METRIC_GAUGE     1
+#define METRIC_HISTOGRAM 2
+
+struct MetricCounter {
+    volatile unsigned long long shards[METRICS_SHARDS];
+};
+
+struct MetricGauge {
+    volatile unsigned long long bits;       /* double stored as raw bits */
+};
+
+struct MetricHistogram {
+    volatile unsigned long long buckets[HIST_BUCKETS];
+    volatile unsigned long long count;
+    volatile unsigned long long sum;
+};
+
+typedef struct {
+    int type;
+    char *name;
+    char *labels;
+    char *help;
+    void *metric;
+} MetricEntry;
+
+/* Growable text buffer for the exposition format */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+} MetricsBuffer;
+
+static PlatformMutex g_registry_lock;
+static int g_registry_init = 0;
+static MetricEntry *g_entries = NULL;
+static size_t g_entry_count = 0;
+static size_t g_entry_capacity = 0;
+static HttpServer *g_http = NULL;
+
+static volatile unsigned long long g_next_slot = 0;
+static PLATFORM_THREAD_LOCAL int tls_slot = -1;
+
+static int thread_slot(void) {
+    if (tls_slot < 0) {
+        unsigned long long slot = g_next_slot;
+        platform_atomic_add_u64(&g_next_slot, 1);
+        tls_slot = (int)(slot % METRICS_SHARDS);
+    }
+    return tls_slot;
+}
+
+void metrics_init(void) {
+    if (!g_registry_init) {
+        platform_mutex_init(&g_registry_lock);
+        g_registry_init = 1;
+    }
+}
+
+static void registry_lock(void) {
+    platform_mutex_lock(&g_registry_lock);
+}
+
+static int highest_bit(unsigned long long v) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, v);
+    return (int)idx;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+static char* dup_string(const char *s) {
+    size_t len = s ? strlen(s) : 0;
+    char *copy = (char*)malloc(len + 1);
+    if (copy) {
+        if (len)
+            memcpy(copy, s, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+static void* register_metric(int type, const char *name, const char *labels,
+                             const char *help, size_t size) {
+    void *metric = NULL;
+
+    if (!g_registry_init)
+        return NULL;
+
+    registry_lock();
+
+    if (g_entry_count >= g_entry_capacity) {
+        size_t cap = g_entry_capacity ? g_entry_capacity * 2 : 64;
+        MetricEntry *grown = (MetricEntry*)realloc(g_entries, cap * sizeof(MetricEntry));
+        if (grown == NULL) {
+            platform_mutex_unlock(&g_registry_lock);
+            return NULL;
+        }
+        g_entries = grown;
+        g_entry_capacity = cap;
+    }
+
+    metric = calloc(1, size);
+    if (metric) {
+        MetricEntry *e = &g_entries[g_entry_count++];
+        e->type = type;
+        e->name = dup_string(name);
+        e->labels = dup_string(labels);
+        e->help = dup_string(help);
+        e->metric = metric;
+    }
+
+    platform_mutex_unlock(&g_registry_lock);
+    return metric;
+}
+
+MetricCounter* metrics_counter(const char *name, const char *labels, const char *help) {
+    return (MetricCounter*)register_metric(METRIC_COUNTER, name, labels, help,
+                                           sizeof(MetricCounter));
+}
+
+MetricGauge* metrics_gauge(const char *name, const char *labels, const char *help) {
+    return (MetricGauge*)register_metric(METRIC_GAUGE, name, labels, help,
+                                         sizeof(MetricGauge));
+}
+
+MetricHistogram* metrics_histogram(const char *name, const char *labels, const char *help) {
+    return (MetricHistogram*)register_metric(METRIC_HISTOGRAM, name, labels, help,
+                                             sizeof(MetricHistogram));
+}
+
+void metrics_counter_add(MetricCounter *counter, unsigned long long value) {
+    if (counter)
+        platform_atomic_add_u64(&counter->shards[thread_slot()], value);
+}
+
+unsigned long long metrics_counter_value(MetricCounter *counter) {
+    unsigned long long total = 0;
+
+    if (counter == NULL)
+        return 0;
+    for (int i = 0; i < METRICS_SHARDS; i++)
+        total += platform_atomic_load_u64(&counter->shards[i]);
+    return total;
+}
+
+void metrics_gauge_set(MetricGauge *gauge, double value) {
+    unsigned long long bits;
+
+    if (gauge == NULL)
+        return;
+    memcpy(&bits, &value, sizeof(bits));
+    platform_atomic_store_u64(&gauge->bits, bits);
+}
+
+double metrics_gauge_value(MetricGauge *gauge) {
+    unsigned long long bits;
+    double value;
+
+    if (gauge == NULL)
+        return 0.0;
+    bits = platform_atomic_load_u64(&gauge->bits);
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static int bucket_index(unsigned long long v) {
+    int exponent;
+
+    if (v < HIST_SUB_COUNT)
+        return (int)v;
+
+    exponent = highest_bit(v);
+    if (exponent > HIST_MAX_EXPONENT)
+        return HIST_BUCKETS - 1;
+
+    return HIST_SUB_COUNT + (exponent - HIST_SUB_BITS) * HIST_SUB_COUNT +
+           (int)((v >> (exponent - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+}
+
+/* Exclusive upper bound of a bucket in microseconds */
+static unsigned long long bucket_upper(int idx) {
+    int exponent, sub;
+
+    if (idx < HIST_SUB_COUNT)
+        return (unsigned long long)idx + 1;
+
+    exponent = (idx - HIST_SUB_COUNT) / HIST_SUB_COUNT + HIST_SUB_BITS;
+    sub = (idx - HIST_SUB_COUNT) % HIST_SUB_COUNT;
+    return ((unsigned long long)(HIST_SUB_COUNT + sub + 1)) << (exponent - HIST_SUB_BITS);
+}
+
+void metrics_histogram_record(MetricHistogram *hist, unsigned long long value_us) {
+    if (hist == NULL)
+        return;
+    platform_atomic_add_u64(&hist->buckets[bucket_index(value_us)], 1);
+    platform_atomic_add_u64(&hist->count, 1);
+    platform_atomic_add_u64(&hist->sum, value_us);
+}
+
+unsigned long long metrics_histogram_count(MetricHistogram *hist) {
+    return hist ? platform_atomic_load_u64(&hist->count) : 0;
+}
+
+unsigned long long metrics_histogram_quantile(MetricHistogram *hist, double q) {
+    unsigned long long total, target, seen = 0;
+
+    if (hist == NULL)
+        return 0;
+    total = platform_atomic_load_u64(&hist->count);
+    if (total == 0)
+        return 0;
+
+    target = (unsigned long long)(q * (double)total);
+    if (target >= total)
+        target = total - 1;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += platform_atomic_load_u64(&hist->buckets[i]);
+        if (seen > target)
+            return bucket_upper(i) - 1;
+    }
+    return bucket_upper(HIST_BUCKETS - 1);
+}
+
+static void buffer_printf(MetricsBuffer *buf, const char *fmt, ...) {
+    va_list ap;
+    int needed;
+
+    for (;;) {
+        size_t room = buf->capacity - buf->len;
+        va_start(ap, fmt);
+        needed = vsnprintf(buf->data ? buf->data + buf->len : NULL, room, fmt, ap);
+        va_end(ap);
+        if (needed < 0)
+            return;
+        if ((size_t)needed < room) {
+            buf->len += (size_t)needed;
+            return;
+        }
+        size_t cap = (buf->capacity ? buf->capacity * 2 : 16384) + (size_t)needed;
+        char *grown = (char*)realloc(buf->data, cap);
+        if (grown == NULL)
+            return;
+        buf->data = grown;
+        buf->capacity = cap;
+    }
+}
+
+static int compare_entries(const void *a, const void *b) {
+    const MetricEntry *ea = *(const MetricEntry * const *)a;
+    const MetricEntry *eb = *(const MetricEntry * const *)b;
+    int cmp = strcmp(ea->name, eb->name);
+    if (cmp != 0)
+        return cmp;
+    return (ea > eb) - (ea < eb);   /* Keep registration order within a family */
+}
+
+static void format_histogram(MetricsBuffer *buf, const MetricEntry *e) {
+    MetricHistogram *h = (MetricHistogram*)e->metric;
+    const char *sep = e->labels[0] ? "," : "";
+    unsigned long long cumulative = 0;
+    unsigned long long count = platform_atomic_load_u64(&h->count);
+    int last = -1;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        if (platform_atomic_load_u64(&h->buckets[i]) > 0)
+            last = i;
+    }
+
+    /* One "le" boundary per power of two up to the highest used bucket */
+    for (int i = 0; i <= last; i++) {
+        cumulative += platform_atomic_load_u64(&h->buckets[i]);
+        if (i >= HIST_SUB_COUNT - 1 && (i + 1) % HIST_SUB_COUNT != 0 && i != last)
+            continue;
+        buffer_printf(buf, "%s_bucket{%s%sle=\"%g\"} %llu\n", e->name, e->labels, sep,
+                      bucket_upper(i) / 1e6, cumulative);
+    }
+    buffer_printf(buf, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", e->name, e->labels, sep, count);
+    buffer_printf(buf, "%s_sum%s%s%s %g\n", e->name, e->labels[0] ? "{" : "",
+                  e->labels, e->labels[0] ? "}" : "",
+                  platform_atomic_load_u64(&h->sum) / 1e6);
+    buffer_printf(buf, "%s_count%s%s%s %llu\n", e->name, e->labels[0] ? "{" : "",
+                  e->labels, e->labels[0] ? "}" : "", count);
+}
+
+static void format_metrics(MetricsBuffer *buf) {
+    static const char *type_names[] = { "counter", "gauge", "histogram" };
+    MetricEntry **sorted;
+    const char *family = NULL;
+
+    if (!g_registry_init)
+        return;
+
+    registry_lock();
+
+    sorted = (MetricEntry**)malloc((g_entry_count ? g_entry_count : 1) * sizeof(MetricEntry*));
+    if (sorted == NULL) {
+        platform_mutex_unlock(&g_registry_lock);
+        return;
+    }
+    for (size_t i = 0; i < g_entry_count; i++)
+        sorted[i] = &g_entries[i];
+    qsort(sorted, g_entry_count, sizeof(MetricEntry*), compare_entries);
+
+    for (size_t i = 0; i < g_entry_count; i++) {
+        MetricEntry *e = sorted[i];
+
+        if (family == NULL || strcmp(family, e->name) != 0) {
+            family = e->name;
+            if (e->help[0])
+                buffer_printf(buf, "# HELP %s %s\n", e->name, e->help);
+            buffer_printf(buf, "# TYPE %s %s\n", e->name, type_names[e->type]);
+        }
+
+        if (e->type == METRIC_HISTOGRAM) {
+            format_histogram(buf, e);
+            continue;
+        }
+
+        buffer_printf(buf, "%s%s%s%s ", e->name, e->labels[0] ? "{" : "",
+                      e->labels, e->labels[0] ? "}" : "");
+        if (e->type == METRIC_COUNTER)
+            buffer_printf(buf, "%llu\n", metrics_counter_value((MetricCounter*)e->metric));
+        else
+            buffer_printf(buf, "%g\n", metrics_gauge_value((MetricGauge*)e->metric));
+    }
+
+    free(sorted);
+    platform_mutex_unlock(&g_registry_lock);
+}
+
+int metrics_write(FILE *fp) {
+    MetricsBuffer buf = { NULL, 0, 0 };
+    int rc = 0;
+
+    format_metrics(&buf);
+    if (buf.len > 0 && fwrite(buf.data, 1, buf.len, fp) != buf.len)
+        rc = -1;
+    free(buf.data);
+    return rc;
+}
+
+int metrics_dump_file(const char *path) {
+    char tmp_path[600];
+    FILE *fp;
+    int rc;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    fp = fopen(tmp_path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "[Metrics] Failed to open %s\n", tmp_path);
+        return -1;
+    }
+    rc = metrics_write(fp);
+    fclose(fp);
+
+    if (rc == 0) {
+#ifdef _WIN32
+        remove(path);
+#endif
+        if (rename(tmp_path, path) != 0) {
+            remove(tmp_path);
+            rc = -1;
+        }
+    }
+    return rc;
+}
+
+static int metrics_http_handler(NetSocket client, const HttpRequest *req, void *ctx) {
+    MetricsBuffer buf = { NULL, 0, 0 };
+
+    (void)ctx;
+
+    if (strcmp(req->path, "/metrics") != 0 && strcmp(req->path, "/") != 0) {
+        const char *msg = "Not found, try /metrics\n";
+        return httpd_send_response(client, 404, "text/plain", msg, strlen(msg));
+    }
+
+    format_metrics(&buf);
+    httpd_send_response(client, 200, "text/plain; version=0.0.4",
+                        buf.data ? buf.data : "", buf.len);
+    free(buf.data);
+    return 0;
+}
+
+int metrics_http_start(const char *host, int port) {
+    g_http = httpd_start(host, port, metrics_http_handler, NULL);
+    if (g_http == NULL) {
+        fprintf(stderr, "[Metrics] Failed to start HTTP endpoint on port %d\n", port);
+        return -1;
+    }
+    printf("[Metrics] Serving http://%s:%d/metrics\n",
+           (host && host[0]) ? host : "127.0.0.1", port);
+    return 0;
+}
+
+void metrics_http_stop(void) {
+    httpd_stop(g_http);
+    g_http = NULL;
+}
+
+void metrics_shutdown(void) {
+    if (!g_registry_init)
+        return;
+
+    platform_mutex_lock(&g_registry_lock);
+    for (size_t i = 0; i < g_entry_count; i++) {
+        free(g_entries[i].name);
+        free(g_entries[i].labels);
+        free(g_entries[i].help);
+        free(g_entries[i].metric);
+    }
+    free(g_entries);
+    g_entries = NULL;
+    g_entry_count = 0;
+    g_entry_capacity = 0;
+    platform_mutex_unlock(&g_registry_lock);
+}
@@ -0,0 +1,62 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+/*
+ * In-process metrics registry.
+ *
+ * Counters are split into per-thread shards updated with relaxed atomics,
+ * so hot paths never take a lock. Histograms use log-linear buckets
+ * (8 sub-buckets per power of two, HDR style) over microsecond values.
+ * Registration takes a lock and is expected at startup or when a new
+ * stream appears. The registry is exposed in Prometheus text format over
+ * a localhost HTTP port and can be dumped to a file.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Set up the registry; call once from main() before starting threads */
+void metrics_init(void);
+
+typedef struct MetricCounter MetricCounter;
+typedef struct MetricGauge MetricGauge;
+typedef struct MetricHistogram MetricHistogram;
+
+/*
+ * Register a metric and keep the returned pointer; registering the same
+ * name and labels twice creates two series. labels is a Prometheus label
+ * set without braces, e.g. "stream=\"GE_APE_HHZ\"", or NULL. Returns NULL
+ * on allocation failure or before metrics_init(); update functions accept
+ * NULL as a no-op.
+ */
+MetricCounter* metrics_counter(const char *name, const char *labels, const char *help);
+MetricGauge* metrics_gauge(const char *name, const char *labels, const char *help);
+MetricHistogram* metrics_histogram(const char *name, const char *labels, const char *help);
+
+void metrics_counter_add(MetricCounter *counter, unsigned long long value);
+unsigned long long metrics_counter_value(MetricCounter *counter);
+
+void metrics_gauge_set(MetricGauge *gauge, double value);
+double metrics_gauge_value(MetricGauge *gauge);
+
+/* Record one observation in microseconds */
+void metrics_histogram_record(MetricHistogram *hist, unsigned long long value_us);
+
+/* Approximate quantile (0..1) in microseconds, 0 when empty */
+unsigned long long metrics_histogram_quantile(MetricHistogram *hist, double q);
+unsigned long long metrics_histogram_count(MetricHistogram *hist);
+
+/* Write every metric in Prometheus text format */
+int metrics_write(FILE *fp);
+
+/* Write atomically to path (tmp + rename) */
+int metrics_dump_file(const char *path);
+
+/* Serve GET /metrics on host:port (empty host = 127.0.0.1) */
+int metrics_http_start(const char *host, int port);
+void metrics_http_stop(void);
+
+/* Free every registered metric (after all threads stopped) */
+void metrics_shutdown(void);
+
+#endif /* METRICS_H */
@@ -0,0 +1,348 @@
+#include "mseed_util.h"
+#include "steim.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+static uint16_t read_u16(const unsigned char *p, int swap) {
+    return swap ? (uint16_t)(p[1] << 8 | p[0]) : (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static int16_t read_i16(const unsigned char *p, int swap) {
+    return (int16_t)read_u16(p, swap);
+}
+
+static int32_t read_i32(const unsigned char *p, int swap) {
+    uint32_t v = swap
+        ? ((uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0])
+        : ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]);
+    return (int32_t)v;
+}
+
+static float read_f32(const unsigned char *p, int swap) {
+    int32_t bits = read_i32(p, swap);
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+long mseed_days_from_year_doy(int year, int doy) {
+    long y = year - 1;
+    long days = (y - 1969) * 365 + (y / 4 - 1969 / 4) - (y / 100 - 1969 / 100) +
+                (y / 400 - 1969 / 400);
+    return days + doy - 1;
+}
+
+void mseed_format_time(double epoch, char *buf, size_t len) {
+    double whole = floor(epoch);
+    long long secs = (long long)whole;
+    long long days = secs / 86400;
+    long rem = (long)(secs % 86400);
+    long usec = (long)llround((epoch - whole) * 1e6);
+    static const int month_days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int year, month = 0, day;
+
+    if (usec >= 1000000) {
+        usec -= 1000000;
+        if (++rem == 86400) {
+            rem = 0;
+            days++;
+        }
+    }
+    if (rem < 0) {
+        rem += 86400;
+        days--;
+    }
+    if (days < mseed_days_from_year_doy(0, 1))
+        days = mseed_days_from_year_doy(0, 1);
+    if (days > mseed_days_from_year_doy(9999, 365))
+        days = mseed_days_from_year_doy(9999, 365);
+
+    year = 1970 + (int)(days / 366) - (days < 0);
+    while (year > 0 && mseed_days_from_year_doy(year, 1) > days)
+        year--;
+    while (year < 9999 && mseed_days_from_year_doy(year + 1, 1) <= days)
+        year++;
+    day = (int)(days - mseed_days_from_year_doy(year, 1));
+    while (month < 11) {
+        int leap = month == 1 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+        if (day < month_days[month] + leap)
+            break;
+        day -= month_days[month] + leap;
+        month++;
+    }
+
+    snprintf(buf, len, "%04d-%02d-%02dT%02d:%02d:%02d.%06ld",
+             year, month + 1, day + 1, (int)(rem / 3600), (int)(rem / 60 % 60),
+             (int)(rem % 60), usec);
+}
+
+/* Header is big-endian unless the year only makes sense byte-swapped */
+static int header_is_swapped(const unsigned char *rec) {
+    uint16_t year = read_u16(rec + 20, 0);
+    return !(year >= 1900 && year <= 2100);
+}
+
+static double btime_to_epoch(const unsigned char *bt, int swap) {
+    int year = read_u16(bt, swap);
+    int doy = read_u16(bt + 2, swap);
+
+    return (double)mseed_days_from_year_doy(year, doy) * 86400.0 +
+           bt[4] * 3600.0 + bt[5] * 60.0 + bt[6] +
+           read_u16(bt + 8, swap) * 0.0001;
+}
+
+double mseed_start_time(const char *record) {
+    const unsigned char *rec = (const unsigned char *)record;
+    return btime_to_epoch(rec + 20, header_is_swapped(rec));
+}
+
+static void copy_code(char *dst, const char *src, size_t n) {
+    size_t i;
+
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+    for (i = n; i > 0 && dst[i - 1] == ' '; i--)
+        dst[i - 1] = '\0';
+}
+
+static double sample_rate_from(int16_t factor, int16_t multiplier) {
+    if (factor == 0)
+        return 0.0;
+    if (factor > 0 && multiplier > 0)
+        return (double)factor * multiplier;
+    if (factor > 0 && multiplier < 0)
+        return -(double)factor / multiplier;
+    if (factor < 0 && multiplier > 0)
+        return -(double)multiplier / factor;
+    if (factor < 0 && multiplier < 0)
+        return 1.0 / ((double)factor * multiplier);
+    return (double)factor;
+}
+
+int mseed_parse_header(const char *record, size_t len, MSeedHeader *hdr) {
+    const unsigned char *rec = (const unsigned char *)record;
+    char seq[7];
+    int swap;
+    int blockette_offset;
+    int guard = 0;
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->encoding = -1;
+    hdr->record_length = 512;
+    hdr->big_endian_data = 1;
+
+    if (len < MSEED_FIXED_HEADER_SIZE)
+        return -1;
+
+    /* Data header indicator: D, R, Q or M */
+    if (strchr("DRQM", record[6]) == NULL || record[6] == '\0')
+        return -1;
+
+    swap = header_is_swapped(rec);
+    hdr->header_swapped = swap;
+    hdr->quality = record[6];
+
+    memcpy(seq, record, 6);
+    seq[6] = '\0';
+    hdr->sequence = strtol(seq, NULL, 10);
+
+    copy_code(hdr->station, record + 8, 5);
+    copy_code(hdr->location, record + 13, 2);
+    copy_code(hdr->channel, record + 15, 3);
+    copy_code(hdr->network, record + 18, 2);
+
+    hdr->start_time = btime_to_epoch(rec + 20, swap);
+    hdr->sample_count = read_u16(rec + 30, swap);
+    hdr->sample_rate = sample_rate_from(read_i16(rec + 32, swap), read_i16(rec + 34, swap));
+    hdr->data_offset = read_u16(rec + 44, swap);
+    blockette_offset = read_u16(rec + 46, swap);
+
+    /* Walk the blockette chain for 100 (rate), 1000 (format), 1001 (usec) */
+    while (blockette_offset >= MSEED_FIXED_HEADER_SIZE &&
+           (size_t)blockette_offset + 4 <= len && guard++ < 16) {
+        const unsigned char *b = rec + blockette_offset;
+        int type = read_u16(b, swap);
+        int next = read_u16(b + 2, swap);
+
+        if (type == 100 && (size_t)blockette_offset + 8 <= len) {
+            float rate = read_f32(b + 4, swap);
+            if (rate > 0.0f)
+                hdr->sample_rate = rate;
+        } else if (type == 1000 && (size_t)blockette_offset + 7 <= len) {
+            hdr->encoding = b[4];
+            hdr->big_endian_data = b[5] != 0;
+            if (b[6] >= 7 && b[6] <= 20)
+                hdr->record_length = 1 << b[6];
+        } else if (type == 1001 && (size_t)blockette_offset + 6 <= len) {
+            hdr->start_time += (signed char)b[5] * 1e-6;
+        }
+
+        if (next <= blockette_offset)
+            break;
+        blockette_offset = next;
+    }
+
+    hdr->end_time = hdr->start_time;
+    if (hdr->sample_rate > 0.0 && hdr->sample_count > 0)
+        hdr->end_time += hdr->sample_count / hdr->sample_rate;
+
+    return 0;
+}
+
+static void write_u16(unsigned char *p, uint16_t v, int swap) {
+    if (swap) {
+        p[0] = (unsigned char)v;
+        p[1] = (unsigned char)(v >> 8);
+    } else {
+        p[0] = (unsigned char)(v >> 8);
+        p[1] = (unsigned char)v;
+    }
+}
+
+static void write_i32(unsigned char *p, int32_t value) {
+    uint32_t v = (uint32_t)value;
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+static void put_code(char *dst, const char *src, size_t n) {
+    size_t len = strlen(src);
+
+    memset(dst, ' ', n);
+    memcpy(dst, src, len < n ? len : n);
+}
+
+/* Write BTIME; returns the microseconds below its 0.0001 s resolution */
+static int write_btime(unsigned char *bt, double epoch, int swap) {
+    double whole = floor(epoch);
+    long long secs = (long long)whole;
+    long days = (long)(secs / 86400);
+    long rem = (long)(secs % 86400);
+    long usec = (long)((epoch - whole) * 1e6 + 0.5);
+    int year = 1970 + (int)(days / 366);
+
+    if (usec >= 1000000) {
+        usec = 999999;
+    }
+    while (mseed_days_from_year_doy(year + 1, 1) <= days)
+        year++;
+
+    write_u16(bt, (uint16_t)year, swap);
+    write_u16(bt + 2, (uint16_t)(days - mseed_days_from_year_doy(year, 1) + 1), swap);
+    bt[4] = (unsigned char)(rem / 3600);
+    bt[5] = (unsigned char)(rem / 60 % 60);
+    bt[6] = (unsigned char)(rem % 60);
+    bt[7] = 0;
+    write_u16(bt + 8, (uint16_t)(usec / 100), swap);
+    return (int)(usec % 100);
+}
+
+void mseed_set_start_time(char *record, double start_time) {
+    unsigned char *rec = (unsigned char *)record;
+    write_btime(rec + 20, start_time, header_is_swapped(rec));
+}
+
+int mseed_build_record(char *record, size_t len,
+                       const char *network, const char *station,
+                       const char *location, const char *channel,
+                       long sequence, double start_time, double sample_rate,
+                       const int32_t *samples, int count) {
+    unsigned char *rec = (unsigned char *)record;
+    const int data_offset = 64;
+    char seq[8];
+    int exponent = 0;
+    int usec;
+    int capacity;
+    int i;
+
+    while (((size_t)1 << exponent) < len)
+        exponent++;
+    if (len < 128 || ((size_t)1 << exponent) != len)
+        return -1;
+
+    capacity = (int)(len - data_offset) / 4;
+    if (count > capacity)
+        count = capacity;
+
+    memset(record, 0, len);
+    snprintf(seq, sizeof(seq), "%06ld", sequence % 1000000);
+    memcpy(record, seq, 6);
+    record[6] = 'D';
+    record[7] = ' ';
+    put_code(record + 8, station, 5);
+    put_code(record + 13, location, 2);
+    put_code(record + 15, channel, 3);
+    put_code(record + 18, network, 2);
+
+    usec = write_btime(rec + 20, start_time, 0);
+    write_u16(rec + 30, (uint16_t)count, 0);
+    if (sample_rate >= 1.0) {
+        write_u16(rec + 32, (uint16_t)(int16_t)(sample_rate + 0.5), 0);
+    } else if (sample_rate > 0.0) {
+        write_u16(rec + 32, (uint16_t)(int16_t)-(int)(1.0 / sample_rate + 0.5), 0);
+    }
+    write_u16(rec + 34, 1, 0);
+    rec[39] = 2;                                /* Blockettes that follow */
+    write_u16(rec + 44, (uint16_t)data_offset, 0);
+    write_u16(rec + 46, 48, 0);
+
+    /* Blockette 1000: encoding, word order, record length */
+    write_u16(rec + 48, 1000, 0);
+    write_u16(rec + 50, 56, 0);
+    rec[52] = MSEED_ENC_INT32;
+    rec[53] = 1;
+    rec[54] = (unsigned char)exponent;
+
+    /* Blockette 1001: microseconds below the BTIME resolution */
+    write_u16(rec + 56, 1001, 0);
+    write_u16(rec + 58, 0, 0);
+    rec[60] = 100;
+    rec[61] = (unsigned char)(signed char)usec;
+
+    for (i = 0; i < count; i++)
+        write_i32(rec + data_offset + 4 * i, samples[i]);
+
+    return count;
+}
+
+int mseed_decode_samples(const char *record, size_t len, const MSeedHeader *hdr,
+                         int32_t *samples, int max) {
+    const unsigned char *data;
+    size_t size;
+    int swap = !hdr->big_endian_data;
+    int count = hdr->sample_count < max ? hdr->sample_count : max;
+    int i;
+
+    if ((size_t)hdr->record_length < len)
+        len = (size_t)hdr->record_length;
+    if (hdr->data_offset < MSEED_FIXED_HEADER_SIZE || (size_t)hdr->data_offset >= len ||
+        count <= 0)
+        return count == 0 ? 0 : -1;
+    data = (const unsigned char *)record + hdr->data_offset;
+    size = len - (size_t)hdr->data_offset;
+
+    switch (hdr->encoding) {
+    case MSEED_ENC_INT16:
+        if ((size_t)count > size / 2)
+            count = (int)(size / 2);
+        for (i = 0; i < count; i++)
+            samples[i] = read_i16(data + 2 * i, swap);
+        return count;
+    case MSEED_ENC_INT32:
+        if ((size_t)count > size / 4)
+            count = (int)(size / 4);
+        for (i = 0; i < count; i++)
+            samples[i] = read_i32(data + 4 * i, swap);
+        return count;
+    case MSEED_ENC_STEIM1:
+    case MSEED_ENC_STEIM2:
+        return steim_decode(data, size, swap, hdr->encoding == MSEED_ENC_STEIM2,
+                            samples, count, count == hdr->sample_count);
+    default:
+        return -1;
+    }
+}
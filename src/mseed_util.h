@@ -0,0 +1,81 @@
+#ifndef MSEED_UTIL_H
+#define MSEED_UTIL_H
+
+/*
+ * miniSEED 2 fixed header helpers.
+ * Only what the client needs: stream codes, start/end time, sample rate,
+ * and the encoding details from blockettes 100, 1000 and 1001, plus
+ * decoding of the integer encodings.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MSEED_FIXED_HEADER_SIZE 48
+
+/* Data encodings from blockette 1000 */
+#define MSEED_ENC_INT16  1
+#define MSEED_ENC_INT32  3
+#define MSEED_ENC_STEIM1 10
+#define MSEED_ENC_STEIM2 11
+
+typedef struct {
+    char network[3];
+    char station[6];
+    char location[3];
+    char channel[4];
+    char quality;
+    long sequence;              /* Sequence number from the first 6 bytes */
+    double start_time;          /* Epoch seconds, UTC */
+    double end_time;            /* Time just after the last sample */
+    double sample_rate;         /* Hz, 0 for records without samples */
+    int sample_count;
+    int data_offset;            /* Byte offset of the data section */
+    int encoding;               /* MSEED_ENC_*, -1 without blockette 1000 */
+    int big_endian_data;        /* Word order of the data section */
+    int record_length;          /* Bytes, from blockette 1000 (default 512) */
+    int header_swapped;         /* Fixed header was little-endian */
+} MSeedHeader;
+
+/* Parse the fixed header and blockettes; 0 on success, -1 if not miniSEED */
+int mseed_parse_header(const char *record, size_t len, MSeedHeader *hdr);
+
+/*
+ * Decode the samples of a parsed record (INT16, INT32, Steim1, Steim2) into
+ * samples[0..max). Returns the number decoded, at most hdr->sample_count,
+ * or -1 for other encodings and for Steim data that fails its integrity
+ * check (last sample != reverse integration constant).
+ */
+int mseed_decode_samples(const char *record, size_t len, const MSeedHeader *hdr,
+                         int32_t *samples, int max);
+
+/* Start time of a record in epoch seconds (UTC), without full parsing */
+double mseed_start_time(const char *record);
+
+/* Days since 1970-01-01 for a year and day-of-year */
+long mseed_days_from_year_doy(int year, int doy);
+
+/* Buffer size for mseed_format_time(), terminator included */
+#define MSEED_TIME_STRING_SIZE 32
+
+/*
+ * Format epoch seconds as UTC YYYY-MM-DDTHH:MM:SS.ffffff, the FDSNWS
+ * time syntax. Years outside 0..9999 are clamped.
+ */
+void mseed_format_time(double epoch, char *buf, size_t len);
+
+/*
+ * Build a big-endian data record of len bytes (a power of two >= 128) with
+ * blockettes 1000 and 1001 and INT32 samples, for benchmarks and test
+ * servers. Stores as many samples as fit; returns that count, or -1.
+ */
+int mseed_build_record(char *record, size_t len,
+                       const char *network, const char *station,
+                       const char *location, const char *channel,
+                       long sequence, double start_time, double sample_rate,
+                       const int32_t *samples, int count);
+
+/* Overwrite the fixed header start time (keeps the header byte order) */
+void mseed_set_start_time(char *record, double start_time);
+
+#endif /* MSEED_UTIL_H */
@@ -0,0 +1,324 @@
+#include "netutil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <io.h>
+    #pragma comment(lib, "ws2_32.lib")
+#else
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <netdb.h>
+    #include <poll.h>
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #ifdef __linux__
+        #include <sys/sendfile.h>
+    #endif
+#endif
+
+int net_init(void) {
+#ifdef _WIN32
+    static int initialized = 0;
+    WSADATA wsa;
+
+    if (initialized)
+        return 0;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        fprintf(stderr, "[Net] WSAStartup failed\n");
+        return -1;
+    }
+    initialized = 1;
+#endif
+    return 0;
+}
+
+void net_close(NetSocket sock) {
+    if (sock == NET_INVALID_SOCKET)
+        return;
+#ifdef _WIN32
+    closesocket(sock);
+#else
+    close(sock);
+#endif
+}
+
+/*
+ * connect() that gives up after timeout_ms: the socket is non-blocking
+ * while the handshake runs, then blocking again. 0 once connected.
+ */
+static int connect_with_timeout(NetSocket sock, const struct sockaddr *addr, int addrlen,
+                                int timeout_ms) {
+#ifdef _WIN32
+    u_long mode = 1;
+    fd_set writefds, exceptfds;
+    struct timeval tv;
+    int rc;
+
+    if (ioctlsocket(sock, FIONBIO, &mode) != 0)
+        return -1;
+    rc = connect(sock, addr, addrlen);
+    if (rc != 0 && WSAGetLastError() == WSAEWOULDBLOCK) {
+        FD_ZERO(&writefds);
+        FD_ZERO(&exceptfds);
+        FD_SET(sock, &writefds);
+        FD_SET(sock, &exceptfds);
+        tv.tv_sec = timeout_ms / 1000;
+        tv.tv_usec = (timeout_ms % 1000) * 1000;
+        /* A refused connect is reported through exceptfds */
+        rc = select(0, NULL, &writefds, &exceptfds, &tv) == 1 &&
+             FD_ISSET(sock, &writefds) ? 0 : -1;
+    }
+    mode = 0;
+    if (ioctlsocket(sock, FIONBIO, &mode) != 0)
+        return -1;
+    return rc == 0 ? 0 : -1;
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    int rc;
+
+    if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0)
+        return -1;
+    rc = connect(sock, addr, (socklen_t)addrlen);
+    if (rc != 0 && errno == EINPROGRESS) {
+        struct pollfd pfd;
+        int err = 0;
+        socklen_t len = sizeof(err);
+
+        pfd.fd = sock;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        do {
+            rc = poll(&pfd, 1, timeout_ms);
+        } while (rc < 0 && errno == EINTR);
+        if (rc == 1 && getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0)
+            rc = 0;
+        else
+            rc = -1;
+    }
+    if (fcntl(sock, F_SETFL, flags) < 0)
+        return -1;
+    return rc == 0 ? 0 : -1;
+#endif
+}
+
+static NetSocket connect_tcp(const char *host, const char *port) {
+    struct addrinfo hints, *res, *ai;
+    NetSocket sock = NET_INVALID_SOCKET;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(host, port, &hints, &res) != 0)
+        return NET_INVALID_SOCKET;
+
+    for (ai = res; ai != NULL; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock == NET_INVALID_SOCKET)
+            continue;
+        if (connect_with_timeout(sock, ai->ai_addr, (int)ai->ai_addrlen,
+                                 NET_CONNECT_TIMEOUT_MS) == 0)
+            break;
+        net_close(sock);
+        sock = NET_INVALID_SOCKET;
+    }
+
+    freeaddrinfo(res);
+
+    if (sock != NET_INVALID_SOCKET) {
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&one, sizeof(one));
+    }
+    return sock;
+}
+
+NetSocket net_connect(const char *address) {
+    char buf[512];
+    char *colon;
+
+    if (strncmp(address, "unix:", 5) == 0) {
+#ifdef _WIN32
+        fprintf(stderr, "[Net] Unix sockets are not supported on Windows\n");
+        return NET_INVALID_SOCKET;
+#else
+        struct sockaddr_un sun;
+        NetSocket sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (sock == NET_INVALID_SOCKET)
+            return NET_INVALID_SOCKET;
+        memset(&sun, 0, sizeof(sun));
+        sun.sun_family = AF_UNIX;
+        strncpy(sun.sun_path, address + 5, sizeof(sun.sun_path) - 1);
+        if (connect(sock, (struct sockaddr *)&sun, sizeof(sun)) != 0) {
+            net_close(sock);
+            return NET_INVALID_SOCKET;
+        }
+        return sock;
+#endif
+    }
+
+    if (strncmp(address, "tcp:", 4) == 0)
+        address += 4;
+
+    strncpy(buf, address, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    colon = strrchr(buf, ':');
+    if (colon == NULL)
+        return NET_INVALID_SOCKET;
+    *colon = '\0';
+
+    return connect_tcp(buf[0] ? buf : "127.0.0.1", colon + 1);
+}
+
+NetSocket net_listen_tcp(const char *host, int port, int backlog) {
+    struct addrinfo hints, *res;
+    char port_str[16];
+    NetSocket sock;
+    int one = 1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    snprintf(port_str, sizeof(port_str), "%d", port);
+
+    if (getaddrinfo((host && host[0]) ? host : "127.0.0.1", port_str, &hints, &res) != 0)
+        return NET_INVALID_SOCKET;
+
+    sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock == NET_INVALID_SOCKET) {
+        freeaddrinfo(res);
+        return NET_INVALID_SOCKET;
+    }
+
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&one, sizeof(one));
+
+    if (bind(sock, res->ai_addr, (int)res->ai_addrlen) != 0 ||
+        listen(sock, backlog) != 0) {
+        fprintf(stderr, "[Net] Cannot listen on %s:%d\n",
+                (host && host[0]) ? host : "127.0.0.1", port);
+        net_close(sock);
+        freeaddrinfo(res);
+        return NET_INVALID_SOCKET;
+    }
+
+    freeaddrinfo(res);
+    return sock;
+}
+
+NetSocket net_accept(NetSocket listener) {
+    NetSocket sock = accept(listener, NULL, NULL);
+
+    if (sock != NET_INVALID_SOCKET) {
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&one, sizeof(one));
+    }
+    return sock;
+}
+
+int net_set_send_timeout(NetSocket sock, int timeout_ms) {
+#ifdef _WIN32
+    DWORD tv = (DWORD)timeout_ms;
+#else
+    struct timeval tv;
+
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+#endif
+    return setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, (const char *)&tv, sizeof(tv)) == 0 ? 0 : -1;
+}
+
+int net_wait_readable(NetSocket sock, int timeout_ms) {
+#ifdef _WIN32
+    fd_set readfds;
+    struct timeval tv;
+
+    FD_ZERO(&readfds);
+    FD_SET(sock, &readfds);
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    int rc = select(0, &readfds, NULL, NULL, &tv);
+    return rc < 0 ? -1 : (rc > 0 ? 1 : 0);
+#else
+    struct pollfd pfd;
+    int rc;
+
+    pfd.fd = sock;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    rc = poll(&pfd, 1, timeout_ms);
+    if (rc < 0)
+        return errno == EINTR ? 0 : -1;
+    return rc > 0 ? 1 : 0;
+#endif
+}
+
+long net_recv(NetSocket sock, char *buffer, size_t len) {
+    long n = (long)recv(sock, buffer, (int)len, 0);
+    return n < 0 ? -1 : n;
+}
+
+int net_send_all(NetSocket sock, const char *buffer, size_t len) {
+    while (len > 0) {
+#ifdef _WIN32
+        int n = send(sock, buffer, (int)len, 0);
+#else
+        ssize_t n = send(sock, buffer, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+#endif
+        if (n <= 0)
+            return -1;
+        buffer += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+int net_send_file(NetSocket sock, int fd, long long offset, long long len) {
+#if defined(__linux__)
+    off_t pos = (off_t)offset;
+
+    while (len > 0) {
+        size_t chunk = len > (1 << 30) ? (size_t)1 << 30 : (size_t)len;
+        ssize_t n = sendfile(sock, fd, &pos, chunk);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        len -= n;
+    }
+    return 0;
+#else
+    char buffer[65536];
+
+    while (len > 0) {
+        size_t chunk = len > (long long)sizeof(buffer) ? sizeof(buffer) : (size_t)len;
+#ifdef _WIN32
+        int n;
+        if (_lseeki64(fd, offset, SEEK_SET) < 0)
+            return -1;
+        n = _read(fd, buffer, (unsigned int)chunk);
+#else
+        ssize_t n = pread(fd, buffer, chunk, (off_t)offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+#endif
+        if (n <= 0)
+            return -1;
+        if (net_send_all(sock, buffer, (size_t)n) < 0)
+            return -1;
+        offset += n;
+        len -= n;
+    }
+    return 0;
+#endif
+}
@@ -0,0 +1,62 @@
+#ifndef NETUTIL_H
+#define NETUTIL_H
+
+/*
+ * Minimal socket helpers shared by the local feeds and endpoints.
+ * Blocking sockets with explicit readiness waits so threads can keep
+ * checking their running flag.
+ */
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    typedef SOCKET NetSocket;
+    #define NET_INVALID_SOCKET INVALID_SOCKET
+#else
+    typedef int NetSocket;
+    #define NET_INVALID_SOCKET (-1)
+#endif
+
+#include <stddef.h>
+
+/* One-time socket library setup (WSAStartup on Windows) */
+int net_init(void);
+
+/* A TCP address that does not complete the handshake in time is skipped */
+#define NET_CONNECT_TIMEOUT_MS 5000
+
+/*
+ * Connect to "tcp:host:port", "host:port" or "unix:/path".
+ * Returns NET_INVALID_SOCKET on failure.
+ */
+NetSocket net_connect(const char *address);
+
+/* Listen on host:port (host may be empty for localhost only) */
+NetSocket net_listen_tcp(const char *host, int port, int backlog);
+
+/* Accept a pending connection on a listening socket */
+NetSocket net_accept(NetSocket listener);
+
+void net_close(NetSocket sock);
+
+/* Wait until readable: 1 = ready, 0 = timeout, -1 = error */
+int net_wait_readable(NetSocket sock, int timeout_ms);
+
+/* recv() wrapper: bytes read, 0 on orderly close, -1 on error */
+long net_recv(NetSocket sock, char *buffer, size_t len);
+
+/* Send the whole buffer: 0 on success, -1 on error */
+int net_send_all(NetSocket sock, const char *buffer, size_t len);
+
+/* Make a send that cannot progress for timeout_ms fail instead of blocking */
+int net_set_send_timeout(NetSocket sock, int timeout_ms);
+
+/*
+ * Send len bytes of an open file starting at offset. Uses sendfile() on
+ * Linux so the data never passes through user space; elsewhere it reads
+ * through a small buffer.
+ * fd is a C runtime descriptor. 0 on success, -1 on error.
+ */
+int net_send_file(NetSocket sock, int fd, long long offset, long long len);
+
+#endif /* NETUTIL_H */
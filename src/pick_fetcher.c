@@ -1,12 +1,83 @@
 #include "pick_fetcher.h"
+#include "netutil.h"
+#include "metrics.h"
+#include "trace.h"
+#include "logger.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-/* Helper function to format time_t to MySQL datetime string */
+#ifdef _WIN32
+    #define strtok_r strtok_s
+#else
+    #include <dirent.h>
+#endif
+
+/* Fetcher metrics, registered when the thread starts */
+static MetricHistogram *g_query_metric = NULL;
+static MetricGauge *g_picks_metric = NULL;
+static MetricGauge *g_interval_metric = NULL;
+static MetricCounter *g_new_picks_metric = NULL;
+static MetricCounter *g_pushed_metric = NULL;
+
+/* Worker pool used to query several sources concurrently */
+typedef struct {
+    PickFetcherConfig *config;
+    PlatformMutex lock;
+    PlatformCond work_cond;
+    PlatformCond done_cond;
+    PlatformThread threads[MAX_PICK_SOURCES];
+    int thread_count;
+    unsigned long generation;   /* Incremented for every query cycle */
+    int next_source;            /* Next source index to hand out */
+    int pending;                /* Sources not yet finished this cycle */
+    time_t start_time;
+    time_t end_time;
+    int shutdown;
+} PickQueryPool;
+
+/* Helper function to format time_t to MySQL datetime string (UTC, as stored) */
 void format_mysql_datetime(time_t timestamp, char *buffer, size_t buffer_size) {
-    struct tm *timeinfo = localtime(&timestamp);
-    strftime(buffer, buffer_size, "%Y-%m-%d %H:%M:%S", timeinfo);
+    struct tm timeinfo;
+
+    if (platform_gmtime(&timestamp, &timeinfo) == NULL) {
+        buffer[0] = '\0';
+        return;
+    }
+    strftime(buffer, buffer_size, "%Y-%m-%d %H:%M:%S", &timeinfo);
+}
+
+/* Days since 1970-01-01 for a proleptic Gregorian date (UTC, no timegm) */
+static long days_from_civil(int year, int month, int day) {
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yoe = year - era * 400;
+    long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static double pick_epoch(const PickData *pick) {
+    int year = 1970, month = 1, day = 1, hour = 0, min = 0, sec = 0;
+
+    sscanf(pick->pick_time, "%d-%d-%d %d:%d:%d",
+           &year, &month, &day, &hour, &min, &sec);
+
+    return (double)days_from_civil(year, month, day) * 86400.0 +
+           hour * 3600.0 + min * 60.0 + sec +
+           atoi(pick->pick_time_ms) / 1e6;
+}
+
+/* Fill a pick from network, station, channel, time, time_ms columns */
+static void copy_pick_row(PickData *pick, MYSQL_ROW row) {
+    memset(pick, 0, sizeof(*pick));
+
+    strncpy(pick->network, row[0] ? row[0] : "", sizeof(pick->network) - 1);
+    strncpy(pick->station, row[1] ? row[1] : "", sizeof(pick->station) - 1);
+    strncpy(pick->channel, row[2] ? row[2] : "", sizeof(pick->channel) - 1);
+    strncpy(pick->pick_time, row[3] ? row[3] : "", sizeof(pick->pick_time) - 1);
+    strncpy(pick->pick_time_ms, row[4] ? row[4] : "", sizeof(pick->pick_time_ms) - 1);
+    pick->epoch = pick_epoch(pick);
 }
 
 PickResult* get_picks(time_t start_time, time_t end_time, MYSQL *conn) {
@@ -35,13 +106,13 @@ PickResult* get_picks(time_t start_time, time_t end_time, MYSQL *conn) {
         start_time_str, end_time_str);
 
     if (mysql_query(conn, query)) {
-        fprintf(stderr, "Query failed: %s\n", mysql_error(conn));
+        LOG_ERROR(LOG_CAT_PICKFETCHER, "Query failed: %s", mysql_error(conn));
         return NULL;
     }
 
     result = mysql_store_result(conn);
     if (result == NULL) {
-        fprintf(stderr, "mysql_store_result() failed: %s\n", mysql_error(conn));
+        LOG_ERROR(LOG_CAT_PICKFETCHER, "mysql_store_result() failed: %s", mysql_error(conn));
         return NULL;
     }
 
@@ -71,20 +142,7 @@ PickResult* get_picks(time_t start_time, time_t end_time, MYSQL *conn) {
             pick_result->picks = new_picks;
         }
 
-        strncpy(pick_result->picks[count].network, row[0] ? row[0] : "", 15);
-        pick_result->picks[count].network[15] = '\0';
-
-        strncpy(pick_result->picks[count].station, row[1] ? row[1] : "", 15);
-        pick_result->picks[count].station[15] = '\0';
-
-        strncpy(pick_result->picks[count].channel, row[2] ? row[2] : "", 15);
-        pick_result->picks[count].channel[15] = '\0';
-
-        strncpy(pick_result->picks[count].pick_time, row[3] ? row[3] : "", 31);
-        pick_result->picks[count].pick_time[31] = '\0';
-
-        strncpy(pick_result->picks[count].pick_time_ms, row[4] ? row[4] : "", 15);
-        pick_result->picks[count].pick_time_ms[15] = '\0';
+        copy_pick_row(&pick_result->picks[count], row);
 
         count++;
     }
@@ -102,43 +160,369 @@ void free_pick_result(PickResult *result) {
     }
 }
 
-int write_picks_to_file(PickResult *picks, const char *filepath,
-                        time_t start_time, time_t end_time) {
-    char temp_filepath[520];
-    FILE *file;
+/* Append a copy of pick to a growable array */
+static int append_pick(PickData **picks, size_t *count, size_t *capacity,
+                       const PickData *pick) {
+    if (*count >= *capacity) {
+        size_t new_capacity = *capacity ? *capacity * 2 : 16;
+        PickData *grown = (PickData*)realloc(*picks, new_capacity * sizeof(PickData));
+        if (grown == NULL)
+            return -1;
+        *picks = grown;
+        *capacity = new_capacity;
+    }
+    (*picks)[(*count)++] = *pick;
+    return 0;
+}
 
-    snprintf(temp_filepath, sizeof(temp_filepath), "%s.tmp", filepath);
+static CachedEvent* find_cached_event(EventPickCache *cache, const char *event_id) {
+    for (size_t i = 0; i < cache->count; i++) {
+        if (strcmp(cache->events[i].event_id, event_id) == 0)
+            return &cache->events[i];
+    }
+    return NULL;
+}
 
-    file = fopen(temp_filepath, "w");
-    if (file == NULL) {
-        fprintf(stderr, "Failed to open file: %s\n", temp_filepath);
-        return -1;
+/* Force every cached event to be re-fetched on the next cycle */
+static void invalidate_event_cache(EventPickCache *cache) {
+    for (size_t i = 0; i < cache->count; i++)
+        cache->events[i].loaded = 0;
+}
+
+void free_event_cache(EventPickCache *cache) {
+    for (size_t i = 0; i < cache->count; i++)
+        free(cache->events[i].picks);
+    free(cache->events);
+    memset(cache, 0, sizeof(*cache));
+}
+
+/* Shared FROM/JOIN clause: Event -> preferred Origin -> Arrival -> Pick */
+#define EVENT_JOIN \
+    "FROM Event " \
+    "JOIN PublicObject EvPO ON EvPO._oid = Event._oid " \
+    "JOIN PublicObject OrPO ON OrPO.publicID = Event.preferredOriginID " \
+    "JOIN Origin ON Origin._oid = OrPO._oid "
+
+/*
+ * Event mode: picks associated with the preferred origin of events whose
+ * origin time falls in the window. A light query lists the events and
+ * their modification stamps; one joined query then fetches the picks of
+ * events that are new or changed since the last cycle. Unchanged events
+ * are served from the cache.
+ */
+PickResult* get_event_picks(time_t start_time, time_t end_time, MYSQL *conn,
+                            EventPickCache *cache) {
+    char start_time_str[32];
+    char end_time_str[32];
+    char query[1024];
+    char *join_query = NULL;
+    size_t join_len = 0, join_capacity = 0;
+    size_t stale = 0;
+    MYSQL_RES *result;
+    MYSQL_ROW row;
+    PickResult *pick_result;
+    size_t capacity = 0;
+
+    format_mysql_datetime(start_time, start_time_str, sizeof(start_time_str));
+    format_mysql_datetime(end_time, end_time_str, sizeof(end_time_str));
+
+    snprintf(query, sizeof(query),
+        "SELECT EvPO.publicID, Event.preferredOriginID, Event._last_modified "
+        EVENT_JOIN
+        "WHERE Origin.time_value >= '%s' "
+        "AND Origin.time_value < '%s'",
+        start_time_str, end_time_str);
+
+    if (mysql_query(conn, query)) {
+        LOG_ERROR(LOG_CAT_PICKFETCHER, "Query failed: %s", mysql_error(conn));
+        return NULL;
     }
 
-    if (picks && picks->count > 0) {
-        for (size_t i = 0; i < picks->count; i++) {
-            int year, month, day, hour, min, sec;
+    result = mysql_store_result(conn);
+    if (result == NULL) {
+        LOG_ERROR(LOG_CAT_PICKFETCHER, "mysql_store_result() failed: %s", mysql_error(conn));
+        return NULL;
+    }
 
-            sscanf(picks->picks[i].pick_time, "%d-%d-%d %d:%d:%d",
-                   &year, &month, &day, &hour, &min, &sec);
+    for (size_t i = 0; i < cache->count; i++)
+        cache->events[i].seen = 0;
 
-            int microseconds = atoi(picks->picks[i].pick_time_ms);
+    while ((row = mysql_fetch_row(result))) {
+        const char *event_id = row[0] ? row[0] : "";
+        const char *origin_id = row[1] ? row[1] : "";
+        const char *modified = row[2] ? row[2] : "";
+        CachedEvent *ev = find_cached_event(cache, event_id);
 
-            fprintf(file, "%s, %s, %s, %04d-%02d-%02d %02d:%02d:%02d.%06d\n",
-                    picks->picks[i].network,
-                    picks->picks[i].station,
-                    picks->picks[i].channel,
-                    year, month, day, hour, min, sec, microseconds);
+        if (ev == NULL) {
+            if (cache->count >= cache->capacity) {
+                size_t new_capacity = cache->capacity ? cache->capacity * 2 : 16;
+                CachedEvent *grown = (CachedEvent*)realloc(cache->events,
+                                        new_capacity * sizeof(CachedEvent));
+                if (grown == NULL)
+                    break;
+                cache->events = grown;
+                cache->capacity = new_capacity;
+            }
+            ev = &cache->events[cache->count++];
+            memset(ev, 0, sizeof(*ev));
+            strncpy(ev->event_id, event_id, sizeof(ev->event_id) - 1);
         }
-    } else {
-        char start_str[32], end_str[32];
-        format_mysql_datetime(start_time, start_str, sizeof(start_str));
-        format_mysql_datetime(end_time, end_str, sizeof(end_str));
-        fprintf(file, "# No picks found from %s to %s\n", start_str, end_str);
+        ev->seen = 1;
+
+        if (ev->loaded && strcmp(ev->origin_id, origin_id) == 0 &&
+            strcmp(ev->last_modified, modified) == 0)
+            continue;
+
+        /* New or changed: queue for the join, then drop cached picks */
+        size_t id_len = strlen(event_id);
+        if (join_len + id_len * 2 + 8 >= join_capacity) {
+            size_t new_capacity = (join_capacity ? join_capacity : 1024) * 2 + id_len * 2;
+            char *grown = (char*)realloc(join_query, new_capacity);
+            if (grown == NULL) {
+                ev->loaded = 0;     /* Not queued: retry next cycle */
+                break;
+            }
+            join_query = grown;
+            join_capacity = new_capacity;
+        }
+
+        free(ev->picks);
+        ev->picks = NULL;
+        ev->count = 0;
+        ev->capacity = 0;
+        ev->loaded = 1;
+        strncpy(ev->origin_id, origin_id, sizeof(ev->origin_id) - 1);
+        strncpy(ev->last_modified, modified, sizeof(ev->last_modified) - 1);
+
+        join_query[join_len++] = stale ? ',' : '(';
+        join_query[join_len++] = '\'';
+        join_len += mysql_real_escape_string(conn, join_query + join_len,
+                                             event_id, (unsigned long)id_len);
+        join_query[join_len++] = '\'';
+        stale++;
     }
+    mysql_free_result(result);
 
-    fclose(file);
+    /* Evict events that left the lookback window */
+    for (size_t i = 0; i < cache->count; ) {
+        if (!cache->events[i].seen) {
+            free(cache->events[i].picks);
+            cache->events[i] = cache->events[--cache->count];
+        } else {
+            i++;
+        }
+    }
+
+    if (stale > 0) {
+        size_t full_len = join_len + 1024;
+        char *full_query = (char*)malloc(full_len);
+
+        if (full_query == NULL) {
+            free(join_query);
+            invalidate_event_cache(cache);
+            return NULL;
+        }
+        join_query[join_len] = '\0';
+
+        snprintf(full_query, full_len,
+            "SELECT EvPO.publicID, "
+            "Pick.waveformID_networkCode, "
+            "Pick.waveformID_stationCode, "
+            "Pick.waveformID_channelCode, "
+            "Pick.time_value, "
+            "Pick.time_value_ms, "
+            "COALESCE(Pick.phaseHint_code, Arrival.phase_code) "
+            EVENT_JOIN
+            "JOIN Arrival ON Arrival._parent_oid = Origin._oid "
+            "JOIN PublicObject PkPO ON PkPO.publicID = Arrival.pickID "
+            "JOIN Pick ON Pick._oid = PkPO._oid "
+            "WHERE Origin.time_value >= '%s' "
+            "AND Origin.time_value < '%s' "
+            "AND EvPO.publicID IN %s)",
+            start_time_str, end_time_str, join_query);
+        free(join_query);
+        join_query = NULL;
+
+        if (mysql_query(conn, full_query)) {
+            LOG_ERROR(LOG_CAT_PICKFETCHER, "Query failed: %s", mysql_error(conn));
+            free(full_query);
+            invalidate_event_cache(cache);
+            return NULL;
+        }
+        free(full_query);
 
+        result = mysql_store_result(conn);
+        if (result == NULL) {
+            LOG_ERROR(LOG_CAT_PICKFETCHER, "mysql_store_result() failed: %s", mysql_error(conn));
+            invalidate_event_cache(cache);
+            return NULL;
+        }
+
+        while ((row = mysql_fetch_row(result))) {
+            CachedEvent *ev = find_cached_event(cache, row[0] ? row[0] : "");
+            PickData pick;
+
+            if (ev == NULL)
+                continue;
+
+            copy_pick_row(&pick, row + 1);
+            strncpy(pick.phase, row[6] ? row[6] : "", sizeof(pick.phase) - 1);
+            memcpy(pick.event_id, ev->event_id, sizeof(pick.event_id));
+
+            if (append_pick(&ev->picks, &ev->count, &ev->capacity, &pick) < 0)
+                ev->loaded = 0;     /* Retry next cycle */
+        }
+        mysql_free_result(result);
+    }
+    free(join_query);
+
+    pick_result = (PickResult*)calloc(1, sizeof(PickResult));
+    if (pick_result == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < cache->count; i++) {
+        for (size_t j = 0; j < cache->events[i].count; j++) {
+            if (append_pick(&pick_result->picks, &pick_result->count, &capacity,
+                            &cache->events[i].picks[j]) < 0) {
+                free_pick_result(pick_result);
+                return NULL;
+            }
+        }
+    }
+
+    return pick_result;
+}
+
+static int compare_picks_by_stream(const void *a, const void *b) {
+    const PickData *pa = (const PickData*)a;
+    const PickData *pb = (const PickData*)b;
+    int cmp;
+
+    if ((cmp = strcmp(pa->network, pb->network)) != 0) return cmp;
+    if ((cmp = strcmp(pa->station, pb->station)) != 0) return cmp;
+    if ((cmp = strcmp(pa->channel, pb->channel)) != 0) return cmp;
+    return (pa->epoch > pb->epoch) - (pa->epoch < pb->epoch);
+}
+
+static int compare_picks_by_time(const void *a, const void *b) {
+    const PickData *pa = (const PickData*)a;
+    const PickData *pb = (const PickData*)b;
+
+    if (pa->epoch != pb->epoch)
+        return (pa->epoch > pb->epoch) - (pa->epoch < pb->epoch);
+    return compare_picks_by_stream(a, b);
+}
+
+static int same_stream(const PickData *a, const PickData *b) {
+    return strcmp(a->network, b->network) == 0 &&
+           strcmp(a->station, b->station) == 0 &&
+           strcmp(a->channel, b->channel) == 0;
+}
+
+/* Dedup order: stream, then event (event mode), then time */
+static int compare_picks_by_stream_event(const void *a, const void *b) {
+    const PickData *pa = (const PickData*)a;
+    const PickData *pb = (const PickData*)b;
+    int cmp;
+
+    if ((cmp = strcmp(pa->network, pb->network)) != 0) return cmp;
+    if ((cmp = strcmp(pa->station, pb->station)) != 0) return cmp;
+    if ((cmp = strcmp(pa->channel, pb->channel)) != 0) return cmp;
+    if ((cmp = strcmp(pa->event_id, pb->event_id)) != 0) return cmp;
+    return (pa->epoch > pb->epoch) - (pa->epoch < pb->epoch);
+}
+
+/*
+ * Merge picks from several sources into one time-sorted result.
+ * Picks on the same stream and event within tolerance_ms of each other
+ * are treated as the same pick reported by more than one database; the
+ * earliest is kept. Picks of different events are never merged, even when
+ * they are close in time.
+ */
+PickResult* merge_pick_results(PickResult **results, int count,
+                               int tolerance_ms) {
+    PickResult *merged;
+    size_t total = 0;
+    size_t kept = 0;
+    double tolerance = tolerance_ms / 1000.0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        if (results[i])
+            total += results[i]->count;
+    }
+
+    merged = (PickResult*)malloc(sizeof(PickResult));
+    if (merged == NULL)
+        return NULL;
+
+    merged->picks = (PickData*)malloc((total > 0 ? total : 1) * sizeof(PickData));
+    if (merged->picks == NULL) {
+        free(merged);
+        return NULL;
+    }
+    merged->count = 0;
+
+    for (i = 0; i < count; i++) {
+        if (results[i] && results[i]->count > 0) {
+            memcpy(merged->picks + merged->count, results[i]->picks,
+                   results[i]->count * sizeof(PickData));
+            merged->count += results[i]->count;
+        }
+    }
+
+    if (merged->count == 0)
+        return merged;
+
+    /* Group by stream and event so duplicates become neighbours, then drop them */
+    qsort(merged->picks, merged->count, sizeof(PickData), compare_picks_by_stream_event);
+
+    for (size_t j = 0; j < merged->count; j++) {
+        if (kept > 0 &&
+            same_stream(&merged->picks[kept - 1], &merged->picks[j]) &&
+            strcmp(merged->picks[kept - 1].event_id, merged->picks[j].event_id) == 0 &&
+            merged->picks[j].epoch - merged->picks[kept - 1].epoch <= tolerance) {
+            continue;
+        }
+        if (kept != j)
+            merged->picks[kept] = merged->picks[j];
+        kept++;
+    }
+    merged->count = kept;
+
+    qsort(merged->picks, merged->count, sizeof(PickData), compare_picks_by_time);
+
+    return merged;
+}
+
+/* Write picks in SW_View format, one per line */
+static void write_pick_lines(FILE *file, const PickData *picks, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int year, month, day, hour, min, sec;
+
+        sscanf(picks[i].pick_time, "%d-%d-%d %d:%d:%d",
+               &year, &month, &day, &hour, &min, &sec);
+
+        int microseconds = atoi(picks[i].pick_time_ms);
+
+        fprintf(file, "%s, %s, %s, %04d-%02d-%02d %02d:%02d:%02d.%06d",
+                picks[i].network,
+                picks[i].station,
+                picks[i].channel,
+                year, month, day, hour, min, sec, microseconds);
+
+        /* Event mode appends the phase hint and event id */
+        if (picks[i].event_id[0] != '\0') {
+            fprintf(file, ", %s, %s",
+                    picks[i].phase[0] ? picks[i].phase : "?",
+                    picks[i].event_id);
+        }
+        fputc('\n', file);
+    }
+}
+
+/* Atomically move temp_filepath over filepath */
+static int replace_file(const char *temp_filepath, const char *filepath) {
 #ifdef _WIN32
     /* Windows: Use ReplaceFile for atomic replacement */
     if (!ReplaceFileA(filepath, temp_filepath, NULL, 
@@ -146,19 +530,19 @@ int write_picks_to_file(PickResult *picks, const char *filepath,
         DWORD error = GetLastError();
         if (error == ERROR_FILE_NOT_FOUND) {
             if (rename(temp_filepath, filepath) != 0) {
-                fprintf(stderr, "Failed to rename %s to %s\n", temp_filepath, filepath);
+                LOG_ERROR(LOG_CAT_PICKFETCHER, "Failed to rename %s to %s", temp_filepath, filepath);
                 remove(temp_filepath);
                 return -1;
             }
         } else {
-            fprintf(stderr, "ReplaceFile failed with error %lu\n", error);
+            LOG_ERROR(LOG_CAT_PICKFETCHER, "ReplaceFile failed with error %lu", error);
             remove(temp_filepath);
             return -1;
         }
     }
 #else
     if (rename(temp_filepath, filepath) != 0) {
-        fprintf(stderr, "Failed to rename %s to %s\n", temp_filepath, filepath);
+        LOG_ERROR(LOG_CAT_PICKFETCHER, "Failed to rename %s to %s", temp_filepath, filepath);
         remove(temp_filepath);
         return -1;
     }
@@ -167,103 +551,935 @@ int write_picks_to_file(PickResult *picks, const char *filepath,
     return 0;
 }
 
-/* Thread function that periodically fetches picks */
+int write_picks_to_file(PickResult *picks, const char *filepath,
+                        time_t start_time, time_t end_time) {
+    char temp_filepath[520];
+    FILE *file;
+
+    snprintf(temp_filepath, sizeof(temp_filepath), "%s.tmp", filepath);
+
+    file = fopen(temp_filepath, "w");
+    if (file == NULL) {
+        LOG_ERROR(LOG_CAT_PICKFETCHER, "Failed to open file: %s", temp_filepath);
+        return -1;
+    }
+
+    if (picks && picks->count > 0) {
+        write_pick_lines(file, picks->picks, picks->count);
+    } else {
+        char start_str[32], end_str[32];
+        format_mysql_datetime(start_time, start_str, sizeof(start_str));
+        format_mysql_datetime(end_time, end_str, sizeof(end_str));
+        fprintf(file, "# No picks found from %s to %s\n", start_str, end_str);
+    }
+
+    fclose(file);
+
+    return replace_file(temp_filepath, filepath);
+}
+
+static int shard_key_char(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '-';
+}
+
+/* Copy a pick field for a shard key, as [A-Za-z0-9_-] only: keys are file names */
+static void shard_key_part(char *dst, size_t len, const char *src) {
+    size_t i;
+
+    for (i = 0; src[i] && i + 1 < len; i++)
+        dst[i] = shard_key_char(src[i]) ? src[i] : '_';
+    dst[i] = '\0';
+}
+
+/* Shard key of a pick: station code or UTC hour/day of the pick time */
+static void pick_shard_key(const PickData *pick, int shard_mode,
+                           char *key, size_t len) {
+    if (shard_mode == PICKS_SHARD_STATION) {
+        char network[sizeof(pick->network)], station[sizeof(pick->station)];
+
+        shard_key_part(network, sizeof(network), pick->network);
+        shard_key_part(station, sizeof(station), pick->station);
+        snprintf(key, len, "%s.%s", network, station);
+    } else {
+        char day[11], hour[3];
+
+        /* pick_time is "YYYY-MM-DD HH:MM:SS"; feed picks are only parsed, not checked */
+        snprintf(day, sizeof(day), "%.10s", pick->pick_time);
+        shard_key_part(key, len, day);
+        if (shard_mode == PICKS_SHARD_HOUR && strlen(pick->pick_time) >= 13) {
+            snprintf(hour, sizeof(hour), "%.2s", pick->pick_time + 11);
+            shard_key_part(day, sizeof(day), hour);
+            snprintf(key + strlen(key), len - strlen(key), "T%s", day);
+        }
+    }
+}
+
+static int compare_picks_by_shard(const void *a, const void *b, int shard_mode) {
+    char ka[64], kb[64];
+    int cmp;
+
+    pick_shard_key((const PickData*)a, shard_mode, ka, sizeof(ka));
+    pick_shard_key((const PickData*)b, shard_mode, kb, sizeof(kb));
+    if ((cmp = strcmp(ka, kb)) != 0)
+        return cmp;
+    return compare_picks_by_time(a, b);
+}
+
+static int compare_picks_by_station_shard(const void *a, const void *b) {
+    return compare_picks_by_shard(a, b, PICKS_SHARD_STATION);
+}
+
+static int compare_picks_by_hour_shard(const void *a, const void *b) {
+    return compare_picks_by_shard(a, b, PICKS_SHARD_HOUR);
+}
+
+static int compare_picks_by_day_shard(const void *a, const void *b) {
+    return compare_picks_by_shard(a, b, PICKS_SHARD_DAY);
+}
+
+/* FNV-1a over the fields that end up in the file */
+static unsigned long long hash_picks(const PickData *picks, size_t count) {
+    unsigned long long h = 1469598103934665603ULL;
+
+    for (size_t i = 0; i < count; i++) {
+        const char *fields[6] = { picks[i].network, picks[i].station, picks[i].channel,
+                                  picks[i].pick_time, picks[i].pick_time_ms,
+                                  picks[i].event_id };
+        for (int f = 0; f < 6; f++) {
+            for (const char *c = fields[f]; ; c++) {
+                h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+                if (*c == '\0')
+                    break;
+            }
+        }
+        for (const char *c = picks[i].phase; *c; c++)
+            h = (h ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+    return h;
+}
+
+/* Shard file path: <picks file stem>.<key>.<ext> next to the picks file */
+static void shard_path(const char *filepath, const char *key, char *path, size_t len) {
+    const char *slash = strrchr(filepath, '/');
+    const char *dot = strrchr(filepath, '.');
+
 #ifdef _WIN32
-static DWORD WINAPI pickfetcher_thread_func(LPVOID arg)
-#else
-static void* pickfetcher_thread_func(void *arg)
+    const char *bslash = strrchr(filepath, '\\');
+    if (bslash && (!slash || bslash > slash))
+        slash = bslash;
 #endif
-{
-    PickFetcherConfig *config = (PickFetcherConfig*)arg;
-    MYSQL *conn = NULL;
-    
-    printf("[PickFetcher] Thread started\n");
-    printf("[PickFetcher] DB: %s@%s:%d/%s\n", 
-           config->db_user, config->db_host, config->db_port, config->db_name);
-    printf("[PickFetcher] Output: %s, Interval: %ds, Lookback: %ds\n",
-           config->output_filepath, config->update_interval_sec, config->lookback_sec);
+    if (dot == NULL || (slash && dot < slash))
+        snprintf(path, len, "%s.%s", filepath, key);
+    else
+        snprintf(path, len, "%.*s.%s%s", (int)(dot - filepath), filepath, key, dot);
+}
+
+/* A shard file name: <stem>.<key><ext>[.tmp], key as built by pick_shard_key() */
+static int is_shard_name(const char *name, const char *stem, size_t stem_len,
+                         const char *ext) {
+    size_t name_len = strlen(name), ext_len = strlen(ext);
+    int dots = 0;
+
+    if (name_len > 4 && strcmp(name + name_len - 4, ".tmp") == 0)
+        name_len -= 4;
+
+    if (name_len <= stem_len + 1 + ext_len || strncmp(name, stem, stem_len) != 0 ||
+        name[stem_len] != '.' || strncmp(name + name_len - ext_len, ext, ext_len) != 0)
+        return 0;
+    for (size_t i = stem_len + 1; i < name_len - ext_len; i++) {
+        if (name[i] == '.' && i > stem_len + 1 && dots++ == 0)
+            continue;
+        if (!shard_key_char(name[i]))
+            return 0;
+    }
+    return name[name_len - ext_len - 1] != '.';
+}
+
+/*
+ * Remove shard files left by an earlier run. The shard state starts empty,
+ * so files of shards that get no picks now would never be removed and
+ * consumers would keep reading their stale picks.
+ */
+static void remove_stale_shards(const char *filepath) {
+    char dir[512], stem[256], ext[64], path[800];
+    const char *slash = strrchr(filepath, '/');
+    const char *base, *dot;
+    int removed = 0;
 
-    /* Initialize MySQL connection */
-    conn = mysql_init(NULL);
-    if (conn == NULL) {
-        fprintf(stderr, "[PickFetcher] mysql_init() failed\n");
 #ifdef _WIN32
-        return 1;
+    const char *bslash = strrchr(filepath, '\\');
+    if (bslash && (!slash || bslash > slash))
+        slash = bslash;
+#endif
+    base = slash ? slash + 1 : filepath;
+    dot = strrchr(base, '.');
+    if (slash)
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - filepath), filepath);
+    else
+        snprintf(dir, sizeof(dir), ".");
+    snprintf(stem, sizeof(stem), "%.*s", (int)(dot ? (size_t)(dot - base) : strlen(base)), base);
+    snprintf(ext, sizeof(ext), "%s", dot ? dot : "");
+
+#ifdef _WIN32
+    {
+        WIN32_FIND_DATAA fd;
+        HANDLE h;
+
+        snprintf(path, sizeof(path), "%s\\%s.*", dir, stem);
+        h = FindFirstFileA(path, &fd);
+        if (h != INVALID_HANDLE_VALUE) {
+            do {
+                if (!is_shard_name(fd.cFileName, stem, strlen(stem), ext))
+                    continue;
+                snprintf(path, sizeof(path), "%s\\%s", dir, fd.cFileName);
+                if (remove(path) == 0)
+                    removed++;
+            } while (FindNextFileA(h, &fd));
+            FindClose(h);
+        }
+    }
 #else
-        return NULL;
+    {
+        DIR *d = opendir(dir);
+        struct dirent *entry;
+
+        if (d != NULL) {
+            while ((entry = readdir(d)) != NULL) {
+                if (!is_shard_name(entry->d_name, stem, strlen(stem), ext))
+                    continue;
+                snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+                if (remove(path) == 0)
+                    removed++;
+            }
+            closedir(d);
+        }
+    }
 #endif
+    if (removed > 0)
+        LOG_INFO(LOG_CAT_PICKFETCHER, "Removed %d shard files of an earlier run", removed);
+}
+
+static PickShard* find_shard(PickShardState *state, const char *key) {
+    for (size_t i = 0; i < state->count; i++) {
+        if (strcmp(state->shards[i].key, key) == 0)
+            return &state->shards[i];
     }
+    return NULL;
+}
 
-    /* Set SSL options */
+/*
+ * Sharded publication: picks are grouped per station or per UTC hour/day
+ * and only shards whose content changed since the last publication are
+ * rewritten (atomically, like the single file). Shards with no picks
+ * left in the window are removed. Reorders picks in place.
+ */
+int write_picks_sharded(PickResult *picks, const char *filepath,
+                        int shard_mode, PickShardState *state) {
+    int (*cmp)(const void *, const void *) =
+        shard_mode == PICKS_SHARD_STATION ? compare_picks_by_station_shard :
+        shard_mode == PICKS_SHARD_HOUR ? compare_picks_by_hour_shard :
+        compare_picks_by_day_shard;
+    char path[600], temp_path[610];
+    int errors = 0;
+    int rewritten = 0;
+    size_t i = 0;
+
+    for (size_t s = 0; s < state->count; s++)
+        state->shards[s].seen = 0;
+
+    if (picks && picks->count > 0)
+        qsort(picks->picks, picks->count, sizeof(PickData), cmp);
+
+    while (picks && i < picks->count) {
+        char key[64], next_key[64];
+        size_t j = i + 1;
+        PickShard *shard;
+        unsigned long long hash;
+
+        pick_shard_key(&picks->picks[i], shard_mode, key, sizeof(key));
+        while (j < picks->count) {
+            pick_shard_key(&picks->picks[j], shard_mode, next_key, sizeof(next_key));
+            if (strcmp(key, next_key) != 0)
+                break;
+            j++;
+        }
+
+        hash = hash_picks(&picks->picks[i], j - i);
+        shard = find_shard(state, key);
+        if (shard == NULL) {
+            if (state->count >= state->capacity) {
+                size_t cap = state->capacity ? state->capacity * 2 : 32;
+                PickShard *grown = (PickShard*)realloc(state->shards, cap * sizeof(PickShard));
+                if (grown == NULL)
+                    return -1;
+                state->shards = grown;
+                state->capacity = cap;
+            }
+            shard = &state->shards[state->count++];
+            memset(shard, 0, sizeof(*shard));
+            memcpy(shard->key, key, sizeof(shard->key));
+            shard->hash = hash + 1;     /* Force the first write */
+        }
+        shard->seen = 1;
+
+        if (shard->hash != hash) {
+            FILE *file;
+
+            shard_path(filepath, key, path, sizeof(path));
+            snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+            file = fopen(temp_path, "w");
+            if (file == NULL) {
+                LOG_ERROR(LOG_CAT_PICKFETCHER, "Failed to open file: %s", temp_path);
+                errors++;
+            } else {
+                write_pick_lines(file, &picks->picks[i], j - i);
+                fclose(file);
+                if (replace_file(temp_path, path) == 0) {
+                    shard->hash = hash;
+                    rewritten++;
+                } else {
+                    errors++;
+                }
+            }
+        }
+
+        i = j;
+    }
+
+    /* Remove shards whose picks all aged out of the window */
+    for (size_t s = 0; s < state->count; ) {
+        if (!state->shards[s].seen) {
+            shard_path(filepath, state->shards[s].key, path, sizeof(path));
+            remove(path);
+            state->shards[s] = state->shards[--state->count];
+        } else {
+            s++;
+        }
+    }
+
+    state->last_rewritten = rewritten;
+    return errors ? -1 : 0;
+}
+
+/* A stalled database must not hold a query worker, or shutdown, for long */
+#define PICK_DB_CONNECT_TIMEOUT_SEC 10
+#define PICK_DB_READ_TIMEOUT_SEC 30
+
+/* Open a connection to one source; returns NULL on failure */
+static MYSQL* connect_source(PickSource *src) {
+    MYSQL *conn = mysql_init(NULL);
     my_bool verify = 0;
-    mysql_optionsv(conn, MYSQL_OPT_SSL_VERIFY_SERVER_CERT, (void *)&verify);
     my_bool enforce_tls = 0;
+    unsigned int connect_timeout = PICK_DB_CONNECT_TIMEOUT_SEC;
+    unsigned int read_timeout = PICK_DB_READ_TIMEOUT_SEC;
+
+    if (conn == NULL) {
+        LOG_ERROR(LOG_CAT_PICKFETCHER, "mysql_init() failed");
+        return NULL;
+    }
+
+    /* Set SSL options */
+    mysql_optionsv(conn, MYSQL_OPT_SSL_VERIFY_SERVER_CERT, (void *)&verify);
     mysql_optionsv(conn, MYSQL_OPT_SSL_ENFORCE, (void *)&enforce_tls);
+    mysql_optionsv(conn, MYSQL_OPT_CONNECT_TIMEOUT, (void *)&connect_timeout);
+    mysql_optionsv(conn, MYSQL_OPT_READ_TIMEOUT, (void *)&read_timeout);
 
-    /* Connect to database */
-    if (mysql_real_connect(conn, config->db_host, config->db_user, 
-                           config->db_password, config->db_name, 
-                           config->db_port, NULL, 0) == NULL) {
-        fprintf(stderr, "[PickFetcher] Connection failed: %s\n", mysql_error(conn));
+    if (mysql_real_connect(conn, src->db_host, src->db_user,
+                           src->db_password, src->db_name,
+                           src->db_port, NULL, 0) == NULL) {
+        LOG_ERROR(LOG_CAT_PICKFETCHER, "Connection to %s:%d/%s failed: %s",
+                  src->db_host, src->db_port, src->db_name, mysql_error(conn));
         mysql_close(conn);
+        return NULL;
+    }
+
+    LOG_INFO(LOG_CAT_PICKFETCHER, "Connected to %s:%d/%s",
+             src->db_host, src->db_port, src->db_name);
+    return conn;
+}
+
+/* Run one query cycle against a single source, reconnecting on failure */
+static void query_source(PickSource *src, int picks_mode,
+                         time_t start_time, time_t end_time) {
+    free_pick_result(src->result);
+    src->result = NULL;
+
+    if (src->conn == NULL) {
+        src->conn = connect_source(src);
+        if (src->conn == NULL)
+            return;
+    }
+
+    TRACE_BEGIN(query_span);
+    if (picks_mode == PICKS_MODE_EVENT)
+        src->result = get_event_picks(start_time, end_time, src->conn, &src->event_cache);
+    else
+        src->result = get_picks(start_time, end_time, src->conn);
+    TRACE_END(query_span, "get_picks");
+
+    if (src->result == NULL) {
+        LOG_WARN(LOG_CAT_PICKFETCHER, "Failed to fetch picks from %s, reconnecting...",
+                 src->db_host);
+        mysql_close(src->conn);
+        src->conn = connect_source(src);
+    }
+}
+
+static PLATFORM_THREAD_FUNC(query_worker_func) {
+    PickQueryPool *pool = (PickQueryPool*)arg;
+    unsigned long seen_generation = 0;
+
+    mysql_thread_init();
+    trace_set_thread_name("pick-query");
+
+    platform_mutex_lock(&pool->lock);
+    while (!pool->shutdown) {
+        if (pool->generation == seen_generation ||
+            pool->next_source >= pool->config->source_count) {
+            seen_generation = pool->generation;
+            platform_cond_wait(&pool->work_cond, &pool->lock);
+            continue;
+        }
+
+        int idx = pool->next_source++;
+        time_t start_time = pool->start_time;
+        time_t end_time = pool->end_time;
+        platform_mutex_unlock(&pool->lock);
+
+        query_source(&pool->config->sources[idx], pool->config->picks_mode,
+                     start_time, end_time);
+
+        platform_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+            platform_cond_signal(&pool->done_cond);
+    }
+    platform_mutex_unlock(&pool->lock);
+
+    mysql_thread_end();
+    PLATFORM_THREAD_RETURN;
+}
+
+static int query_pool_start(PickQueryPool *pool, PickFetcherConfig *config) {
+    int wanted = config->query_threads;
+
+    memset(pool, 0, sizeof(*pool));
+    pool->config = config;
+    platform_mutex_init(&pool->lock);
+    platform_cond_init(&pool->work_cond);
+    platform_cond_init(&pool->done_cond);
+
+    if (wanted <= 0)
+        wanted = DEFAULT_PICK_QUERY_THREADS;
+    if (wanted > config->source_count)
+        wanted = config->source_count;
+
+    while (pool->thread_count < wanted) {
+        if (platform_thread_create(&pool->threads[pool->thread_count],
+                                   query_worker_func, pool) < 0) {
+            fprintf(stderr, "[PickFetcher] Failed to create query worker\n");
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    return pool->thread_count > 0 ? 0 : -1;
+}
+
+static void query_pool_run(PickQueryPool *pool, time_t start_time, time_t end_time) {
+    platform_mutex_lock(&pool->lock);
+    pool->start_time = start_time;
+    pool->end_time = end_time;
+    pool->next_source = 0;
+    pool->pending = pool->config->source_count;
+    pool->generation++;
+    platform_cond_broadcast(&pool->work_cond);
+
+    while (pool->pending > 0)
+        platform_cond_wait(&pool->done_cond, &pool->lock);
+    platform_mutex_unlock(&pool->lock);
+}
+
+static void query_pool_stop(PickQueryPool *pool) {
+    platform_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    platform_cond_broadcast(&pool->work_cond);
+    platform_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count; i++)
+        platform_thread_join(pool->threads[i]);
+
+    platform_cond_destroy(&pool->work_cond);
+    platform_cond_destroy(&pool->done_cond);
+    platform_mutex_destroy(&pool->lock);
+}
+
+/* Pushed picks older than this before the last SQL cycle are left to SQL */
+#define PUSH_RECONCILE_GRACE_SEC 120
+/* Delay between push feed reconnection attempts */
+#define PUSH_RECONNECT_MS 2000
+/* Idle wait on the feed socket when a reactor can interrupt it */
+#define PUSH_IDLE_WAIT_MS 30000
+
+/* Drop pushed picks that left the lookback or that SQL now covers */
+static void prune_pushed(PickFetcherConfig *config, double keep_after) {
+    size_t kept = 0;
+
+    for (size_t i = 0; i < config->pushed.count; i++) {
+        if (config->pushed.picks[i].epoch >= keep_after)
+            config->pushed.picks[kept++] = config->pushed.picks[i];
+    }
+    config->pushed.count = kept;
+}
+
+/*
+ * Publish the merged window. Caller must not hold window_lock.
+ * Both the SQL thread and the push feed thread publish, so the file
+ * write happens under the lock as well. Pushed picks before start_time
+ * are dropped first, so neither writer publishes them.
+ */
+static int publish_window(PickFetcherConfig *config, time_t start_time, time_t end_time) {
+    PickResult *parts[2];
+    PickResult *merged;
+    int rc = -1;
+
+    platform_mutex_lock(&config->window_lock);
+    prune_pushed(config, (double)start_time);
+    parts[0] = config->polled;
+    parts[1] = &config->pushed;
+    merged = merge_pick_results(parts, 2, config->dedup_tolerance_ms);
+    if (merged) {
+        TRACE_BEGIN(write_span);
+        if (config->shard_mode == PICKS_SHARD_NONE)
+            rc = write_picks_to_file(merged, config->output_filepath, start_time, end_time);
+        else
+            rc = write_picks_sharded(merged, config->output_filepath,
+                                     config->shard_mode, &config->shards);
+        TRACE_END(write_span, "write_picks_to_file");
+        free_pick_result(merged);
+    }
+    platform_mutex_unlock(&config->window_lock);
+
+    return rc;
+}
+
+/*
+ * Record a pick as passed to the callback. Returns 1 if it was not reported
+ * before, 0 if the same pick (same stream, within the merge tolerance) was.
+ * Picks carry no database ID, so stream and time identify them, for SQL
+ * and push feed picks alike. Caller holds window_lock.
+ */
+static int remember_pick(PickFetcherConfig *config, const PickData *pick) {
+    PickResult *seen = &config->reported;
+    double tolerance = config->dedup_tolerance_ms / 1000.0 + 1e-6;
+    PickData probe = *pick;
+    size_t lo = 0, hi = seen->count;
+
+    /* First entry not before (stream, epoch - tolerance) */
+    probe.epoch = pick->epoch - tolerance;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (compare_picks_by_stream(&seen->picks[mid], &probe) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < seen->count && same_stream(&seen->picks[lo], pick) &&
+        seen->picks[lo].epoch <= pick->epoch + tolerance)
+        return 0;
+
+    if (seen->count >= config->reported_capacity) {
+        size_t cap = config->reported_capacity ? config->reported_capacity * 2 : 256;
+        PickData *grown = (PickData*)realloc(seen->picks, cap * sizeof(PickData));
+        if (grown == NULL)
+            return 1;       /* Report it; at worst it is reported again */
+        seen->picks = grown;
+        config->reported_capacity = cap;
+    }
+    memmove(&seen->picks[lo + 1], &seen->picks[lo], (seen->count - lo) * sizeof(PickData));
+    seen->picks[lo] = *pick;
+    seen->count++;
+    return 1;
+}
+
+/* Forget reported picks that left the lookback; SQL cannot return them again */
+static void prune_reported(PickFetcherConfig *config, double keep_after) {
+    size_t kept = 0;
+
+    for (size_t i = 0; i < config->reported.count; i++) {
+        if (config->reported.picks[i].epoch >= keep_after)
+            config->reported.picks[kept++] = config->reported.picks[i];
+    }
+    config->reported.count = kept;
+}
+
+/*
+ * Parse one feed line in picks file format:
+ *   NET, STA, CHA, YYYY-MM-DD HH:MM:SS.ffffff[, PHASE[, EVENTID]]
+ * A 'T' date/time separator and trailing 'Z' are accepted as well.
+ */
+static int parse_feed_line(char *line, PickData *pick) {
+    char *fields[6];
+    int nfields = 0;
+    char *token, *save = NULL;
+    char *frac;
+    char digits[7] = "000000";
+
+    memset(pick, 0, sizeof(*pick));
+
+    for (token = strtok_r(line, ",", &save); token && nfields < 6;
+         token = strtok_r(NULL, ",", &save)) {
+        while (*token == ' ' || *token == '\t')
+            token++;
+        size_t len = strlen(token);
+        while (len > 0 && (token[len - 1] == ' ' || token[len - 1] == '\t' ||
+                           token[len - 1] == '\r'))
+            token[--len] = '\0';
+        fields[nfields++] = token;
+    }
+
+    if (nfields < 4 || fields[0][0] == '#')
+        return -1;
+
+    strncpy(pick->network, fields[0], sizeof(pick->network) - 1);
+    strncpy(pick->station, fields[1], sizeof(pick->station) - 1);
+    strncpy(pick->channel, fields[2], sizeof(pick->channel) - 1);
+
+    size_t time_len = strlen(fields[3]);
+    if (time_len > 0 && fields[3][time_len - 1] == 'Z')
+        fields[3][time_len - 1] = '\0';
+    if (time_len > 10 && fields[3][10] == 'T')
+        fields[3][10] = ' ';
+    frac = strchr(fields[3], '.');
+    if (frac) {
+        *frac++ = '\0';
+        for (int i = 0; i < 6 && frac[i] >= '0' && frac[i] <= '9'; i++)
+            digits[i] = frac[i];
+    }
+    strncpy(pick->pick_time, fields[3], sizeof(pick->pick_time) - 1);
+    snprintf(pick->pick_time_ms, sizeof(pick->pick_time_ms), "%d", atoi(digits));
+    pick->epoch = pick_epoch(pick);
+    if (pick->epoch <= 0)
+        return -1;
+
+    if (nfields > 4)
+        strncpy(pick->phase, fields[4], sizeof(pick->phase) - 1);
+    if (nfields > 5)
+        strncpy(pick->event_id, fields[5], sizeof(pick->event_id) - 1);
+
+    return 0;
+}
+
+/* Thread that appends pushed picks to the window and republishes at once */
+static PLATFORM_THREAD_FUNC(feed_thread_func) {
+    PickFetcherConfig *config = (PickFetcherConfig*)arg;
+    NetSocket sock = NET_INVALID_SOCKET;
+    char buffer[8192];
+    size_t used = 0;
+    PickData *fresh = NULL;         /* New picks of a batch, reported unlocked */
+    size_t fresh_capacity = 0;
+
+    printf("[PickFetcher] Push feed: %s\n", config->feed_address);
+    trace_set_thread_name("pick-feed");
+
+    while (config->running) {
+        if (sock == NET_INVALID_SOCKET) {
+            sock = net_connect(config->feed_address);
+            if (sock == NET_INVALID_SOCKET) {
+                reactor_sleep(config->reactor, PUSH_RECONNECT_MS);
+                continue;
+            }
+            LOG_INFO(LOG_CAT_PICKFETCHER, "Push feed connected");
+            used = 0;
+        }
+
+        /* With a reactor the stop event interrupts the wait, so it can be long */
+        int ready = reactor_wait_readable(config->reactor, sock,
+                                          config->reactor ? PUSH_IDLE_WAIT_MS : 500);
+        if (ready == 0)
+            continue;
+
+        long n = ready > 0 ? net_recv(sock, buffer + used, sizeof(buffer) - used - 1) : -1;
+        if (n <= 0) {
+            LOG_WARN(LOG_CAT_PICKFETCHER, "Push feed disconnected");
+            net_close(sock);
+            sock = NET_INVALID_SOCKET;
+            continue;
+        }
+        used += (size_t)n;
+        buffer[used] = '\0';
+
+        /* Append every complete line, then publish the batch once */
+        char *line = buffer;
+        char *nl;
+        int added = 0;
+        size_t fresh_count = 0;
+
+        platform_mutex_lock(&config->window_lock);
+        while ((nl = strchr(line, '\n')) != NULL) {
+            PickData pick;
+            *nl = '\0';
+            if (parse_feed_line(line, &pick) == 0) {
+                if (config->pushed.count >= config->pushed_capacity) {
+                    size_t cap = config->pushed_capacity ? config->pushed_capacity * 2 : 64;
+                    PickData *grown = (PickData*)realloc(config->pushed.picks,
+                                                         cap * sizeof(PickData));
+                    if (grown == NULL)
+                        break;
+                    config->pushed.picks = grown;
+                    config->pushed_capacity = cap;
+                }
+                config->pushed.picks[config->pushed.count++] = pick;
+                added++;
+                if (remember_pick(config, &pick) && config->pick_callback)
+                    append_pick(&fresh, &fresh_count, &fresh_capacity, &pick);
+            }
+            line = nl + 1;
+        }
+        platform_mutex_unlock(&config->window_lock);
+
+        for (size_t i = 0; i < fresh_count; i++)
+            config->pick_callback(&fresh[i], config->pick_callback_ctx);
+
+        used = strlen(line);
+        memmove(buffer, line, used);
+        if (used >= sizeof(buffer) - 1)
+            used = 0;       /* Oversized line, drop it */
+
+        if (added > 0) {
+            time_t end_time = time(NULL);
+            config->stats.pushed_picks += added;
+            metrics_counter_add(g_pushed_metric, (unsigned long long)added);
+            publish_window(config, end_time - config->lookback_sec, end_time);
+        }
+    }
+
+    net_close(sock);
+    free(fresh);
+    PLATFORM_THREAD_RETURN;
+}
+
+/* Query cost may use at most 1/N of the polling period */
+#define ADAPTIVE_COST_FACTOR 10.0
+/* Time constant of the smoothed pick arrival rate (seconds) */
+#define ADAPTIVE_RATE_WINDOW 120.0
+/* Poll about once per this many expected new picks */
+#define ADAPTIVE_PICKS_PER_POLL 1.0
+
+/* Fold one cycle's new picks into the smoothed arrival rate (picks/s) */
+static void update_pick_rate(PickFetcherStats *stats, long new_picks, double elapsed_sec) {
+    double weight;
+
+    if (elapsed_sec <= 0)
+        return;
+    /* Longer cycles carry more weight, so the window is in seconds, not cycles */
+    weight = elapsed_sec / (elapsed_sec + ADAPTIVE_RATE_WINDOW);
+    stats->pick_rate += weight * (new_picks / elapsed_sec - stats->pick_rate);
+}
+
+/*
+ * Pick the delay before the next cycle from the smoothed pick arrival
+ * rate: poll about as often as a new pick is expected, clamped to
+ * [min, max]. A single stray pick only nudges the rate, while a sustained
+ * sequence pulls the interval down to the minimum. The interval never
+ * drops below a multiple of the measured query cost so a slow database is
+ * not hammered.
+ */
+static double next_poll_interval(const PickFetcherConfig *config,
+                                 double pick_rate, double query_ms) {
+    double min_sec = config->interval_min_sec;
+    double max_sec = config->interval_max_sec;
+    double next;
+
+    if (max_sec <= min_sec || min_sec <= 0)
+        return config->update_interval_sec;
+
+    next = pick_rate > 0 ? ADAPTIVE_PICKS_PER_POLL / pick_rate : max_sec;
+
+    if (next < query_ms / 1000.0 * ADAPTIVE_COST_FACTOR)
+        next = query_ms / 1000.0 * ADAPTIVE_COST_FACTOR;
+    if (next < min_sec)
+        next = min_sec;
+    if (next > max_sec)
+        next = max_sec;
+
+    return next;
+}
+
+/* Thread function that periodically fetches picks */
 #ifdef _WIN32
-        return 1;
+static DWORD WINAPI pickfetcher_thread_func(LPVOID arg)
 #else
-        return NULL;
+static void* pickfetcher_thread_func(void *arg)
 #endif
+{
+    PickFetcherConfig *config = (PickFetcherConfig*)arg;
+    PickQueryPool pool;
+    PickResult *results[MAX_PICK_SOURCES];
+    int use_pool = config->source_count > 1;
+    long long last_cycle_us = 0;
+    int i;
+    
+    printf("[PickFetcher] Thread started\n");
+    trace_set_thread_name("pickfetcher");
+    for (i = 0; i < config->source_count; i++) {
+        printf("[PickFetcher] DB: %s@%s:%d/%s\n", config->sources[i].db_user,
+               config->sources[i].db_host, config->sources[i].db_port,
+               config->sources[i].db_name);
     }
+    printf("[PickFetcher] Output: %s, Interval: %ds, Lookback: %ds, Mode: %s\n",
+           config->output_filepath, config->update_interval_sec, config->lookback_sec,
+           config->picks_mode == PICKS_MODE_EVENT ? "event" : "all");
 
-    printf("[PickFetcher] Connected to database\n");
+    g_query_metric = metrics_histogram("pickfetcher_query_seconds", NULL,
+        "Duration of one pick query cycle across all sources");
+    g_picks_metric = metrics_gauge("pickfetcher_picks", NULL,
+        "Picks in the last SQL result");
+    g_interval_metric = metrics_gauge("pickfetcher_interval_seconds", NULL,
+        "Current pick polling interval");
+    g_new_picks_metric = metrics_counter("pickfetcher_new_picks_total", NULL,
+        "Picks not reported by earlier cycles");
+    g_pushed_metric = metrics_counter("pickfetcher_pushed_picks_total", NULL,
+        "Picks received from the push feed");
+
+    /* Connect up front so configuration errors show at startup */
+    for (i = 0; i < config->source_count; i++)
+        config->sources[i].conn = connect_source(&config->sources[i]);
+
+    if (use_pool && query_pool_start(&pool, config) < 0)
+        use_pool = 0;
+
+    config->stats.interval_sec = config->interval_max_sec > config->interval_min_sec &&
+                                 config->interval_min_sec > 0
+                                 ? config->interval_min_sec : config->update_interval_sec;
+    if (config->interval_max_sec > config->interval_min_sec && config->interval_min_sec > 0) {
+        printf("[PickFetcher] Adaptive polling between %ds and %ds\n",
+               config->interval_min_sec, config->interval_max_sec);
+    }
 
     /* Main loop */
     while (config->running) {
         time_t end_time = time(NULL);
         time_t start_time = end_time - config->lookback_sec;
+        int ok_sources = 0;
+        long new_picks = 0;
+        long long query_start_us = platform_monotonic_us();
+        double query_ms;
+
+        if (use_pool) {
+            query_pool_run(&pool, start_time, end_time);
+        } else {
+            for (i = 0; i < config->source_count; i++)
+                query_source(&config->sources[i], config->picks_mode,
+                             start_time, end_time);
+        }
 
-        PickResult *picks = get_picks(start_time, end_time, conn);
+        query_ms = (platform_monotonic_us() - query_start_us) / 1000.0;
 
-        if (picks) {
-            printf("[PickFetcher] Found %zu picks\n", picks->count);
-            
-            if (write_picks_to_file(picks, config->output_filepath, 
-                                    start_time, end_time) == 0) {
-                printf("[PickFetcher] Updated %s\n", config->output_filepath);
-            } else {
-                fprintf(stderr, "[PickFetcher] Failed to write picks file\n");
-            }
+        for (i = 0; i < config->source_count; i++) {
+            results[i] = config->sources[i].result;
+            if (results[i])
+                ok_sources++;
+        }
 
-            free_pick_result(picks);
-        } else {
-            fprintf(stderr, "[PickFetcher] Failed to fetch picks, reconnecting...\n");
-            
-            /* Try to reconnect */
-            mysql_close(conn);
-            conn = mysql_init(NULL);
-            if (conn) {
-                mysql_optionsv(conn, MYSQL_OPT_SSL_VERIFY_SERVER_CERT, (void *)&verify);
-                mysql_optionsv(conn, MYSQL_OPT_SSL_ENFORCE, (void *)&enforce_tls);
-                if (mysql_real_connect(conn, config->db_host, config->db_user,
-                                       config->db_password, config->db_name,
-                                       config->db_port, NULL, 0) == NULL) {
-                    fprintf(stderr, "[PickFetcher] Reconnection failed: %s\n", 
-                            mysql_error(conn));
+        /* Publish whenever at least one source answered */
+        if (ok_sources > 0) {
+            PickResult *picks = merge_pick_results(results, config->source_count,
+                                                   config->dedup_tolerance_ms);
+            if (picks) {
+                size_t *fresh = (size_t*)malloc((picks->count + 1) * sizeof(size_t));
+                int seeding = !config->reported_seeded;
+
+                /*
+                 * A pick is new if it was never reported, however late it
+                 * was inserted. The first result only seeds the set, so a
+                 * restart does not replay the whole lookback.
+                 */
+                platform_mutex_lock(&config->window_lock);
+                prune_reported(config, (double)start_time);
+                for (size_t j = 0; j < picks->count; j++) {
+                    if (remember_pick(config, &picks->picks[j]) && !seeding && fresh)
+                        fresh[new_picks++] = j;
+                }
+                config->reported_seeded = 1;
+
+                /* SQL result is authoritative; keep only recent pushed picks */
+                free_pick_result(config->polled);
+                config->polled = picks;
+                prune_pushed(config, (double)(end_time - PUSH_RECONCILE_GRACE_SEC));
+                platform_mutex_unlock(&config->window_lock);
+
+                /* polled is only replaced by this thread, so picks stays valid */
+                if (config->pick_callback) {
+                    for (long j = 0; j < new_picks; j++)
+                        config->pick_callback(&picks->picks[fresh[j]], config->pick_callback_ctx);
+                }
+                free(fresh);
+                config->stats.last_pick_count = (long)picks->count;
+
+                LOG_INFO(LOG_CAT_PICKFETCHER, "Found %zu picks, %ld new (%d/%d sources, %.0f ms)",
+                         picks->count, new_picks, ok_sources, config->source_count,
+                         query_ms);
+
+                if (publish_window(config, start_time, end_time) == 0) {
+                    if (config->shard_mode == PICKS_SHARD_NONE)
+                        LOG_INFO(LOG_CAT_PICKFETCHER, "Updated %s", config->output_filepath);
+                    else
+                        LOG_INFO(LOG_CAT_PICKFETCHER, "Updated %d of %zu shards",
+                                 config->shards.last_rewritten, config->shards.count);
+                } else {
+                    LOG_ERROR(LOG_CAT_PICKFETCHER, "Failed to write picks file");
                 }
             }
         }
 
-        /* Sleep for the configured interval, checking running flag periodically */
-        for (int i = 0; i < config->update_interval_sec && config->running; i++) {
-#ifdef _WIN32
-            Sleep(1000);  /* 1 second */
-#else
-            sleep(1);
-#endif
+        metrics_histogram_record(g_query_metric, (unsigned long long)(query_ms * 1000.0));
+        metrics_gauge_set(g_picks_metric, (double)config->stats.last_pick_count);
+        metrics_counter_add(g_new_picks_metric, (unsigned long long)new_picks);
+
+        config->stats.last_query_ms = query_ms;
+        config->stats.avg_query_ms = config->stats.cycles == 0 ? query_ms :
+            0.8 * config->stats.avg_query_ms + 0.2 * query_ms;
+        config->stats.last_new_picks = new_picks;
+        config->stats.cycles++;
+        /* No sample from the first cycle (no elapsed time) or failed cycles */
+        if (last_cycle_us != 0 && ok_sources > 0)
+            update_pick_rate(&config->stats, new_picks,
+                             (query_start_us - last_cycle_us) / 1e6);
+        last_cycle_us = query_start_us;
+        config->stats.interval_sec = next_poll_interval(config, config->stats.pick_rate,
+                                                        config->stats.avg_query_ms);
+        metrics_gauge_set(g_interval_metric, config->stats.interval_sec);
+
+        /*
+         * Sleep until the next cycle. The reactor's stop event ends the
+         * wait at once; without one, check the running flag every second.
+         */
+        long long wake_us = platform_monotonic_us() +
+                            (long long)(config->stats.interval_sec * 1e6);
+        while (config->running) {
+            long long remaining_ms = (wake_us - platform_monotonic_us()) / 1000;
+            if (remaining_ms <= 0)
+                break;
+            if (config->reactor == NULL && remaining_ms > 1000)
+                remaining_ms = 1000;
+            if (reactor_sleep(config->reactor, (unsigned int)remaining_ms))
+                break;
         }
     }
 
+    if (use_pool)
+        query_pool_stop(&pool);
+
     /* Cleanup */
-    if (conn) {
-        mysql_close(conn);
+    for (i = 0; i < config->source_count; i++) {
+        free_pick_result(config->sources[i].result);
+        config->sources[i].result = NULL;
+        free_event_cache(&config->sources[i].event_cache);
+        if (config->sources[i].conn) {
+            mysql_close(config->sources[i].conn);
+            config->sources[i].conn = NULL;
+        }
     }
 
     printf("[PickFetcher] Thread stopped\n");
@@ -276,7 +1492,18 @@ static void* pickfetcher_thread_func(void *arg)
 }
 
 int pickfetcher_start(PickFetcherConfig *config, PickFetcherThread *thread) {
+    if (config->source_count <= 0 && config->feed_address[0] == '\0') {
+        fprintf(stderr, "No database sources configured for pick fetcher\n");
+        return -1;
+    }
+
+    /* Must run before any thread touches the client library */
+    mysql_library_init(0, NULL, NULL);
+
     config->running = 1;
+    platform_mutex_init(&config->window_lock);
+    if (config->shard_mode != PICKS_SHARD_NONE)
+        remove_stale_shards(config->output_filepath);
 
 #ifdef _WIN32
     *thread = CreateThread(NULL, 0, pickfetcher_thread_func, config, 0, NULL);
@@ -291,9 +1518,27 @@ int pickfetcher_start(PickFetcherConfig *config, PickFetcherThread *thread) {
     }
 #endif
 
+    if (config->feed_address[0] != '\0') {
+        net_init();
+        if (platform_thread_create(&config->feed_thread, feed_thread_func, config) < 0)
+            fprintf(stderr, "Failed to create pick feed thread\n");
+        else
+            config->feed_started = 1;
+    }
+
     return 0;
 }
 
+void pickfetcher_get_stats(const PickFetcherConfig *config, PickFetcherStats *stats) {
+    stats->interval_sec = config->stats.interval_sec;
+    stats->last_query_ms = config->stats.last_query_ms;
+    stats->avg_query_ms = config->stats.avg_query_ms;
+    stats->pick_rate = config->stats.pick_rate;
+    stats->last_new_picks = config->stats.last_new_picks;
+    stats->last_pick_count = config->stats.last_pick_count;
+    stats->cycles = config->stats.cycles;
+}
+
 int pickfetcher_stop(PickFetcherConfig *config, PickFetcherThread thread) {
     config->running = 0;
 
@@ -304,5 +1549,25 @@ int pickfetcher_stop(PickFetcherConfig *config, PickFetcherThread thread) {
     pthread_join(thread, NULL);
 #endif
 
+    if (config->feed_started) {
+        platform_thread_join(config->feed_thread);
+        config->feed_started = 0;
+    }
+
+    free_pick_result(config->polled);
+    config->polled = NULL;
+    free(config->pushed.picks);
+    config->pushed.picks = NULL;
+    free(config->reported.picks);
+    config->reported.picks = NULL;
+    config->reported.count = 0;
+    config->reported_capacity = 0;
+    config->reported_seeded = 0;
+    free(config->shards.shards);
+    memset(&config->shards, 0, sizeof(config->shards));
+    config->pushed.count = 0;
+    config->pushed_capacity = 0;
+    platform_mutex_destroy(&config->window_lock);
+
     return 0;
 }
\ No newline at end of file
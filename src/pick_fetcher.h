@@ -10,19 +10,12 @@
 #include <mysql.h>
 #include <time.h>
 #include "config.h"
+#include "platform.h"
+#include "reactor.h"
 
-/* Configuration structure for the pick fetcher thread */
-typedef struct {
-    char db_host[256];
-    char db_user[64];
-    char db_password[64];
-    char db_name[64];
-    int db_port;
-    char output_filepath[512];
-    int update_interval_sec;    /* How often to check for new picks */
-    int lookback_sec;           /* How far back to query picks */
-    volatile int running;       /* Flag to signal thread shutdown */
-} PickFetcherConfig;
+#define MAX_PICK_SOURCES MAX_DB_SOURCES
+#define DEFAULT_PICK_QUERY_THREADS 4
+#define DEFAULT_PICK_DEDUP_TOLERANCE_MS 500
 
 typedef struct {
     char network[16];
@@ -30,6 +23,9 @@ typedef struct {
     char channel[16];
     char pick_time[32];
     char pick_time_ms[16];
+    double epoch;               /* pick_time + pick_time_ms as epoch seconds */
+    char phase[16];             /* Phase hint (event mode only) */
+    char event_id[64];          /* Associated event (event mode only) */
 } PickData;
 
 typedef struct {
@@ -37,6 +33,111 @@ typedef struct {
     size_t count;
 } PickResult;
 
+/* Which picks the fetcher publishes */
+#define PICKS_MODE_ALL   0      /* Every Pick row in the lookback window */
+#define PICKS_MODE_EVENT 1      /* Only picks associated to preferred origins */
+
+/* Picks of one event, kept until the event's preferred origin changes */
+typedef struct {
+    char event_id[64];
+    char origin_id[64];
+    char last_modified[32];
+    PickData *picks;
+    size_t count;
+    size_t capacity;
+    int loaded;                 /* Picks fetched for the current origin */
+    int seen;                   /* Still inside the lookback this cycle */
+} CachedEvent;
+
+typedef struct {
+    CachedEvent *events;
+    size_t count;
+    size_t capacity;
+} EventPickCache;
+
+/* How the picks file is split */
+#define PICKS_SHARD_NONE    0   /* One picks_file with every pick */
+#define PICKS_SHARD_STATION 1   /* One file per NET.STA */
+#define PICKS_SHARD_HOUR    2   /* One file per UTC hour of pick time */
+#define PICKS_SHARD_DAY     3   /* One file per UTC day of pick time */
+
+typedef struct {
+    char key[64];
+    unsigned long long hash;    /* Content hash of the last written version */
+    int seen;
+} PickShard;
+
+typedef struct {
+    PickShard *shards;
+    size_t count;
+    size_t capacity;
+    int last_rewritten;         /* Shards written by the last publication */
+} PickShardState;
+
+/* One SeisComP database the fetcher reads picks from */
+typedef struct {
+    char db_host[256];
+    char db_user[64];
+    char db_password[64];
+    char db_name[64];
+    int db_port;
+    MYSQL *conn;                /* Persistent connection, owned by the fetcher */
+    PickResult *result;         /* Picks returned by the current cycle */
+    EventPickCache event_cache; /* Per-event picks for PICKS_MODE_EVENT */
+} PickSource;
+
+/* Polling statistics, updated by the fetcher thread once per cycle */
+typedef struct {
+    volatile double interval_sec;       /* Delay before the next cycle */
+    volatile double last_query_ms;      /* Wall time of the last query cycle */
+    volatile double avg_query_ms;       /* Smoothed query cost */
+    volatile long last_new_picks;       /* Picks not seen by earlier cycles */
+    volatile double pick_rate;          /* Smoothed new picks per second */
+    volatile long last_pick_count;
+    volatile long cycles;
+    volatile long pushed_picks;         /* Picks received from the push feed */
+} PickFetcherStats;
+
+/* Called once per new pick, on the fetcher or push feed thread */
+typedef void (*PickCallback)(const PickData *pick, void *ctx);
+
+/* Configuration structure for the pick fetcher thread */
+typedef struct {
+    PickSource sources[MAX_PICK_SOURCES];
+    int source_count;
+    int query_threads;          /* Worker threads used when source_count > 1 */
+    int dedup_tolerance_ms;     /* Same-stream picks closer than this are merged */
+    int picks_mode;             /* PICKS_MODE_ALL or PICKS_MODE_EVENT */
+    int shard_mode;             /* PICKS_SHARD_* */
+    PickShardState shards;
+    char output_filepath[512];
+    int update_interval_sec;    /* How often to check for new picks */
+    int interval_min_sec;       /* Adaptive polling bounds; adaptive when */
+    int interval_max_sec;       /* max > min, otherwise update_interval_sec */
+    int lookback_sec;           /* How far back to query picks */
+    volatile int running;       /* Flag to signal thread shutdown */
+    Reactor *reactor;           /* Optional; its stop event ends waits at once */
+    PickFetcherStats stats;
+    PickCallback pick_callback; /* Optional, see PickCallback */
+    void *pick_callback_ctx;
+
+    /* Optional push feed ("unix:/path" or "tcp:host:port"), one pick per line */
+    char feed_address[256];
+    PlatformThread feed_thread;
+    int feed_started;
+
+    /* Published pick window: last SQL result plus picks pushed since */
+    PlatformMutex window_lock;
+    PickResult *polled;
+    PickResult pushed;
+    size_t pushed_capacity;
+
+    /* Picks already passed to pick_callback, sorted by stream and time */
+    PickResult reported;
+    size_t reported_capacity;
+    int reported_seeded;        /* First SQL result recorded without callbacks */
+} PickFetcherConfig;
+
 /* Thread handle type (platform-independent) */
 #ifdef _WIN32
     typedef HANDLE PickFetcherThread;
@@ -50,11 +151,21 @@ int pickfetcher_start(PickFetcherConfig *config, PickFetcherThread *thread);
 /* Stop the pick fetcher thread and wait for it to finish */
 int pickfetcher_stop(PickFetcherConfig *config, PickFetcherThread thread);
 
+/* Snapshot of the polling cadence and query cost (safe from any thread) */
+void pickfetcher_get_stats(const PickFetcherConfig *config, PickFetcherStats *stats);
+
 /* Helper functions (can be called independently if needed) */
 void format_mysql_datetime(time_t timestamp, char *buffer, size_t buffer_size);
 PickResult* get_picks(time_t start_time, time_t end_time, MYSQL *conn);
 void free_pick_result(PickResult *result);
+PickResult* get_event_picks(time_t start_time, time_t end_time, MYSQL *conn,
+                            EventPickCache *cache);
+void free_event_cache(EventPickCache *cache);
+PickResult* merge_pick_results(PickResult **results, int count,
+                               int tolerance_ms);
 int write_picks_to_file(PickResult *picks, const char *filepath,
                         time_t start_time, time_t end_time);
+int write_picks_sharded(PickResult *picks, const char *filepath,
+                        int shard_mode, PickShardState *state);
 
 #endif /* PICKFETCHER_H */
\ No newline at end of file
@@ -0,0 +1,297 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+/*
+ * Thin portability layer for threads, locks and clocks.
+ * Wraps Win32 and pthreads the same way the thread entry points in
+ * ringclient.c and pick_fetcher.c already do.
+ */
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <windows.h>
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+    #include <sys/time.h>
+#endif
+
+#include <time.h>
+
+#ifdef _WIN32
+    typedef HANDLE PlatformThread;
+    typedef CRITICAL_SECTION PlatformMutex;
+    typedef CONDITION_VARIABLE PlatformCond;
+    #define PLATFORM_THREAD_FUNC(name) DWORD WINAPI name(LPVOID arg)
+    #define PLATFORM_THREAD_RETURN return 0
+    typedef LPTHREAD_START_ROUTINE PlatformThreadFunc;
+#else
+    typedef pthread_t PlatformThread;
+    typedef pthread_mutex_t PlatformMutex;
+    typedef pthread_cond_t PlatformCond;
+    #define PLATFORM_THREAD_FUNC(name) void* name(void *arg)
+    #define PLATFORM_THREAD_RETURN return NULL
+    typedef void* (*PlatformThreadFunc)(void *);
+#endif
+
+#ifdef _WIN32
+    #define PLATFORM_THREAD_LOCAL __declspec(thread)
+#else
+    #define PLATFORM_THREAD_LOCAL __thread
+#endif
+
+/* Relaxed 64-bit atomics for statistics counters; add returns the old value */
+static inline unsigned long long platform_atomic_add_u64(volatile unsigned long long *p,
+                                                         unsigned long long v) {
+#ifdef _WIN32
+    return (unsigned long long)InterlockedExchangeAdd64((volatile LONG64 *)p, (LONG64)v);
+#else
+    return __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline unsigned long long platform_atomic_load_u64(volatile unsigned long long *p) {
+#ifdef _WIN32
+    return (unsigned long long)InterlockedCompareExchange64((volatile LONG64 *)p, 0, 0);
+#else
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+#endif
+}
+
+static inline void platform_atomic_store_u64(volatile unsigned long long *p,
+                                             unsigned long long v) {
+#ifdef _WIN32
+    InterlockedExchange64((volatile LONG64 *)p, (LONG64)v);
+#else
+    __atomic_store_n(p, v, __ATOMIC_RELAXED);
+#endif
+}
+
+/* Ordered variants for publishing data between threads */
+static inline unsigned long long platform_atomic_load_acquire_u64(volatile unsigned long long *p) {
+#ifdef _WIN32
+    return (unsigned long long)InterlockedCompareExchange64((volatile LONG64 *)p, 0, 0);
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
+
+static inline void platform_atomic_store_release_u64(volatile unsigned long long *p,
+                                                     unsigned long long v) {
+#ifdef _WIN32
+    InterlockedExchange64((volatile LONG64 *)p, (LONG64)v);
+#else
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#endif
+}
+
+/* Reference count drop: returns the old value, releasing this thread's writes */
+static inline unsigned long long platform_atomic_sub_release_u64(volatile unsigned long long *p,
+                                                                 unsigned long long v) {
+#ifdef _WIN32
+    return (unsigned long long)InterlockedExchangeAdd64((volatile LONG64 *)p, -(LONG64)v);
+#else
+    return __atomic_fetch_sub(p, v, __ATOMIC_RELEASE);
+#endif
+}
+
+/* Pairs with the release drops above before the last owner frees the object */
+static inline void platform_atomic_fence_acquire(void) {
+#ifdef _WIN32
+    MemoryBarrier();
+#else
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif
+}
+
+/* Returns 1 if *p was expected and is now desired */
+static inline int platform_atomic_cas_u64(volatile unsigned long long *p,
+                                          unsigned long long expected,
+                                          unsigned long long desired) {
+#ifdef _WIN32
+    return (unsigned long long)InterlockedCompareExchange64(
+               (volatile LONG64 *)p, (LONG64)desired, (LONG64)expected) == expected;
+#else
+    return __atomic_compare_exchange_n(p, &expected, desired, 0,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+#endif
+}
+
+/* Full barrier, for store-then-load handshakes between two threads */
+static inline void platform_atomic_fence(void) {
+#ifdef _WIN32
+    MemoryBarrier();
+#else
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+static inline int platform_thread_create(PlatformThread *thread,
+                                         PlatformThreadFunc func, void *arg) {
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, func, arg, 0, NULL);
+    return *thread == NULL ? -1 : 0;
+#else
+    return pthread_create(thread, NULL, func, arg) != 0 ? -1 : 0;
+#endif
+}
+
+static inline void platform_thread_join(PlatformThread thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+static inline void platform_mutex_init(PlatformMutex *m) {
+#ifdef _WIN32
+    InitializeCriticalSection(m);
+#else
+    pthread_mutex_init(m, NULL);
+#endif
+}
+
+static inline void platform_mutex_destroy(PlatformMutex *m) {
+#ifdef _WIN32
+    DeleteCriticalSection(m);
+#else
+    pthread_mutex_destroy(m);
+#endif
+}
+
+static inline void platform_mutex_lock(PlatformMutex *m) {
+#ifdef _WIN32
+    EnterCriticalSection(m);
+#else
+    pthread_mutex_lock(m);
+#endif
+}
+
+static inline void platform_mutex_unlock(PlatformMutex *m) {
+#ifdef _WIN32
+    LeaveCriticalSection(m);
+#else
+    pthread_mutex_unlock(m);
+#endif
+}
+
+static inline void platform_cond_init(PlatformCond *c) {
+#ifdef _WIN32
+    InitializeConditionVariable(c);
+#else
+    pthread_cond_init(c, NULL);
+#endif
+}
+
+static inline void platform_cond_destroy(PlatformCond *c) {
+#ifdef _WIN32
+    (void)c;
+#else
+    pthread_cond_destroy(c);
+#endif
+}
+
+static inline void platform_cond_wait(PlatformCond *c, PlatformMutex *m) {
+#ifdef _WIN32
+    SleepConditionVariableCS(c, m, INFINITE);
+#else
+    pthread_cond_wait(c, m);
+#endif
+}
+
+/* Wait at most timeout_ms; returns 0 when woken, 1 on timeout */
+static inline int platform_cond_timedwait_ms(PlatformCond *c, PlatformMutex *m,
+                                             unsigned int timeout_ms) {
+#ifdef _WIN32
+    if (SleepConditionVariableCS(c, m, timeout_ms))
+        return 0;
+    return GetLastError() == ERROR_TIMEOUT ? 1 : 0;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(c, m, &ts) == 0 ? 0 : 1;
+#endif
+}
+
+static inline void platform_cond_signal(PlatformCond *c) {
+#ifdef _WIN32
+    WakeConditionVariable(c);
+#else
+    pthread_cond_signal(c);
+#endif
+}
+
+static inline void platform_cond_broadcast(PlatformCond *c) {
+#ifdef _WIN32
+    WakeAllConditionVariable(c);
+#else
+    pthread_cond_broadcast(c);
+#endif
+}
+
+static inline void platform_sleep_ms(unsigned int ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep((useconds_t)ms * 1000);
+#endif
+}
+
+/* Monotonic clock in microseconds (for durations, not timestamps) */
+static inline long long platform_monotonic_us(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    /* Split so now * 1000000 cannot overflow after long uptimes */
+    return (long long)(now.QuadPart / freq.QuadPart * 1000000 +
+                       now.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+/* Wall clock as fractional epoch seconds (UTC) */
+static inline double platform_time_now(void) {
+#ifdef _WIN32
+    FILETIME ft;
+    ULARGE_INTEGER t;
+    GetSystemTimeAsFileTime(&ft);
+    t.LowPart = ft.dwLowDateTime;
+    t.HighPart = ft.dwHighDateTime;
+    return (double)(t.QuadPart - 116444736000000000ULL) / 1e7;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1e6;
+#endif
+}
+
+/* Reentrant gmtime/localtime; both threads may convert times concurrently */
+static inline struct tm* platform_gmtime(const time_t *t, struct tm *out) {
+#ifdef _WIN32
+    return gmtime_s(out, t) == 0 ? out : NULL;
+#else
+    return gmtime_r(t, out);
+#endif
+}
+
+static inline struct tm* platform_localtime(const time_t *t, struct tm *out) {
+#ifdef _WIN32
+    return localtime_s(out, t) == 0 ? out : NULL;
+#else
+    return localtime_r(t, out);
+#endif
+}
+
+#endif /* PLATFORM_H */
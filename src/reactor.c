@@ -0,0 +1,454 @@
+#ifdef __linux__
+    #define REACTOR_EPOLL 1
+#endif
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <windows.h>
+#elif defined(REACTOR_EPOLL)
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+    #include <sys/signalfd.h>
+    #include <sys/timerfd.h>
+    #include <poll.h>
+    #include <errno.h>
+#endif
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "reactor.h"
+#include "platform.h"
+
+typedef struct {
+    ReactorCallback callback;
+    void *ctx;
+    unsigned int interval_ms;
+#ifdef REACTOR_EPOLL
+    int fd;
+#else
+    long long due_us;
+#endif
+} ReactorTimer;
+
+typedef struct {
+    int signum;
+    ReactorCallback callback;
+    void *ctx;
+} ReactorSignal;
+
+struct Reactor {
+    ReactorTimer timers[REACTOR_MAX_TIMERS];
+    int timer_count;
+    ReactorSignal signals[REACTOR_MAX_SIGNALS];
+    int signal_count;
+    volatile unsigned long long stopped;
+#ifdef REACTOR_EPOLL
+    int epoll_fd;
+    int stop_fd;                /* eventfd, left readable once stopped */
+    int signal_fd;
+    sigset_t signal_mask;
+#else
+    PlatformMutex lock;
+    PlatformCond cond;
+#endif
+};
+
+/* epoll tags: which kind of descriptor became ready */
+#define TAG_STOP   0
+#define TAG_SIGNAL 1
+#define TAG_TIMER  2           /* + timer index */
+
+static void dispatch_signal(Reactor *reactor, int signum) {
+    for (int i = 0; i < reactor->signal_count; i++) {
+        if (reactor->signals[i].signum == signum)
+            reactor->signals[i].callback(reactor, reactor->signals[i].ctx);
+    }
+}
+
+int reactor_stopped(Reactor *reactor) {
+    return reactor != NULL && platform_atomic_load_acquire_u64(&reactor->stopped) != 0;
+}
+
+#ifdef REACTOR_EPOLL
+
+static int epoll_add(Reactor *reactor, int fd, unsigned int tag) {
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u32 = tag;
+    return epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+Reactor* reactor_create(void) {
+    Reactor *reactor = (Reactor*)calloc(1, sizeof(Reactor));
+
+    if (reactor == NULL)
+        return NULL;
+    reactor->signal_fd = -1;
+    sigemptyset(&reactor->signal_mask);
+
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    reactor->stop_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (reactor->epoll_fd < 0 || reactor->stop_fd < 0 ||
+        epoll_add(reactor, reactor->stop_fd, TAG_STOP) < 0) {
+        fprintf(stderr, "[Reactor] Failed to create event loop\n");
+        reactor_destroy(reactor);
+        return NULL;
+    }
+    return reactor;
+}
+
+void reactor_destroy(Reactor *reactor) {
+    if (reactor == NULL)
+        return;
+    for (int i = 0; i < reactor->timer_count; i++)
+        close(reactor->timers[i].fd);
+    if (reactor->signal_fd >= 0)
+        close(reactor->signal_fd);
+    if (reactor->stop_fd >= 0)
+        close(reactor->stop_fd);
+    if (reactor->epoll_fd >= 0)
+        close(reactor->epoll_fd);
+    free(reactor);
+}
+
+int reactor_add_timer(Reactor *reactor, unsigned int interval_ms,
+                      ReactorCallback callback, void *ctx) {
+    ReactorTimer *timer;
+    struct itimerspec spec;
+    int fd;
+
+    if (reactor->timer_count >= REACTOR_MAX_TIMERS || interval_ms == 0)
+        return -1;
+
+    fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd < 0)
+        return -1;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (long)(interval_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(fd, 0, &spec, NULL) < 0 ||
+        epoll_add(reactor, fd, TAG_TIMER + reactor->timer_count) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    timer = &reactor->timers[reactor->timer_count++];
+    timer->callback = callback;
+    timer->ctx = ctx;
+    timer->interval_ms = interval_ms;
+    timer->fd = fd;
+    return 0;
+}
+
+int reactor_add_signal(Reactor *reactor, int signum, ReactorCallback callback, void *ctx) {
+    ReactorSignal *sig;
+    int fd;
+
+    if (reactor->signal_count >= REACTOR_MAX_SIGNALS)
+        return -1;
+
+    sigaddset(&reactor->signal_mask, signum);
+    if (pthread_sigmask(SIG_BLOCK, &reactor->signal_mask, NULL) != 0)
+        return -1;
+
+    /* Passing the existing descriptor updates its mask */
+    fd = signalfd(reactor->signal_fd, &reactor->signal_mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (fd < 0)
+        return -1;
+    if (reactor->signal_fd < 0) {
+        if (epoll_add(reactor, fd, TAG_SIGNAL) < 0) {
+            close(fd);
+            return -1;
+        }
+        reactor->signal_fd = fd;
+    }
+
+    sig = &reactor->signals[reactor->signal_count++];
+    sig->signum = signum;
+    sig->callback = callback;
+    sig->ctx = ctx;
+    return 0;
+}
+
+void reactor_run(Reactor *reactor) {
+    struct epoll_event events[REACTOR_MAX_TIMERS + 2];
+
+    while (!reactor_stopped(reactor)) {
+        int n = epoll_wait(reactor->epoll_fd, events,
+                           (int)(sizeof(events) / sizeof(events[0])), -1);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "[Reactor] epoll_wait failed: %s\n", strerror(errno));
+            return;
+        }
+
+        for (int i = 0; i < n && !reactor_stopped(reactor); i++) {
+            unsigned int tag = events[i].data.u32;
+
+            if (tag == TAG_SIGNAL) {
+                struct signalfd_siginfo info;
+                while (read(reactor->signal_fd, &info, sizeof(info)) == sizeof(info))
+                    dispatch_signal(reactor, (int)info.ssi_signo);
+            } else if (tag >= TAG_TIMER) {
+                ReactorTimer *timer = &reactor->timers[tag - TAG_TIMER];
+                unsigned long long expirations;
+
+                /* Missed expirations are coalesced into one call */
+                if (read(timer->fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+                    timer->callback(reactor, timer->ctx);
+            }
+        }
+    }
+}
+
+void reactor_stop(Reactor *reactor) {
+    unsigned long long one = 1;
+
+    platform_atomic_store_release_u64(&reactor->stopped, 1);
+    if (write(reactor->stop_fd, &one, sizeof(one)) < 0) {
+        /* Counter overflow cannot happen with one write per stop */
+    }
+}
+
+int reactor_sleep(Reactor *reactor, unsigned int timeout_ms) {
+    struct pollfd pfd;
+
+    if (reactor == NULL) {
+        platform_sleep_ms(timeout_ms);
+        return 0;
+    }
+
+    pfd.fd = reactor->stop_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    poll(&pfd, 1, (int)timeout_ms);
+    return reactor_stopped(reactor);
+}
+
+int reactor_wait_readable(Reactor *reactor, NetSocket sock, int timeout_ms) {
+    struct pollfd pfd[2];
+    int rc;
+
+    if (reactor == NULL)
+        return net_wait_readable(sock, timeout_ms);
+
+    pfd[0].fd = sock;
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+    pfd[1].fd = reactor->stop_fd;
+    pfd[1].events = POLLIN;
+    pfd[1].revents = 0;
+
+    rc = poll(pfd, 2, timeout_ms);
+    if (rc < 0)
+        return errno == EINTR ? 0 : -1;
+    if (pfd[0].revents & (POLLIN | POLLHUP | POLLERR))
+        return 1;
+    return 0;
+}
+
+#else /* Portable fallback */
+
+/* Signal handlers need a way back to the reactor; only one can own signals */
+static Reactor *g_signal_reactor = NULL;
+static volatile sig_atomic_t g_pending[REACTOR_MAX_SIGNALS];
+
+#ifdef _WIN32
+static BOOL WINAPI console_handler(DWORD event) {
+    Reactor *reactor = g_signal_reactor;
+
+    if (reactor == NULL || (event != CTRL_C_EVENT && event != CTRL_BREAK_EVENT))
+        return FALSE;
+
+    /* Runs on its own thread, so it can wake the loop directly */
+    platform_mutex_lock(&reactor->lock);
+    for (int i = 0; i < reactor->signal_count; i++) {
+        if (reactor->signals[i].signum == SIGINT)
+            g_pending[i] = 1;
+    }
+    platform_cond_broadcast(&reactor->cond);
+    platform_mutex_unlock(&reactor->lock);
+    return TRUE;
+}
+#else
+static void signal_handler(int signum) {
+    Reactor *reactor = g_signal_reactor;
+
+    if (reactor == NULL)
+        return;
+    for (int i = 0; i < reactor->signal_count; i++) {
+        if (reactor->signals[i].signum == signum)
+            g_pending[i] = 1;
+    }
+}
+#endif
+
+Reactor* reactor_create(void) {
+    Reactor *reactor = (Reactor*)calloc(1, sizeof(Reactor));
+
+    if (reactor == NULL)
+        return NULL;
+    platform_mutex_init(&reactor->lock);
+    platform_cond_init(&reactor->cond);
+    return reactor;
+}
+
+void reactor_destroy(Reactor *reactor) {
+    if (reactor == NULL)
+        return;
+    if (g_signal_reactor == reactor)
+        g_signal_reactor = NULL;
+    platform_cond_destroy(&reactor->cond);
+    platform_mutex_destroy(&reactor->lock);
+    free(reactor);
+}
+
+int reactor_add_timer(Reactor *reactor, unsigned int interval_ms,
+                      ReactorCallback callback, void *ctx) {
+    ReactorTimer *timer;
+
+    if (reactor->timer_count >= REACTOR_MAX_TIMERS || interval_ms == 0)
+        return -1;
+
+    platform_mutex_lock(&reactor->lock);
+    timer = &reactor->timers[reactor->timer_count++];
+    timer->callback = callback;
+    timer->ctx = ctx;
+    timer->interval_ms = interval_ms;
+    timer->due_us = platform_monotonic_us() + (long long)interval_ms * 1000;
+    platform_mutex_unlock(&reactor->lock);
+    return 0;
+}
+
+int reactor_add_signal(Reactor *reactor, int signum, ReactorCallback callback, void *ctx) {
+    ReactorSignal *sig;
+
+    if (reactor->signal_count >= REACTOR_MAX_SIGNALS)
+        return -1;
+    if (g_signal_reactor != NULL && g_signal_reactor != reactor)
+        return -1;
+
+    sig = &reactor->signals[reactor->signal_count];
+    sig->signum = signum;
+    sig->callback = callback;
+    sig->ctx = ctx;
+    reactor->signal_count++;
+    g_signal_reactor = reactor;
+
+#ifdef _WIN32
+    if (reactor->signal_count == 1)
+        SetConsoleCtrlHandler(console_handler, TRUE);
+#else
+    signal(signum, signal_handler);
+#endif
+    return 0;
+}
+
+void reactor_run(Reactor *reactor) {
+    while (!reactor_stopped(reactor)) {
+        long long now = platform_monotonic_us();
+        long long wait_us = -1;
+        int i;
+
+        for (i = 0; i < reactor->timer_count; i++) {
+            long long left = reactor->timers[i].due_us - now;
+            if (wait_us < 0 || left < wait_us)
+                wait_us = left > 0 ? left : 0;
+        }
+#ifndef _WIN32
+        /* Handlers cannot signal the condition variable, so poll for them */
+        if (reactor->signal_count > 0 &&
+            (wait_us < 0 || wait_us > REACTOR_SIGNAL_POLL_MS * 1000LL))
+            wait_us = REACTOR_SIGNAL_POLL_MS * 1000LL;
+#endif
+
+        platform_mutex_lock(&reactor->lock);
+        if (!reactor_stopped(reactor) && wait_us != 0) {
+            if (wait_us < 0)
+                platform_cond_wait(&reactor->cond, &reactor->lock);
+            else
+                platform_cond_timedwait_ms(&reactor->cond, &reactor->lock,
+                                           (unsigned int)((wait_us + 999) / 1000));
+        }
+        platform_mutex_unlock(&reactor->lock);
+
+        for (i = 0; i < reactor->signal_count && !reactor_stopped(reactor); i++) {
+            if (g_pending[i]) {
+                g_pending[i] = 0;
+                reactor->signals[i].callback(reactor, reactor->signals[i].ctx);
+            }
+        }
+
+        now = platform_monotonic_us();
+        for (i = 0; i < reactor->timer_count && !reactor_stopped(reactor); i++) {
+            ReactorTimer *timer = &reactor->timers[i];
+            if (now < timer->due_us)
+                continue;
+            /* Missed expirations are coalesced into one call */
+            while (timer->due_us <= now)
+                timer->due_us += (long long)timer->interval_ms * 1000;
+            timer->callback(reactor, timer->ctx);
+        }
+    }
+}
+
+void reactor_stop(Reactor *reactor) {
+    platform_mutex_lock(&reactor->lock);
+    platform_atomic_store_release_u64(&reactor->stopped, 1);
+    platform_cond_broadcast(&reactor->cond);
+    platform_mutex_unlock(&reactor->lock);
+}
+
+int reactor_sleep(Reactor *reactor, unsigned int timeout_ms) {
+    long long deadline_us;
+
+    if (reactor == NULL) {
+        platform_sleep_ms(timeout_ms);
+        return 0;
+    }
+
+    deadline_us = platform_monotonic_us() + (long long)timeout_ms * 1000;
+    platform_mutex_lock(&reactor->lock);
+    while (!reactor_stopped(reactor)) {
+        long long left_us = deadline_us - platform_monotonic_us();
+        if (left_us <= 0)
+            break;
+        platform_cond_timedwait_ms(&reactor->cond, &reactor->lock,
+                                   (unsigned int)((left_us + 999) / 1000));
+    }
+    platform_mutex_unlock(&reactor->lock);
+    return reactor_stopped(reactor);
+}
+
+int reactor_wait_readable(Reactor *reactor, NetSocket sock, int timeout_ms) {
+    long long deadline_us;
+
+    if (reactor == NULL)
+        return net_wait_readable(sock, timeout_ms);
+
+    /* No descriptor to wait on for the stop event; check it between slices */
+    deadline_us = platform_monotonic_us() + (long long)timeout_ms * 1000;
+    while (!reactor_stopped(reactor)) {
+        long long left_ms = (deadline_us - platform_monotonic_us()) / 1000;
+        int rc;
+
+        if (left_ms <= 0)
+            return 0;
+        rc = net_wait_readable(sock, left_ms > REACTOR_SIGNAL_POLL_MS
+                                     ? REACTOR_SIGNAL_POLL_MS : (int)left_ms);
+        if (rc != 0)
+            return rc;
+    }
+    return 0;
+}
+
+#endif /* REACTOR_EPOLL */
@@ -0,0 +1,61 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+/*
+ * Event loop for the main thread: periodic timers, signal handling and a
+ * stop event the worker threads can block on.
+ *
+ * On Linux this is epoll over a timerfd per timer, a signalfd and an
+ * eventfd, so an idle process does not wake up at all and a stop request
+ * reaches every waiting thread at once. Elsewhere it falls back to a
+ * condition variable; Windows console events wake it directly, other
+ * POSIX signals are noticed within REACTOR_SIGNAL_POLL_MS.
+ *
+ * Signals must be added before any thread is started: on Linux they are
+ * blocked in the calling thread and delivered only through the signalfd,
+ * and threads inherit the blocked mask when they are created.
+ */
+
+#include "netutil.h"
+
+#define REACTOR_MAX_TIMERS 16
+#define REACTOR_MAX_SIGNALS 8
+#define REACTOR_SIGNAL_POLL_MS 250
+
+typedef struct Reactor Reactor;
+
+typedef void (*ReactorCallback)(Reactor *reactor, void *ctx);
+
+/* NULL on failure */
+Reactor* reactor_create(void);
+
+/* Close the descriptors; the reactor must no longer be in use */
+void reactor_destroy(Reactor *reactor);
+
+/* Call callback every interval_ms from reactor_run(); 0 on success */
+int reactor_add_timer(Reactor *reactor, unsigned int interval_ms,
+                      ReactorCallback callback, void *ctx);
+
+/* Call callback from reactor_run() when signum arrives; 0 on success */
+int reactor_add_signal(Reactor *reactor, int signum, ReactorCallback callback, void *ctx);
+
+/* Dispatch timers and signals until reactor_stop() */
+void reactor_run(Reactor *reactor);
+
+/* Stop the loop and wake every waiter; safe from any thread */
+void reactor_stop(Reactor *reactor);
+
+int reactor_stopped(Reactor *reactor);
+
+/*
+ * Helpers for worker threads. Both accept a NULL reactor and then behave
+ * like platform_sleep_ms() and net_wait_readable().
+ */
+
+/* Sleep up to timeout_ms; returns 1 early once the reactor is stopped */
+int reactor_sleep(Reactor *reactor, unsigned int timeout_ms);
+
+/* 1 = sock readable, 0 = timeout or stopped, -1 = error */
+int reactor_wait_readable(Reactor *reactor, NetSocket sock, int timeout_ms);
+
+#endif /* REACTOR_H */
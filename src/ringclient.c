@@ -3,37 +3,134 @@
  * Derived from the example of the seedlink client from libslink
  */
 #include "ringclient.h"
+#include "platform.h"
+#include "trace.h"
+#include "logger.h"
+#include "archive_source.h"
+#include <math.h>
+
+#ifdef _WIN32
+    #include <io.h>
+    #include <fcntl.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
 
 /* Module-level state */
 static int g_verbose = 0;
 static int g_ring_buffer_minutes = DEFAULT_RING_BUFFER_MINUTES;
 static int g_cleanup_interval = DEFAULT_CLEANUP_INTERVAL;
 static char g_output_dir[512] = ".";
+static int g_latency_threshold = DEFAULT_LATENCY_THRESHOLD;
 
 static StreamSubscription *subscriptions = NULL;
 static int subscription_count = 0;
+static int subscription_capacity = 0;
+static int *subscription_buckets = NULL;    /* Station hash -> first subscription */
+static unsigned int subscription_mask = 0;
 static RingBuffer *ring_buffers = NULL;
 
+/* Metrics shared by all streams (per-stream counters live in RingBuffer) */
+static MetricHistogram *g_collect_wait_metric = NULL;
+static MetricHistogram *g_write_metric = NULL;
+static MetricHistogram *g_cleanup_metric = NULL;
+static MetricCounter *g_rewritten_metric = NULL;
+static MetricGauge *g_streams_metric = NULL;
+static MetricHistogram *g_data_latency_metric = NULL;
+static MetricHistogram *g_receive_write_metric = NULL;
+static MetricCounter *g_duplicate_metric = NULL;
+static MetricCounter *g_unparsable_metric = NULL;
+static MetricCounter *g_reordered_metric = NULL;
+static MetricCounter *g_late_metric = NULL;
+static MetricGauge *g_pending_metric = NULL;
+static MetricCounter *g_gaps_metric = NULL;
+static MetricCounter *g_overlaps_metric = NULL;
+
+/* Reorder window; records held in it, over all rings */
+static int g_reorder_seconds = 0;
+static long g_pending_total = 0;
+
+/* Records fetched for gaps, queued by the backfill worker for the receive thread */
+typedef struct BackfillBatch {
+    char streamid[64];
+    char *records;              /* count records of MSEED_RECORD_SIZE bytes */
+    int count;
+    struct BackfillBatch *next;
+} BackfillBatch;
+
+/* A fetched record on its way into a ring file */
+typedef struct {
+    MSeedHeader hdr;
+    const char *record;
+} BackfillRecord;
+
+static BackfillBatch *g_backfill_head = NULL;
+static BackfillBatch *g_backfill_tail = NULL;
+static volatile int g_backfill_queued = 0;  /* Records in the queue */
+static PlatformMutex g_backfill_lock;
+static MetricCounter *g_backfilled_metric = NULL;
+
 /* Pointer to the config so we can check running flag */
 static volatile int *g_running_ptr = NULL;
 
+/* Cumulative ingest counters, updated on the receive thread only */
+static RingClientStats g_stats;
+
+static RingClientRecordCallback g_record_callbacks[MAX_RECORD_CALLBACKS];
+static void *g_record_callback_ctx[MAX_RECORD_CALLBACKS];
+static int g_record_callback_count = 0;
+
+/* Replay clock for data latency while replaying an archive, 0 = wall clock */
+static volatile double g_replay_now = 0.0;
+
+/*
+ * Record index for ringclient_select(). The receive thread takes the lock
+ * to change the ring list, to index an append and around the cleanup
+ * rename; readers hold it while choosing extents and opening files.
+ */
+static int g_record_index = 0;
+static PlatformMutex g_index_lock;
+static int g_index_lock_ready = 0;
+
 /* Forward declarations for internal functions */
 static void packet_handler(SLCD *slconn, const SLpacketinfo *packetinfo,
-                           const char *payload, uint32_t payloadlength);
+                           const char *payload, uint32_t payloadlength,
+                           long long received_us);
 static void sanitize_selector_for_filename(const char *selector, char *sanitized, size_t len);
-static void create_filename_from_streamid(const char *streamid, const char *selector, 
-                                          char *filename, size_t len);
-static void add_subscription(const char *streamid, const char *selector);
+static int create_filename_from_streamid(const char *streamid, const char *selector, 
+                                         char *filename, size_t len);
+static int add_subscription(const char *streamid, const char *selector);
 static void cleanup_subscriptions(void);
 static const char* find_matching_selector(const char *streamid, const char *loc_channel);
 static void extract_selector_from_miniseed(const char *mseed_record, char *loc_channel, size_t len);
 static double extract_miniseed_time(const char *mseed_record);
+static RingBuffer* find_ringbuffer(const char *streamid, const char *selector);
 static RingBuffer* get_or_create_ringbuffer(const char *streamid, const char *selector);
 static int write_packet_to_ringbuffer(RingBuffer *rb, const char *payload,
-                                      uint32_t payloadlen, double datatime);
+                                      uint32_t payloadlen, const MSeedHeader *hdr);
 static int cleanup_old_records(RingBuffer *rb, double current_time);
 static void ringbuffer_cleanup(void);
-static int load_stream_file(SLCD *slconn, const char *streamfile);
+static int load_subscriptions(SLCD *slconn, const char *streamfile);
+static int subscription_accepts(const char *streamid, const char *loc_channel);
+static int ringclient_run_replay(RingClientConfig *config);
+static void register_metrics(void);
+static void track_latency(RingBuffer *rb, double data_latency, double write_latency);
+static int seen_before(RingBuffer *rb, const MSeedHeader *hdr);
+static void remember_record(RingBuffer *rb, const MSeedHeader *hdr);
+static void forget_record(RingBuffer *rb, const MSeedHeader *hdr);
+static RingChannel* lookup_channel(RingBuffer *rb, const MSeedHeader *hdr);
+static RingChannel* find_channel(RingBuffer *rb, const MSeedHeader *hdr);
+static void update_timeline(RingBuffer *rb, RingChannel *ch, const MSeedHeader *hdr);
+static void update_gap_metrics(RingBuffer *rb);
+static void record_written(RingBuffer *rb, const char *payload, uint32_t payloadlength,
+                           const MSeedHeader *hdr, unsigned long long seqnum,
+                           long long received_us);
+static int hold_for_reorder(RingBuffer *rb, const char *payload, const MSeedHeader *hdr,
+                            unsigned long long seqnum, long long received_us);
+static void flush_pending(long long now_us, int force);
+static void maybe_flush_pending(void);
+static void merge_backfill(void);
 
 /* ============================================================================
  * PUBLIC API IMPLEMENTATION
@@ -49,7 +146,55 @@ void ringclient_init_config(RingClientConfig *config) {
     config->verbose = 0;
     config->ring_buffer_minutes = DEFAULT_RING_BUFFER_MINUTES;
     config->cleanup_interval = DEFAULT_CLEANUP_INTERVAL;
+    config->latency_threshold = DEFAULT_LATENCY_THRESHOLD;
+    config->replay_path[0] = '\0';
+    config->replay_speed = 1.0;
     config->running = 0;
+
+    /* Created here, on the main thread, so readers can select before the first record */
+    if (!g_index_lock_ready) {
+        platform_mutex_init(&g_index_lock);
+        platform_mutex_init(&g_backfill_lock);
+        g_index_lock_ready = 1;
+    }
+}
+
+void ringclient_setup(RingClientConfig *config) {
+    g_verbose = config->verbose;
+    g_ring_buffer_minutes = config->ring_buffer_minutes;
+    g_cleanup_interval = config->cleanup_interval;
+    g_latency_threshold = config->latency_threshold;
+    g_record_index = config->record_index && g_index_lock_ready;
+    g_reorder_seconds = config->reorder_seconds;
+    g_running_ptr = &config->running;
+    snprintf(g_output_dir, sizeof(g_output_dir), "%s", config->output_dir);
+    memset(&g_stats, 0, sizeof(g_stats));
+    register_metrics();
+}
+
+void ringclient_get_stats(RingClientStats *stats) {
+    *stats = g_stats;
+}
+
+void ringclient_set_record_callback(RingClientRecordCallback callback, void *ctx) {
+    g_record_callback_count = 0;
+    if (callback != NULL)
+        ringclient_add_record_callback(callback, ctx);
+}
+
+double ringclient_clock(void) {
+    double replay_now = g_replay_now;
+
+    return replay_now > 0.0 ? replay_now : platform_time_now();
+}
+
+int ringclient_add_record_callback(RingClientRecordCallback callback, void *ctx) {
+    if (g_record_callback_count == MAX_RECORD_CALLBACKS)
+        return -1;
+    g_record_callbacks[g_record_callback_count] = callback;
+    g_record_callback_ctx[g_record_callback_count] = ctx;
+    g_record_callback_count++;
+    return 0;
 }
 
 /* Internal run function - does the actual work */
@@ -62,11 +207,10 @@ static int ringclient_run_internal(RingClientConfig *config) {
     int status;
 
     /* Set module-level configuration */
-    g_verbose = config->verbose;
-    g_ring_buffer_minutes = config->ring_buffer_minutes;
-    g_cleanup_interval = config->cleanup_interval;
-    g_running_ptr = &config->running;
-    strncpy(g_output_dir, config->output_dir, sizeof(g_output_dir) - 1);
+    ringclient_setup(config);
+
+    if (config->replay_path[0] != '\0')
+        return ringclient_run_replay(config);
 
     /* Initialize SeedLink connection */
     slconn = sl_initslcd(PACKAGE, VERSION);
@@ -104,7 +248,7 @@ static int ringclient_run_internal(RingClientConfig *config) {
 
     /* Load stream file if specified */
     if (config->stream_file[0] != '\0') {
-        if (load_stream_file(slconn, config->stream_file) < 0) {
+        if (load_subscriptions(slconn, config->stream_file) < 0) {
             fprintf(stderr, "[RingClient] Failed to load stream file: %s\n", 
                     config->stream_file);
             sl_freeslcd(slconn);
@@ -135,27 +279,57 @@ static int ringclient_run_internal(RingClientConfig *config) {
            g_ring_buffer_minutes);
 
     /* Main collection loop - check config->running flag */
-    while (config->running) {
+    trace_set_thread_name("ringclient");
+
+    /*
+     * Non-blocking collection: when no packet is buffered, wait on the
+     * reactor so a stop request ends the wait at once. A stop is passed
+     * to libslink with sl_terminate(); it closes the link and answers
+     * with SLTERMINATE.
+     */
+    sl_set_blockingmode(slconn, 1);
+    long long wait_start_us = platform_monotonic_us();
+    int terminating = 0;
+
+    for (;;) {
+        if (!config->running && !terminating) {
+            sl_terminate(slconn);
+            terminating = 1;
+        }
+        TRACE_BEGIN(collect_span);
         status = sl_collect(slconn, &packetinfo, plbuffer, plbuffersize);
+        TRACE_END(collect_span, "sl_collect");
         
         if (status == SLPACKET) {
-            packet_handler(slconn, packetinfo, plbuffer, packetinfo->payloadcollected);
+            long long received_us = platform_monotonic_us();
+            metrics_histogram_record(g_collect_wait_metric, received_us - wait_start_us);
+            TRACE_BEGIN(handler_span);
+            packet_handler(slconn, packetinfo, plbuffer, packetinfo->payloadcollected,
+                           received_us);
+            TRACE_END(handler_span, "packet_handler");
+            maybe_flush_pending();
+            merge_backfill();
+            wait_start_us = platform_monotonic_us();
         }
         else if (status == SLTERMINATE) {
-            printf("[RingClient] Received terminate signal from libslink\n");
+            LOG_INFO(LOG_CAT_RINGCLIENT, "Received terminate signal from libslink");
             break;
         }
         else if (status == SLTOOLARGE) {
-            fprintf(stderr, "[RingClient] Payload too large: %u > %u\n",
-                    packetinfo->payloadlength, plbuffersize);
+            LOG_ERROR(LOG_CAT_RINGCLIENT, "Payload too large: %u > %u",
+                      packetinfo->payloadlength, plbuffersize);
             break;
         }
         else if (status == SLAUTHFAIL) {
-            fprintf(stderr, "[RingClient] Authentication failed\n");
+            LOG_ERROR(LOG_CAT_RINGCLIENT, "Authentication failed");
             break;
         }
         else if (status == SLNOPACKET) {
-            sl_usleep(100000);  /* 100ms */
+            /* Short, so libslink's timers keep running and a packet waits little */
+            if (!terminating)
+                reactor_sleep(config->reactor, COLLECT_WAIT_MS);
+            maybe_flush_pending();
+            merge_backfill();
         }
     }
 
@@ -241,6 +415,121 @@ void ringclient_cleanup(void) {
  * INTERNAL FUNCTIONS
  * ============================================================================ */
 
+static void
+register_metrics(void)
+{
+    static int registered = 0;
+
+    if (registered)
+        return;
+    registered = 1;
+
+    g_collect_wait_metric = metrics_histogram("ringclient_collect_wait_seconds", NULL,
+        "Time spent in sl_collect() until a packet arrived");
+    g_write_metric = metrics_histogram("ringclient_write_seconds", NULL,
+        "Time to append one record to its ring file");
+    g_cleanup_metric = metrics_histogram("ringclient_cleanup_seconds", NULL,
+        "Duration of one ring file cleanup pass");
+    g_rewritten_metric = metrics_counter("ringclient_rewritten_bytes_total", NULL,
+        "Bytes copied while trimming ring files or merging backfill");
+    g_streams_metric = metrics_gauge("ringclient_streams", NULL,
+        "Number of ring buffers");
+    g_data_latency_metric = metrics_histogram("ringclient_data_latency_seconds", NULL,
+        "Wall clock minus record end time, all streams");
+    g_receive_write_metric = metrics_histogram("ringclient_receive_to_write_seconds", NULL,
+        "Packet receipt to completed ring file write, all streams");
+    g_duplicate_metric = metrics_counter("ringclient_duplicate_records_total", NULL,
+        "Records dropped as repeats of one already received");
+    g_unparsable_metric = metrics_counter("ringclient_unparsable_records_total", NULL,
+        "Payloads dropped because their miniSEED header could not be parsed");
+    g_reordered_metric = metrics_counter("ringclient_reordered_records_total", NULL,
+        "Records the reorder window wrote ahead of later ones that arrived first");
+    g_late_metric = metrics_counter("ringclient_late_records_total", NULL,
+        "Records written behind a newer record of their channel");
+    g_pending_metric = metrics_gauge("ringclient_reorder_pending", NULL,
+        "Records held by the reorder window");
+    g_gaps_metric = metrics_counter("ringclient_gaps_total", NULL,
+        "Gaps opened in a channel timeline, all streams");
+    g_overlaps_metric = metrics_counter("ringclient_overlaps_total", NULL,
+        "Records overlapping data already in their channel timeline");
+    g_backfilled_metric = metrics_counter("ringclient_backfilled_records_total", NULL,
+        "Fetched records merged into ring files to fill gaps");
+}
+
+static int
+compare_floats(const void *a, const void *b)
+{
+    float fa = *(const float *)a;
+    float fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+/* Percentile q (0..1) of the first n samples */
+static float
+window_percentile(const float *samples, int n, double q)
+{
+    float sorted[LATENCY_WINDOW];
+    int idx;
+
+    if (n <= 0)
+        return 0.0f;
+    memcpy(sorted, samples, n * sizeof(float));
+    qsort(sorted, n, sizeof(float), compare_floats);
+    idx = (int)(q * (n - 1) + 0.5);
+    return sorted[idx];
+}
+
+/*
+ * Record one latency sample. Percentile gauges are refreshed every
+ * quarter window; a stream is flagged late when its median data latency
+ * exceeds the threshold and cleared when it drops back below.
+ */
+static void
+track_latency(RingBuffer *rb, double data_latency, double write_latency)
+{
+    StreamLatency *lat = &rb->latency;
+    float p50;
+
+    metrics_histogram_record(g_data_latency_metric,
+        data_latency > 0 ? (unsigned long long)(data_latency * 1e6) : 0);
+    metrics_histogram_record(g_receive_write_metric,
+        (unsigned long long)(write_latency * 1e6));
+
+    lat->data_latency[lat->next] = (float)data_latency;
+    lat->write_latency[lat->next] = (float)write_latency;
+    lat->next = (lat->next + 1) % LATENCY_WINDOW;
+    if (lat->filled < LATENCY_WINDOW)
+        lat->filled++;
+
+    if (lat->next % (LATENCY_WINDOW / 4) != 0)
+        return;
+
+    p50 = window_percentile(lat->data_latency, lat->filled, 0.50);
+    metrics_gauge_set(lat->data_p50_metric, p50);
+    metrics_gauge_set(lat->data_p99_metric,
+                      window_percentile(lat->data_latency, lat->filled, 0.99));
+    metrics_gauge_set(lat->write_p99_metric,
+                      window_percentile(lat->write_latency, lat->filled, 0.99));
+
+    if (g_latency_threshold <= 0)
+        return;
+
+    if (!lat->late && p50 > g_latency_threshold)
+    {
+        lat->late = 1;
+        metrics_gauge_set(lat->late_metric, 1);
+        LOG_WARN(LOG_CAT_RINGCLIENT, "Warning: %s_%s is late, median latency %.1f s",
+                 rb->streamid, rb->selector, p50);
+    }
+    else if (lat->late && p50 <= g_latency_threshold)
+    {
+        lat->late = 0;
+        metrics_gauge_set(lat->late_metric, 0);
+        LOG_INFO(LOG_CAT_RINGCLIENT, "%s_%s caught up, median latency %.1f s",
+                 rb->streamid, rb->selector, p50);
+    }
+}
+
 static void
 sanitize_selector_for_filename(const char *selector, char *sanitized, size_t len)
 {
@@ -249,8 +538,7 @@ sanitize_selector_for_filename(const char *selector, char *sanitized, size_t len
     if (len == 0)
         return;
     
-    strncpy(sanitized, selector, len - 1);
-    sanitized[len - 1] = '\0';
+    snprintf(sanitized, len, "%s", selector);
     
     for (i = 0; i < strlen(sanitized); i++)
     {
@@ -264,49 +552,117 @@ sanitize_selector_for_filename(const char *selector, char *sanitized, size_t len
     }
 }
 
-static void 
+/* -1 if the name does not fit in len */
+static int 
 create_filename_from_streamid(const char *streamid, const char *selector, 
                               char *filename, size_t len)
 {
     char sanitized_selector[16] = {0};
+    int n;
     
     if (selector && selector[0] != '\0')
     {
         sanitize_selector_for_filename(selector, sanitized_selector, sizeof(sanitized_selector));
-        snprintf(filename, len, "%s/%s_%s.mseed", g_output_dir, streamid, sanitized_selector);
+        n = snprintf(filename, len, "%s/%s_%s.mseed", g_output_dir, streamid, sanitized_selector);
     }
     else
     {
-        snprintf(filename, len, "%s/%s.mseed", g_output_dir, streamid);
+        n = snprintf(filename, len, "%s/%s.mseed", g_output_dir, streamid);
     }
+    return n < 0 || (size_t)n >= len ? -1 : 0;
 }
 
-static void
+static unsigned int
+hash_streamid(const char *streamid)
+{
+    unsigned int h = 2166136261u;
+    
+    while (*streamid)
+        h = (h ^ (unsigned char)*streamid++) * 16777619u;
+    return h;
+}
+
+static int
 add_subscription(const char *streamid, const char *selector)
 {
-    StreamSubscription *new_subs;
+    StreamSubscription *sub;
     
-    new_subs = (StreamSubscription *)realloc(subscriptions, 
-                                             (subscription_count + 1) * sizeof(StreamSubscription));
-    if (new_subs == NULL)
+    /* Grow geometrically so a large stream file loads in linear time */
+    if (subscription_count == subscription_capacity)
     {
-        fprintf(stderr, "[RingClient] Failed to allocate subscription\n");
-        return;
+        int capacity = subscription_capacity ? subscription_capacity * 2 : 64;
+        StreamSubscription *new_subs;
+        
+        new_subs = (StreamSubscription *)realloc(subscriptions, 
+                                                 (size_t)capacity * sizeof(StreamSubscription));
+        if (new_subs == NULL)
+        {
+            fprintf(stderr, "[RingClient] Failed to allocate subscription\n");
+            return -1;
+        }
+        subscriptions = new_subs;
+        subscription_capacity = capacity;
     }
     
-    subscriptions = new_subs;
-    strncpy(subscriptions[subscription_count].streamid, streamid, 
-            sizeof(subscriptions[subscription_count].streamid) - 1);
-    subscriptions[subscription_count].streamid[sizeof(subscriptions[subscription_count].streamid) - 1] = '\0';
-    strncpy(subscriptions[subscription_count].selector, selector, 
-            sizeof(subscriptions[subscription_count].selector) - 1);
-    subscriptions[subscription_count].selector[sizeof(subscriptions[subscription_count].selector) - 1] = '\0';
+    sub = &subscriptions[subscription_count];
+    strncpy(sub->streamid, streamid, sizeof(sub->streamid) - 1);
+    sub->streamid[sizeof(sub->streamid) - 1] = '\0';
+    strncpy(sub->selector, selector, sizeof(sub->selector) - 1);
+    sub->selector[sizeof(sub->selector) - 1] = '\0';
+    sub->next = -1;
     
-    /* Show subscription info at verbose >= 1 */
-    if (g_verbose >= 1)
+    /* Show subscription info at verbose >= 2, one line per channel is a lot */
+    if (g_verbose >= 2)
         printf("[RingClient] Subscription: %s:%s\n", streamid, selector);
     
     subscription_count++;
+    return 0;
+}
+
+/*
+ * Hash the loaded subscriptions by station so per-packet selector lookups
+ * only walk that station's entries. Chains keep file order, which
+ * find_matching_selector() relies on for ties.
+ */
+static int
+build_subscription_index(void)
+{
+    unsigned int buckets = 64;
+    int i;
+    
+    while (buckets < (unsigned int)subscription_count)
+        buckets <<= 1;
+    
+    free(subscription_buckets);
+    subscription_buckets = (int *)malloc(buckets * sizeof(int));
+    if (subscription_buckets == NULL)
+    {
+        fprintf(stderr, "[RingClient] Failed to allocate subscription index\n");
+        subscription_mask = 0;
+        return -1;
+    }
+    subscription_mask = buckets - 1;
+    for (i = 0; i < (int)buckets; i++)
+        subscription_buckets[i] = -1;
+    
+    /* Insert in reverse so each chain ends up in file order */
+    for (i = subscription_count - 1; i >= 0; i--)
+    {
+        unsigned int b = hash_streamid(subscriptions[i].streamid) & subscription_mask;
+        subscriptions[i].next = subscription_buckets[b];
+        subscription_buckets[b] = i;
+    }
+    
+    return 0;
+}
+
+/* First subscription in the station's hash bucket, -1 if none */
+static int
+first_subscription(const char *streamid)
+{
+    if (subscription_buckets == NULL)
+        return -1;
+    return subscription_buckets[hash_streamid(streamid) & subscription_mask];
 }
 
 static void
@@ -317,7 +673,11 @@ cleanup_subscriptions(void)
         free(subscriptions);
         subscriptions = NULL;
     }
+    free(subscription_buckets);
+    subscription_buckets = NULL;
+    subscription_mask = 0;
     subscription_count = 0;
+    subscription_capacity = 0;
 }
 
 static const char*
@@ -329,7 +689,7 @@ find_matching_selector(const char *streamid, const char *loc_channel)
     int best_match_idx = -1;
     int best_wildcard_count = 999;
     
-    for (i = 0; i < subscription_count; i++)
+    for (i = first_subscription(streamid); i >= 0; i = subscriptions[i].next)
     {
         if (strcmp(subscriptions[i].streamid, streamid) != 0)
             continue;
@@ -417,42 +777,105 @@ extract_selector_from_miniseed(const char *mseed_record, char *loc_channel, size
 static double 
 extract_miniseed_time(const char *mseed_record)
 {
-    struct tm timeinfo = {0};
-    unsigned short year, day, fraction;
-    unsigned char hour, minute, second;
-    time_t epoch;
+    /* UTC epoch; the old mktime() variant was shifted by the local zone */
+    return mseed_start_time(mseed_record);
+}
+
+/* Append one record to an index array, growing it geometrically */
+static int
+index_push(RingRecordEntry **index, long *count, long *capacity,
+           const char *record, uint32_t length, long long offset)
+{
+    RingRecordEntry *entry;
+    MSeedHeader hdr;
+    
+    if (*count == *capacity)
+    {
+        long new_capacity = *capacity ? *capacity * 2 : 64;
+        RingRecordEntry *grown = (RingRecordEntry *)realloc(*index,
+            (size_t)new_capacity * sizeof(RingRecordEntry));
+        if (grown == NULL)
+            return -1;
+        *index = grown;
+        *capacity = new_capacity;
+    }
+    
+    entry = &(*index)[*count];
+    memset(entry, 0, sizeof(*entry));
+    entry->offset = offset;
+    entry->length = length;
+    if (mseed_parse_header(record, length, &hdr) == 0)
+    {
+        entry->start_time = hdr.start_time;
+        entry->end_time = hdr.end_time;
+        memcpy(entry->location, hdr.location, sizeof(entry->location));
+        memcpy(entry->channel, hdr.channel, sizeof(entry->channel));
+    }
+    else
+    {
+        entry->start_time = entry->end_time = mseed_start_time(record);
+    }
     
-    year = (unsigned char)mseed_record[20] << 8 | (unsigned char)mseed_record[21];
-    day = (unsigned char)mseed_record[22] << 8 | (unsigned char)mseed_record[23];
-    hour = (unsigned char)mseed_record[24];
-    minute = (unsigned char)mseed_record[25];
-    second = (unsigned char)mseed_record[26];
-    fraction = (unsigned char)mseed_record[27] << 8 | (unsigned char)mseed_record[28];
+    (*count)++;
+    return 0;
+}
+
+/* Index a ring file that already exists when its buffer is created */
+static void
+load_existing_records(RingBuffer *rb)
+{
+    FILE *fp;
+    char record_buffer[MSEED_RECORD_SIZE];
+    long long offset = 0;
+    MSeedHeader hdr;
+    RingChannel *ch;
     
-    timeinfo.tm_year = year - 1900;
-    timeinfo.tm_mon = 0;
-    timeinfo.tm_mday = day;
-    timeinfo.tm_hour = hour;
-    timeinfo.tm_min = minute;
-    timeinfo.tm_sec = second;
-    timeinfo.tm_isdst = -1;
+    fp = fopen(rb->filename, "rb");
+    if (fp == NULL)
+        return;
     
-    epoch = mktime(&timeinfo);
+    while (fread(record_buffer, 1, MSEED_RECORD_SIZE, fp) == MSEED_RECORD_SIZE)
+    {
+        if (g_record_index &&
+            index_push(&rb->index, &rb->index_count, &rb->index_capacity,
+                       record_buffer, MSEED_RECORD_SIZE, offset) < 0)
+            break;
+        if (mseed_parse_header(record_buffer, MSEED_RECORD_SIZE, &hdr) == 0 &&
+            (ch = find_channel(rb, &hdr)) != NULL)
+        {
+            if (hdr.start_time > ch->last_start)
+                ch->last_start = hdr.start_time;
+            update_timeline(rb, ch, &hdr);
+        }
+        offset += MSEED_RECORD_SIZE;
+    }
+    rb->file_size = offset;
     
-    return (double)epoch + (double)fraction * 0.0001;
+    fclose(fp);
 }
 
+/* Existing ring of a stream, or NULL; never creates one */
 static RingBuffer* 
-get_or_create_ringbuffer(const char *streamid, const char *selector)
+find_ringbuffer(const char *streamid, const char *selector)
 {
-    RingBuffer *rb = ring_buffers;
+    RingBuffer *rb;
     
-    while (rb != NULL)
+    for (rb = ring_buffers; rb != NULL; rb = rb->next)
     {
         if (strcmp(rb->streamid, streamid) == 0 && strcmp(rb->selector, selector) == 0)
             return rb;
-        rb = rb->next;
     }
+    return NULL;
+}
+
+static RingBuffer* 
+get_or_create_ringbuffer(const char *streamid, const char *selector)
+{
+    RingBuffer *rb = find_ringbuffer(streamid, selector);
+    char labels[128];
+    
+    if (rb != NULL)
+        return rb;
     
     rb = (RingBuffer *)calloc(1, sizeof(RingBuffer));
     if (rb == NULL)
@@ -461,32 +884,115 @@ get_or_create_ringbuffer(const char *streamid, const char *selector)
         return NULL;
     }
     
-    strncpy(rb->streamid, streamid, sizeof(rb->streamid) - 1);
-    strncpy(rb->selector, selector, sizeof(rb->selector) - 1);
-    create_filename_from_streamid(streamid, selector, rb->filename, sizeof(rb->filename));
+    snprintf(rb->streamid, sizeof(rb->streamid), "%s", streamid);
+    snprintf(rb->selector, sizeof(rb->selector), "%s", selector);
+    if (create_filename_from_streamid(streamid, selector, rb->filename, sizeof(rb->filename)) < 0)
+    {
+        LOG_ERROR(LOG_CAT_RINGCLIENT, "Ring file name for %s_%s is too long", streamid, selector);
+        free(rb);
+        return NULL;
+    }
+    rb->seen = (uint64_t *)calloc(RING_DEDUP_SLOTS, sizeof(uint64_t));
+    
+    /*
+     * Records left from an earlier run are served until the first cleanup,
+     * and seed the timelines so the outage since then shows as a gap
+     */
+    load_existing_records(rb);
     
+    if (g_index_lock_ready)
+        platform_mutex_lock(&g_index_lock);
     rb->next = ring_buffers;
     ring_buffers = rb;
+    if (g_index_lock_ready)
+        platform_mutex_unlock(&g_index_lock);
+
+    snprintf(labels, sizeof(labels), "stream=\"%s_%s\"", streamid, selector);
+    rb->packets_metric = metrics_counter("ringclient_packets_total", labels,
+                                         "Records received per stream");
+    rb->bytes_metric = metrics_counter("ringclient_bytes_total", labels,
+                                       "Payload bytes received per stream");
+    rb->latency.data_p50_metric = metrics_gauge("ringclient_stream_data_latency_p50_seconds",
+        labels, "Rolling median of wall clock minus record end time");
+    rb->latency.data_p99_metric = metrics_gauge("ringclient_stream_data_latency_p99_seconds",
+        labels, "Rolling 99th percentile of wall clock minus record end time");
+    rb->latency.write_p99_metric = metrics_gauge("ringclient_stream_write_latency_p99_seconds",
+        labels, "Rolling 99th percentile of packet receipt to written");
+    rb->latency.late_metric = metrics_gauge("ringclient_stream_late", labels,
+        "1 while the stream median latency exceeds latency_threshold");
+    rb->gaps_metric = metrics_gauge("ringclient_stream_gaps", labels,
+        "Gaps in the stream's channel timelines within the ring retention");
+    rb->missing_metric = metrics_gauge("ringclient_stream_missing_seconds", labels,
+        "Total length of those gaps");
+    update_gap_metrics(rb);
+    metrics_gauge_set(g_streams_metric, metrics_gauge_value(g_streams_metric) + 1);
     
     /* Always show new buffer creation */
-    printf("[RingClient] Created buffer: %s -> %s\n", streamid, rb->filename);
+    LOG_INFO(LOG_CAT_RINGCLIENT, "Created buffer: %s -> %s", streamid, rb->filename);
     
     return rb;
 }
 
+/* Move the rewritten ring file over the old one; 0 on success */
 static int
-cleanup_old_records(RingBuffer *rb, double current_time)
+replace_ring_file(const char *filename, const char *tmp_filename)
+{
+#ifdef _WIN32
+    if (!ReplaceFileA(filename, tmp_filename, NULL, 
+                      REPLACEFILE_IGNORE_MERGE_ERRORS, NULL, NULL))
+    {
+        DWORD error = GetLastError();
+        if (error == ERROR_FILE_NOT_FOUND)
+        {
+            if (rename(tmp_filename, filename) != 0)
+            {
+                remove(tmp_filename);
+                return -1;
+            }
+        }
+        else
+        {
+            remove(tmp_filename);
+            return -1;
+        }
+    }
+#else
+    if (rename(tmp_filename, filename) != 0)
+    {
+        remove(tmp_filename);
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+/*
+ * Copy the ring file without the records older than cutoff_time, merging
+ * in count backfilled records (sorted by start time) ahead of the first
+ * record that starts later. Returns the number of records removed.
+ */
+static int
+rewrite_ring_file(RingBuffer *rb, double cutoff_time, const BackfillRecord *merge, int count)
 {
     FILE *fp = NULL;
     FILE *tmp_fp = NULL;
     char tmp_filename[MAX_FILENAME + 8];
     char record_buffer[MSEED_RECORD_SIZE];
-    double cutoff_time = current_time - (g_ring_buffer_minutes * 60.0);
     long records_kept = 0;
     long records_removed = 0;
+    long long start_us = platform_monotonic_us();
+    RingRecordEntry *new_index = NULL;
+    long new_count = 0;
+    long new_capacity = 0;
+    int status;
+    int have_record;
+    double file_time;
+    double oldest_kept = rb->newest_time;  /* An empty ring spans nothing */
+    int next = 0;
 
     fp = fopen(rb->filename, "rb");
-    if (fp == NULL)
+    if (fp == NULL && count == 0)
         return 0;
 
     snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", rb->filename);
@@ -494,104 +1000,170 @@ cleanup_old_records(RingBuffer *rb, double current_time)
     tmp_fp = fopen(tmp_filename, "wb");
     if (tmp_fp == NULL)
     {
-        fclose(fp);
+        if (fp != NULL)
+            fclose(fp);
         return -1;
     }
 
-    while (fread(record_buffer, 1, MSEED_RECORD_SIZE, fp) == MSEED_RECORD_SIZE)
+    have_record = fp != NULL &&
+                  fread(record_buffer, 1, MSEED_RECORD_SIZE, fp) == MSEED_RECORD_SIZE;
+    file_time = have_record ? extract_miniseed_time(record_buffer) : 0.0;
+
+    while (have_record || next < count)
     {
-        double record_time = extract_miniseed_time(record_buffer);
+        const char *record = record_buffer;
+        double record_time = file_time;
+
+        if (next < count && (!have_record || merge[next].hdr.start_time < file_time))
+        {
+            record = merge[next].record;
+            record_time = merge[next++].hdr.start_time;
+        }
 
         if (record_time >= cutoff_time)
         {
-            if (fwrite(record_buffer, 1, MSEED_RECORD_SIZE, tmp_fp) != MSEED_RECORD_SIZE)
+            if (fwrite(record, 1, MSEED_RECORD_SIZE, tmp_fp) != MSEED_RECORD_SIZE ||
+                (g_record_index &&
+                 index_push(&new_index, &new_count, &new_capacity, record,
+                            MSEED_RECORD_SIZE, (long long)records_kept * MSEED_RECORD_SIZE) < 0))
             {
-                fclose(fp);
+                if (fp != NULL)
+                    fclose(fp);
                 fclose(tmp_fp);
                 remove(tmp_filename);
+                free(new_index);
                 return -1;
             }
             records_kept++;
 
             if (records_kept == 1)
-                rb->oldest_time = record_time;
+                oldest_kept = record_time;
         }
         else
         {
             records_removed++;
         }
+
+        if (record == record_buffer)
+        {
+            have_record = fread(record_buffer, 1, MSEED_RECORD_SIZE, fp) == MSEED_RECORD_SIZE;
+            file_time = have_record ? extract_miniseed_time(record_buffer) : 0.0;
+        }
     }
 
-    fclose(fp);
+    if (fp != NULL)
+        fclose(fp);
     fclose(tmp_fp);
 
-#ifdef _WIN32
-    if (!ReplaceFileA(rb->filename, tmp_filename, NULL, 
-                      REPLACEFILE_IGNORE_MERGE_ERRORS, NULL, NULL))
+    /* Readers must never see the new file with the old index */
+    if (g_record_index)
+        platform_mutex_lock(&g_index_lock);
+    status = replace_ring_file(rb->filename, tmp_filename);
+    if (status == 0 && g_record_index)
     {
-        DWORD error = GetLastError();
-        if (error == ERROR_FILE_NOT_FOUND)
-        {
-            if (rename(tmp_filename, rb->filename) != 0)
-            {
-                remove(tmp_filename);
-                return -1;
-            }
-        }
-        else
-        {
-            remove(tmp_filename);
-            return -1;
-        }
+        free(rb->index);
+        rb->index = new_index;
+        rb->index_count = new_count;
+        rb->index_capacity = new_capacity;
+        rb->file_size = (long long)records_kept * MSEED_RECORD_SIZE;
+        new_index = NULL;
     }
-#else
-    if (rename(tmp_filename, rb->filename) != 0)
-    {
-        remove(tmp_filename);
+    if (g_record_index)
+        platform_mutex_unlock(&g_index_lock);
+    free(new_index);
+    if (status != 0)
         return -1;
-    }
-#endif
 
     rb->record_count = records_kept;
+    rb->oldest_time = oldest_kept;
+
+    /* A backfill merge is not a cleanup run, though it rewrites the file too */
+    if (count > 0)
+    {
+        g_stats.backfill_merges++;
+    }
+    else
+    {
+        g_stats.cleanup_runs++;
+        g_stats.cleanup_us += (unsigned long long)(platform_monotonic_us() - start_us);
+        metrics_histogram_record(g_cleanup_metric, platform_monotonic_us() - start_us);
+    }
+    g_stats.bytes_written += (unsigned long long)records_kept * MSEED_RECORD_SIZE;
+    metrics_counter_add(g_rewritten_metric,
+                        (unsigned long long)records_kept * MSEED_RECORD_SIZE);
 
     /* Show cleanup info at verbose >= 1, but only if records were removed */
     if (records_removed > 0 && g_verbose >= 1)
     {
-        printf("[RingClient] Cleaned %ld old records from %s (kept %ld)\n", 
-               records_removed, rb->filename, records_kept);
+        LOG_INFO(LOG_CAT_RINGCLIENT, "Cleaned %ld old records from %s (kept %ld)",
+                 records_removed, rb->filename, records_kept);
     }
 
     return (int)records_removed;
 }
 
+static int
+cleanup_old_records(RingBuffer *rb, double current_time)
+{
+    return rewrite_ring_file(rb, current_time - (g_ring_buffer_minutes * 60.0), NULL, 0);
+}
+
 static int 
 write_packet_to_ringbuffer(RingBuffer *rb, const char *payload, 
-                           uint32_t payloadlen, double datatime)
+                           uint32_t payloadlen, const MSeedHeader *hdr)
 {
     FILE *fp = NULL;
+    long long start_us;
+    long long end_offset;
+    double datatime = hdr->start_time;
+    RingChannel *ch;
     
     /* Use configurable cleanup interval */
     if (g_cleanup_interval > 0 && rb->record_count % g_cleanup_interval == 0)
     {
+        TRACE_BEGIN(cleanup_span);
         cleanup_old_records(rb, datatime);
+        TRACE_END(cleanup_span, "cleanup_old_records");
     }
     
+    start_us = platform_monotonic_us();
     fp = fopen(rb->filename, "ab");
     if (fp == NULL)
     {
-        fprintf(stderr, "[RingClient] Failed to open %s\n", rb->filename);
+        LOG_ERROR(LOG_CAT_RINGCLIENT, "Failed to open %s", rb->filename);
         return -1;
     }
     
     if (fwrite(payload, 1, payloadlen, fp) != payloadlen)
     {
-        fprintf(stderr, "[RingClient] Failed to write to %s\n", rb->filename);
+        LOG_ERROR(LOG_CAT_RINGCLIENT, "Failed to write to %s", rb->filename);
         fclose(fp);
         return -1;
     }
     
+    end_offset = (long long)ftell(fp);
     fclose(fp);
     
+    if (g_record_index && end_offset >= (long long)payloadlen)
+    {
+        platform_mutex_lock(&g_index_lock);
+        if (index_push(&rb->index, &rb->index_count, &rb->index_capacity,
+                       payload, payloadlen, end_offset - payloadlen) == 0)
+            rb->file_size = end_offset;
+        platform_mutex_unlock(&g_index_lock);
+    }
+    metrics_histogram_record(g_write_metric, platform_monotonic_us() - start_us);
+    if ((ch = find_channel(rb, hdr)) != NULL)
+    {
+        if (hdr->start_time < ch->last_start)
+            metrics_counter_add(g_late_metric, 1);
+        else
+            ch->last_start = hdr->start_time;
+        update_timeline(rb, ch, hdr);
+    }
+    metrics_counter_add(rb->packets_metric, 1);
+    metrics_counter_add(rb->bytes_metric, payloadlen);
+    
     rb->newest_time = datatime;
     if (rb->record_count == 0)
         rb->oldest_time = datatime;
@@ -600,36 +1172,976 @@ write_packet_to_ringbuffer(RingBuffer *rb, const char *payload,
     return 0;
 }
 
-static void 
-ringbuffer_cleanup(void)
+/* Channel, start time (microseconds) and sample count, mixed into 64 bits */
+static uint64_t
+record_fingerprint(const MSeedHeader *hdr)
 {
-    RingBuffer *rb = ring_buffers;
-    RingBuffer *next = NULL;
+    uint64_t h = 14695981039346656037ULL;
+    long long start_us = llround(hdr->start_time * 1e6);
+    const char *p;
+    int i;
     
-    while (rb != NULL)
-    {
-        next = rb->next;
-        
-        printf("[RingClient] Final: %s - %ld records, %.1f min\n",
-               rb->streamid, rb->record_count,
-               (rb->newest_time - rb->oldest_time) / 60.0);
-        
-        free(rb);
-        rb = next;
-    }
+    for (p = hdr->location; *p; p++)
+        h = (h ^ (unsigned char)*p) * 1099511628211ULL;
+    h = (h ^ '.') * 1099511628211ULL;
+    for (p = hdr->channel; *p; p++)
+        h = (h ^ (unsigned char)*p) * 1099511628211ULL;
+    for (i = 0; i < 8; i++)
+        h = (h ^ (unsigned char)(start_us >> (8 * i))) * 1099511628211ULL;
+    h = (h ^ (unsigned int)hdr->sample_count) * 1099511628211ULL;
     
-    ring_buffers = NULL;
+    /* Spread the bits so the low ones can pick the slot */
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h != 0 ? h : 1;
 }
 
+/*
+ * 1 if the ring took this record before. The table is 4-way set
+ * associative with the newest fingerprint first in each bucket, so a check
+ * reads one 32-byte bucket; a fingerprint is forgotten only after four
+ * newer records land in its bucket, far more than a reconnect redelivers.
+ */
 static int
-load_stream_file(SLCD *slconn, const char *streamfile)
+seen_before(RingBuffer *rb, const MSeedHeader *hdr)
+{
+    uint64_t fingerprint;
+    uint64_t *bucket;
+    int i;
+    
+    if (rb->seen == NULL)
+        return 0;
+    
+    fingerprint = record_fingerprint(hdr);
+    bucket = &rb->seen[(fingerprint & (RING_DEDUP_SLOTS / 4 - 1)) * 4];
+    for (i = 0; i < 4; i++)
+    {
+        if (bucket[i] == fingerprint)
+            return 1;
+    }
+    return 0;
+}
+
+/* Note a record the ring took; only after it was written or held for reorder */
+static void
+remember_record(RingBuffer *rb, const MSeedHeader *hdr)
+{
+    uint64_t fingerprint;
+    uint64_t *bucket;
+    
+    if (rb->seen == NULL)
+        return;
+    
+    fingerprint = record_fingerprint(hdr);
+    bucket = &rb->seen[(fingerprint & (RING_DEDUP_SLOTS / 4 - 1)) * 4];
+    memmove(bucket + 1, bucket, 3 * sizeof(uint64_t));
+    bucket[0] = fingerprint;
+}
+
+/* Undo remember_record() for a held record that failed to write */
+static void
+forget_record(RingBuffer *rb, const MSeedHeader *hdr)
+{
+    uint64_t fingerprint;
+    uint64_t *bucket;
+    int i;
+    
+    if (rb->seen == NULL)
+        return;
+    
+    fingerprint = record_fingerprint(hdr);
+    bucket = &rb->seen[(fingerprint & (RING_DEDUP_SLOTS / 4 - 1)) * 4];
+    for (i = 0; i < 4; i++)
+    {
+        if (bucket[i] == fingerprint)
+        {
+            memmove(bucket + i, bucket + i + 1, (size_t)(3 - i) * sizeof(uint64_t));
+            bucket[3] = 0;
+            return;
+        }
+    }
+}
+
+/* The record's channel in a ring if it has one; never adds it */
+static RingChannel*
+lookup_channel(RingBuffer *rb, const MSeedHeader *hdr)
+{
+    int i;
+    
+    for (i = 0; i < rb->channel_count; i++)
+    {
+        if (strcmp(rb->channels[i].channel, hdr->channel) == 0 &&
+            strcmp(rb->channels[i].location, hdr->location) == 0)
+            return &rb->channels[i];
+    }
+    return NULL;
+}
+
+/* The record's channel in a ring, added on first sight; NULL without memory */
+static RingChannel*
+find_channel(RingBuffer *rb, const MSeedHeader *hdr)
+{
+    RingChannel *grown;
+    RingChannel *ch = lookup_channel(rb, hdr);
+    
+    if (ch != NULL)
+        return ch;
+    
+    /* Gap readers walk the channels, so they move under the lock */
+    if (g_index_lock_ready)
+        platform_mutex_lock(&g_index_lock);
+    grown = (RingChannel *)realloc(rb->channels,
+        (size_t)(rb->channel_count + 1) * sizeof(RingChannel));
+    if (grown != NULL)
+    {
+        rb->channels = grown;
+        ch = &rb->channels[rb->channel_count++];
+        memset(ch, 0, sizeof(*ch));
+        memcpy(ch->location, hdr->location, sizeof(ch->location));
+        memcpy(ch->channel, hdr->channel, sizeof(ch->channel));
+        ch->last_start = hdr->start_time;
+        ch->segments = (RingSegment *)malloc(RING_TIMELINE_SEGMENTS * sizeof(RingSegment));
+    }
+    if (g_index_lock_ready)
+        platform_mutex_unlock(&g_index_lock);
+    
+    return grown != NULL ? ch : NULL;
+}
+
+/*
+ * Merge [start, end) into a channel timeline; spans less than tolerance
+ * apart join. Records nearly always extend the newest span, so the search
+ * from the newest end stops at once. A record older than every span of a
+ * full timeline is not tracked. Returns 1 if the record overlapped data
+ * already there.
+ */
+static int
+timeline_add(RingChannel *ch, double start, double end, double tolerance)
+{
+    RingSegment *seg = ch->segments;
+    int i = ch->segment_count;
+    int j;
+    int overlap = 0;
+    
+    while (i > 0 && seg[i - 1].end + tolerance >= start)
+        i--;
+    
+    for (j = i; j < ch->segment_count && seg[j].start - tolerance <= end; j++)
+    {
+        double lo = start > seg[j].start ? start : seg[j].start;
+        double hi = end < seg[j].end ? end : seg[j].end;
+        
+        if (hi - lo > tolerance)
+            overlap = 1;
+        if (seg[j].start < start)
+            start = seg[j].start;
+        if (seg[j].end > end)
+            end = seg[j].end;
+    }
+    
+    if (j == i)
+    {
+        /* A new span; a full timeline forgets its oldest one */
+        if (ch->segment_count == RING_TIMELINE_SEGMENTS)
+        {
+            if (i == 0)
+                return 0;
+            memmove(seg, seg + 1, (size_t)(ch->segment_count - 1) * sizeof(RingSegment));
+            ch->segment_count--;
+            i--;
+        }
+        memmove(seg + i + 1, seg + i, (size_t)(ch->segment_count - i) * sizeof(RingSegment));
+        ch->segment_count++;
+    }
+    else if (j > i + 1)
+    {
+        /* The record bridged one or more gaps */
+        memmove(seg + i + 1, seg + j, (size_t)(ch->segment_count - j) * sizeof(RingSegment));
+        ch->segment_count -= j - i - 1;
+    }
+    
+    seg[i].start = start;
+    seg[i].end = end;
+    return overlap;
+}
+
+/* Oldest time still in a channel's ring retention */
+static double
+timeline_cutoff(const RingChannel *ch)
+{
+    return ch->segments[ch->segment_count - 1].end - g_ring_buffer_minutes * 60.0;
+}
+
+/* Gap count and missing seconds of a ring, as of its last timeline change */
+static void
+update_gap_metrics(RingBuffer *rb)
+{
+    double missing = 0.0;
+    int gaps = 0;
+    int c;
+    int i;
+    
+    for (c = 0; c < rb->channel_count; c++)
+    {
+        RingChannel *ch = &rb->channels[c];
+        double cutoff;
+        
+        if (ch->segment_count == 0)
+            continue;
+        cutoff = timeline_cutoff(ch);
+        for (i = 1; i < ch->segment_count; i++)
+        {
+            double start = ch->segments[i - 1].end;
+            
+            if (start < cutoff)
+                start = cutoff;
+            if (ch->segments[i].start > start)
+            {
+                gaps++;
+                missing += ch->segments[i].start - start;
+            }
+        }
+    }
+    metrics_gauge_set(rb->gaps_metric, (double)gaps);
+    metrics_gauge_set(rb->missing_metric, missing);
+}
+
+/*
+ * Add a written record to its channel timeline and drop the spans whose
+ * following gap aged out of the retention
+ */
+static void
+update_timeline(RingBuffer *rb, RingChannel *ch, const MSeedHeader *hdr)
+{
+    RingSegment *seg = ch->segments;
+    int before;
+    int overlap;
+    int n = 0;
+    
+    if (seg == NULL || hdr->sample_rate <= 0.0 || hdr->sample_count <= 0)
+        return;
+    
+    if (g_index_lock_ready)
+        platform_mutex_lock(&g_index_lock);
+    before = ch->segment_count;
+    overlap = timeline_add(ch, hdr->start_time, hdr->end_time, 0.5 / hdr->sample_rate);
+    /* A channel's first span is not a gap */
+    if (before > 0 && ch->segment_count > before)
+        metrics_counter_add(g_gaps_metric, (unsigned long long)(ch->segment_count - before));
+    while (n + 1 < ch->segment_count && seg[n + 1].start <= timeline_cutoff(ch))
+        n++;
+    if (n > 0)
+    {
+        ch->segment_count -= n;
+        memmove(seg, seg + n, (size_t)ch->segment_count * sizeof(RingSegment));
+    }
+    if (g_index_lock_ready)
+        platform_mutex_unlock(&g_index_lock);
+    
+    if (overlap)
+        metrics_counter_add(g_overlaps_metric, 1);
+    if (ch->segment_count != before || n > 0)
+        update_gap_metrics(rb);
+}
+
+/*
+ * A record reached its ring file: measure its latency and pass it on.
+ * Held records get here when the reorder window releases them, so sinks
+ * and callbacks see records in written order and the write latency
+ * includes the hold.
+ */
+static void
+record_written(RingBuffer *rb, const char *payload, uint32_t payloadlength,
+               const MSeedHeader *hdr, unsigned long long seqnum, long long received_us)
+{
+    int i;
+    
+    g_stats.bytes_written += payloadlength;
+    
+    track_latency(rb, ringclient_clock() - hdr->end_time,
+                  (platform_monotonic_us() - received_us) / 1e6);
+    
+    for (i = 0; i < g_record_callback_count; i++)
+        g_record_callbacks[i](rb->streamid, payload, payloadlength, hdr, seqnum,
+                              g_record_callback_ctx[i]);
+}
+
+/*
+ * Write out held records, oldest first, once they are reorder_seconds older
+ * than the newest one held or have been held that long (all with force)
+ */
+static void
+commit_pending(RingBuffer *rb, long long now_us, int force)
+{
+    long long hold_us = (long long)g_reorder_seconds * 1000000;
+    double newest;
+    int n = 0;
+    
+    if (rb->pending_count == 0)
+        return;
+    newest = rb->pending[rb->pending_count - 1].hdr.start_time;
+    
+    while (n < rb->pending_count)
+    {
+        PendingRecord *pr = &rb->pending[n];
+        
+        if (!force && newest - pr->hdr.start_time < g_reorder_seconds &&
+            now_us - pr->received_us < hold_us)
+            break;
+        if (write_packet_to_ringbuffer(rb, pr->record, MSEED_RECORD_SIZE, &pr->hdr) == 0)
+            record_written(rb, pr->record, MSEED_RECORD_SIZE, &pr->hdr, pr->seqnum,
+                           pr->received_us);
+        else
+            forget_record(rb, &pr->hdr);
+        n++;
+    }
+    
+    if (n > 0)
+    {
+        rb->pending_count -= n;
+        memmove(rb->pending, rb->pending + n, (size_t)rb->pending_count * sizeof(PendingRecord));
+        g_pending_total -= n;
+        metrics_gauge_set(g_pending_metric, (double)g_pending_total);
+    }
+}
+
+/* Insert a record into the reorder window by start time, then commit what is due */
+static int
+hold_for_reorder(RingBuffer *rb, const char *payload, const MSeedHeader *hdr,
+                 unsigned long long seqnum, long long received_us)
+{
+    PendingRecord *pr;
+    int i;
+    
+    if (rb->pending_count == rb->pending_capacity)
+    {
+        int capacity = rb->pending_capacity ? rb->pending_capacity * 2 : 16;
+        PendingRecord *grown = (PendingRecord *)realloc(rb->pending,
+            (size_t)capacity * sizeof(PendingRecord));
+        if (grown == NULL)
+        {
+            if (write_packet_to_ringbuffer(rb, payload, MSEED_RECORD_SIZE, hdr) != 0)
+                return -1;
+            remember_record(rb, hdr);
+            record_written(rb, payload, MSEED_RECORD_SIZE, hdr, seqnum, received_us);
+            return 0;
+        }
+        rb->pending = grown;
+        rb->pending_capacity = capacity;
+    }
+    
+    /* Records nearly always arrive in order, so search from the newest end */
+    i = rb->pending_count;
+    while (i > 0 && rb->pending[i - 1].hdr.start_time > hdr->start_time)
+        i--;
+    if (i < rb->pending_count)
+    {
+        memmove(rb->pending + i + 1, rb->pending + i,
+                (size_t)(rb->pending_count - i) * sizeof(PendingRecord));
+        metrics_counter_add(g_reordered_metric, 1);
+    }
+    
+    pr = &rb->pending[i];
+    pr->hdr = *hdr;
+    pr->received_us = received_us;
+    pr->seqnum = seqnum;
+    memcpy(pr->record, payload, MSEED_RECORD_SIZE);
+    rb->pending_count++;
+    g_pending_total++;
+    metrics_gauge_set(g_pending_metric, (double)g_pending_total);
+    
+    /* Held counts as taken, so a redelivery while it waits is dropped too */
+    remember_record(rb, hdr);
+    commit_pending(rb, received_us, 0);
+    return 0;
+}
+
+static void
+flush_pending(long long now_us, int force)
+{
+    RingBuffer *rb;
+    
+    for (rb = ring_buffers; rb != NULL && g_pending_total > 0; rb = rb->next)
+        commit_pending(rb, now_us, force);
+}
+
+/* Once a second, so rings whose stream went quiet still empty their window */
+static void
+maybe_flush_pending(void)
+{
+    static long long last_us = 0;
+    long long now_us;
+    
+    if (g_pending_total == 0)
+        return;
+    now_us = platform_monotonic_us();
+    if (now_us - last_us < 1000000)
+        return;
+    last_us = now_us;
+    flush_pending(now_us, 0);
+}
+
+/* 1 if a span of the channel timeline already holds [start, end) */
+static int
+timeline_covers(const RingChannel *ch, double start, double end, double tolerance)
+{
+    int i;
+    
+    for (i = ch->segment_count - 1; i >= 0; i--)
+    {
+        if (ch->segments[i].start - tolerance <= start)
+            return end <= ch->segments[i].end + tolerance;
+    }
+    return 0;
+}
+
+static int
+compare_backfill_records(const void *a, const void *b)
+{
+    double ta = ((const BackfillRecord *)a)->hdr.start_time;
+    double tb = ((const BackfillRecord *)b)->hdr.start_time;
+    
+    return ta < tb ? -1 : ta > tb;
+}
+
+/*
+ * Merge one fetched batch into its ring: records the ring holds already or
+ * that aged out are dropped, the rest go in by start time with one file
+ * rewrite, as cleanup does
+ */
+static void
+merge_batch(const BackfillBatch *batch)
+{
+    BackfillRecord *merge;
+    RingBuffer *rb = NULL;
+    RingChannel *ch = NULL;
+    char loc_channel[16] = {0};
+    char selector[16] = {0};
+    double cutoff;
+    int count = 0;
+    int kept = 0;
+    int i;
+    
+    merge = (BackfillRecord *)malloc((size_t)batch->count * sizeof(BackfillRecord));
+    if (merge == NULL)
+        return;
+    
+    for (i = 0; i < batch->count; i++)
+    {
+        BackfillRecord *br = &merge[count];
+        
+        br->record = batch->records + (size_t)i * MSEED_RECORD_SIZE;
+        if (mseed_parse_header(br->record, MSEED_RECORD_SIZE, &br->hdr) < 0 ||
+            br->hdr.sample_rate <= 0.0 || br->hdr.sample_count <= 0)
+            continue;
+        
+        /*
+         * A batch fills one channel; its first record picks the ring. Gaps
+         * are only found in channels that have data, so a batch for a ring
+         * or channel that is gone (or never existed) is dropped
+         */
+        if (rb == NULL)
+        {
+            extract_selector_from_miniseed(br->record, loc_channel, sizeof(loc_channel));
+            strncpy(selector, find_matching_selector(batch->streamid, loc_channel),
+                    sizeof(selector) - 1);
+            rb = find_ringbuffer(batch->streamid, selector);
+            if (rb == NULL || (ch = lookup_channel(rb, &br->hdr)) == NULL)
+                break;
+        }
+        else if (strcmp(br->hdr.channel, ch->channel) != 0 ||
+                 strcmp(br->hdr.location, ch->location) != 0)
+        {
+            continue;
+        }
+        count++;
+    }
+    
+    if (ch == NULL || ch->segment_count == 0)
+    {
+        free(merge);
+        return;
+    }
+    
+    qsort(merge, (size_t)count, sizeof(BackfillRecord), compare_backfill_records);
+    cutoff = timeline_cutoff(ch);
+    for (i = 0; i < count; i++)
+    {
+        const MSeedHeader *hdr = &merge[i].hdr;
+        
+        if (hdr->start_time < cutoff ||
+            timeline_covers(ch, hdr->start_time, hdr->end_time, 0.5 / hdr->sample_rate) ||
+            seen_before(rb, hdr) ||
+            (kept > 0 && record_fingerprint(hdr) == record_fingerprint(&merge[kept - 1].hdr)))
+            continue;
+        merge[kept++] = merge[i];
+    }
+    
+    if (kept > 0 &&
+        rewrite_ring_file(rb, rb->newest_time - (g_ring_buffer_minutes * 60.0), merge, kept) >= 0)
+    {
+        for (i = 0; i < kept; i++)
+        {
+            update_timeline(rb, ch, &merge[i].hdr);
+            remember_record(rb, &merge[i].hdr);
+        }
+        metrics_counter_add(g_backfilled_metric, (unsigned long long)kept);
+        LOG_INFO(LOG_CAT_RINGCLIENT, "Backfilled %d records into %s", kept, rb->filename);
+    }
+    free(merge);
+}
+
+/* Between packets: merge one queued batch, so a large backfill never stalls ingest for long */
+static void
+merge_backfill(void)
+{
+    BackfillBatch *batch;
+    
+    if (g_backfill_queued == 0)
+        return;
+    
+    platform_mutex_lock(&g_backfill_lock);
+    batch = g_backfill_head;
+    if (batch != NULL)
+    {
+        g_backfill_head = batch->next;
+        if (g_backfill_head == NULL)
+            g_backfill_tail = NULL;
+        g_backfill_queued -= batch->count;
+    }
+    platform_mutex_unlock(&g_backfill_lock);
+    
+    if (batch == NULL)
+        return;
+    merge_batch(batch);
+    free(batch->records);
+    free(batch);
+}
+
+/* Drop whatever the backfill worker queued and the receive thread did not merge */
+static void
+discard_backfill(void)
+{
+    BackfillBatch *batch;
+    
+    if (!g_index_lock_ready)
+        return;
+    platform_mutex_lock(&g_backfill_lock);
+    while ((batch = g_backfill_head) != NULL)
+    {
+        g_backfill_head = batch->next;
+        free(batch->records);
+        free(batch);
+    }
+    g_backfill_tail = NULL;
+    g_backfill_queued = 0;
+    platform_mutex_unlock(&g_backfill_lock);
+}
+
+static void 
+ringbuffer_cleanup(void)
+{
+    RingBuffer *rb;
+    RingBuffer *next = NULL;
+    int i;
+    
+    /* Whatever the reorder window still holds goes to disk first */
+    flush_pending(platform_monotonic_us(), 1);
+    discard_backfill();
+    
+    if (g_index_lock_ready)
+        platform_mutex_lock(&g_index_lock);
+    rb = ring_buffers;
+    
+    while (rb != NULL)
+    {
+        next = rb->next;
+        
+        LOG_INFO(LOG_CAT_RINGCLIENT, "Final: %s - %ld records, %.1f min",
+                 rb->streamid, rb->record_count,
+                 (rb->newest_time - rb->oldest_time) / 60.0);
+        
+        free(rb->index);
+        free(rb->seen);
+        for (i = 0; i < rb->channel_count; i++)
+            free(rb->channels[i].segments);
+        free(rb->channels);
+        free(rb->pending);
+        free(rb);
+        rb = next;
+    }
+    
+    ring_buffers = NULL;
+    if (g_index_lock_ready)
+        platform_mutex_unlock(&g_index_lock);
+}
+
+static int
+open_ring_readonly(const char *filename)
+{
+#ifdef _WIN32
+    /* Share delete so the cleanup ReplaceFileA() still succeeds while a reader holds it */
+    HANDLE h = CreateFileA(filename, GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    int fd;
+    
+    if (h == INVALID_HANDLE_VALUE)
+        return -1;
+    fd = _open_osfhandle((intptr_t)h, _O_RDONLY | _O_BINARY);
+    if (fd < 0)
+        CloseHandle(h);
+    return fd;
+#else
+    return open(filename, O_RDONLY);
+#endif
+}
+
+static int
+selection_add(RingSelection *selection, int file, long long offset, long long length)
+{
+    RingExtent *last = selection->extent_count > 0 ?
+                       &selection->extents[selection->extent_count - 1] : NULL;
+    
+    selection->total_bytes += length;
+    if (last != NULL && last->file == file && last->offset + last->length == offset)
+    {
+        last->length += length;
+        return 0;
+    }
+    
+    if (selection->extent_count == selection->extent_capacity)
+    {
+        int capacity = selection->extent_capacity ? selection->extent_capacity * 2 : 64;
+        RingExtent *grown = (RingExtent *)realloc(selection->extents,
+                                                  (size_t)capacity * sizeof(RingExtent));
+        if (grown == NULL)
+            return -1;
+        selection->extents = grown;
+        selection->extent_capacity = capacity;
+    }
+    
+    selection->extents[selection->extent_count].file = file;
+    selection->extents[selection->extent_count].offset = offset;
+    selection->extents[selection->extent_count].length = length;
+    selection->extent_count++;
+    return 0;
+}
+
+static int
+selection_add_file(RingSelection *selection, int fd)
+{
+    if (selection->fd_count == selection->fd_capacity)
+    {
+        int capacity = selection->fd_capacity ? selection->fd_capacity * 2 : 16;
+        int *grown = (int *)realloc(selection->fds, (size_t)capacity * sizeof(int));
+        if (grown == NULL)
+            return -1;
+        selection->fds = grown;
+        selection->fd_capacity = capacity;
+    }
+    
+    selection->fds[selection->fd_count] = fd;
+    return selection->fd_count++;
+}
+
+int
+ringclient_select(RingRecordFilter filter, void *ctx, double start_time,
+                  double end_time, RingSelection *selection)
+{
+    RingBuffer *rb;
+    int status = 0;
+    
+    if (!g_record_index)
+        return 0;
+    
+    platform_mutex_lock(&g_index_lock);
+    
+    for (rb = ring_buffers; rb != NULL && status == 0; rb = rb->next)
+    {
+        char network[16];
+        const char *station;
+        const char *sep = strchr(rb->streamid, '_');
+        int file = -1;
+        long i;
+        
+        if (sep == NULL || (size_t)(sep - rb->streamid) >= sizeof(network))
+            continue;
+        memcpy(network, rb->streamid, (size_t)(sep - rb->streamid));
+        network[sep - rb->streamid] = '\0';
+        station = sep + 1;
+        
+        for (i = 0; i < rb->index_count; i++)
+        {
+            const RingRecordEntry *entry = &rb->index[i];
+            
+            if (end_time > 0.0 && entry->start_time > end_time)
+                continue;
+            if (start_time > 0.0 && entry->end_time <= start_time)
+                continue;
+            if (filter != NULL &&
+                !filter(network, station, entry->location, entry->channel, ctx))
+                continue;
+            
+            /* Open the file while holding the lock so it matches the index */
+            if (file < 0)
+            {
+                int fd = open_ring_readonly(rb->filename);
+                if (fd < 0)
+                    break;
+                file = selection_add_file(selection, fd);
+                if (file < 0)
+                {
+#ifdef _WIN32
+                    _close(fd);
+#else
+                    close(fd);
+#endif
+                    status = -1;
+                    break;
+                }
+            }
+            
+            if (selection_add(selection, file, entry->offset, entry->length) < 0)
+            {
+                status = -1;
+                break;
+            }
+        }
+    }
+    
+    platform_mutex_unlock(&g_index_lock);
+    return status;
+}
+
+void
+ringclient_selection_free(RingSelection *selection)
+{
+    int i;
+    
+    for (i = 0; i < selection->fd_count; i++)
+    {
+#ifdef _WIN32
+        _close(selection->fds[i]);
+#else
+        close(selection->fds[i]);
+#endif
+    }
+    free(selection->fds);
+    free(selection->extents);
+    memset(selection, 0, sizeof(*selection));
+}
+
+int
+ringclient_gaps(RingGap *gaps, int max)
+{
+    RingBuffer *rb;
+    int total = 0;
+    int c;
+    int i;
+    
+    if (!g_index_lock_ready)
+        return 0;
+    
+    platform_mutex_lock(&g_index_lock);
+    for (rb = ring_buffers; rb != NULL; rb = rb->next)
+    {
+        for (c = 0; c < rb->channel_count; c++)
+        {
+            RingChannel *ch = &rb->channels[c];
+            double cutoff;
+            
+            if (ch->segment_count == 0)
+                continue;
+            cutoff = timeline_cutoff(ch);
+            for (i = 1; i < ch->segment_count; i++)
+            {
+                double start = ch->segments[i - 1].end;
+                
+                if (start < cutoff)
+                    start = cutoff;
+                if (ch->segments[i].start <= start)
+                    continue;
+                if (total < max)
+                {
+                    RingGap *gap = &gaps[total];
+                    
+                    strncpy(gap->streamid, rb->streamid, sizeof(gap->streamid) - 1);
+                    gap->streamid[sizeof(gap->streamid) - 1] = '\0';
+                    memcpy(gap->location, ch->location, sizeof(gap->location));
+                    memcpy(gap->channel, ch->channel, sizeof(gap->channel));
+                    gap->start = start;
+                    gap->end = ch->segments[i].start;
+                }
+                total++;
+            }
+        }
+    }
+    platform_mutex_unlock(&g_index_lock);
+    
+    return total;
+}
+
+int
+ringclient_backfill(const char *streamid, const char *records, int count)
+{
+    BackfillBatch *batch;
+    int queued = 0;
+    
+    if (!g_index_lock_ready || count <= 0 || g_backfill_queued + count > RING_BACKFILL_QUEUE)
+        return -1;
+    
+    batch = (BackfillBatch *)calloc(1, sizeof(BackfillBatch));
+    if (batch == NULL)
+        return -1;
+    batch->records = (char *)malloc((size_t)count * MSEED_RECORD_SIZE);
+    if (batch->records == NULL)
+    {
+        free(batch);
+        return -1;
+    }
+    strncpy(batch->streamid, streamid, sizeof(batch->streamid) - 1);
+    memcpy(batch->records, records, (size_t)count * MSEED_RECORD_SIZE);
+    batch->count = count;
+    
+    platform_mutex_lock(&g_backfill_lock);
+    if (g_backfill_queued + count <= RING_BACKFILL_QUEUE)
+    {
+        if (g_backfill_tail != NULL)
+            g_backfill_tail->next = batch;
+        else
+            g_backfill_head = batch;
+        g_backfill_tail = batch;
+        g_backfill_queued += count;
+        queued = 1;
+    }
+    platform_mutex_unlock(&g_backfill_lock);
+    
+    if (!queued)
+    {
+        free(batch->records);
+        free(batch);
+        return -1;
+    }
+    return 0;
+}
+
+int
+ringclient_write_gap_file(const char *path)
+{
+    char tmp_path[600];
+    char start[MSEED_TIME_STRING_SIZE];
+    char end[MSEED_TIME_STRING_SIZE];
+    RingGap *gaps = NULL;
+    FILE *fp;
+    int count;
+    int found;
+    int i;
+    
+    /* The gaps may change between sizing and copying; take what fits */
+    count = ringclient_gaps(NULL, 0);
+    if (count > 0)
+    {
+        gaps = (RingGap *)malloc((size_t)count * sizeof(RingGap));
+        if (gaps == NULL)
+            return -1;
+        found = ringclient_gaps(gaps, count);
+        if (found < count)
+            count = found;
+    }
+    
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    fp = fopen(tmp_path, "w");
+    if (fp == NULL)
+    {
+        LOG_ERROR(LOG_CAT_RINGCLIENT, "Failed to open %s", tmp_path);
+        free(gaps);
+        return -1;
+    }
+    
+    fprintf(fp, "# Gaps within the ring buffers, UTC: NET_STA LOC CHA START END SECONDS\n");
+    for (i = 0; i < count; i++)
+    {
+        mseed_format_time(gaps[i].start, start, sizeof(start));
+        mseed_format_time(gaps[i].end, end, sizeof(end));
+        fprintf(fp, "%s %s %s %s %s %.3f\n", gaps[i].streamid,
+                gaps[i].location[0] ? gaps[i].location : "--", gaps[i].channel,
+                start, end, gaps[i].end - gaps[i].start);
+    }
+    free(gaps);
+    
+    if (fclose(fp) != 0)
+    {
+        remove(tmp_path);
+        return -1;
+    }
+#ifdef _WIN32
+    remove(path);
+#endif
+    if (rename(tmp_path, path) != 0)
+    {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Read one line of any length into *buf, growing it as needed. Returns the
+ * line length without the line ending, or -1 at end of file.
+ */
+static long
+read_stream_line(FILE *fp, char **buf, size_t *cap)
+{
+    size_t len = 0;
+    
+    for (;;)
+    {
+        if (*cap - len < 2)
+        {
+            size_t new_cap = *cap ? *cap * 2 : 256;
+            char *new_buf = (char *)realloc(*buf, new_cap);
+            if (new_buf == NULL)
+                return -1;
+            *buf = new_buf;
+            *cap = new_cap;
+        }
+        
+        if (fgets(*buf + len, (int)(*cap - len), fp) == NULL)
+        {
+            if (len == 0)
+                return -1;
+            break;
+        }
+        
+        len += strlen(*buf + len);
+        if (len > 0 && (*buf)[len - 1] == '\n')
+            break;
+    }
+    
+    while (len > 0 && ((*buf)[len - 1] == '\n' || (*buf)[len - 1] == '\r'))
+        (*buf)[--len] = '\0';
+    
+    return (long)len;
+}
+
+/*
+ * Single pass over the stream file. Each line is "NET_STA [selectors...]";
+ * it becomes one subscription per selector and, when slconn is given, one
+ * libslink stream entry, so the file is never parsed twice.
+ */
+static int
+load_subscriptions(SLCD *slconn, const char *streamfile)
 {
     FILE *fp;
-    char line[200];
-    char stationid[64] = {0};
-    char selector_str[200] = {0};
-    char *cp;
-    int fields;
+    char *line = NULL;
+    size_t line_cap = 0;
+    long long start_us = platform_monotonic_us();
+    int stations = 0;
+    int lineno = 0;
+    int status = 0;
+    size_t index_bytes;
     
     fp = fopen(streamfile, "rb");
     if (fp == NULL)
@@ -641,62 +2153,247 @@ load_stream_file(SLCD *slconn, const char *streamfile)
     if (g_verbose >= 1)
         printf("[RingClient] Loading streams from: %s\n", streamfile);
     
-    while (fgets(line, sizeof(line), fp))
+    while (status == 0 && read_stream_line(fp, &line, &line_cap) >= 0)
     {
-        memset(stationid, 0, sizeof(stationid));
-        memset(selector_str, 0, sizeof(selector_str));
+        char *stationid;
+        char *selectors;
+        char *token;
+        
+        lineno++;
+        
+        stationid = line + strspn(line, " \t");
+        if (*stationid == '\0' || *stationid == '#')
+            continue;
+        
+        selectors = stationid + strcspn(stationid, " \t");
+        if (*selectors != '\0')
+        {
+            *selectors++ = '\0';
+            selectors += strspn(selectors, " \t");
+        }
+        
+        /* libslink takes the selector list as given, before strtok splits it */
+        if (slconn != NULL &&
+            sl_add_stream(slconn, stationid, *selectors ? selectors : NULL,
+                          SL_UNSETSEQUENCE, NULL) < 0)
+        {
+            fprintf(stderr, "[RingClient] Cannot add stream %s (line %d of %s)\n",
+                    stationid, lineno, streamfile);
+            status = -1;
+            break;
+        }
+        stations++;
         
-        if ((cp = strchr(line, '\r')) != NULL || (cp = strchr(line, '\n')) != NULL)
-            *cp = '\0';
+        if (*selectors == '\0')
+        {
+            status = add_subscription(stationid, "");
+            continue;
+        }
         
-        fields = sscanf(line, "%63s %199[^\r\n]", stationid, selector_str);
+        for (token = strtok(selectors, " \t"); token != NULL && status == 0;
+             token = strtok(NULL, " \t"))
+            status = add_subscription(stationid, token);
+    }
+    
+    free(line);
+    fclose(fp);
+    
+    if (status == 0)
+        status = build_subscription_index();
+    if (status < 0)
+        return -1;
+    
+    index_bytes = (size_t)subscription_capacity * sizeof(StreamSubscription) +
+                  (size_t)(subscription_mask + 1) * sizeof(int);
+    printf("[RingClient] Loaded %d subscriptions for %d stations in %.1f ms (%.1f KB index)\n",
+           subscription_count, stations,
+           (platform_monotonic_us() - start_us) / 1000.0, index_bytes / 1024.0);
+    
+    return 0;
+}
+
+/* Whether the stream file covers a record; everything without a stream file */
+static int
+subscription_accepts(const char *streamid, const char *loc_channel)
+{
+    int i;
+    int listed = 0;
+    
+    if (subscription_count == 0)
+        return 1;
+    
+    for (i = first_subscription(streamid); i >= 0; i = subscriptions[i].next)
+    {
+        if (strcmp(subscriptions[i].streamid, streamid) != 0)
+            continue;
+        if (subscriptions[i].selector[0] == '\0')
+            return 1;
+        listed = 1;
+    }
+    
+    return listed && find_matching_selector(streamid, loc_channel) != loc_channel;
+}
+
+/*
+ * Replay an archive through ringclient_ingest() in start time order.
+ * At replay_speed N a record is written when N times the elapsed wall
+ * time has passed since the first record; data latency is measured
+ * against that replay clock so late-stream warnings stay meaningful.
+ */
+static int
+ringclient_run_replay(RingClientConfig *config)
+{
+    ArchiveSource *src;
+    ArchiveSourceStats stats;
+    ArchiveRecord *rec;
+    char loc_channel[16];
+    unsigned long long seqnum = 0;
+    unsigned long long filtered = 0;
+    unsigned long long oversized = 0;
+    long long wall_start_us = 0;
+    double first_time = 0.0;
+    double speed = config->replay_speed;
+    
+    trace_set_thread_name("ringclient");
+    
+    if (config->stream_file[0] != '\0' && load_subscriptions(NULL, config->stream_file) < 0)
+    {
+        fprintf(stderr, "[RingClient] Failed to load stream file: %s\n", 
+                config->stream_file);
+        return -1;
+    }
+    
+    src = archive_source_open(config->replay_path, config->replay_start, config->replay_end);
+    if (src == NULL)
+    {
+        cleanup_subscriptions();
+        return -1;
+    }
+    
+    rec = (ArchiveRecord *)malloc(sizeof(ArchiveRecord));
+    if (rec == NULL)
+    {
+        fprintf(stderr, "[RingClient] Memory allocation failed\n");
+        archive_source_close(src);
+        cleanup_subscriptions();
+        return -1;
+    }
+    
+    archive_source_get_stats(src, &stats);
+    if (speed > 0.0)
+        printf("[RingClient] Replaying %lu files from %s at %gx real time\n",
+               stats.files, config->replay_path, speed);
+    else
+        printf("[RingClient] Replaying %lu files from %s as fast as possible\n",
+               stats.files, config->replay_path);
+    printf("[RingClient] Starting replay (ring buffer: %d minutes)\n", 
+           g_ring_buffer_minutes);
+    
+    while (config->running && archive_source_next(src, rec))
+    {
+        long long received_us;
         
-        if (fields <= 0 || stationid[0] == '#')
+        if (rec->length != MSEED_RECORD_SIZE)
+        {
+            oversized++;
             continue;
+        }
         
-        if (fields == 2)
+        extract_selector_from_miniseed(rec->data, loc_channel, sizeof(loc_channel));
+        if (!subscription_accepts(rec->stationid, loc_channel))
         {
-            char *sel_copy = strdup(selector_str);
-            char *token = strtok(sel_copy, " \t");
-            while (token != NULL)
+            filtered++;
+            continue;
+        }
+        
+        if (wall_start_us == 0)
+        {
+            wall_start_us = platform_monotonic_us();
+            first_time = rec->hdr.start_time;
+        }
+        
+        if (speed > 0.0)
+        {
+            /* Without a reactor, sleep in short steps to see a stop request */
+            long long due_us = wall_start_us +
+                (long long)((rec->hdr.start_time - first_time) / speed * 1e6);
+            long long wait_us;
+            
+            while (config->running && (wait_us = due_us - platform_monotonic_us()) > 1000)
             {
-                add_subscription(stationid, token);
-                token = strtok(NULL, " \t");
+                if (config->reactor)
+                    reactor_sleep(config->reactor, (unsigned int)(wait_us / 1000));
+                else
+                    platform_sleep_ms(wait_us > 100000 ? 100 : (unsigned int)(wait_us / 1000));
             }
-            free(sel_copy);
+            
+            g_replay_now = first_time +
+                (platform_monotonic_us() - wall_start_us) / 1e6 * speed;
         }
         else
         {
-            add_subscription(stationid, "");
+            g_replay_now = rec->hdr.end_time;
         }
+        
+        received_us = platform_monotonic_us();
+        TRACE_BEGIN(handler_span);
+        ringclient_ingest(rec->stationid, rec->data, rec->length, ++seqnum, received_us);
+        TRACE_END(handler_span, "packet_handler");
+        maybe_flush_pending();
+        merge_backfill();
     }
     
-    fclose(fp);
+    archive_source_get_stats(src, &stats);
+    g_replay_now = 0.0;
+    
+    printf("[RingClient] Replay %s: %llu records in %.1f s",
+           config->running ? "finished" : "stopped", g_stats.packets,
+           wall_start_us ? (platform_monotonic_us() - wall_start_us) / 1e6 : 0.0);
+    printf(" (%llu outside window, %llu not in stream file, %llu not %d bytes)\n",
+           stats.skipped, filtered, oversized, MSEED_RECORD_SIZE);
+    
+    free(rec);
+    archive_source_close(src);
+    ringbuffer_cleanup();
+    cleanup_subscriptions();
     
-    return sl_add_streamlist_file(slconn, streamfile, NULL);
+    printf("[RingClient] Stopped\n");
+    return 0;
 }
 
 static void
 packet_handler(SLCD *slconn, const SLpacketinfo *packetinfo,
-               const char *payload, uint32_t payloadlength)
+               const char *payload, uint32_t payloadlength,
+               long long received_us)
+{
+    (void)slconn;
+
+    /* Check if we should stop */
+    if (g_running_ptr && !(*g_running_ptr))
+        return;
+
+    ringclient_ingest(packetinfo->stationid, payload, payloadlength,
+                      (unsigned long long)packetinfo->seqnum, received_us);
+}
+
+int
+ringclient_ingest(const char *stationid, const char *payload,
+                  uint32_t payloadlength, unsigned long long seqnum,
+                  long long received_us)
 {
     char streamid[64];
     char loc_channel[16] = {0};
     char selector[16] = {0};
     const char *matched_selector;
     RingBuffer *rb = NULL;
+    MSeedHeader hdr;
     double datatime;
+    int status;
 
-    (void)slconn;
-
-    /* Check if we should stop */
-    if (g_running_ptr && !(*g_running_ptr))
-        return;
-
-    if (packetinfo->stationid[0] == '\0')
-        return;
+    if (stationid[0] == '\0')
+        return -1;
 
-    strncpy(streamid, packetinfo->stationid, sizeof(streamid) - 1);
+    strncpy(streamid, stationid, sizeof(streamid) - 1);
     streamid[sizeof(streamid) - 1] = '\0';
     
     if (payloadlength >= 18)
@@ -708,47 +2405,75 @@ packet_handler(SLCD *slconn, const SLpacketinfo *packetinfo,
     }
     else
     {
-        return;
+        return -1;
+    }
+    
+    /* Parse before the lookup so a bad payload does not create a ring */
+    if (mseed_parse_header(payload, payloadlength, &hdr) < 0)
+    {
+        static long dropped = 0;
+
+        metrics_counter_add(g_unparsable_metric, 1);
+        if (++dropped == 1 || dropped % 1000 == 0)
+            LOG_WARN(LOG_CAT_RINGCLIENT, "Dropped %ld unparsable records, last from %s (%u bytes)",
+                     dropped, streamid, payloadlength);
+        return -1;
     }
+    datatime = hdr.start_time;
     
+    TRACE_BEGIN(lookup_span);
     rb = get_or_create_ringbuffer(streamid, selector);
+    TRACE_END(lookup_span, "get_or_create_ringbuffer");
     if (rb == NULL)
-        return;
+        return -1;
     
-    datatime = extract_miniseed_time(payload);
+    /* Redelivered after a reconnect: already written and passed on */
+    if (seen_before(rb, &hdr))
+    {
+        metrics_counter_add(g_duplicate_metric, 1);
+        return 1;
+    }
     
-    if (write_packet_to_ringbuffer(rb, payload, payloadlength, datatime) == 0)
+    TRACE_BEGIN(write_span);
+    if (g_reorder_seconds > 0 && payloadlength == MSEED_RECORD_SIZE)
+        status = hold_for_reorder(rb, payload, &hdr, seqnum, received_us);
+    else if ((status = write_packet_to_ringbuffer(rb, payload, payloadlength, &hdr)) == 0)
     {
-        /* 
-         * Verbose level behavior:
-         * 0 = quiet, no per-packet output
-         * 1 = normal, status every 100 packets
-         * 2+ = debug, every packet
-         */
-        if (g_verbose >= 2)
-        {
-            /* Debug mode: show EVERY packet */
-            time_t t = (time_t)datatime;
-            struct tm *tm_info = gmtime(&t);
-            char time_str[32];
-            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-            
-            printf("[RingClient] PKT %s_%s seq=%llu time=%s bytes=%u\n",
-                   streamid, loc_channel, 
-                   (unsigned long long)packetinfo->seqnum,
-                   time_str, payloadlength);
-        }
-        else if (g_verbose == 1)
+        remember_record(rb, &hdr);
+        record_written(rb, payload, payloadlength, &hdr, seqnum, received_us);
+    }
+    TRACE_END(write_span, "write_packet_to_ringbuffer");
+
+    if (status != 0)
+        return -1;
+
+    g_stats.packets++;
+    g_stats.bytes_ingested += payloadlength;
+
+    /* 
+     * Verbose level behavior:
+     * 0 = quiet, no per-packet output
+     * 1 = normal, status every 100 packets
+     * 2+ = debug, every packet
+     */
+    if (g_verbose >= 2)
+    {
+        /* Debug mode: show EVERY packet, formatted on the logger thread */
+        LOG_DEBUG(LOG_CAT_RINGCLIENT, "PKT %s_%s seq=%llu time=%T bytes=%u",
+                  streamid, loc_channel, seqnum, datatime, payloadlength);
+    }
+    else if (g_verbose == 1)
+    {
+        /* Normal mode: show summary every 100 packets */
+        static int count = 0;
+        if (++count % 100 == 0)
         {
-            /* Normal mode: show summary every 100 packets */
-            static int count = 0;
-            if (++count % 100 == 0)
-            {
-                printf("[RingClient] %s_%s: %ld records, %.1f min buffer\n",
-                       streamid, selector, rb->record_count,
-                       (rb->newest_time - rb->oldest_time) / 60.0);
-            }
+            LOG_INFO(LOG_CAT_RINGCLIENT, "%s_%s: %ld records, %.1f min buffer",
+                     streamid, selector, rb->record_count,
+                     (rb->newest_time - rb->oldest_time) / 60.0);
         }
-        /* verbose == 0: no output */
     }
-}
\ No newline at end of file
+    /* verbose == 0: no output */
+
+    return 0;
+}
@@ -16,12 +16,81 @@
 
 #include <libslink.h>
 #include "config.h"
+#include "metrics.h"
+#include "mseed_util.h"
+#include "reactor.h"
 
 /* Ring buffer configuration - can be overridden at runtime */
 #define DEFAULT_RING_BUFFER_MINUTES 5
 #define DEFAULT_CLEANUP_INTERVAL 100
 #define MSEED_RECORD_SIZE 512
 #define MAX_FILENAME 256
+#define LATENCY_WINDOW 64
+#define DEFAULT_LATENCY_THRESHOLD 60
+#define COLLECT_WAIT_MS 20         /* Idle wait between non-blocking sl_collect() calls */
+#define MAX_RECORD_CALLBACKS 4
+#define RING_DEDUP_SLOTS 1024      /* Recent record fingerprints kept per ring */
+#define RING_TIMELINE_SEGMENTS 64  /* Continuous spans kept per channel */
+#define RING_BACKFILL_QUEUE 20000  /* Fetched records waiting to be merged, all rings */
+
+/* Rolling latency samples for one stream (seconds) */
+typedef struct {
+    float data_latency[LATENCY_WINDOW];     /* Wall clock - record end time */
+    float write_latency[LATENCY_WINDOW];    /* Packet receipt - write done */
+    int next;
+    int filled;
+    int late;                               /* p50 data latency above threshold */
+    MetricGauge *data_p50_metric;
+    MetricGauge *data_p99_metric;
+    MetricGauge *write_p99_metric;
+    MetricGauge *late_metric;
+} StreamLatency;
+
+/* One record of a ring file, kept when record_index is enabled */
+typedef struct {
+    double start_time;
+    double end_time;
+    long long offset;           /* Byte offset in the ring file */
+    uint32_t length;
+    char location[3];
+    char channel[4];
+} RingRecordEntry;
+
+/* A continuous span of data, epoch seconds (end is just after the last sample) */
+typedef struct {
+    double start;
+    double end;
+} RingSegment;
+
+/*
+ * One channel of a ring: the newest record written, to count late
+ * arrivals, and the timeline of continuous spans within the retention,
+ * oldest first. Segments are guarded by the index lock.
+ */
+typedef struct {
+    char location[3];
+    char channel[4];
+    double last_start;
+    RingSegment *segments;
+    int segment_count;
+} RingChannel;
+
+/* A hole in one channel's data, between two spans of its timeline */
+typedef struct {
+    char streamid[64];          /* NET_STA */
+    char location[3];
+    char channel[4];
+    double start;               /* End of the data before the gap */
+    double end;                 /* Start of the data after it */
+} RingGap;
+
+/* A record held back by the reorder window */
+typedef struct {
+    MSeedHeader hdr;
+    long long received_us;
+    unsigned long long seqnum;
+    char record[MSEED_RECORD_SIZE];
+} PendingRecord;
 
 /* Structure to track ring buffer state for each stream */
 typedef struct RingBuffer {
@@ -31,14 +100,40 @@ typedef struct RingBuffer {
     double oldest_time;
     double newest_time;
     long record_count;
+    MetricCounter *packets_metric;
+    MetricCounter *bytes_metric;
+    StreamLatency latency;
+    RingRecordEntry *index;     /* Records in file order, guarded by the index lock */
+    long index_count;
+    long index_capacity;
+    long long file_size;        /* Bytes of the ring file covered by index */
+    uint64_t *seen;             /* RING_DEDUP_SLOTS recent fingerprints in 4-way buckets, 0 = free */
+    RingChannel *channels;
+    int channel_count;
+    MetricGauge *gaps_metric;
+    MetricGauge *missing_metric;
+    PendingRecord *pending;     /* Reorder window, sorted by start time */
+    int pending_count;
+    int pending_capacity;
     struct RingBuffer *next;
 } RingBuffer;
 
 typedef struct {
     char streamid[64];
     char selector[16];
+    int next;                   /* Next subscription in the same hash bucket, -1 at the end */
 } StreamSubscription;
 
+/* Ingest counters since ringclient_setup() */
+typedef struct {
+    unsigned long long packets;         /* Records written to a ring buffer */
+    unsigned long long bytes_ingested;  /* Payload bytes of those records */
+    unsigned long long bytes_written;   /* Appends plus cleanup rewrites */
+    unsigned long long cleanup_runs;
+    unsigned long long cleanup_us;      /* Total time spent in cleanup */
+    unsigned long long backfill_merges; /* Rewrites that merged backfilled records */
+} RingClientStats;
+
 /* Runtime configuration for ringclient */
 typedef struct {
     char server_address[256];
@@ -49,6 +144,14 @@ typedef struct {
     int verbose;
     int ring_buffer_minutes;
     int cleanup_interval;      /* Clean old records every N packets */
+    int latency_threshold;     /* Flag streams staler than N seconds, 0 = off */
+    char replay_path[512];     /* Replay this miniSEED archive instead of SeedLink */
+    double replay_speed;       /* Multiple of real time, 0 = as fast as possible */
+    double replay_start;       /* Replay window (epoch seconds), 0 = open */
+    double replay_end;
+    int record_index;          /* Keep a per-ring record index for ringclient_select() */
+    int reorder_seconds;       /* Hold records this long to write them in time order, 0 = off */
+    Reactor *reactor;          /* Optional; its stop event ends idle waits at once */
     volatile int running;      /* Flag to signal shutdown */
 } RingClientConfig;
 
@@ -77,4 +180,95 @@ int ringclient_run(RingClientConfig *config);
 /* Cleanup resources */
 void ringclient_cleanup(void);
 
+/*
+ * Offline ingestion, for benchmarks and replay without a SeedLink server.
+ * ringclient_setup() applies the configuration that ringclient_run() would;
+ * ringclient_ingest() then feeds one record through the same path as a
+ * received packet. Returns 0 if the record was taken (written to a ring
+ * buffer or held by the reorder window), 1 if it duplicated a recent one.
+ */
+void ringclient_setup(RingClientConfig *config);
+int ringclient_ingest(const char *stationid, const char *payload,
+                      uint32_t payloadlength, unsigned long long seqnum,
+                      long long received_us);
+
+/*
+ * Current gaps of every channel, oldest first within a channel, from the
+ * timelines kept as records are written (no file scan). Copies up to max
+ * into gaps and returns how many there are, which may exceed max. Safe
+ * from any thread.
+ */
+int ringclient_gaps(RingGap *gaps, int max);
+
+/* Write the current gaps as a text status file, atomically (tmp + rename) */
+int ringclient_write_gap_file(const char *path);
+
+/*
+ * Queue records fetched for a gap (count records of MSEED_RECORD_SIZE
+ * bytes, one channel of station streamid NET_STA) for the receive thread,
+ * which merges one batch at a time between packets into the ring file by
+ * start time. Records the ring already holds or that aged out of it are
+ * dropped; merged records are not passed to the record callbacks. Safe
+ * from any thread; 0 if queued, -1 if the queue is full.
+ */
+int ringclient_backfill(const char *streamid, const char *records, int count);
+
+/* Data clock: the replay position while replaying an archive, else wall time */
+double ringclient_clock(void);
+
+/* Cumulative counters since ringclient_setup(), owned by the receive thread */
+void ringclient_get_stats(RingClientStats *stats);
+
+/*
+ * Called on the receive thread after each record is written to its ring
+ * buffer; records held by the reorder window when they are released.
+ * Keep it short; it delays the next packet. Register before the
+ * ringclient starts.
+ */
+typedef void (*RingClientRecordCallback)(const char *streamid, const char *record,
+                                         uint32_t length, const MSeedHeader *hdr,
+                                         unsigned long long seqnum, void *ctx);
+
+/* Replace every registered callback with this one (NULL clears them) */
+void ringclient_set_record_callback(RingClientRecordCallback callback, void *ctx);
+
+/* Add a callback after the existing ones; -1 once MAX_RECORD_CALLBACKS are set */
+int ringclient_add_record_callback(RingClientRecordCallback callback, void *ctx);
+
+/*
+ * Record selection for readers on other threads (the dataselect endpoint).
+ * Matching records are returned as byte extents of ring files opened
+ * read-only under the index lock, so a later cleanup rewrite cannot change
+ * what the caller sends. Requires record_index.
+ */
+typedef struct {
+    int file;                   /* Index into RingSelection.fds */
+    long long offset;
+    long long length;
+} RingExtent;
+
+typedef struct {
+    RingExtent *extents;
+    int extent_count;
+    int extent_capacity;
+    int *fds;                   /* Read-only descriptors, closed by ringclient_selection_free() */
+    int fd_count;
+    int fd_capacity;
+    long long total_bytes;
+} RingSelection;
+
+/* Per-record channel filter; called with the index lock held, keep it cheap */
+typedef int (*RingRecordFilter)(const char *network, const char *station,
+                                const char *location, const char *channel, void *ctx);
+
+/*
+ * Append every indexed record overlapping [start_time, end_time] (0 = open)
+ * that filter accepts. Adjacent records are merged into one extent.
+ * 0 on success, -1 on error (selection is left for ringclient_selection_free).
+ */
+int ringclient_select(RingRecordFilter filter, void *ctx, double start_time,
+                      double end_time, RingSelection *selection);
+
+void ringclient_selection_free(RingSelection *selection);
+
 #endif /* RINGCLIENT_H */
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "seedlink_proto.h"
+#include "mseed_util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifdef _WIN32
+    #define strtok_r strtok_s
+#endif
+
+static const struct {
+    const char *verb;
+    SlCommandType type;
+} g_commands[] = {
+    { "HELLO", SLCMD_HELLO },
+    { "CAPABILITIES", SLCMD_CAPABILITIES },
+    { "BATCH", SLCMD_BATCH },
+    { "STATION", SLCMD_STATION },
+    { "SELECT", SLCMD_SELECT },
+    { "DATA", SLCMD_DATA },
+    { "FETCH", SLCMD_FETCH },
+    { "TIME", SLCMD_TIME },
+    { "END", SLCMD_END },
+    { "INFO", SLCMD_INFO },
+    { "CAT", SLCMD_CAT },
+    { "BYE", SLCMD_BYE }
+};
+
+void slproto_parse_command(const char *line, SlCommand *cmd) {
+    char buf[SLPROTO_MAX_LINE];
+    char *tok, *save = NULL;
+    size_t i;
+
+    memset(cmd, 0, sizeof(*cmd));
+    strncpy(buf, line, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    tok = strtok_r(buf, " \t", &save);
+    if (tok == NULL)
+        return;
+
+    for (i = 0; i < sizeof(g_commands) / sizeof(g_commands[0]); i++) {
+        if (strcasecmp(tok, g_commands[i].verb) == 0) {
+            cmd->type = g_commands[i].type;
+            break;
+        }
+    }
+
+    while ((tok = strtok_r(NULL, " \t", &save)) != NULL && cmd->argc < SLPROTO_MAX_ARGS) {
+        strncpy(cmd->argv[cmd->argc], tok, sizeof(cmd->argv[0]) - 1);
+        cmd->argc++;
+    }
+}
+
+int slproto_take_line(char *buffer, size_t *used, char *line, size_t line_len) {
+    size_t i, len, skip;
+
+    for (i = 0; i < *used; i++) {
+        if (buffer[i] == '\r' || buffer[i] == '\n')
+            break;
+    }
+    if (i == *used) {
+        /* Overlong garbage without a terminator: drop it */
+        if (*used >= line_len - 1)
+            *used = 0;
+        return 0;
+    }
+
+    len = i < line_len - 1 ? i : line_len - 1;
+    memcpy(line, buffer, len);
+    line[len] = '\0';
+
+    skip = i + 1;
+    if (buffer[i] == '\r' && skip < *used && buffer[skip] == '\n')
+        skip++;
+    memmove(buffer, buffer + skip, *used - skip);
+    *used -= skip;
+    return 1;
+}
+
+int slproto_parse_time(const char *text, double *epoch) {
+    static const int month_days[] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+    int year, month, day, hour = 0, minute = 0, second = 0;
+    int doy;
+
+    if (sscanf(text, "%d,%d,%d,%d,%d,%d", &year, &month, &day, &hour, &minute, &second) < 3)
+        return -1;
+    if (month < 1 || month > 12 || day < 1 || day > 31)
+        return -1;
+
+    doy = month_days[month - 1] + day;
+    if (month > 2 && ((year % 4 == 0 && year % 100 != 0) || year % 400 == 0))
+        doy++;
+
+    *epoch = (double)mseed_days_from_year_doy(year, doy) * 86400.0 +
+             hour * 3600.0 + minute * 60.0 + second;
+    return 0;
+}
+
+long slproto_parse_sequence(const char *text) {
+    char *end;
+    unsigned long value;
+
+    if (text == NULL || text[0] == '\0')
+        return -1;
+    value = strtoul(text, &end, 16);
+    if (*end != '\0' || value > SLPROTO_SEQ_MASK)
+        return -1;
+    return (long)value;
+}
+
+void slproto_format_header(char *header, unsigned long sequence) {
+    char buf[SLPROTO_HEADER_SIZE + 1];
+
+    snprintf(buf, sizeof(buf), "SL%06lX", sequence & SLPROTO_SEQ_MASK);
+    memcpy(header, buf, SLPROTO_HEADER_SIZE);
+}
+
+static int match_wildcard(const char *pattern, const char *text) {
+    if (*pattern == '\0')
+        return *text == '\0';
+    if (*pattern == '*')
+        return match_wildcard(pattern + 1, text) || (*text && match_wildcard(pattern, text + 1));
+    if (*text == '\0')
+        return 0;
+    if (*pattern == '?' || toupper((unsigned char)*pattern) == toupper((unsigned char)*text))
+        return match_wildcard(pattern + 1, text + 1);
+    return 0;
+}
+
+int slproto_match_station(const char *station_pattern, const char *network_pattern,
+                          const char *station, const char *network) {
+    if (!match_wildcard(station_pattern, station))
+        return 0;
+    return network_pattern == NULL || network_pattern[0] == '\0' ||
+           match_wildcard(network_pattern, network);
+}
+
+int slproto_match_selector(const char *pattern, const char *location,
+                           const char *channel, char type) {
+    char code[6];
+    const char *dot = strchr(pattern, '.');
+    size_t len = dot ? (size_t)(dot - pattern) : strlen(pattern);
+    size_t offset, i;
+
+    if (dot && dot[1] != '\0' && toupper((unsigned char)dot[1]) != type)
+        return 0;
+
+    /* Location as two characters, space padded */
+    code[0] = location[0] ? location[0] : ' ';
+    code[1] = location[0] && location[1] ? location[1] : ' ';
+    memset(code + 2, ' ', 3);
+    memcpy(code + 2, channel, strlen(channel) < 3 ? strlen(channel) : 3);
+    code[5] = '\0';
+
+    if (len == 5) {
+        offset = 0;
+        if (pattern[0] == '-' && pattern[1] == '-') {
+            if (location[0] != '\0')
+                return 0;
+            pattern += 2;
+            offset = 2;
+        }
+    } else if (len == 3) {
+        offset = 2;
+    } else if (len == 0) {
+        return 1;
+    } else {
+        return 0;
+    }
+
+    for (i = offset; i < 5; i++, pattern++) {
+        if (*pattern != '?' && toupper((unsigned char)*pattern) != code[i])
+            return 0;
+    }
+    return 1;
+}
+
+long slproto_sequence_diff(unsigned long a, unsigned long b) {
+    long diff = (long)((a - b) & SLPROTO_SEQ_MASK);
+
+    if (diff > (long)(SLPROTO_SEQ_MASK / 2))
+        diff -= (long)SLPROTO_SEQ_MASK + 1;
+    return diff;
+}
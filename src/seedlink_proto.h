@@ -0,0 +1,77 @@
+#ifndef SEEDLINK_PROTO_H
+#define SEEDLINK_PROTO_H
+
+/*
+ * Server side of the SeedLink v3 protocol: command parsing, packet
+ * headers and station/selector matching. Shared by the test server and
+ * anything else that serves records to SeedLink clients.
+ *
+ * Commands are single lines terminated by CR and/or LF. Data packets are
+ * an 8-byte header ("SL" + 6 hex digit sequence) followed by one 512-byte
+ * miniSEED record; INFO responses use "SLINFO" plus a continuation flag.
+ */
+
+#include <stddef.h>
+
+#define SLPROTO_HEADER_SIZE 8
+#define SLPROTO_RECORD_SIZE 512
+#define SLPROTO_PACKET_SIZE (SLPROTO_HEADER_SIZE + SLPROTO_RECORD_SIZE)
+#define SLPROTO_MAX_LINE 256
+#define SLPROTO_MAX_ARGS 4
+#define SLPROTO_SEQ_MASK 0xFFFFFFUL
+
+typedef enum {
+    SLCMD_UNKNOWN = 0,
+    SLCMD_HELLO,
+    SLCMD_CAPABILITIES,
+    SLCMD_BATCH,
+    SLCMD_STATION,
+    SLCMD_SELECT,
+    SLCMD_DATA,
+    SLCMD_FETCH,
+    SLCMD_TIME,
+    SLCMD_END,
+    SLCMD_INFO,
+    SLCMD_CAT,
+    SLCMD_BYE
+} SlCommandType;
+
+typedef struct {
+    SlCommandType type;
+    int argc;
+    char argv[SLPROTO_MAX_ARGS][64];
+} SlCommand;
+
+/* Split one command line; unknown verbs give SLCMD_UNKNOWN */
+void slproto_parse_command(const char *line, SlCommand *cmd);
+
+/*
+ * Take one complete line out of buffer (used bytes), shifting the rest
+ * down. Returns 1 with line filled, 0 if no complete line yet.
+ */
+int slproto_take_line(char *buffer, size_t *used, char *line, size_t line_len);
+
+/* "YYYY,MM,DD,hh,mm,ss" to epoch seconds; 0 on success */
+int slproto_parse_time(const char *text, double *epoch);
+
+/* Hex sequence from DATA/FETCH; -1 if absent or malformed */
+long slproto_parse_sequence(const char *text);
+
+/* Write the 8-byte "SLxxxxxx" header for a sequence number */
+void slproto_format_header(char *header, unsigned long sequence);
+
+/* Station/network patterns with '?' and '*' wildcards */
+int slproto_match_station(const char *station_pattern, const char *network_pattern,
+                          const char *station, const char *network);
+
+/*
+ * SELECT pattern "LLCCC", "CCC" or either with ".T" type suffix; '?'
+ * matches any character and "--" stands for an empty location.
+ */
+int slproto_match_selector(const char *pattern, const char *location,
+                           const char *channel, char type);
+
+/* Compare 24-bit sequence numbers allowing wrap: <0, 0, >0 like strcmp */
+long slproto_sequence_diff(unsigned long a, unsigned long b);
+
+#endif /* SEEDLINK_PROTO_H */
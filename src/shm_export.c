@@ -0,0 +1,265 @@
+#include "shm_export.h"
+#include "shm_ring.h"
+#include "platform.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #ifdef __linux__
+        #include <limits.h>
+        #include <linux/futex.h>
+        #include <sys/syscall.h>
+    #endif
+#endif
+
+#define SHM_EXPORT_BUCKETS 4096
+
+typedef struct ExportRing {
+    char key[32];               /* NET.STA.LOC.CHA */
+    ShmRingHeader *ring;
+    size_t size;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+    struct ExportRing *next;
+} ExportRing;
+
+static char g_prefix[64] = "ringclient";
+static unsigned int g_slots = 256;
+static ExportRing *g_buckets[SHM_EXPORT_BUCKETS];
+static int g_started = 0;
+
+static MetricCounter *g_records_metric = NULL;
+static MetricCounter *g_skipped_metric = NULL;
+static MetricGauge *g_segments_metric = NULL;
+
+static unsigned int hash_key(const char *key) {
+    unsigned int h = 2166136261u;
+
+    while (*key)
+        h = (h ^ (unsigned char)*key++) * 16777619u;
+    return h;
+}
+
+/* Mark a segment retired so attached readers reopen it by name */
+static void retire_ring(ShmRingHeader *ring) {
+    ring->magic = 0;
+    platform_atomic_fence();
+    platform_atomic_add_u64(&ring->generation, 1);
+}
+
+/* Map (creating if needed) the segment for one channel; NULL on failure */
+static ShmRingHeader* map_ring(ExportRing *er, const char *name) {
+    size_t size = shm_ring_size(g_slots);
+    ShmRingHeader *ring;
+
+#ifdef _WIN32
+    er->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                     (DWORD)((unsigned long long)size >> 32),
+                                     (DWORD)(size & 0xffffffffu), name);
+    if (er->mapping == NULL)
+        return NULL;
+    ring = (ShmRingHeader*)MapViewOfFile(er->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (ring == NULL) {
+        CloseHandle(er->mapping);
+        return NULL;
+    }
+#else
+    struct stat st;
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+
+    if (fd < 0)
+        return NULL;
+
+    /* A segment left with another geometry is retired and replaced */
+    if (fstat(fd, &st) == 0 && st.st_size != 0 && (size_t)st.st_size != size) {
+        void *old = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (old != MAP_FAILED) {
+            if ((size_t)st.st_size >= sizeof(ShmRingHeader))
+                retire_ring((ShmRingHeader*)old);
+            munmap(old, (size_t)st.st_size);
+        }
+        close(fd);
+        shm_unlink(name);
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+            return NULL;
+    }
+
+    if (ftruncate(fd, (off_t)size) < 0) {
+        close(fd);
+        return NULL;
+    }
+    ring = (ShmRingHeader*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED)
+        return NULL;
+#endif
+
+    er->size = size;
+    return ring;
+}
+
+static ExportRing* find_or_create(const MSeedHeader *hdr) {
+    char key[32];
+    char name[SHM_RING_NAME_MAX];
+    unsigned int b;
+    ExportRing *er;
+    ShmRingHeader *ring;
+
+    snprintf(key, sizeof(key), "%s.%s.%s.%s", hdr->network, hdr->station,
+             hdr->location, hdr->channel);
+    b = hash_key(key) & (SHM_EXPORT_BUCKETS - 1);
+    for (er = g_buckets[b]; er != NULL; er = er->next) {
+        if (strcmp(er->key, key) == 0)
+            return er;
+    }
+
+    er = (ExportRing*)calloc(1, sizeof(ExportRing));
+    if (er == NULL)
+        return NULL;
+    strcpy(er->key, key);
+
+    shm_ring_name(name, sizeof(name), g_prefix, hdr->network, hdr->station,
+                  hdr->location, hdr->channel);
+    ring = map_ring(er, name);
+    if (ring == NULL) {
+        fprintf(stderr, "[ShmExport] Cannot map %s\n", name);
+        free(er);
+        return NULL;
+    }
+
+    if (ring->magic == SHM_RING_MAGIC && ring->version == SHM_RING_VERSION &&
+        ring->slot_count == g_slots && ring->slot_size == sizeof(ShmRingSlot)) {
+        /* Same layout from an earlier run: keep numbering, tell readers */
+        platform_atomic_add_u64(&ring->generation, 1);
+    } else {
+        memset(ring, 0, sizeof(ShmRingHeader));
+        ring->version = SHM_RING_VERSION;
+        ring->slot_count = g_slots;
+        ring->slot_size = (uint32_t)sizeof(ShmRingSlot);
+        ring->generation = 1;
+        memcpy(ring->network, hdr->network, sizeof(hdr->network));
+        memcpy(ring->station, hdr->station, sizeof(hdr->station));
+        memcpy(ring->location, hdr->location, sizeof(hdr->location));
+        memcpy(ring->channel, hdr->channel, sizeof(hdr->channel));
+        platform_atomic_fence();
+        ring->magic = SHM_RING_MAGIC;
+    }
+    ring->sample_rate = hdr->sample_rate;
+
+    er->ring = ring;
+    er->next = g_buckets[b];
+    g_buckets[b] = er;
+    metrics_gauge_set(g_segments_metric, metrics_gauge_value(g_segments_metric) + 1);
+    return er;
+}
+
+static int shm_export_write(const SinkRecord *rec, void *ctx) {
+    const MSeedHeader *hdr = &rec->hdr;
+    ExportRing *er;
+    ShmRingHeader *ring;
+    ShmRingSlot *slot;
+    unsigned long long n;
+
+    (void)ctx;
+
+    if (!g_started)
+        return 0;
+    if (rec->length > SHM_RING_RECORD_MAX) {
+        metrics_counter_add(g_skipped_metric, 1);
+        return 0;
+    }
+
+    er = find_or_create(hdr);
+    if (er == NULL) {
+        metrics_counter_add(g_skipped_metric, 1);
+        return -1;
+    }
+    ring = er->ring;
+
+    /* Only this thread writes head, so a plain read is current */
+    n = ring->head;
+    slot = shm_ring_slot(ring, n);
+
+    platform_atomic_store_u64(&slot->seq, 2 * n + 1);
+    platform_atomic_fence();
+    slot->start_time = hdr->start_time;
+    slot->end_time = hdr->end_time;
+    slot->length = rec->length;
+    memcpy(slot->data, rec->record, rec->length);
+    platform_atomic_store_release_u64(&slot->seq, 2 * n + 2);
+
+    if (n + 1 > ring->slot_count)
+        platform_atomic_store_release_u64(&ring->tail, n + 1 - ring->slot_count);
+    platform_atomic_store_release_u64(&ring->head, n + 1);
+
+#ifdef __linux__
+    /* Wake blocked readers; same store-fence-load handshake as the logger */
+    __atomic_add_fetch(&ring->notify, 1, __ATOMIC_RELEASE);
+    platform_atomic_fence();
+    if (__atomic_load_n(&ring->waiters, __ATOMIC_RELAXED) != 0)
+        syscall(SYS_futex, &ring->notify, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+
+    metrics_counter_add(g_records_metric, 1);
+    return 0;
+}
+
+const SinkOps shm_export_ops = { shm_export_write, NULL, NULL };
+
+int shm_export_start(const char *prefix, unsigned int slots) {
+    unsigned int count = 16;
+
+    while (count < slots)
+        count <<= 1;
+    g_slots = count;
+    if (prefix != NULL && prefix[0] != '\0') {
+        strncpy(g_prefix, prefix, sizeof(g_prefix) - 1);
+        g_prefix[sizeof(g_prefix) - 1] = '\0';
+    }
+
+    g_records_metric = metrics_counter("shm_export_records_total", NULL,
+                                       "Records published to shared-memory rings");
+    g_skipped_metric = metrics_counter("shm_export_skipped_total", NULL,
+                                       "Records not published (too large or unmappable)");
+    g_segments_metric = metrics_gauge("shm_export_segments", NULL,
+                                      "Shared-memory ring segments mapped");
+
+    g_started = 1;
+    printf("[ShmExport] Publishing %s.NET.STA.LOC.CHA segments, %u slots (%.1f KB each)\n",
+           g_prefix, g_slots, shm_ring_size(g_slots) / 1024.0);
+    return 0;
+}
+
+void shm_export_stop(void) {
+    int i;
+
+    if (!g_started)
+        return;
+    g_started = 0;
+
+    for (i = 0; i < SHM_EXPORT_BUCKETS; i++) {
+        ExportRing *er = g_buckets[i];
+        while (er != NULL) {
+            ExportRing *next = er->next;
+#ifdef _WIN32
+            UnmapViewOfFile(er->ring);
+            CloseHandle(er->mapping);
+#else
+            munmap(er->ring, er->size);
+#endif
+            free(er);
+            er = next;
+        }
+        g_buckets[i] = NULL;
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef SHM_EXPORT_H
+#define SHM_EXPORT_H
+
+/*
+ * Publishes every record the ringclient writes into a per-channel
+ * shared-memory ring (layout in shm_ring.h), so consumers on the same host
+ * see new records within microseconds without touching the file system.
+ * Consumers use shm_reader.h.
+ *
+ * shm_export_ops is an inline sink (see sink.h) and runs on the receive
+ * thread; start before and stop after the ringclient thread.
+ */
+
+#include "sink.h"
+
+/* slots is rounded up to a power of two; 0 on success */
+int shm_export_start(const char *prefix, unsigned int slots);
+
+extern const SinkOps shm_export_ops;
+
+/* Unmap every segment; segments stay for readers and the next run */
+void shm_export_stop(void);
+
+#endif /* SHM_EXPORT_H */
@@ -0,0 +1,254 @@
+#include "shm_reader.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #ifdef __linux__
+        #include <time.h>
+        #include <linux/futex.h>
+        #include <sys/syscall.h>
+    #endif
+#endif
+
+struct ShmReader {
+    char name[SHM_RING_NAME_MAX];
+    ShmRingHeader *ring;
+    size_t size;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+    unsigned long long next;        /* Next record number to read */
+    unsigned long long generation;
+    unsigned long long lost;
+};
+
+/*
+ * Map the segment read-write: readers only ever write the waiters count,
+ * which the producer checks before waking anyone.
+ */
+static int attach(ShmReader *reader) {
+    ShmRingHeader *ring;
+    size_t size;
+
+#ifdef _WIN32
+    reader->mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, reader->name);
+    if (reader->mapping == NULL)
+        return -1;
+    ring = (ShmRingHeader*)MapViewOfFile(reader->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (ring == NULL) {
+        CloseHandle(reader->mapping);
+        return -1;
+    }
+    {
+        MEMORY_BASIC_INFORMATION info;
+        VirtualQuery(ring, &info, sizeof(info));
+        size = info.RegionSize;
+    }
+#else
+    struct stat st;
+    int fd = shm_open(reader->name, O_RDWR, 0);
+
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ShmRingHeader)) {
+        close(fd);
+        return -1;
+    }
+    size = (size_t)st.st_size;
+    ring = (ShmRingHeader*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED)
+        return -1;
+#endif
+
+    /* The producer sets magic last, after the geometry */
+    if (ring->magic != SHM_RING_MAGIC || ring->version != SHM_RING_VERSION ||
+        ring->slot_size != sizeof(ShmRingSlot) || ring->slot_count == 0 ||
+        (ring->slot_count & (ring->slot_count - 1)) != 0 ||
+        shm_ring_size(ring->slot_count) > size) {
+#ifdef _WIN32
+        UnmapViewOfFile(ring);
+        CloseHandle(reader->mapping);
+#else
+        munmap(ring, size);
+#endif
+        return -1;
+    }
+
+    reader->ring = ring;
+    reader->size = size;
+    reader->generation = platform_atomic_load_acquire_u64(&ring->generation);
+    return 0;
+}
+
+static void detach(ShmReader *reader) {
+    if (reader->ring == NULL)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(reader->ring);
+    CloseHandle(reader->mapping);
+#else
+    munmap(reader->ring, reader->size);
+#endif
+    reader->ring = NULL;
+}
+
+ShmReader* shm_reader_open(const char *name, int from_oldest) {
+    ShmReader *reader = (ShmReader*)calloc(1, sizeof(ShmReader));
+
+    if (reader == NULL)
+        return NULL;
+    strncpy(reader->name, name, sizeof(reader->name) - 1);
+
+    if (attach(reader) < 0) {
+        free(reader);
+        return NULL;
+    }
+
+    reader->next = from_oldest ? platform_atomic_load_acquire_u64(&reader->ring->tail)
+                               : platform_atomic_load_acquire_u64(&reader->ring->head);
+    return reader;
+}
+
+/* Producer restarted or replaced the segment; 0 once attached again */
+static int resync(ShmReader *reader) {
+    unsigned long long head;
+
+    if (reader->ring->magic != SHM_RING_MAGIC) {
+        detach(reader);
+        if (attach(reader) < 0)
+            return -1;
+        reader->next = platform_atomic_load_acquire_u64(&reader->ring->head);
+        return 0;
+    }
+
+    reader->generation = platform_atomic_load_acquire_u64(&reader->ring->generation);
+    head = platform_atomic_load_acquire_u64(&reader->ring->head);
+    if (reader->next > head)
+        reader->next = head;
+    return 0;
+}
+
+int shm_reader_next(ShmReader *reader, char *buffer, size_t len, ShmRecordInfo *info) {
+    for (;;) {
+        ShmRingHeader *ring;
+        ShmRingSlot *slot;
+        unsigned long long head, oldest, want, seq;
+        uint32_t length;
+
+        if (reader->ring == NULL) {
+            if (attach(reader) < 0)
+                return 0;
+            reader->next = platform_atomic_load_acquire_u64(&reader->ring->head);
+        }
+        ring = reader->ring;
+
+        if (platform_atomic_load_acquire_u64(&ring->generation) != reader->generation &&
+            resync(reader) < 0)
+            return 0;
+        ring = reader->ring;
+
+        head = platform_atomic_load_acquire_u64(&ring->head);
+        if (reader->next >= head)
+            return 0;
+
+        oldest = head > ring->slot_count ? head - ring->slot_count : 0;
+        if (reader->next < oldest) {
+            reader->lost += oldest - reader->next;
+            reader->next = oldest;
+        }
+
+        slot = shm_ring_slot(ring, reader->next);
+        want = 2 * reader->next + 2;
+        seq = platform_atomic_load_acquire_u64(&slot->seq);
+        if (seq != want) {
+            if (seq < want)
+                return 0;           /* Published head but slot not visible yet */
+            continue;               /* Overwritten: recompute the oldest record */
+        }
+
+        length = slot->length;
+        if (length > SHM_RING_RECORD_MAX)
+            length = SHM_RING_RECORD_MAX;
+        if (length > len)
+            return -1;
+
+        memcpy(buffer, slot->data, length);
+        if (info != NULL) {
+            info->sequence = reader->next;
+            info->start_time = slot->start_time;
+            info->end_time = slot->end_time;
+            info->length = length;
+        }
+
+        /* The copy is valid only if the producer did not start this slot again */
+        platform_atomic_fence();
+        if (platform_atomic_load_u64(&slot->seq) != want)
+            continue;
+
+        reader->next++;
+        return 1;
+    }
+}
+
+int shm_reader_wait(ShmReader *reader, int timeout_ms) {
+    ShmRingHeader *ring = reader->ring;
+
+    if (ring == NULL) {
+        platform_sleep_ms((unsigned int)(timeout_ms > 0 ? timeout_ms : 0));
+        return 0;
+    }
+
+#ifdef __linux__
+    {
+        unsigned int seen = __atomic_load_n(&ring->notify, __ATOMIC_ACQUIRE);
+        struct timespec ts;
+
+        if (platform_atomic_load_acquire_u64(&ring->head) > reader->next)
+            return 1;
+
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+
+        /* Producer bumps notify, fences, then checks waiters */
+        __atomic_add_fetch(&ring->waiters, 1, __ATOMIC_RELAXED);
+        platform_atomic_fence();
+        if (platform_atomic_load_acquire_u64(&ring->head) <= reader->next)
+            syscall(SYS_futex, &ring->notify, FUTEX_WAIT, seen, &ts, NULL, 0);
+        __atomic_sub_fetch(&ring->waiters, 1, __ATOMIC_RELAXED);
+    }
+#else
+    {
+        long long deadline = platform_monotonic_us() + (long long)timeout_ms * 1000;
+
+        while (platform_atomic_load_acquire_u64(&ring->head) <= reader->next &&
+               platform_monotonic_us() < deadline)
+            platform_sleep_ms(1);
+    }
+#endif
+
+    return platform_atomic_load_acquire_u64(&ring->head) > reader->next;
+}
+
+unsigned long long shm_reader_lost(const ShmReader *reader) {
+    return reader->lost;
+}
+
+const ShmRingHeader* shm_reader_header(const ShmReader *reader) {
+    return reader->ring;
+}
+
+void shm_reader_close(ShmReader *reader) {
+    if (reader == NULL)
+        return;
+    detach(reader);
+    free(reader);
+}
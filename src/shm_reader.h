@@ -0,0 +1,48 @@
+#ifndef SHM_READER_H
+#define SHM_READER_H
+
+/*
+ * Reader side of the shared-memory stream rings (see shm_ring.h). Each
+ * reader is independent and never blocks the producer; a reader that
+ * falls more than slot_count records behind skips ahead and counts the
+ * records it lost.
+ *
+ * Build a consumer with shm_reader.c (add -lrt on older glibc), e.g.
+ * tools/shm_consumer.c.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "shm_ring.h"
+
+typedef struct ShmReader ShmReader;
+
+typedef struct {
+    unsigned long long sequence;    /* Record number in the segment */
+    double start_time;              /* Epoch seconds, UTC */
+    double end_time;
+    uint32_t length;
+} ShmRecordInfo;
+
+/*
+ * Attach to a segment by name (see shm_ring_name()). Starts after the
+ * newest record, or at the oldest one still held when from_oldest is set.
+ * NULL if the segment does not exist yet.
+ */
+ShmReader* shm_reader_open(const char *name, int from_oldest);
+
+/* Copy the next record into buffer: 1 = record, 0 = none yet, -1 = buffer too small */
+int shm_reader_next(ShmReader *reader, char *buffer, size_t len, ShmRecordInfo *info);
+
+/* Block until a record may be ready or timeout_ms passes; 1 = ready, 0 = timeout */
+int shm_reader_wait(ShmReader *reader, int timeout_ms);
+
+/* Records skipped because the producer overwrote them first */
+unsigned long long shm_reader_lost(const ShmReader *reader);
+
+/* Channel header of the attached segment */
+const ShmRingHeader* shm_reader_header(const ShmReader *reader);
+
+void shm_reader_close(ShmReader *reader);
+
+#endif /* SHM_READER_H */
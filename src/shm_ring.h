@@ -0,0 +1,74 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+/*
+ * Layout of the shared-memory stream rings written by shm_export.c and
+ * read by shm_reader.c. One segment per channel, named
+ * "/<prefix>.NET.STA.LOC.CHA" (POSIX shm_open, or "Local\<prefix>..." file
+ * mapping on Windows).
+ *
+ * Single producer, any number of readers, no locks. Record n (counting from
+ * 0 since the segment was created) lives in slot n % slot_count. Each slot
+ * is a seqlock: the producer stores 2n+1 in seq, copies the record, then
+ * stores 2n+2 and finally head = n+1. A reader copies slot n only while seq
+ * reads 2n+2 before and after the copy; anything else means the producer
+ * lapped it. generation changes whenever the producer reattaches to an
+ * existing segment (restart), which tells readers to resynchronize.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SHM_RING_MAGIC 0x52494e47u      /* "RING" */
+#define SHM_RING_VERSION 1
+#define SHM_RING_RECORD_MAX 512         /* Payload bytes per slot */
+#define SHM_RING_NAME_MAX 128
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;                /* Power of two */
+    uint32_t slot_size;                 /* Bytes per slot, header included */
+    volatile unsigned long long generation;
+    volatile unsigned long long head;   /* Records published so far */
+    volatile unsigned long long tail;   /* Oldest record still in the ring */
+    volatile unsigned int notify;       /* Bumped per record, futex word on Linux */
+    volatile unsigned int waiters;      /* Readers blocked on notify */
+    char network[4];
+    char station[8];
+    char location[4];
+    char channel[4];
+    double sample_rate;
+    char reserved[48];                  /* Pads the header to 128 bytes */
+} ShmRingHeader;
+
+typedef struct {
+    volatile unsigned long long seq;    /* 2n+1 while writing record n, 2n+2 when done */
+    double start_time;                  /* Epoch seconds, UTC */
+    double end_time;
+    uint32_t length;
+    uint32_t reserved;
+    char data[SHM_RING_RECORD_MAX];
+} ShmRingSlot;
+
+static inline size_t shm_ring_size(uint32_t slot_count) {
+    return sizeof(ShmRingHeader) + (size_t)slot_count * sizeof(ShmRingSlot);
+}
+
+static inline ShmRingSlot* shm_ring_slot(ShmRingHeader *ring, unsigned long long n) {
+    return (ShmRingSlot*)((char*)ring + sizeof(ShmRingHeader)) + (n & (ring->slot_count - 1));
+}
+
+/* Segment name for a channel; an empty location gives "NET.STA..CHA" */
+static inline void shm_ring_name(char *name, size_t len, const char *prefix,
+                                 const char *network, const char *station,
+                                 const char *location, const char *channel) {
+#ifdef _WIN32
+    snprintf(name, len, "Local\\%s.%s.%s.%s.%s", prefix, network, station, location, channel);
+#else
+    snprintf(name, len, "/%s.%s.%s.%s.%s", prefix, network, station, location, channel);
+#endif
+}
+
+#endif /* SHM_RING_H */
@@ -0,0 +1,240 @@
+#include "sink.h"
+#include "platform.h"
+#include "metrics.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SINK_BATCH 64
+
+/* One copy of a record, shared by every queue it was put on */
+typedef struct {
+    volatile unsigned long long refs;
+    SinkRecord rec;
+    char streamid[16];
+    char data[1];
+} QueuedRecord;
+
+typedef struct {
+    char name[32];
+    SinkOps ops;
+    void *ctx;
+    int depth;                      /* 0 = called inline */
+    QueuedRecord **queue;
+    int head;
+    int count;
+    int waiting;                    /* Thread blocked on cond */
+    int full;                       /* Dropping since the last accepted record */
+    int running;
+    PlatformMutex lock;
+    PlatformCond cond;
+    PlatformThread thread;
+    MetricCounter *written_metric;
+    MetricCounter *dropped_metric;
+    MetricCounter *error_metric;
+    MetricGauge *queued_metric;
+} Sink;
+
+static Sink *g_sinks[SINK_MAX];
+static int g_sink_count = 0;
+
+static QueuedRecord* record_copy(const SinkRecord *rec) {
+    QueuedRecord *qr = (QueuedRecord*)malloc(sizeof(QueuedRecord) + rec->length);
+
+    if (qr == NULL)
+        return NULL;
+    qr->refs = 1;                   /* Held by the dispatcher until every queue has it */
+    qr->rec = *rec;
+    strncpy(qr->streamid, rec->streamid, sizeof(qr->streamid) - 1);
+    qr->streamid[sizeof(qr->streamid) - 1] = '\0';
+    memcpy(qr->data, rec->record, rec->length);
+    qr->rec.streamid = qr->streamid;
+    qr->rec.record = qr->data;
+    return qr;
+}
+
+static void record_release(QueuedRecord *qr) {
+    /* Other holders' reads of the record happen before the free */
+    if (platform_atomic_sub_release_u64(&qr->refs, 1) == 1) {
+        platform_atomic_fence_acquire();
+        free(qr);
+    }
+}
+
+static void deliver(Sink *sink, const SinkRecord *rec) {
+    if (sink->ops.write(rec, sink->ctx) < 0)
+        metrics_counter_add(sink->error_metric, 1);
+    else
+        metrics_counter_add(sink->written_metric, 1);
+}
+
+static PLATFORM_THREAD_FUNC(sink_thread_func) {
+    Sink *sink = (Sink*)arg;
+    QueuedRecord *batch[SINK_BATCH];
+
+    for (;;) {
+        int n = 0, left, i;
+
+        platform_mutex_lock(&sink->lock);
+        while (sink->count == 0 && sink->running) {
+            sink->waiting = 1;
+            platform_cond_wait(&sink->cond, &sink->lock);
+            sink->waiting = 0;
+        }
+        if (sink->count == 0) {
+            platform_mutex_unlock(&sink->lock);
+            break;
+        }
+        while (n < SINK_BATCH && sink->count > 0) {
+            batch[n++] = sink->queue[sink->head];
+            sink->head = (sink->head + 1) % sink->depth;
+            sink->count--;
+        }
+        left = sink->count;
+        platform_mutex_unlock(&sink->lock);
+
+        metrics_gauge_set(sink->queued_metric, (double)left);
+        for (i = 0; i < n; i++) {
+            deliver(sink, &batch[i]->rec);
+            record_release(batch[i]);
+        }
+        if (left == 0 && sink->ops.flush != NULL)
+            sink->ops.flush(sink->ctx);
+    }
+
+    if (sink->ops.flush != NULL)
+        sink->ops.flush(sink->ctx);
+    PLATFORM_THREAD_RETURN;
+}
+
+int sink_add(const char *name, const SinkOps *ops, void *ctx, int queue_depth) {
+    char labels[64];
+    Sink *sink;
+
+    if (g_sink_count == SINK_MAX || ops == NULL || ops->write == NULL)
+        return -1;
+
+    sink = (Sink*)calloc(1, sizeof(Sink));
+    if (sink == NULL)
+        return -1;
+    strncpy(sink->name, name, sizeof(sink->name) - 1);
+    sink->ops = *ops;
+    sink->ctx = ctx;
+    sink->depth = queue_depth > 0 ? queue_depth : 0;
+
+    snprintf(labels, sizeof(labels), "sink=\"%s\"", sink->name);
+    sink->written_metric = metrics_counter("sink_records_total", labels,
+                                           "Records delivered to an output sink");
+    sink->dropped_metric = metrics_counter("sink_dropped_total", labels,
+                                           "Records dropped because the sink queue was full");
+    sink->error_metric = metrics_counter("sink_errors_total", labels,
+                                         "Records the sink failed to write");
+    sink->queued_metric = metrics_gauge("sink_queue_records", labels,
+                                        "Records waiting in the sink queue");
+
+    if (sink->depth > 0) {
+        sink->queue = (QueuedRecord**)calloc((size_t)sink->depth, sizeof(QueuedRecord*));
+        if (sink->queue == NULL) {
+            free(sink);
+            return -1;
+        }
+        platform_mutex_init(&sink->lock);
+        platform_cond_init(&sink->cond);
+        sink->running = 1;
+        if (platform_thread_create(&sink->thread, sink_thread_func, sink) < 0) {
+            fprintf(stderr, "[Sink] Failed to create thread for %s\n", sink->name);
+            platform_cond_destroy(&sink->cond);
+            platform_mutex_destroy(&sink->lock);
+            free(sink->queue);
+            free(sink);
+            return -1;
+        }
+    }
+
+    g_sinks[g_sink_count++] = sink;
+    if (sink->depth > 0)
+        printf("[Sink] %s: own thread, queue of %d records\n", sink->name, sink->depth);
+    else
+        printf("[Sink] %s: inline\n", sink->name);
+    return 0;
+}
+
+int sink_count(void) {
+    return g_sink_count;
+}
+
+void sink_dispatch(const char *streamid, const char *record, uint32_t length,
+                   const MSeedHeader *hdr, unsigned long long seqnum, void *ctx) {
+    SinkRecord rec;
+    QueuedRecord *qr = NULL;
+    int i;
+
+    (void)ctx;
+
+    rec.streamid = streamid;
+    rec.record = record;
+    rec.length = length;
+    rec.hdr = *hdr;
+    rec.seqnum = seqnum;
+
+    for (i = 0; i < g_sink_count; i++) {
+        Sink *sink = g_sinks[i];
+        int accepted = 0, wake = 0;
+
+        if (sink->depth == 0) {
+            deliver(sink, &rec);
+            continue;
+        }
+
+        if (qr == NULL)
+            qr = record_copy(&rec);
+
+        platform_mutex_lock(&sink->lock);
+        if (qr != NULL && sink->count < sink->depth) {
+            platform_atomic_add_u64(&qr->refs, 1);
+            sink->queue[(sink->head + sink->count) % sink->depth] = qr;
+            sink->count++;
+            sink->full = 0;
+            accepted = 1;
+            wake = sink->waiting;
+        } else if (!sink->full) {
+            sink->full = 1;
+            LOG_WARN(LOG_CAT_SINK, "%s queue full (%d records), dropping records",
+                     sink->name, sink->depth);
+        }
+        if (wake)
+            platform_cond_signal(&sink->cond);
+        platform_mutex_unlock(&sink->lock);
+
+        if (!accepted)
+            metrics_counter_add(sink->dropped_metric, 1);
+    }
+
+    if (qr != NULL)
+        record_release(qr);
+}
+
+void sink_stop_all(void) {
+    int i;
+
+    for (i = 0; i < g_sink_count; i++) {
+        Sink *sink = g_sinks[i];
+
+        if (sink->depth > 0) {
+            platform_mutex_lock(&sink->lock);
+            sink->running = 0;
+            platform_cond_signal(&sink->cond);
+            platform_mutex_unlock(&sink->lock);
+            platform_thread_join(sink->thread);
+            platform_cond_destroy(&sink->cond);
+            platform_mutex_destroy(&sink->lock);
+            free(sink->queue);
+        }
+        if (sink->ops.close != NULL)
+            sink->ops.close(sink->ctx);
+        free(sink);
+        g_sinks[i] = NULL;
+    }
+    g_sink_count = 0;
+}
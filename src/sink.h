@@ -0,0 +1,54 @@
+#ifndef SINK_H
+#define SINK_H
+
+/*
+ * Output pipeline behind the ring buffers. The ringclient parses each
+ * record once and sink_dispatch() hands the same record to every
+ * registered sink:
+ *
+ *   - inline sinks (queue_depth 0) are called on the receive thread with
+ *     the caller's buffer; use only for sinks that never block, such as
+ *     the shared-memory export or the SeedLink relay
+ *   - queued sinks get their own thread and a bounded queue of records.
+ *     The record is copied once and shared by reference between every
+ *     queue it enters. A full queue drops the record for that sink only,
+ *     so a slow disk or network peer cannot stall ingest or other sinks.
+ *
+ * sink_dispatch() is a RingClientRecordCallback. Add sinks before the
+ * ringclient starts; sink_stop_all() after it stops drains the queues.
+ */
+
+#include <stdint.h>
+#include "mseed_util.h"
+
+#define SINK_MAX 8
+
+typedef struct {
+    const char *streamid;           /* NET_STA, as libslink reports it */
+    const char *record;
+    uint32_t length;
+    MSeedHeader hdr;
+    unsigned long long seqnum;      /* Upstream sequence, ~0 if unknown */
+} SinkRecord;
+
+typedef struct {
+    /* Deliver one record; -1 counts it as a write error */
+    int (*write)(const SinkRecord *rec, void *ctx);
+    /* Queue ran empty: push out anything buffered. Optional */
+    void (*flush)(void *ctx);
+    /* Queue drained at shutdown; release ctx. Optional */
+    void (*close)(void *ctx);
+} SinkOps;
+
+/* name labels the sink's metrics and log messages; 0 on success */
+int sink_add(const char *name, const SinkOps *ops, void *ctx, int queue_depth);
+
+int sink_count(void);
+
+void sink_dispatch(const char *streamid, const char *record, uint32_t length,
+                   const MSeedHeader *hdr, unsigned long long seqnum, void *ctx);
+
+/* Drain and close every sink, then forget them */
+void sink_stop_all(void);
+
+#endif /* SINK_H */
@@ -0,0 +1,756 @@
+#include "slrelay.h"
+#include "seedlink_proto.h"
+#include "netutil.h"
+#include "platform.h"
+#include "metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #define strcasecmp _stricmp
+#endif
+
+#define SLRELAY_BUCKETS 1024
+#define SLRELAY_SEND_BATCH 64
+#define SLRELAY_MAX_SUBS 64
+#define SLRELAY_MAX_SELECTORS 8
+#define SLRELAY_CURSOR_DONE (~0ULL)
+#define SLRELAY_NO_SEQUENCE (~0ULL)     /* libslink SL_UNSETSEQUENCE */
+#define SLRELAY_INFO_CHUNK (SLPROTO_RECORD_SIZE - 64)
+#define SLRELAY_SEND_TIMEOUT_MS 10000   /* A client that stops reading this long is dropped */
+
+typedef struct {
+    char record[SLPROTO_RECORD_SIZE];
+    unsigned long seq;
+    double start_time;
+    char location[3];
+    char channel[4];
+} StoredRecord;
+
+typedef struct RelayStation {
+    char network[3];
+    char station[6];
+    StoredRecord *history;          /* Ring of g_history records */
+    unsigned long long written;     /* Records ever added */
+    unsigned long next_seq;         /* Used when upstream gives no sequence */
+    struct RelayStation *hash_next;
+} RelayStation;
+
+typedef struct {
+    char station[16];
+    char network[8];
+    char selectors[SLRELAY_MAX_SELECTORS][16];
+    int selector_count;
+    long start_seq;                 /* -1 = only new records */
+    double begin_time;
+    double end_time;                /* 0 = open ended */
+    int has_time;
+} Subscription;
+
+typedef struct {
+    NetSocket sock;
+    PlatformThread thread;
+    volatile int finished;
+    Subscription subs[SLRELAY_MAX_SUBS];
+    int sub_count;
+    int batch_mode;
+    int fetch;
+    int uni_station;
+    unsigned long long *cursor;     /* Next history index per station */
+    int *sub_index;                 /* Subscription per station, -1 = none */
+    int known;                      /* Stations with a positioned cursor */
+    int capacity;
+    char *sendbuf;
+    long sent;
+    char inbuf[1024];
+    size_t inused;
+} Client;
+
+/* Stations only grow while running; the receive thread is the only writer */
+static RelayStation **g_stations = NULL;
+static int g_station_count = 0;
+static int g_station_capacity = 0;
+static RelayStation *g_buckets[SLRELAY_BUCKETS];
+
+static PlatformMutex g_lock;
+static PlatformCond g_cond;
+static unsigned long long g_generation = 0;    /* Bumped for every record */
+static int g_waiters = 0;                      /* Clients blocked on g_cond */
+
+static int g_history = 600;
+static int g_max_clients = 16;
+static volatile int g_running = 0;
+static NetSocket g_listener = NET_INVALID_SOCKET;
+static PlatformThread g_accept_thread;
+static Client *g_clients[SLRELAY_MAX_CLIENTS];
+static double g_started = 0.0;
+static volatile unsigned long long g_active = 0;
+
+static MetricGauge *g_clients_metric = NULL;
+static MetricCounter *g_sent_metric = NULL;
+static MetricCounter *g_overrun_metric = NULL;
+
+/* ============================================================================
+ * RECORD HISTORY
+ * ============================================================================ */
+
+static unsigned int hash_station(const char *network, const char *station) {
+    unsigned int h = 2166136261u;
+
+    while (*network)
+        h = (h ^ (unsigned char)*network++) * 16777619u;
+    h = (h ^ '_') * 16777619u;
+    while (*station)
+        h = (h ^ (unsigned char)*station++) * 16777619u;
+    return h;
+}
+
+static RelayStation* find_or_add_station(const MSeedHeader *hdr) {
+    unsigned int b = hash_station(hdr->network, hdr->station) & (SLRELAY_BUCKETS - 1);
+    RelayStation *st;
+
+    for (st = g_buckets[b]; st != NULL; st = st->hash_next) {
+        if (strcmp(st->network, hdr->network) == 0 && strcmp(st->station, hdr->station) == 0)
+            return st;
+    }
+
+    st = (RelayStation*)calloc(1, sizeof(RelayStation));
+    if (st == NULL)
+        return NULL;
+    st->history = (StoredRecord*)calloc((size_t)g_history, sizeof(StoredRecord));
+    if (st->history == NULL) {
+        free(st);
+        return NULL;
+    }
+    memcpy(st->network, hdr->network, sizeof(hdr->network));
+    memcpy(st->station, hdr->station, sizeof(hdr->station));
+    st->next_seq = 1;
+
+    /* Clients read the station list under the lock */
+    platform_mutex_lock(&g_lock);
+    if (g_station_count == g_station_capacity) {
+        int capacity = g_station_capacity ? g_station_capacity * 2 : 64;
+        RelayStation **grown = (RelayStation**)realloc(g_stations,
+                                                       (size_t)capacity * sizeof(RelayStation*));
+        if (grown == NULL) {
+            platform_mutex_unlock(&g_lock);
+            free(st->history);
+            free(st);
+            return NULL;
+        }
+        g_stations = grown;
+        g_station_capacity = capacity;
+    }
+    g_stations[g_station_count++] = st;
+    st->hash_next = g_buckets[b];
+    g_buckets[b] = st;
+    platform_mutex_unlock(&g_lock);
+
+    return st;
+}
+
+static int slrelay_write(const SinkRecord *rec, void *ctx) {
+    const MSeedHeader *hdr = &rec->hdr;
+    RelayStation *st;
+    StoredRecord *slot;
+
+    (void)ctx;
+
+    /* SeedLink v3 packets carry exactly one 512-byte record */
+    if (!g_running || rec->length != SLPROTO_RECORD_SIZE)
+        return 0;
+
+    st = find_or_add_station(hdr);
+    if (st == NULL)
+        return -1;
+
+    platform_mutex_lock(&g_lock);
+    slot = &st->history[st->written % (unsigned long long)g_history];
+    memcpy(slot->record, rec->record, SLPROTO_RECORD_SIZE);
+    slot->start_time = hdr->start_time;
+    memcpy(slot->location, hdr->location, sizeof(slot->location));
+    memcpy(slot->channel, hdr->channel, sizeof(slot->channel));
+    slot->seq = rec->seqnum != SLRELAY_NO_SEQUENCE
+                ? (unsigned long)(rec->seqnum & SLPROTO_SEQ_MASK) : st->next_seq;
+    st->next_seq = (slot->seq + 1) & SLPROTO_SEQ_MASK;
+    st->written++;
+    g_generation++;
+    if (g_waiters > 0)
+        platform_cond_broadcast(&g_cond);
+    platform_mutex_unlock(&g_lock);
+    return 0;
+}
+
+const SinkOps slrelay_ops = { slrelay_write, NULL, NULL };
+
+/* ============================================================================
+ * CLIENT PROTOCOL
+ * ============================================================================ */
+
+static int send_text(Client *client, const char *text) {
+    return net_send_all(client->sock, text, strlen(text));
+}
+
+static int send_reply(Client *client, int ok) {
+    if (client->batch_mode)
+        return 0;
+    return send_text(client, ok ? "OK\r\n" : "ERROR\r\n");
+}
+
+/* INFO responses: XML text in ASCII log records, '*' marks continuation */
+static int send_info(Client *client, const char *xml) {
+    char packet[SLPROTO_PACKET_SIZE];
+    size_t len = strlen(xml);
+    size_t offset = 0;
+
+    do {
+        size_t chunk = len - offset > SLRELAY_INFO_CHUNK ? SLRELAY_INFO_CHUNK : len - offset;
+        int last = offset + chunk >= len;
+
+        memcpy(packet, last ? "SLINFO  " : "SLINFO *", SLPROTO_HEADER_SIZE);
+        mseed_build_record(packet + SLPROTO_HEADER_SIZE, SLPROTO_RECORD_SIZE,
+                           "", "INFO", "", "LOG", 0, platform_time_now(), 0.0, NULL, 0);
+        packet[SLPROTO_HEADER_SIZE + 30] = (char)(chunk >> 8);
+        packet[SLPROTO_HEADER_SIZE + 31] = (char)(chunk & 0xFF);
+        packet[SLPROTO_HEADER_SIZE + 52] = 0;       /* ASCII encoding */
+        memcpy(packet + SLPROTO_HEADER_SIZE + 64, xml + offset, chunk);
+
+        if (net_send_all(client->sock, packet, sizeof(packet)) < 0)
+            return -1;
+        offset += chunk;
+    } while (offset < len);
+
+    return 0;
+}
+
+static int handle_info(Client *client, const char *level) {
+    char *xml;
+    size_t size, used;
+    int i, rc;
+
+    platform_mutex_lock(&g_lock);
+    size = 256 + (size_t)g_station_count * 96;
+    xml = (char*)malloc(size);
+    if (xml == NULL) {
+        platform_mutex_unlock(&g_lock);
+        return -1;
+    }
+
+    used = (size_t)snprintf(xml, size,
+        "<?xml version=\"1.0\"?><seedlink software=\"SeisComP_To_SW_View relay\" "
+        "organization=\"SeisComP_To_SW_View\" started=\"%.0f\">", g_started);
+    if (strcasecmp(level, "STATIONS") == 0 || strcasecmp(level, "STREAMS") == 0) {
+        for (i = 0; i < g_station_count && used < size; i++) {
+            RelayStation *st = g_stations[i];
+            unsigned long long oldest = st->written > (unsigned long long)g_history
+                                        ? st->written - (unsigned long long)g_history : 0;
+            used += (size_t)snprintf(xml + used, size - used,
+                "<station name=\"%s\" network=\"%s\" begin_seq=\"%06lX\" end_seq=\"%06lX\"/>",
+                st->station, st->network,
+                st->history[oldest % (unsigned long long)g_history].seq, st->next_seq);
+        }
+    }
+    platform_mutex_unlock(&g_lock);
+    if (used < size)
+        snprintf(xml + used, size - used, "</seedlink>");
+
+    rc = send_info(client, xml);
+    free(xml);
+    return rc;
+}
+
+static int handle_cat(Client *client) {
+    char line[64];
+    int i, rc = 0;
+
+    for (i = 0; rc == 0; i++) {
+        platform_mutex_lock(&g_lock);
+        if (i >= g_station_count) {
+            platform_mutex_unlock(&g_lock);
+            break;
+        }
+        snprintf(line, sizeof(line), "%-2s %-5s relayed station\r\n",
+                 g_stations[i]->network, g_stations[i]->station);
+        platform_mutex_unlock(&g_lock);
+        rc = send_text(client, line);
+    }
+    return rc < 0 ? -1 : send_text(client, "END");
+}
+
+/* Copy a command argument; -1 if it does not fit, so it is refused, not cut */
+static int copy_arg(char *dst, size_t size, const char *arg) {
+    size_t len = strlen(arg);
+
+    if (len >= size)
+        return -1;
+    memcpy(dst, arg, len + 1);
+    return 0;
+}
+
+static Subscription* current_sub(Client *client) {
+    if (client->sub_count == 0) {
+        /* Uni-station mode: no STATION command, everything is selected */
+        client->uni_station = 1;
+        memset(&client->subs[0], 0, sizeof(Subscription));
+        strcpy(client->subs[0].station, "*");
+        client->subs[0].start_seq = -1;
+        client->sub_count = 1;
+    }
+    return &client->subs[client->sub_count - 1];
+}
+
+/* Returns 0 to keep reading commands, 1 to start streaming, -1 to close */
+static int handle_command(Client *client, const char *line) {
+    SlCommand cmd;
+    Subscription *sub;
+
+    slproto_parse_command(line, &cmd);
+
+    switch (cmd.type) {
+    case SLCMD_HELLO:
+        if (send_text(client, "SeedLink v3.1 (SeisComP_To_SW_View relay) :: "
+                              "SLPROTO:3.1 CAP NSWILDCARD BATCH\r\n") < 0)
+            return -1;
+        return send_text(client, "SeisComP_To_SW_View\r\n") < 0 ? -1 : 0;
+
+    case SLCMD_CAPABILITIES:
+        return send_reply(client, 1) < 0 ? -1 : 0;
+
+    case SLCMD_BATCH:
+        client->batch_mode = 1;
+        return send_text(client, "OK\r\n") < 0 ? -1 : 0;
+
+    case SLCMD_STATION:
+        if (cmd.argc < 1 || client->uni_station || client->sub_count >= SLRELAY_MAX_SUBS)
+            return send_reply(client, 0) < 0 ? -1 : 0;
+        sub = &client->subs[client->sub_count];
+        memset(sub, 0, sizeof(*sub));
+        if (copy_arg(sub->station, sizeof(sub->station), cmd.argv[0]) < 0 ||
+            (cmd.argc > 1 && copy_arg(sub->network, sizeof(sub->network), cmd.argv[1]) < 0))
+            return send_reply(client, 0) < 0 ? -1 : 0;
+        sub->start_seq = -1;
+        client->sub_count++;
+        return send_reply(client, 1) < 0 ? -1 : 0;
+
+    case SLCMD_SELECT:
+        sub = current_sub(client);
+        if (cmd.argc < 1 || sub->selector_count >= SLRELAY_MAX_SELECTORS ||
+            copy_arg(sub->selectors[sub->selector_count], sizeof(sub->selectors[0]),
+                     cmd.argv[0]) < 0)
+            return send_reply(client, 0) < 0 ? -1 : 0;
+        sub->selector_count++;
+        return send_reply(client, 1) < 0 ? -1 : 0;
+
+    case SLCMD_FETCH:
+        client->fetch = 1;
+        /* Fall through */
+    case SLCMD_DATA:
+        sub = current_sub(client);
+        sub->start_seq = cmd.argc > 0 ? slproto_parse_sequence(cmd.argv[0]) : -1;
+        if (cmd.argc > 1 && slproto_parse_time(cmd.argv[1], &sub->begin_time) == 0)
+            sub->has_time = 1;
+        if (client->uni_station)
+            return 1;
+        return send_reply(client, 1) < 0 ? -1 : 0;
+
+    case SLCMD_TIME:
+        sub = current_sub(client);
+        if (cmd.argc < 1 || slproto_parse_time(cmd.argv[0], &sub->begin_time) < 0)
+            return send_reply(client, 0) < 0 ? -1 : 0;
+        sub->has_time = 1;
+        if (cmd.argc > 1)
+            slproto_parse_time(cmd.argv[1], &sub->end_time);
+        if (client->uni_station)
+            return 1;
+        return send_reply(client, 1) < 0 ? -1 : 0;
+
+    case SLCMD_END:
+        return client->sub_count > 0 ? 1 : -1;
+
+    case SLCMD_INFO:
+        return handle_info(client, cmd.argc > 0 ? cmd.argv[0] : "ID") < 0 ? -1 : 0;
+
+    case SLCMD_CAT:
+        return handle_cat(client) < 0 ? -1 : 0;
+
+    case SLCMD_BYE:
+        return -1;
+
+    default:
+        return send_text(client, "ERROR\r\n") < 0 ? -1 : 0;
+    }
+}
+
+/* Read and dispatch whatever commands are pending; mode as handle_command */
+static int read_commands(Client *client, int timeout_ms) {
+    char line[SLPROTO_MAX_LINE];
+    int ready = net_wait_readable(client->sock, timeout_ms);
+    long n;
+    int rc = 0;
+
+    if (ready <= 0)
+        return ready;
+
+    n = net_recv(client->sock, client->inbuf + client->inused,
+                 sizeof(client->inbuf) - client->inused);
+    if (n <= 0)
+        return -1;
+    client->inused += (size_t)n;
+
+    while (rc == 0 && slproto_take_line(client->inbuf, &client->inused, line, sizeof(line)))
+        rc = handle_command(client, line);
+    return rc;
+}
+
+/*
+ * Position the cursor of one station from the client's subscriptions
+ * (lock held). Stations present at END start with new records unless a
+ * sequence or time asks for backfill; stations that appear later start
+ * with their first record.
+ */
+static void position_cursor(Client *client, int i, int existing) {
+    RelayStation *st = g_stations[i];
+    unsigned long long history = (unsigned long long)g_history;
+    unsigned long long oldest = st->written > history ? st->written - history : 0;
+    unsigned long long idx;
+    Subscription *sub;
+    int j;
+
+    client->sub_index[i] = -1;
+    client->cursor[i] = existing ? st->written : oldest;
+    for (j = 0; j < client->sub_count; j++) {
+        if (slproto_match_station(client->subs[j].station, client->subs[j].network,
+                                  st->station, st->network)) {
+            client->sub_index[i] = j;
+            break;
+        }
+    }
+    if (client->sub_index[i] < 0)
+        return;
+    sub = &client->subs[client->sub_index[i]];
+
+    if (sub->start_seq >= 0 && st->written > oldest) {
+        /* Resume at the requested sequence, or the oldest kept record */
+        unsigned long oldest_seq = st->history[oldest % history].seq;
+        if (slproto_sequence_diff((unsigned long)sub->start_seq, oldest_seq) < 0) {
+            client->cursor[i] = oldest;
+        } else {
+            /* Upstream numbering may skip; take the first record at or after it */
+            for (idx = oldest; idx < st->written; idx++) {
+                if (slproto_sequence_diff(st->history[idx % history].seq,
+                                          (unsigned long)sub->start_seq) >= 0) {
+                    client->cursor[i] = idx;
+                    break;
+                }
+            }
+        }
+    } else if (sub->has_time) {
+        client->cursor[i] = st->written;
+        for (idx = oldest; idx < st->written; idx++) {
+            if (st->history[idx % history].start_time >= sub->begin_time) {
+                client->cursor[i] = idx;
+                break;
+            }
+        }
+    }
+}
+
+/* Pick up stations added since the last pass (lock held); -1 if out of memory */
+static int sync_stations(Client *client, int existing) {
+    if (client->capacity < g_station_capacity) {
+        unsigned long long *cursor = (unsigned long long*)realloc(
+            client->cursor, (size_t)g_station_capacity * sizeof(unsigned long long));
+        int *sub_index;
+
+        if (cursor == NULL)
+            return -1;
+        client->cursor = cursor;
+        sub_index = (int*)realloc(client->sub_index, (size_t)g_station_capacity * sizeof(int));
+        if (sub_index == NULL)
+            return -1;
+        client->sub_index = sub_index;
+        client->capacity = g_station_capacity;
+    }
+
+    for (; client->known < g_station_count; client->known++)
+        position_cursor(client, client->known, existing);
+    return 0;
+}
+
+static int record_selected(const Subscription *sub, const StoredRecord *rec) {
+    int i;
+
+    if (sub->selector_count == 0)
+        return 1;
+    for (i = 0; i < sub->selector_count; i++) {
+        if (slproto_match_selector(sub->selectors[i], rec->location, rec->channel, 'D'))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Copy up to one batch of pending packets into sendbuf (lock held).
+ * Sets *finished when every subscribed time window has closed and
+ * *caught_up when no station has records left to send.
+ */
+static int collect_batch(Client *client, int *finished, int *caught_up) {
+    unsigned long long history = (unsigned long long)g_history;
+    int count = 0;
+    int open_streams = 0;
+    int windowed = 0;
+    int i;
+
+    *caught_up = 1;
+    for (i = 0; i < client->known; i++) {
+        RelayStation *st = g_stations[i];
+        Subscription *sub;
+
+        if (client->sub_index[i] < 0)
+            continue;
+        sub = &client->subs[client->sub_index[i]];
+        if (sub->has_time && sub->end_time > 0.0)
+            windowed = 1;
+        if (client->cursor[i] == SLRELAY_CURSOR_DONE)
+            continue;
+        open_streams++;
+
+        while (client->cursor[i] < st->written && count < SLRELAY_SEND_BATCH) {
+            StoredRecord *rec;
+            char *packet;
+
+            /* Slow client: skip what the history no longer holds */
+            if (st->written - client->cursor[i] > history) {
+                metrics_counter_add(g_overrun_metric, st->written - history - client->cursor[i]);
+                client->cursor[i] = st->written - history;
+            }
+            rec = &st->history[client->cursor[i] % history];
+            client->cursor[i]++;
+
+            if (sub->has_time && sub->end_time > 0.0 && rec->start_time >= sub->end_time) {
+                client->cursor[i] = SLRELAY_CURSOR_DONE;
+                open_streams--;
+                break;
+            }
+            if (!record_selected(sub, rec))
+                continue;
+
+            packet = client->sendbuf + (size_t)count * SLPROTO_PACKET_SIZE;
+            slproto_format_header(packet, rec->seq);
+            memcpy(packet + SLPROTO_HEADER_SIZE, rec->record, SLPROTO_RECORD_SIZE);
+            count++;
+        }
+        if (client->cursor[i] != SLRELAY_CURSOR_DONE && client->cursor[i] < st->written)
+            *caught_up = 0;
+    }
+
+    *finished = windowed && open_streams == 0;
+    return count;
+}
+
+static PLATFORM_THREAD_FUNC(client_thread_func) {
+    Client *client = (Client*)arg;
+    unsigned long long seen_generation = 0;
+    int rc = 0;
+
+    /* Handshake until END (or DATA in uni-station mode) */
+    while (g_running && rc == 0)
+        rc = read_commands(client, 500);
+
+    if (rc == 1) {
+        platform_mutex_lock(&g_lock);
+        if (sync_stations(client, 1) < 0)
+            rc = -1;
+        platform_mutex_unlock(&g_lock);
+    }
+
+    while (g_running && rc >= 0) {
+        int finished = 0, caught_up = 0, count;
+
+        platform_mutex_lock(&g_lock);
+        if (g_generation == seen_generation) {
+            g_waiters++;
+            platform_cond_timedwait_ms(&g_cond, &g_lock, 200);
+            g_waiters--;
+        }
+        seen_generation = g_generation;
+        if (sync_stations(client, 0) < 0) {
+            platform_mutex_unlock(&g_lock);
+            break;
+        }
+        count = collect_batch(client, &finished, &caught_up);
+        platform_mutex_unlock(&g_lock);
+
+        if (count > 0) {
+            if (net_send_all(client->sock, client->sendbuf,
+                             (size_t)count * SLPROTO_PACKET_SIZE) < 0)
+                break;
+            client->sent += count;
+            metrics_counter_add(g_sent_metric, (unsigned long long)count);
+            if (!caught_up)
+                seen_generation = 0;    /* More pending: do not wait */
+        }
+
+        if (finished || (client->fetch && caught_up && count == 0)) {
+            send_text(client, "END");
+            break;
+        }
+
+        /* INFO keepalives and BYE may arrive while streaming */
+        rc = read_commands(client, 0);
+        if (rc == 1)
+            rc = 0;
+    }
+
+    net_close(client->sock);
+    metrics_gauge_set(g_clients_metric,
+                      (double)(platform_atomic_add_u64(&g_active, (unsigned long long)-1) - 1));
+    client->finished = 1;
+    PLATFORM_THREAD_RETURN;
+}
+
+/* ============================================================================
+ * SERVER
+ * ============================================================================ */
+
+static void free_client(Client *client) {
+    free(client->cursor);
+    free(client->sub_index);
+    free(client->sendbuf);
+    free(client);
+}
+
+static void reap_clients(int wait_all) {
+    int i;
+
+    for (i = 0; i < SLRELAY_MAX_CLIENTS; i++) {
+        Client *client = g_clients[i];
+        if (client && (client->finished || wait_all)) {
+            platform_thread_join(client->thread);
+            free_client(client);
+            g_clients[i] = NULL;
+        }
+    }
+}
+
+static void accept_client(NetSocket sock) {
+    Client *client;
+    int active = 0, slot = -1, i;
+
+    reap_clients(0);
+    for (i = 0; i < SLRELAY_MAX_CLIENTS; i++) {
+        if (g_clients[i])
+            active++;
+        else if (slot < 0)
+            slot = i;
+    }
+    if (slot < 0 || active >= g_max_clients) {
+        fprintf(stderr, "[SLRelay] Client limit (%d) reached, refusing connection\n",
+                g_max_clients);
+        net_close(sock);
+        return;
+    }
+
+    client = (Client*)calloc(1, sizeof(Client));
+    if (client == NULL) {
+        net_close(sock);
+        return;
+    }
+    client->sock = sock;
+    net_set_send_timeout(sock, SLRELAY_SEND_TIMEOUT_MS);
+    client->sendbuf = (char*)malloc((size_t)SLRELAY_SEND_BATCH * SLPROTO_PACKET_SIZE);
+    if (client->sendbuf == NULL ||
+        platform_thread_create(&client->thread, client_thread_func, client) < 0) {
+        net_close(sock);
+        free_client(client);
+        return;
+    }
+
+    g_clients[slot] = client;
+    metrics_gauge_set(g_clients_metric, (double)(platform_atomic_add_u64(&g_active, 1) + 1));
+}
+
+static PLATFORM_THREAD_FUNC(accept_thread_func) {
+    (void)arg;
+
+    while (g_running) {
+        NetSocket sock;
+
+        if (net_wait_readable(g_listener, 500) <= 0)
+            continue;
+        sock = net_accept(g_listener);
+        if (sock != NET_INVALID_SOCKET)
+            accept_client(sock);
+    }
+
+    PLATFORM_THREAD_RETURN;
+}
+
+int slrelay_start(const char *host, int port, int history, int max_clients) {
+    if (history <= 0 || max_clients <= 0 || net_init() < 0)
+        return -1;
+
+    g_history = history;
+    g_max_clients = max_clients > SLRELAY_MAX_CLIENTS ? SLRELAY_MAX_CLIENTS : max_clients;
+    g_started = platform_time_now();
+
+    g_clients_metric = metrics_gauge("slrelay_clients", NULL,
+                                     "SeedLink clients connected to the relay");
+    g_sent_metric = metrics_counter("slrelay_packets_sent_total", NULL,
+                                    "SeedLink packets sent to relay clients");
+    g_overrun_metric = metrics_counter("slrelay_overruns_total", NULL,
+                                       "Records skipped because a client fell behind the history");
+
+    g_listener = net_listen_tcp(host, port, 16);
+    if (g_listener == NET_INVALID_SOCKET) {
+        fprintf(stderr, "[SLRelay] Cannot listen on port %d\n", port);
+        return -1;
+    }
+
+    platform_mutex_init(&g_lock);
+    platform_cond_init(&g_cond);
+    g_running = 1;
+
+    if (platform_thread_create(&g_accept_thread, accept_thread_func, NULL) < 0) {
+        g_running = 0;
+        net_close(g_listener);
+        platform_cond_destroy(&g_cond);
+        platform_mutex_destroy(&g_lock);
+        return -1;
+    }
+
+    printf("[SLRelay] Serving SeedLink on %s:%d, %d records history per station\n",
+           (host && host[0]) ? host : "127.0.0.1", port, g_history);
+    return 0;
+}
+
+void slrelay_stop(void) {
+    int i;
+
+    if (!g_running)
+        return;
+
+    platform_mutex_lock(&g_lock);
+    g_running = 0;
+    platform_cond_broadcast(&g_cond);
+    platform_mutex_unlock(&g_lock);
+
+    platform_thread_join(g_accept_thread);
+    reap_clients(1);
+    net_close(g_listener);
+    g_listener = NET_INVALID_SOCKET;
+
+    for (i = 0; i < g_station_count; i++) {
+        free(g_stations[i]->history);
+        free(g_stations[i]);
+    }
+    free(g_stations);
+    g_stations = NULL;
+    g_station_count = 0;
+    g_station_capacity = 0;
+    memset(g_buckets, 0, sizeof(g_buckets));
+
+    platform_cond_destroy(&g_cond);
+    platform_mutex_destroy(&g_lock);
+}
@@ -0,0 +1,30 @@
+#ifndef SLRELAY_H
+#define SLRELAY_H
+
+/*
+ * Local SeedLink v3 server fed by the ringclient: every record written to
+ * a ring buffer is also kept in a per-station history of recent records
+ * and streamed to any number of downstream SeedLink clients, so one
+ * upstream connection can feed many consumers.
+ *
+ * Sequence numbers are the upstream ones (24-bit), so a client that
+ * reconnects with DATA <seq> resumes where it left off as long as the
+ * record is still within the last `history` records of its station.
+ *
+ * slrelay_ops is an inline sink (see sink.h) and runs on the receive
+ * thread; start before and stop after the ringclient thread.
+ */
+
+#include "sink.h"
+
+#define SLRELAY_MAX_CLIENTS 64
+
+/* host NULL or "" = 127.0.0.1; history is records kept per station; 0 on success */
+int slrelay_start(const char *host, int port, int history, int max_clients);
+
+extern const SinkOps slrelay_ops;
+
+/* Disconnect every client and free the histories */
+void slrelay_stop(void);
+
+#endif /* SLRELAY_H */
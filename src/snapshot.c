@@ -0,0 +1,514 @@
+#include "snapshot.h"
+#include "ringclient.h"
+#include "config.h"
+#include "platform.h"
+#include "metrics.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <io.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/types.h>
+    #include <sys/resource.h>
+    #ifdef __linux__
+        #include <sys/syscall.h>
+    #endif
+#endif
+
+#ifdef _WIN32
+    #define strtok_r strtok_s
+#endif
+
+#define SNAPSHOT_MAX_JOBS 4096
+#define SNAPSHOT_DONE_HISTORY 256
+#define SNAPSHOT_SETTLE_SEC 10.0        /* Allowance for data latency after the window */
+
+typedef struct {
+    char network[8];
+    char station[8];
+    char event[80];                     /* Directory under SnapshotConfig.dir */
+    double start;
+    double end;
+} SnapshotJob;
+
+typedef struct {
+    char key[16];                       /* NET.STA */
+    char (*neighbours)[16];
+    int count;
+} NeighbourList;
+
+static SnapshotConfig g_config;
+static SnapshotJob *g_jobs = NULL;      /* Pending, unordered */
+static int g_job_count = 0;
+static SnapshotJob g_done[SNAPSHOT_DONE_HISTORY];
+static int g_done_next = 0;
+static NeighbourList *g_neighbours = NULL;
+static int g_neighbour_count = 0;
+
+static PlatformMutex g_lock;
+static PlatformCond g_cond;
+static PlatformThread g_thread;
+static int g_running = 0;
+static int g_started = 0;
+
+static MetricCounter *g_jobs_metric = NULL;
+static MetricCounter *g_bytes_metric = NULL;
+static MetricCounter *g_failed_metric = NULL;
+static MetricGauge *g_pending_metric = NULL;
+
+/* ============================================================================
+ * NEIGHBOURS
+ * ============================================================================ */
+
+static int load_neighbours(const char *path) {
+    char line[4096];
+    FILE *fp = fopen(path, "r");
+    int stations = 0;
+
+    if (fp == NULL) {
+        fprintf(stderr, "[Snapshot] Cannot open neighbours file %s\n", path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char *save = NULL;
+        char *token = strtok_r(line, " \t,\r\n", &save);
+        NeighbourList *list;
+
+        if (token == NULL || token[0] == '#')
+            continue;
+
+        list = (NeighbourList*)realloc(g_neighbours,
+                                       (size_t)(g_neighbour_count + 1) * sizeof(NeighbourList));
+        if (list == NULL)
+            break;
+        g_neighbours = list;
+        list = &g_neighbours[g_neighbour_count++];
+        memset(list, 0, sizeof(*list));
+        strncpy(list->key, token, sizeof(list->key) - 1);
+
+        while ((token = strtok_r(NULL, " \t,\r\n", &save)) != NULL) {
+            char (*grown)[16] = (char (*)[16])realloc(list->neighbours,
+                                                      (size_t)(list->count + 1) * 16);
+            if (grown == NULL)
+                break;
+            list->neighbours = grown;
+            memset(list->neighbours[list->count], 0, 16);
+            strncpy(list->neighbours[list->count++], token, 15);
+        }
+        stations++;
+    }
+    fclose(fp);
+
+    printf("[Snapshot] Neighbours for %d stations from %s\n", stations, path);
+    return 0;
+}
+
+static const NeighbourList* find_neighbours(const char *network, const char *station) {
+    char key[16];
+    int i;
+
+    snprintf(key, sizeof(key), "%s.%s", network, station);
+    for (i = 0; i < g_neighbour_count; i++) {
+        if (strcmp(g_neighbours[i].key, key) == 0)
+            return &g_neighbours[i];
+    }
+    return NULL;
+}
+
+/* ============================================================================
+ * JOB QUEUE
+ * ============================================================================ */
+
+static int same_target(const SnapshotJob *a, const char *network, const char *station,
+                       const char *event) {
+    return strcmp(a->network, network) == 0 && strcmp(a->station, station) == 0 &&
+           strcmp(a->event, event) == 0;
+}
+
+/* Keep file name characters only; never "." or ".." */
+static void clean_name(char *name) {
+    size_t i;
+
+    for (i = 0; name[i]; i++) {
+        if (!isalnum((unsigned char)name[i]) && name[i] != '-' && name[i] != '.')
+            name[i] = '_';
+    }
+    if (name[0] == '.')
+        name[0] = '_';
+}
+
+/* Codes end up in file names; refuse anything that could leave the directory */
+static int safe_code(const char *code) {
+    return code[0] != '\0' && strchr(code, '/') == NULL && strchr(code, '\\') == NULL &&
+           strstr(code, "..") == NULL;
+}
+
+/* Merge into a pending job or queue a new one (lock held) */
+static void add_job(const char *network, const char *station, const char *event,
+                    double start, double end) {
+    SnapshotJob *job;
+    int i;
+
+    if (!safe_code(network) || !safe_code(station) || !safe_code(event)) {
+        LOG_WARN(LOG_CAT_SNAPSHOT, "Refusing unsafe job name %s.%s (%s)",
+                 network, station, event);
+        metrics_counter_add(g_failed_metric, 1);
+        return;
+    }
+
+    /* Already extracted: skip if covered, otherwise redo the union */
+    for (i = 0; i < SNAPSHOT_DONE_HISTORY; i++) {
+        const SnapshotJob *done = &g_done[i];
+        if (done->event[0] == '\0' || !same_target(done, network, station, event))
+            continue;
+        if (start >= done->start && end <= done->end)
+            return;
+        if (start <= done->end && end >= done->start) {
+            if (done->start < start)
+                start = done->start;
+            if (done->end > end)
+                end = done->end;
+        }
+    }
+
+    for (i = 0; i < g_job_count; i++) {
+        job = &g_jobs[i];
+        if (same_target(job, network, station, event) &&
+            start <= job->end && end >= job->start) {
+            if (start < job->start)
+                job->start = start;
+            if (end > job->end)
+                job->end = end;
+            return;
+        }
+    }
+
+    if (g_job_count == SNAPSHOT_MAX_JOBS) {
+        LOG_WARN(LOG_CAT_SNAPSHOT, "Queue full, skipping %s.%s", network, station);
+        metrics_counter_add(g_failed_metric, 1);
+        return;
+    }
+
+    job = &g_jobs[g_job_count++];
+    memset(job, 0, sizeof(*job));
+    strncpy(job->network, network, sizeof(job->network) - 1);
+    strncpy(job->station, station, sizeof(job->station) - 1);
+    strncpy(job->event, event, sizeof(job->event) - 1);
+    clean_name(job->network);
+    clean_name(job->station);
+    clean_name(job->event);
+    job->start = start;
+    job->end = end;
+}
+
+/* Directory name for a pick: its event, or pick time and station */
+static void event_label(const char *network, const char *station, double pick_time,
+                        const char *event_id, char *label, size_t len) {
+    if (event_id != NULL && event_id[0] != '\0') {
+        strncpy(label, event_id, len - 1);
+        label[len - 1] = '\0';
+    } else {
+        time_t t = (time_t)pick_time;
+        struct tm tm_info;
+
+        memset(&tm_info, 0, sizeof(tm_info));
+        platform_gmtime(&t, &tm_info);
+        snprintf(label, len, "%04d%02d%02dT%02d%02d%02d_%s.%s",
+                 tm_info.tm_year + 1900, tm_info.tm_mon + 1, tm_info.tm_mday,
+                 tm_info.tm_hour, tm_info.tm_min, tm_info.tm_sec, network, station);
+    }
+    clean_name(label);
+}
+
+void snapshot_enqueue(const char *network, const char *station, double pick_time,
+                      const char *event_id) {
+    char label[80];
+    double start = pick_time - g_config.pre_sec;
+    double end = pick_time + g_config.post_sec;
+    const NeighbourList *list;
+    int i;
+
+    if (!g_started)
+        return;
+
+    event_label(network, station, pick_time, event_id, label, sizeof(label));
+    list = find_neighbours(network, station);
+
+    platform_mutex_lock(&g_lock);
+    add_job(network, station, label, start, end);
+    for (i = 0; list != NULL && i < list->count; i++) {
+        char net[8], sta[8];
+        const char *dot = strchr(list->neighbours[i], '.');
+        size_t n;
+
+        if (dot == NULL || (n = (size_t)(dot - list->neighbours[i])) >= sizeof(net))
+            continue;
+        memcpy(net, list->neighbours[i], n);
+        net[n] = '\0';
+        strncpy(sta, dot + 1, sizeof(sta) - 1);
+        sta[sizeof(sta) - 1] = '\0';
+        add_job(net, sta, label, start, end);
+    }
+    metrics_gauge_set(g_pending_metric, (double)g_job_count);
+    platform_cond_signal(&g_cond);
+    platform_mutex_unlock(&g_lock);
+}
+
+/* ============================================================================
+ * EXTRACTION
+ * ============================================================================ */
+
+/* Idle CPU and I/O class: snapshots must never compete with ingest */
+static void lower_priority(void) {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#elif defined(__linux__)
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+
+    setpriority(PRIO_PROCESS, (id_t)tid, 19);      /* Per thread on Linux */
+    #ifdef SYS_ioprio_set
+    syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, tid, 3 << 13 /* IOPRIO_CLASS_IDLE */);
+    #endif
+#endif
+}
+
+static int write_all(int fd, const char *buffer, size_t len) {
+    while (len > 0) {
+#ifdef _WIN32
+        int n = _write(fd, buffer, (unsigned int)len);
+#else
+        ssize_t n = write(fd, buffer, len);
+#endif
+        if (n <= 0)
+            return -1;
+        buffer += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int copy_extent(int in, int out, long long offset, long long len) {
+    char buffer[65536];
+
+#if defined(__linux__) && defined(SYS_copy_file_range)
+    /* In-kernel copy, reflinked where the file system supports it */
+    while (len > 0) {
+        long long pos = offset;
+        long n = syscall(SYS_copy_file_range, in, &pos, out, NULL, (size_t)len, 0u);
+        if (n <= 0)
+            break;          /* EXDEV, ENOSYS, ...: copy the rest by hand */
+        offset += n;
+        len -= n;
+    }
+#endif
+
+    while (len > 0) {
+        size_t chunk = len > (long long)sizeof(buffer) ? sizeof(buffer) : (size_t)len;
+#ifdef _WIN32
+        int n;
+        if (_lseeki64(in, offset, SEEK_SET) < 0)
+            return -1;
+        n = _read(in, buffer, (unsigned int)chunk);
+#else
+        ssize_t n = pread(in, buffer, chunk, (off_t)offset);
+#endif
+        if (n <= 0 || write_all(out, buffer, (size_t)n) < 0)
+            return -1;
+        offset += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static int station_filter(const char *network, const char *station,
+                          const char *location, const char *channel, void *ctx) {
+    const SnapshotJob *job = (const SnapshotJob*)ctx;
+
+    (void)location;
+    (void)channel;
+    return strcmp(network, job->network) == 0 && strcmp(station, job->station) == 0;
+}
+
+static void extract_job(const SnapshotJob *job) {
+    RingSelection selection;
+    char dir[1024];
+    char path[1100];
+    char temp[1110];
+    int out, i, rc = 0;
+
+    memset(&selection, 0, sizeof(selection));
+    if (ringclient_select(station_filter, (void*)job, job->start, job->end, &selection) < 0 ||
+        selection.total_bytes == 0) {
+        LOG_WARN(LOG_CAT_SNAPSHOT, "No data for %s.%s (%s)",
+                 job->network, job->station, job->event);
+        ringclient_selection_free(&selection);
+        metrics_counter_add(g_failed_metric, 1);
+        return;
+    }
+
+    snprintf(dir, sizeof(dir), "%s/%s", g_config.dir, job->event);
+    snprintf(path, sizeof(path), "%s/%s.%s.mseed", dir, job->network, job->station);
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+
+    if (config_create_directory(dir) < 0) {
+        ringclient_selection_free(&selection);
+        metrics_counter_add(g_failed_metric, 1);
+        return;
+    }
+#ifdef _WIN32
+    out = _open(temp, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    out = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (out < 0) {
+        LOG_ERROR(LOG_CAT_SNAPSHOT, "Cannot create %s", temp);
+        ringclient_selection_free(&selection);
+        metrics_counter_add(g_failed_metric, 1);
+        return;
+    }
+
+    for (i = 0; i < selection.extent_count && rc == 0; i++) {
+        const RingExtent *extent = &selection.extents[i];
+        rc = copy_extent(selection.fds[extent->file], out, extent->offset, extent->length);
+    }
+#ifdef _WIN32
+    _close(out);
+    if (rc == 0)
+        remove(path);
+#else
+    close(out);
+#endif
+
+    if (rc < 0 || rename(temp, path) != 0) {
+        LOG_ERROR(LOG_CAT_SNAPSHOT, "Failed to write %s", path);
+        remove(temp);
+        metrics_counter_add(g_failed_metric, 1);
+    } else {
+        LOG_INFO(LOG_CAT_SNAPSHOT, "%s: %lld bytes", path, selection.total_bytes);
+        metrics_counter_add(g_jobs_metric, 1);
+        metrics_counter_add(g_bytes_metric, (unsigned long long)selection.total_bytes);
+    }
+    ringclient_selection_free(&selection);
+}
+
+static PLATFORM_THREAD_FUNC(snapshot_thread_func) {
+    (void)arg;
+
+    lower_priority();
+
+    platform_mutex_lock(&g_lock);
+    for (;;) {
+        double now = ringclient_clock();
+        double due = 0.0;
+        int next = -1;
+        int i;
+
+        for (i = 0; i < g_job_count; i++) {
+            double job_due = g_jobs[i].end + SNAPSHOT_SETTLE_SEC;
+            if (next < 0 || job_due < due) {
+                next = i;
+                due = job_due;
+            }
+        }
+
+        /* At shutdown every job runs with the data that is there */
+        if (next >= 0 && (due <= now || !g_running)) {
+            SnapshotJob job = g_jobs[next];
+
+            g_jobs[next] = g_jobs[--g_job_count];
+            g_done[g_done_next] = job;
+            g_done_next = (g_done_next + 1) % SNAPSHOT_DONE_HISTORY;
+            metrics_gauge_set(g_pending_metric, (double)g_job_count);
+            platform_mutex_unlock(&g_lock);
+
+            extract_job(&job);
+
+            platform_mutex_lock(&g_lock);
+            continue;
+        }
+        if (!g_running)
+            break;
+
+        /* The replay clock can run faster than the wall clock: recheck each second */
+        platform_cond_timedwait_ms(&g_cond, &g_lock, next < 0 || due - now > 1.0
+                                   ? 1000 : (unsigned int)((due - now) * 1000.0) + 1);
+    }
+    platform_mutex_unlock(&g_lock);
+
+    PLATFORM_THREAD_RETURN;
+}
+
+int snapshot_start(const SnapshotConfig *config) {
+    g_config = *config;
+
+    if (g_config.neighbours_file[0] != '\0' && load_neighbours(g_config.neighbours_file) < 0)
+        return -1;
+    if (config_create_directory(g_config.dir) < 0)
+        return -1;
+
+    g_jobs = (SnapshotJob*)calloc(SNAPSHOT_MAX_JOBS, sizeof(SnapshotJob));
+    if (g_jobs == NULL)
+        return -1;
+
+    g_jobs_metric = metrics_counter("snapshot_files_total", NULL,
+                                    "Station snapshots written around picks");
+    g_bytes_metric = metrics_counter("snapshot_bytes_total", NULL,
+                                     "miniSEED bytes copied into snapshots");
+    g_failed_metric = metrics_counter("snapshot_failed_total", NULL,
+                                      "Snapshots skipped for lack of data or failed");
+    g_pending_metric = metrics_gauge("snapshot_pending", NULL,
+                                     "Snapshot jobs waiting for their window to complete");
+
+    platform_mutex_init(&g_lock);
+    platform_cond_init(&g_cond);
+    g_running = 1;
+    if (platform_thread_create(&g_thread, snapshot_thread_func, NULL) < 0) {
+        g_running = 0;
+        platform_cond_destroy(&g_cond);
+        platform_mutex_destroy(&g_lock);
+        free(g_jobs);
+        g_jobs = NULL;
+        return -1;
+    }
+    g_started = 1;
+
+    printf("[Snapshot] Saving %ds before to %ds after each pick into %s\n",
+           g_config.pre_sec, g_config.post_sec, g_config.dir);
+    return 0;
+}
+
+void snapshot_stop(void) {
+    int i;
+
+    if (!g_started)
+        return;
+    g_started = 0;
+
+    platform_mutex_lock(&g_lock);
+    g_running = 0;
+    platform_cond_signal(&g_cond);
+    platform_mutex_unlock(&g_lock);
+    platform_thread_join(g_thread);
+
+    platform_cond_destroy(&g_cond);
+    platform_mutex_destroy(&g_lock);
+    free(g_jobs);
+    g_jobs = NULL;
+    g_job_count = 0;
+    for (i = 0; i < g_neighbour_count; i++)
+        free(g_neighbours[i].neighbours);
+    free(g_neighbours);
+    g_neighbours = NULL;
+    g_neighbour_count = 0;
+}
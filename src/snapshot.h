@@ -0,0 +1,37 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/*
+ * Pick-triggered waveform snapshots. Each new pick queues a job that,
+ * once post_sec of data after the pick can have arrived, copies the
+ * window [pick - pre_sec, pick + post_sec] of the picked station (and of
+ * its neighbours, if a neighbours file lists any) out of the ring buffers
+ * into DIR/<event>/NET.STA.mseed, before it ages out of the ring.
+ *
+ * <event> is the pick's event ID, or YYYYMMDDThhmmss_NET.STA of the pick
+ * time. Picks of one station with overlapping windows share a job.
+ *
+ * Records are located through the ring index (record_index must be on)
+ * and copied with copy_file_range() where the kernel offers it, which
+ * shares extents instead of copying on file systems with reflink support.
+ * The worker runs at idle CPU and I/O priority.
+ */
+
+typedef struct {
+    char dir[512];
+    int pre_sec;
+    int post_sec;
+    char neighbours_file[512];      /* "NET.STA NET.STA ..." per line, first is the key */
+} SnapshotConfig;
+
+/* 0 on success */
+int snapshot_start(const SnapshotConfig *config);
+
+/* Queue the snapshot for a pick; safe from any thread. event_id may be NULL */
+void snapshot_enqueue(const char *network, const char *station, double pick_time,
+                      const char *event_id);
+
+/* Runs the jobs still waiting (with whatever data has arrived), then stops */
+void snapshot_stop(void);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,384 @@
+#include "steim.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define STEIM_X86 1
+    #include <immintrin.h>
+    #ifdef _MSC_VER
+        #include <intrin.h>
+        #define STEIM_TARGET(isa)
+    #else
+        #define STEIM_TARGET(isa) __attribute__((target(isa)))
+    #endif
+#endif
+
+#define STEIM_FRAME_SIZE 64
+#define STEIM_MAX_FRAMES 64             /* 4096-byte records; larger ones use the scalar path */
+#define STEIM_MAX_DIFFS (STEIM_MAX_FRAMES * 15 * 7)
+
+static uint32_t read_word(const unsigned char *p, int swap) {
+    return swap
+        ? ((uint32_t)p[3] << 24 | (uint32_t)p[2] << 16 | (uint32_t)p[1] << 8 | p[0])
+        : ((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]);
+}
+
+/* ---- Scalar reference ---- */
+
+/* Sign-extend the bits-wide field of w that starts shift bits from the right */
+static int32_t steim_field(uint32_t w, int shift, int bits) {
+    return (int32_t)(w << (32 - shift - bits)) >> (32 - bits);
+}
+
+/*
+ * Unpack the differences of one Steim word with control code ctrl into
+ * diffs; returns how many (0 for a non-data word, -1 if malformed)
+ */
+static int steim_unpack(uint32_t w, int ctrl, int steim2, int32_t *diffs) {
+    int count;
+    int bits;
+    int i;
+
+    switch (ctrl) {
+    case 1:
+        count = 4;
+        bits = 8;
+        break;
+    case 2:
+        if (!steim2) {
+            count = 2;
+            bits = 16;
+            break;
+        }
+        switch (w >> 30) {
+        case 1: count = 1; bits = 30; break;
+        case 2: count = 2; bits = 15; break;
+        case 3: count = 3; bits = 10; break;
+        default: return -1;
+        }
+        break;
+    case 3:
+        if (!steim2) {
+            count = 1;
+            bits = 32;
+            break;
+        }
+        switch (w >> 30) {
+        case 0: count = 5; bits = 6; break;
+        case 1: count = 6; bits = 5; break;
+        case 2: count = 7; bits = 4; break;
+        default: return -1;
+        }
+        break;
+    default:
+        return 0;
+    }
+
+    if (bits == 32) {
+        diffs[0] = (int32_t)w;
+        return 1;
+    }
+    for (i = 0; i < count; i++)
+        diffs[i] = steim_field(w, (count - 1 - i) * bits, bits);
+    return count;
+}
+
+static int decode_scalar(const unsigned char *data, size_t size, int swap, int steim2,
+                         int32_t *samples, int count, int check) {
+    size_t frames = size / STEIM_FRAME_SIZE;
+    size_t f;
+    int32_t first = 0;
+    int32_t last = 0;
+    int n = 0;
+
+    for (f = 0; f < frames && n < count; f++) {
+        const unsigned char *frame = data + f * STEIM_FRAME_SIZE;
+        uint32_t nibbles = read_word(frame, swap);
+        int w;
+
+        for (w = 1; w < 16 && n < count; w++) {
+            uint32_t word = read_word(frame + 4 * w, swap);
+            int32_t diffs[7];
+            int d = steim_unpack(word, (int)(nibbles >> (30 - 2 * w)) & 3, steim2, diffs);
+            int i;
+
+            if (f == 0 && w <= 2) {
+                /* Forward (X0) and reverse (Xn) integration constants */
+                if (w == 1)
+                    first = (int32_t)word;
+                else
+                    last = (int32_t)word;
+                continue;
+            }
+            if (d < 0)
+                return -1;
+
+            for (i = 0; i < d && n < count; i++) {
+                /* The first difference links to the previous record: X0 replaces it */
+                samples[n] = n == 0 ? first : (int32_t)((uint32_t)samples[n - 1] + (uint32_t)diffs[i]);
+                n++;
+            }
+        }
+    }
+
+    if (check && n > 0 && (n < count || samples[n - 1] != last))
+        return -1;
+    return n;
+}
+
+#ifdef STEIM_X86
+
+/*
+ * Word formats by control code * 4 + dnib (the top two bits of the word,
+ * which Steim1 ignores). Lane i of a word holding count fields of bits
+ * each is (int32_t)(w << left[i]) >> (32 - bits); mul[i] = 1 << left[i]
+ * does the left shift where only SSE4.1 is available. count -1 marks a
+ * reserved combination.
+ */
+typedef struct {
+    uint32_t left[8];
+    uint32_t mul[8];
+    int32_t count;
+    int32_t right;
+} SteimFormat;
+
+#define STEIM_L(c, b, i) ((i) < (c) ? 32 - (b) * ((c) - (i)) : 0)
+#define STEIM_LANES(m, c, b) { m(c, b, 0), m(c, b, 1), m(c, b, 2), m(c, b, 3), \
+                               m(c, b, 4), m(c, b, 5), m(c, b, 6), m(c, b, 7) }
+#define STEIM_M(c, b, i) (1u << STEIM_L(c, b, i))
+#define STEIM_FMT(c, b) { STEIM_LANES(STEIM_L, c, b), STEIM_LANES(STEIM_M, c, b), \
+                          c, (c) > 0 ? 32 - (b) : 0 }
+#define STEIM_NONE { STEIM_LANES(STEIM_L, 0, 0), STEIM_LANES(STEIM_M, 0, 0), 0, 0 }
+#define STEIM_BAD { STEIM_LANES(STEIM_L, 0, 0), STEIM_LANES(STEIM_M, 0, 0), -1, 0 }
+
+static const SteimFormat g_steim1_formats[16] = {
+    STEIM_NONE, STEIM_NONE, STEIM_NONE, STEIM_NONE,
+    STEIM_FMT(4, 8), STEIM_FMT(4, 8), STEIM_FMT(4, 8), STEIM_FMT(4, 8),
+    STEIM_FMT(2, 16), STEIM_FMT(2, 16), STEIM_FMT(2, 16), STEIM_FMT(2, 16),
+    STEIM_FMT(1, 32), STEIM_FMT(1, 32), STEIM_FMT(1, 32), STEIM_FMT(1, 32)
+};
+
+static const SteimFormat g_steim2_formats[16] = {
+    STEIM_NONE, STEIM_NONE, STEIM_NONE, STEIM_NONE,
+    STEIM_FMT(4, 8), STEIM_FMT(4, 8), STEIM_FMT(4, 8), STEIM_FMT(4, 8),
+    STEIM_BAD, STEIM_FMT(1, 30), STEIM_FMT(2, 15), STEIM_FMT(3, 10),
+    STEIM_FMT(5, 6), STEIM_FMT(6, 5), STEIM_FMT(7, 4), STEIM_BAD
+};
+
+/* Format of one data word: control code from the frame's nibbles, dnib from the word */
+static const SteimFormat* word_format(const SteimFormat *formats, uint32_t nibbles, int w,
+                                      uint32_t word) {
+    return &formats[((nibbles >> (30 - 2 * w)) & 3) << 2 | word >> 30];
+}
+
+/*
+ * The unpack loops below store the differences of every data word, with X0
+ * in place of the first one, and stop once count are in. They return how
+ * many were stored (may exceed count) or -1. Each word stores 8 lanes, so
+ * diffs needs 8 spare entries.
+ */
+STEIM_TARGET("sse4.1")
+static int unpack_sse41(const unsigned char *data, size_t size, int swap, int steim2,
+                        int32_t *diffs, int count) {
+    const SteimFormat *formats = steim2 ? g_steim2_formats : g_steim1_formats;
+    size_t frames = size / STEIM_FRAME_SIZE;
+    size_t f;
+    int n = 0;
+
+    for (f = 0; f < frames && n < count; f++) {
+        const unsigned char *frame = data + f * STEIM_FRAME_SIZE;
+        uint32_t nibbles = read_word(frame, swap);
+        int w;
+
+        for (w = f == 0 ? 3 : 1; w < 16 && n < count; w++) {
+            uint32_t word = read_word(frame + 4 * w, swap);
+            const SteimFormat *fmt = word_format(formats, nibbles, w, word);
+            __m128i v = _mm_set1_epi32((int)word);
+            __m128i shift = _mm_cvtsi32_si128(fmt->right);
+            __m128i lo = _mm_mullo_epi32(v, _mm_loadu_si128((const __m128i*)fmt->mul));
+            __m128i hi = _mm_mullo_epi32(v, _mm_loadu_si128((const __m128i*)(fmt->mul + 4)));
+
+            if (fmt->count < 0)
+                return -1;
+            _mm_storeu_si128((__m128i*)(diffs + n), _mm_sra_epi32(lo, shift));
+            _mm_storeu_si128((__m128i*)(diffs + n + 4), _mm_sra_epi32(hi, shift));
+            n += fmt->count;
+        }
+    }
+    if (n > 0)
+        diffs[0] = (int32_t)read_word(data + 4, swap);
+    return n;
+}
+
+STEIM_TARGET("avx2")
+static int unpack_avx2(const unsigned char *data, size_t size, int swap, int steim2,
+                       int32_t *diffs, int count) {
+    const SteimFormat *formats = steim2 ? g_steim2_formats : g_steim1_formats;
+    size_t frames = size / STEIM_FRAME_SIZE;
+    size_t f;
+    int n = 0;
+
+    for (f = 0; f < frames && n < count; f++) {
+        const unsigned char *frame = data + f * STEIM_FRAME_SIZE;
+        uint32_t nibbles = read_word(frame, swap);
+        int w;
+
+        for (w = f == 0 ? 3 : 1; w < 16 && n < count; w++) {
+            uint32_t word = read_word(frame + 4 * w, swap);
+            const SteimFormat *fmt = word_format(formats, nibbles, w, word);
+            __m256i v = _mm256_set1_epi32((int)word);
+
+            if (fmt->count < 0)
+                return -1;
+            v = _mm256_sllv_epi32(v, _mm256_loadu_si256((const __m256i*)fmt->left));
+            v = _mm256_sra_epi32(v, _mm_cvtsi32_si128(fmt->right));
+            _mm256_storeu_si256((__m256i*)(diffs + n), v);
+            n += fmt->count;
+        }
+    }
+    if (n > 0)
+        diffs[0] = (int32_t)read_word(data + 4, swap);
+    return n;
+}
+
+/* samples[i] = diffs[0] + ... + diffs[i] (wrapping), 4 lanes at a time */
+STEIM_TARGET("sse4.1")
+static void prefix_sum_sse41(const int32_t *diffs, int32_t *samples, int count) {
+    __m128i carry = _mm_setzero_si128();
+    uint32_t sum;
+    int i;
+
+    for (i = 0; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(diffs + i));
+
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        _mm_storeu_si128((__m128i*)(samples + i), x);
+        carry = _mm_shuffle_epi32(x, 0xFF);
+    }
+    sum = (uint32_t)_mm_cvtsi128_si32(carry);
+    for (; i < count; i++) {
+        sum += (uint32_t)diffs[i];
+        samples[i] = (int32_t)sum;
+    }
+}
+
+/* The same with 8 lanes: in-lane scans, then the low lane's total into the high one */
+STEIM_TARGET("avx2")
+static void prefix_sum_avx2(const int32_t *diffs, int32_t *samples, int count) {
+    __m256i carry = _mm256_setzero_si256();
+    const __m256i last_lane = _mm256_set1_epi32(7);
+    uint32_t sum;
+    int i;
+
+    for (i = 0; i + 8 <= count; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(diffs + i));
+        __m256i low_total;
+
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+        low_total = _mm256_shuffle_epi32(x, 0xFF);
+        low_total = _mm256_permute2x128_si256(low_total, low_total, 0x08);
+        x = _mm256_add_epi32(x, _mm256_add_epi32(low_total, carry));
+        _mm256_storeu_si256((__m256i*)(samples + i), x);
+        carry = _mm256_permutevar8x32_epi32(x, last_lane);
+    }
+    sum = (uint32_t)_mm_cvtsi128_si32(_mm256_castsi256_si128(carry));
+    for (; i < count; i++) {
+        sum += (uint32_t)diffs[i];
+        samples[i] = (int32_t)sum;
+    }
+}
+
+static int decode_vector(SteimPath path, const unsigned char *data, size_t size, int swap,
+                         int steim2, int32_t *samples, int count, int check) {
+    int32_t diffs[STEIM_MAX_DIFFS + 8];
+    int n;
+
+    if (size > (size_t)STEIM_MAX_FRAMES * STEIM_FRAME_SIZE)
+        return decode_scalar(data, size, swap, steim2, samples, count, check);
+
+    n = path == STEIM_PATH_AVX2
+        ? unpack_avx2(data, size, swap, steim2, diffs, count)
+        : unpack_sse41(data, size, swap, steim2, diffs, count);
+    if (n < 0)
+        return -1;
+    if (n > count)
+        n = count;
+
+    if (path == STEIM_PATH_AVX2)
+        prefix_sum_avx2(diffs, samples, n);
+    else
+        prefix_sum_sse41(diffs, samples, n);
+
+    if (check && n > 0 && (n < count || samples[n - 1] != (int32_t)read_word(data + 8, swap)))
+        return -1;
+    return n;
+}
+
+static SteimPath detect_path(void) {
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] >= 7) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) {
+            __cpuid(info, 1);
+            /* AVX2 also needs the OS to save the YMM registers */
+            if ((info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6)
+                return STEIM_PATH_AVX2;
+        }
+    }
+    __cpuid(info, 1);
+    return (info[2] & (1 << 19)) ? STEIM_PATH_SSE41 : STEIM_PATH_SCALAR;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return STEIM_PATH_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return STEIM_PATH_SSE41;
+    return STEIM_PATH_SCALAR;
+#endif
+}
+
+#endif /* STEIM_X86 */
+
+SteimPath steim_best_path(void) {
+#ifdef STEIM_X86
+    static volatile int best = -1;
+
+    /* Racing first calls store the same value */
+    if (best < 0)
+        best = (int)detect_path();
+    return (SteimPath)best;
+#else
+    return STEIM_PATH_SCALAR;
+#endif
+}
+
+const char* steim_path_name(SteimPath path) {
+    switch (path) {
+    case STEIM_PATH_SSE41: return "sse4.1";
+    case STEIM_PATH_AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+int steim_decode_with(SteimPath path, const unsigned char *data, size_t size, int swap,
+                      int steim2, int32_t *samples, int count, int check) {
+    if (count <= 0)
+        return 0;
+    if (path == STEIM_PATH_SCALAR)
+        return decode_scalar(data, size, swap, steim2, samples, count, check);
+#ifdef STEIM_X86
+    if (path <= steim_best_path())
+        return decode_vector(path, data, size, swap, steim2, samples, count, check);
+#endif
+    return -1;
+}
+
+int steim_decode(const unsigned char *data, size_t size, int swap, int steim2,
+                 int32_t *samples, int count, int check) {
+    return steim_decode_with(steim_best_path(), data, size, swap, steim2, samples, count, check);
+}
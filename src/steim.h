@@ -0,0 +1,37 @@
+#ifndef STEIM_H
+#define STEIM_H
+
+/*
+ * Steim1/Steim2 decoding, used by mseed_decode_samples(). The scalar
+ * decoder is the reference; on x86 an SSE4.1 or AVX2 path is chosen at
+ * run time. Those unpack each 32-bit word into up to 7 differences with
+ * one table lookup and two vector shifts, then rebuild the samples with a
+ * vector prefix sum. All paths give identical results.
+ *
+ * data/size: the frames of one record; swap: frames are little-endian
+ * words; check: count is the whole record, so the last sample must equal
+ * the reverse integration constant. Returns the number of samples written
+ * (at most count), or -1 for malformed or failed-check data.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    STEIM_PATH_SCALAR,
+    STEIM_PATH_SSE41,
+    STEIM_PATH_AVX2
+} SteimPath;
+
+int steim_decode(const unsigned char *data, size_t size, int swap, int steim2,
+                 int32_t *samples, int count, int check);
+
+/* Decode with one specific path; -1 if this CPU or build lacks it */
+int steim_decode_with(SteimPath path, const unsigned char *data, size_t size, int swap,
+                      int steim2, int32_t *samples, int count, int check);
+
+/* Fastest path this CPU supports, and a short name for reports */
+SteimPath steim_best_path(void);
+const char* steim_path_name(SteimPath path);
+
+#endif /* STEIM_H */
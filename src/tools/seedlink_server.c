@@ -0,0 +1,150 @@
+/*
+ * seedlink_server - local SeedLink v3 stand-in for load and recovery tests
+ *
+ * Build (from src/):
+ *   cc -O2 -I. -Itools -o seedlink_server tools/seedlink_server.c tools/slserver.c \
+ *      seedlink_proto.c mseed_util.c steim.c netutil.c -lpthread -lm
+ *
+ * Examples:
+ *   seedlink_server --streams 200 --rate 10          # 2000 records/s synthetic
+ *   seedlink_server --file day.mseed --history 5000  # replay, wall-clock times
+ *   seedlink_server --disconnect-after 1000          # exercise reconnect/resume
+ *
+ * Point the client at it with seedlink_server = 127.0.0.1 and the chosen
+ * seedlink_port; stop with Ctrl+C.
+ */
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <windows.h>
+#else
+    #include <signal.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slserver.h"
+#include "platform.h"
+
+static volatile int g_running = 1;
+
+#ifdef _WIN32
+static BOOL WINAPI console_handler(DWORD signal) {
+    if (signal == CTRL_C_EVENT || signal == CTRL_BREAK_EVENT) {
+        g_running = 0;
+        return TRUE;
+    }
+    return FALSE;
+}
+#else
+static void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+#endif
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --host ADDR             Listen address (default 127.0.0.1)\n");
+    printf("  --port N                Listen port (default 18000)\n");
+    printf("  --streams N             Synthetic stations (default 10)\n");
+    printf("  --network NN            Synthetic network code (default XX)\n");
+    printf("  --rate R                Records/s per station, 0 = real time (default 0)\n");
+    printf("  --sample-rate HZ        Synthetic sample rate (default 100)\n");
+    printf("  --history N             Records kept per station for DATA/TIME (default 600)\n");
+    printf("  --max-clients N         Concurrent clients (default 8)\n");
+    printf("  --disconnect-after N    Drop clients after N packets (default never)\n");
+    printf("  --file PATH             Replay records from a miniSEED file (repeatable)\n");
+    printf("  --keep-times            Replay with original record times, once\n");
+    printf("  --stats-interval S      Print rates every S seconds (default 10, 0 = off)\n");
+}
+
+int main(int argc, char **argv) {
+    SlServerConfig config;
+    SlServerStats stats, last;
+    SlServer *server;
+    int stats_interval = 10;
+    int ticks = 0;
+    int i;
+
+    slserver_init_config(&config);
+
+    for (i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if (strcmp(argv[i], "--keep-times") == 0) {
+            config.keep_times = 1;
+            continue;
+        }
+        if (value == NULL) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--host") == 0)
+            strncpy(config.host, value, sizeof(config.host) - 1);
+        else if (strcmp(argv[i], "--port") == 0)
+            config.port = atoi(value);
+        else if (strcmp(argv[i], "--streams") == 0)
+            config.streams = atoi(value);
+        else if (strcmp(argv[i], "--network") == 0)
+            strncpy(config.network, value, sizeof(config.network) - 1);
+        else if (strcmp(argv[i], "--rate") == 0)
+            config.rate = atof(value);
+        else if (strcmp(argv[i], "--sample-rate") == 0)
+            config.sample_rate = atof(value);
+        else if (strcmp(argv[i], "--history") == 0)
+            config.history = atoi(value);
+        else if (strcmp(argv[i], "--max-clients") == 0)
+            config.max_clients = atoi(value);
+        else if (strcmp(argv[i], "--disconnect-after") == 0)
+            config.disconnect_after = atol(value);
+        else if (strcmp(argv[i], "--file") == 0 && config.file_count < SLSERVER_MAX_FILES)
+            config.files[config.file_count++] = value;
+        else if (strcmp(argv[i], "--stats-interval") == 0)
+            stats_interval = atoi(value);
+        else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+#ifdef _WIN32
+    SetConsoleCtrlHandler(console_handler, TRUE);
+#else
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    server = slserver_start(&config);
+    if (server == NULL)
+        return 1;
+
+    memset(&last, 0, sizeof(last));
+    while (g_running) {
+        platform_sleep_ms(1000);
+        if (stats_interval <= 0 || ++ticks < stats_interval)
+            continue;
+        ticks = 0;
+
+        slserver_get_stats(server, &stats);
+        printf("[SLServer] %.0f records/s generated, %.0f packets/s sent, "
+               "%d clients, %llu overruns\n",
+               (double)(stats.generated - last.generated) / stats_interval,
+               (double)(stats.sent - last.sent) / stats_interval,
+               stats.clients, stats.overruns);
+        fflush(stdout);
+        last = stats;
+    }
+
+    printf("[SLServer] Stopping\n");
+    slserver_stop(server);
+    return 0;
+}
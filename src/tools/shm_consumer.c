@@ -0,0 +1,184 @@
+/*
+ * shm_consumer - sample reader for the ringclient shared-memory export
+ *
+ * Build (from src/):
+ *   cc -O2 -I. -o shm_consumer tools/shm_consumer.c shm_reader.c
+ *   (add -lrt on glibc older than 2.34)
+ *
+ * Examples:
+ *   shm_consumer XX.STA1..HHZ                # follow one channel from now on
+ *   shm_consumer --oldest XX.STA1..HHZ XX.STA2.00.BHZ
+ *   shm_consumer --prefix ringclient --quiet XX.STA1..HHZ
+ *
+ * Channels are NET.STA.LOC.CHA as published with shm_export = true. Prints
+ * one line per record with its data latency, then a summary on Ctrl+C.
+ */
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <windows.h>
+#else
+    #include <signal.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shm_reader.h"
+#include "platform.h"
+
+#define MAX_CHANNELS 64
+
+static volatile int g_running = 1;
+
+#ifdef _WIN32
+static BOOL WINAPI console_handler(DWORD signal) {
+    if (signal == CTRL_C_EVENT || signal == CTRL_BREAK_EVENT) {
+        g_running = 0;
+        return TRUE;
+    }
+    return FALSE;
+}
+#else
+static void signal_handler(int sig) {
+    (void)sig;
+    g_running = 0;
+}
+#endif
+
+typedef struct {
+    char channel[32];
+    char name[SHM_RING_NAME_MAX];
+    ShmReader *reader;
+    unsigned long long records;
+} Channel;
+
+static void print_usage(const char *prog) {
+    printf("Usage: %s [options] NET.STA.LOC.CHA...\n", prog);
+    printf("  --prefix NAME           Segment prefix (shm_prefix, default ringclient)\n");
+    printf("  --oldest                Start with the oldest record still in each ring\n");
+    printf("  --quiet                 Only print the summary\n");
+}
+
+/* Split NET.STA.LOC.CHA and build the segment name */
+static int channel_name(const char *prefix, const char *channel, char *name, size_t len) {
+    char net[8], sta[8], loc[8], cha[8];
+    const char *p = channel;
+    char *fields[4] = { net, sta, loc, cha };
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        size_t n = strcspn(p, ".");
+        if (n >= 8 || (i < 3 && p[n] != '.') || (i == 3 && p[n] != '\0'))
+            return -1;
+        memcpy(fields[i], p, n);
+        fields[i][n] = '\0';
+        p += n + (i < 3);
+    }
+
+    shm_ring_name(name, len, prefix, net, sta, loc, cha);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Channel channels[MAX_CHANNELS];
+    const char *prefix = "ringclient";
+    int from_oldest = 0;
+    int quiet = 0;
+    int count = 0;
+    double latency_sum = 0.0;
+    double latency_max = 0.0;
+    unsigned long long total = 0;
+    char record[SHM_RING_RECORD_MAX];
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "--oldest") == 0) {
+            from_oldest = 1;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = 1;
+        } else if (strcmp(argv[i], "--prefix") == 0 && i + 1 < argc) {
+            prefix = argv[++i];
+        } else if (argv[i][0] == '-') {
+            print_usage(argv[0]);
+            return 1;
+        } else if (count < MAX_CHANNELS) {
+            Channel *ch = &channels[count];
+            memset(ch, 0, sizeof(*ch));
+            strncpy(ch->channel, argv[i], sizeof(ch->channel) - 1);
+            if (channel_name(prefix, argv[i], ch->name, sizeof(ch->name)) < 0) {
+                fprintf(stderr, "Bad channel %s, expected NET.STA.LOC.CHA\n", argv[i]);
+                return 1;
+            }
+            count++;
+        }
+    }
+
+    if (count == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+#ifdef _WIN32
+    SetConsoleCtrlHandler(console_handler, TRUE);
+#else
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+#endif
+
+    while (g_running) {
+        int got = 0;
+
+        for (i = 0; i < count; i++) {
+            Channel *ch = &channels[i];
+            ShmRecordInfo info;
+
+            /* Segments appear when the first record of a channel arrives */
+            if (ch->reader == NULL) {
+                ch->reader = shm_reader_open(ch->name, from_oldest);
+                if (ch->reader == NULL)
+                    continue;
+                if (!quiet)
+                    printf("Attached %s\n", ch->name);
+            }
+
+            while (shm_reader_next(ch->reader, record, sizeof(record), &info) == 1) {
+                double latency = platform_time_now() - info.end_time;
+
+                ch->records++;
+                total++;
+                latency_sum += latency;
+                if (latency > latency_max)
+                    latency_max = latency;
+                got = 1;
+
+                if (!quiet)
+                    printf("%s seq=%llu start=%.3f bytes=%u latency=%.3fs\n",
+                           ch->channel, info.sequence, info.start_time,
+                           info.length, latency);
+            }
+        }
+
+        /* A single channel can block on the ring; several are polled */
+        if (!got) {
+            if (count == 1 && channels[0].reader != NULL)
+                shm_reader_wait(channels[0].reader, 500);
+            else
+                platform_sleep_ms(count == 1 ? 500 : 1);
+        }
+    }
+
+    printf("\n%llu records", total);
+    if (total > 0)
+        printf(", data latency avg %.3fs max %.3fs", latency_sum / total, latency_max);
+    printf("\n");
+    for (i = 0; i < count; i++) {
+        printf("  %-20s %llu records, %llu lost\n", channels[i].channel, channels[i].records,
+               channels[i].reader ? shm_reader_lost(channels[i].reader) : 0ULL);
+        shm_reader_close(channels[i].reader);
+    }
+    return 0;
+}
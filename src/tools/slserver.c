@@ -0,0 +1,842 @@
+#include "slserver.h"
+#include "seedlink_proto.h"
+#include "mseed_util.h"
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+
+#define SLSERVER_SEND_BATCH 64
+#define SLSERVER_MAX_SUBS 64
+#define SLSERVER_MAX_SELECTORS 8
+#define SLSERVER_MAX_BURST 100          /* Records per station per generator pass */
+#define SLSERVER_CURSOR_DONE (~0ULL)
+#define SLSERVER_INFO_CHUNK (SLPROTO_RECORD_SIZE - 64)
+
+typedef struct {
+    char record[SLPROTO_RECORD_SIZE];
+    unsigned long seq;
+    double start_time;
+    char location[3];
+    char channel[4];
+} StoredRecord;
+
+typedef struct {
+    char network[3];
+    char station[6];
+    StoredRecord *history;          /* Ring of config.history records */
+    unsigned long long written;     /* Records ever added */
+    unsigned long next_seq;
+    char *replay;                   /* Records loaded from files */
+    int replay_count;
+    int replay_next;
+    double next_emit;               /* Monotonic seconds, 0 = not scheduled */
+    long sample_index;              /* Synthetic waveform position */
+    int exhausted;
+} Station;
+
+typedef struct {
+    char station[16];
+    char network[8];
+    char selectors[SLSERVER_MAX_SELECTORS][16];
+    int selector_count;
+    long start_seq;                 /* -1 = only new records */
+    double begin_time;
+    double end_time;                /* 0 = open ended */
+    int has_time;
+} Subscription;
+
+typedef struct {
+    SlServer *server;
+    NetSocket sock;
+    PlatformThread thread;
+    volatile int finished;
+    Subscription subs[SLSERVER_MAX_SUBS];
+    int sub_count;
+    int batch_mode;
+    int fetch;
+    int uni_station;
+    unsigned long long *cursor;     /* Next history index per station */
+    int *sub_index;                 /* Subscription per station, -1 = none */
+    char *sendbuf;
+    long sent;
+    char inbuf[1024];
+    size_t inused;
+} Client;
+
+struct SlServer {
+    SlServerConfig config;
+    Station *stations;
+    int station_count;
+    PlatformMutex lock;
+    PlatformCond cond;
+    unsigned long long generation;  /* Bumped whenever records are added */
+    double rate;
+    volatile int running;
+    NetSocket listener;
+    PlatformThread accept_thread;
+    PlatformThread generator_thread;
+    Client *clients[SLSERVER_MAX_CLIENTS];
+    double started;
+    volatile unsigned long long generated;
+    volatile unsigned long long sent;
+    volatile unsigned long long overruns;
+    volatile unsigned long long connections;
+    volatile unsigned long long active_clients;
+};
+
+void slserver_init_config(SlServerConfig *config) {
+    memset(config, 0, sizeof(SlServerConfig));
+    config->port = 18000;
+    config->streams = 10;
+    strcpy(config->network, "XX");
+    config->rate = 0.0;
+    config->sample_rate = 100.0;
+    config->history = 600;
+    config->max_clients = 8;
+}
+
+/* ============================================================================
+ * SOURCES
+ * ============================================================================ */
+
+static Station* find_or_add_station(SlServer *server, const char *network, const char *station) {
+    Station *st;
+    int i;
+
+    for (i = 0; i < server->station_count; i++) {
+        if (strcmp(server->stations[i].network, network) == 0 &&
+            strcmp(server->stations[i].station, station) == 0)
+            return &server->stations[i];
+    }
+
+    st = (Station*)realloc(server->stations, (size_t)(server->station_count + 1) * sizeof(Station));
+    if (st == NULL)
+        return NULL;
+    server->stations = st;
+    st = &server->stations[server->station_count++];
+    memset(st, 0, sizeof(*st));
+    strncpy(st->network, network, sizeof(st->network) - 1);
+    strncpy(st->station, station, sizeof(st->station) - 1);
+    st->next_seq = 1;
+    return st;
+}
+
+static int load_file(SlServer *server, const char *path) {
+    char record[SLPROTO_RECORD_SIZE];
+    MSeedHeader hdr;
+    FILE *fp = fopen(path, "rb");
+    long loaded = 0;
+
+    if (fp == NULL) {
+        fprintf(stderr, "[SLServer] Cannot open %s\n", path);
+        return -1;
+    }
+
+    while (fread(record, 1, sizeof(record), fp) == sizeof(record)) {
+        Station *st;
+        char *grown;
+
+        if (mseed_parse_header(record, sizeof(record), &hdr) < 0 ||
+            hdr.record_length != SLPROTO_RECORD_SIZE)
+            continue;
+        st = find_or_add_station(server, hdr.network, hdr.station);
+        if (st == NULL)
+            break;
+        grown = (char*)realloc(st->replay, (size_t)(st->replay_count + 1) * SLPROTO_RECORD_SIZE);
+        if (grown == NULL)
+            break;
+        st->replay = grown;
+        memcpy(st->replay + (size_t)st->replay_count * SLPROTO_RECORD_SIZE, record, sizeof(record));
+        st->replay_count++;
+        loaded++;
+    }
+    fclose(fp);
+
+    printf("[SLServer] Loaded %ld records from %s\n", loaded, path);
+    return loaded > 0 ? 0 : -1;
+}
+
+static int setup_sources(SlServer *server) {
+    char name[8];
+    int i;
+
+    if (server->config.file_count > 0) {
+        for (i = 0; i < server->config.file_count; i++) {
+            if (load_file(server, server->config.files[i]) < 0)
+                return -1;
+        }
+    } else {
+        for (i = 0; i < server->config.streams; i++) {
+            snprintf(name, sizeof(name), "S%04d", i % 10000);
+            if (find_or_add_station(server, server->config.network, name) == NULL)
+                return -1;
+        }
+    }
+
+    for (i = 0; i < server->station_count; i++) {
+        server->stations[i].history =
+            (StoredRecord*)calloc((size_t)server->config.history, sizeof(StoredRecord));
+        if (server->stations[i].history == NULL)
+            return -1;
+    }
+    return server->station_count > 0 ? 0 : -1;
+}
+
+/* Add the next record of a station to its history; returns its time span */
+static double emit_record(SlServer *server, Station *st, double wall_now) {
+    StoredRecord *slot = &st->history[st->written % (unsigned long long)server->config.history];
+    MSeedHeader hdr;
+    double span;
+
+    if (st->replay_count > 0) {
+        memcpy(slot->record, st->replay + (size_t)st->replay_next * SLPROTO_RECORD_SIZE,
+               SLPROTO_RECORD_SIZE);
+        mseed_parse_header(slot->record, SLPROTO_RECORD_SIZE, &hdr);
+        span = hdr.end_time - hdr.start_time;
+        if (!server->config.keep_times)
+            mseed_set_start_time(slot->record, wall_now - span);
+        if (++st->replay_next >= st->replay_count) {
+            st->replay_next = 0;
+            if (server->config.keep_times)
+                st->exhausted = 1;
+        }
+    } else {
+        int32_t samples[(SLPROTO_RECORD_SIZE - 64) / 4];
+        int count = (int)(sizeof(samples) / sizeof(samples[0]));
+        int i;
+
+        span = count / server->config.sample_rate;
+        for (i = 0; i < count; i++) {
+            samples[i] = (int32_t)(2000.0 * sin((st->sample_index + i) * 0.02)) +
+                         (int32_t)((st->sample_index + i) % 7) - 3;
+        }
+        st->sample_index += count;
+        mseed_build_record(slot->record, SLPROTO_RECORD_SIZE, st->network, st->station,
+                           "00", "HHZ", (long)st->next_seq, wall_now - span,
+                           server->config.sample_rate, samples, count);
+    }
+
+    mseed_parse_header(slot->record, SLPROTO_RECORD_SIZE, &hdr);
+    slot->start_time = hdr.start_time;
+    memcpy(slot->location, hdr.location, sizeof(slot->location));
+    memcpy(slot->channel, hdr.channel, sizeof(slot->channel));
+    slot->seq = st->next_seq;
+    st->next_seq = (st->next_seq + 1) & SLPROTO_SEQ_MASK;
+    st->written++;
+
+    return span > 0.0 ? span : 1.0;
+}
+
+static PLATFORM_THREAD_FUNC(generator_thread_func) {
+    SlServer *server = (SlServer*)arg;
+
+    while (server->running) {
+        double now = platform_monotonic_us() / 1e6;
+        double wall = platform_time_now();
+        double earliest = now + 0.05;
+        unsigned long long produced = 0;
+        int i;
+
+        platform_mutex_lock(&server->lock);
+        for (i = 0; i < server->station_count; i++) {
+            Station *st = &server->stations[i];
+            int burst = 0;
+
+            if (st->exhausted)
+                continue;
+            if (st->next_emit == 0.0) {
+                /* Stagger stations across the first interval */
+                double first = server->rate > 0.0 ? 1.0 / server->rate : 1.0;
+                st->next_emit = now + first * i / server->station_count;
+            }
+            while (st->next_emit <= now && burst < SLSERVER_MAX_BURST && !st->exhausted) {
+                double span = emit_record(server, st, wall);
+                st->next_emit += server->rate > 0.0 ? 1.0 / server->rate : span;
+                burst++;
+            }
+            /* Too far behind to catch up: restart the schedule */
+            if (now - st->next_emit > 1.0)
+                st->next_emit = now;
+            produced += (unsigned long long)burst;
+            if (st->next_emit < earliest)
+                earliest = st->next_emit;
+        }
+        if (produced > 0) {
+            server->generation++;
+            platform_cond_broadcast(&server->cond);
+        }
+        platform_mutex_unlock(&server->lock);
+
+        platform_atomic_add_u64(&server->generated, produced);
+
+        earliest -= platform_monotonic_us() / 1e6;
+        if (earliest > 0.0)
+            platform_sleep_ms(earliest > 0.05 ? 50 : (unsigned int)(earliest * 1000.0) + 1);
+    }
+
+    PLATFORM_THREAD_RETURN;
+}
+
+/* ============================================================================
+ * CLIENT PROTOCOL
+ * ============================================================================ */
+
+static int send_text(Client *client, const char *text) {
+    return net_send_all(client->sock, text, strlen(text));
+}
+
+static int send_reply(Client *client, int ok) {
+    if (client->batch_mode)
+        return 0;
+    return send_text(client, ok ? "OK\r\n" : "ERROR\r\n");
+}
+
+/* INFO responses: XML text in ASCII log records, '*' marks continuation */
+static int send_info(Client *client, const char *xml) {
+    char packet[SLPROTO_PACKET_SIZE];
+    size_t len = strlen(xml);
+    size_t offset = 0;
+
+    do {
+        size_t chunk = len - offset > SLSERVER_INFO_CHUNK ? SLSERVER_INFO_CHUNK : len - offset;
+        int last = offset + chunk >= len;
+
+        memcpy(packet, last ? "SLINFO  " : "SLINFO *", SLPROTO_HEADER_SIZE);
+        mseed_build_record(packet + SLPROTO_HEADER_SIZE, SLPROTO_RECORD_SIZE,
+                           "", "INFO", "", "LOG", 0, platform_time_now(), 0.0, NULL, 0);
+        packet[SLPROTO_HEADER_SIZE + 30] = (char)(chunk >> 8);
+        packet[SLPROTO_HEADER_SIZE + 31] = (char)(chunk & 0xFF);
+        packet[SLPROTO_HEADER_SIZE + 52] = 0;       /* ASCII encoding */
+        memcpy(packet + SLPROTO_HEADER_SIZE + 64, xml + offset, chunk);
+
+        if (net_send_all(client->sock, packet, sizeof(packet)) < 0)
+            return -1;
+        offset += chunk;
+    } while (offset < len);
+
+    return 0;
+}
+
+static int handle_info(Client *client, const char *level) {
+    SlServer *server = client->server;
+    size_t size = 256 + (size_t)server->station_count * 96;
+    char *xml = (char*)malloc(size);
+    size_t used;
+    int i, rc;
+
+    if (xml == NULL)
+        return -1;
+
+    used = (size_t)snprintf(xml, size,
+        "<?xml version=\"1.0\"?><seedlink software=\"seedlink_server\" "
+        "organization=\"SeisComP_To_SW_View test server\" started=\"%.0f\">",
+        server->started);
+    if (strcasecmp(level, "STATIONS") == 0 || strcasecmp(level, "STREAMS") == 0) {
+        platform_mutex_lock(&server->lock);
+        for (i = 0; i < server->station_count && used < size; i++) {
+            Station *st = &server->stations[i];
+            used += (size_t)snprintf(xml + used, size - used,
+                "<station name=\"%s\" network=\"%s\" end_seq=\"%06lX\"/>",
+                st->station, st->network, st->next_seq);
+        }
+        platform_mutex_unlock(&server->lock);
+    }
+    if (used < size)
+        snprintf(xml + used, size - used, "</seedlink>");
+
+    rc = send_info(client, xml);
+    free(xml);
+    return rc;
+}
+
+static int handle_cat(Client *client) {
+    SlServer *server = client->server;
+    char line[64];
+    int i;
+
+    for (i = 0; i < server->station_count; i++) {
+        snprintf(line, sizeof(line), "%-2s %-5s test station\r\n",
+                 server->stations[i].network, server->stations[i].station);
+        if (send_text(client, line) < 0)
+            return -1;
+    }
+    return send_text(client, "END");
+}
+
+/* Copy a command argument; -1 if it does not fit, so it is refused, not cut */
+static int copy_arg(char *dst, size_t size, const char *arg) {
+    size_t len = strlen(arg);
+
+    if (len >= size)
+        return -1;
+    memcpy(dst, arg, len + 1);
+    return 0;
+}
+
+static Subscription* current_sub(Client *client) {
+    if (client->sub_count == 0) {
+        /* Uni-station mode: no STATION command, everything is selected */
+        client->uni_station = 1;
+        memset(&client->subs[0], 0, sizeof(Subscription));
+        strcpy(client->subs[0].station, "*");
+        client->subs[0].start_seq = -1;
+        client->sub_count = 1;
+    }
+    return &client->subs[client->sub_count - 1];
+}
+
+/* Returns 0 to keep reading commands, 1 to start streaming, -1 to close */
+static int handle_command(Client *client, const char *line) {
+    SlCommand cmd;
+    Subscription *sub;
+
+    slproto_parse_command(line, &cmd);
+
+    switch (cmd.type) {
+    case SLCMD_HELLO:
+        if (send_text(client, "SeedLink v3.1 (seedlink_server) :: SLPROTO:3.1 CAP NSWILDCARD BATCH\r\n") < 0)
+            return -1;
+        return send_text(client, "SeisComP_To_SW_View test server\r\n") < 0 ? -1 : 0;
+
+    case SLCMD_CAPABILITIES:
+        return send_reply(client, 1) < 0 ? -1 : 0;
+
+    case SLCMD_BATCH:
+        client->batch_mode = 1;
+        return send_text(client, "OK\r\n") < 0 ? -1 : 0;
+
+    case SLCMD_STATION:
+        if (cmd.argc < 1 || client->uni_station || client->sub_count >= SLSERVER_MAX_SUBS)
+            return send_reply(client, 0) < 0 ? -1 : 0;
+        sub = &client->subs[client->sub_count];
+        memset(sub, 0, sizeof(*sub));
+        if (copy_arg(sub->station, sizeof(sub->station), cmd.argv[0]) < 0 ||
+            (cmd.argc > 1 && copy_arg(sub->network, sizeof(sub->network), cmd.argv[1]) < 0))
+            return send_reply(client, 0) < 0 ? -1 : 0;
+        sub->start_seq = -1;
+        client->sub_count++;
+        return send_reply(client, 1) < 0 ? -1 : 0;
+
+    case SLCMD_SELECT:
+        sub = current_sub(client);
+        if (cmd.argc < 1 || sub->selector_count >= SLSERVER_MAX_SELECTORS ||
+            copy_arg(sub->selectors[sub->selector_count], sizeof(sub->selectors[0]),
+                     cmd.argv[0]) < 0)
+            return send_reply(client, 0) < 0 ? -1 : 0;
+        sub->selector_count++;
+        return send_reply(client, 1) < 0 ? -1 : 0;
+
+    case SLCMD_FETCH:
+        client->fetch = 1;
+        /* Fall through */
+    case SLCMD_DATA:
+        sub = current_sub(client);
+        sub->start_seq = cmd.argc > 0 ? slproto_parse_sequence(cmd.argv[0]) : -1;
+        if (cmd.argc > 1 && slproto_parse_time(cmd.argv[1], &sub->begin_time) == 0)
+            sub->has_time = 1;
+        if (client->uni_station)
+            return 1;
+        return send_reply(client, 1) < 0 ? -1 : 0;
+
+    case SLCMD_TIME:
+        sub = current_sub(client);
+        if (cmd.argc < 1 || slproto_parse_time(cmd.argv[0], &sub->begin_time) < 0)
+            return send_reply(client, 0) < 0 ? -1 : 0;
+        sub->has_time = 1;
+        if (cmd.argc > 1)
+            slproto_parse_time(cmd.argv[1], &sub->end_time);
+        if (client->uni_station)
+            return 1;
+        return send_reply(client, 1) < 0 ? -1 : 0;
+
+    case SLCMD_END:
+        return client->sub_count > 0 ? 1 : -1;
+
+    case SLCMD_INFO:
+        return handle_info(client, cmd.argc > 0 ? cmd.argv[0] : "ID") < 0 ? -1 : 0;
+
+    case SLCMD_CAT:
+        return handle_cat(client) < 0 ? -1 : 0;
+
+    case SLCMD_BYE:
+        return -1;
+
+    default:
+        return send_text(client, "ERROR\r\n") < 0 ? -1 : 0;
+    }
+}
+
+/* Read and dispatch whatever commands are pending; mode as handle_command */
+static int read_commands(Client *client, int timeout_ms) {
+    char line[SLPROTO_MAX_LINE];
+    int ready = net_wait_readable(client->sock, timeout_ms);
+    long n;
+    int rc = 0;
+
+    if (ready <= 0)
+        return ready;
+
+    n = net_recv(client->sock, client->inbuf + client->inused,
+                 sizeof(client->inbuf) - client->inused);
+    if (n <= 0)
+        return -1;
+    client->inused += (size_t)n;
+
+    while (rc == 0 && slproto_take_line(client->inbuf, &client->inused, line, sizeof(line)))
+        rc = handle_command(client, line);
+    return rc;
+}
+
+/* Position each station's cursor from its subscription (lock held) */
+static void start_streaming(Client *client) {
+    SlServer *server = client->server;
+    unsigned long long history = (unsigned long long)server->config.history;
+    int i, j;
+
+    for (i = 0; i < server->station_count; i++) {
+        Station *st = &server->stations[i];
+        unsigned long long oldest = st->written > history ? st->written - history : 0;
+        unsigned long long idx;
+        Subscription *sub;
+
+        client->sub_index[i] = -1;
+        client->cursor[i] = st->written;
+        for (j = 0; j < client->sub_count; j++) {
+            if (slproto_match_station(client->subs[j].station, client->subs[j].network,
+                                      st->station, st->network)) {
+                client->sub_index[i] = j;
+                break;
+            }
+        }
+        if (client->sub_index[i] < 0)
+            continue;
+        sub = &client->subs[client->sub_index[i]];
+
+        if (sub->start_seq >= 0 && st->written > oldest) {
+            /* Resume at the requested sequence, or the oldest kept record */
+            unsigned long oldest_seq = st->history[oldest % history].seq;
+            if (slproto_sequence_diff((unsigned long)sub->start_seq, oldest_seq) < 0) {
+                client->cursor[i] = oldest;
+            } else {
+                for (idx = oldest; idx < st->written; idx++) {
+                    if (st->history[idx % history].seq == (unsigned long)sub->start_seq) {
+                        client->cursor[i] = idx;
+                        break;
+                    }
+                }
+            }
+        } else if (sub->has_time) {
+            for (idx = oldest; idx < st->written; idx++) {
+                if (st->history[idx % history].start_time >= sub->begin_time) {
+                    client->cursor[i] = idx;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static int record_selected(const Subscription *sub, const StoredRecord *rec) {
+    int i;
+
+    if (sub->selector_count == 0)
+        return 1;
+    for (i = 0; i < sub->selector_count; i++) {
+        if (slproto_match_selector(sub->selectors[i], rec->location, rec->channel, 'D'))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Copy up to one batch of pending packets into sendbuf (lock held).
+ * Sets *finished when every subscribed time window has closed and
+ * *caught_up when no station has records left to send.
+ */
+static int collect_batch(Client *client, int *finished, int *caught_up) {
+    SlServer *server = client->server;
+    unsigned long long history = (unsigned long long)server->config.history;
+    int count = 0;
+    int open_streams = 0;
+    int windowed = 0;
+    int i;
+
+    *caught_up = 1;
+    for (i = 0; i < server->station_count; i++) {
+        Station *st = &server->stations[i];
+        Subscription *sub;
+
+        if (client->sub_index[i] < 0)
+            continue;
+        sub = &client->subs[client->sub_index[i]];
+        if (sub->has_time && sub->end_time > 0.0)
+            windowed = 1;
+        if (client->cursor[i] == SLSERVER_CURSOR_DONE)
+            continue;
+        open_streams++;
+
+        while (client->cursor[i] < st->written && count < SLSERVER_SEND_BATCH) {
+            StoredRecord *rec;
+            char *packet;
+
+            if (st->written - client->cursor[i] > history) {
+                platform_atomic_add_u64(&server->overruns,
+                                        st->written - history - client->cursor[i]);
+                client->cursor[i] = st->written - history;
+            }
+            rec = &st->history[client->cursor[i] % history];
+            client->cursor[i]++;
+
+            if (sub->has_time && sub->end_time > 0.0 && rec->start_time >= sub->end_time) {
+                client->cursor[i] = SLSERVER_CURSOR_DONE;
+                open_streams--;
+                break;
+            }
+            if (!record_selected(sub, rec))
+                continue;
+
+            packet = client->sendbuf + (size_t)count * SLPROTO_PACKET_SIZE;
+            slproto_format_header(packet, rec->seq);
+            memcpy(packet + SLPROTO_HEADER_SIZE, rec->record, SLPROTO_RECORD_SIZE);
+            count++;
+        }
+        if (client->cursor[i] != SLSERVER_CURSOR_DONE && client->cursor[i] < st->written)
+            *caught_up = 0;
+    }
+
+    *finished = windowed && open_streams == 0;
+    return count;
+}
+
+static PLATFORM_THREAD_FUNC(client_thread_func) {
+    Client *client = (Client*)arg;
+    SlServer *server = client->server;
+    unsigned long long seen_generation = 0;
+    int rc = 0;
+
+    /* Handshake until END (or DATA in uni-station mode) */
+    while (server->running && rc == 0)
+        rc = read_commands(client, 500);
+
+    if (rc == 1) {
+        platform_mutex_lock(&server->lock);
+        start_streaming(client);
+        platform_mutex_unlock(&server->lock);
+    }
+
+    while (server->running && rc >= 0) {
+        int finished = 0, caught_up = 0, count;
+
+        platform_mutex_lock(&server->lock);
+        if (server->generation == seen_generation)
+            platform_cond_timedwait_ms(&server->cond, &server->lock, 200);
+        seen_generation = server->generation;
+        count = collect_batch(client, &finished, &caught_up);
+        platform_mutex_unlock(&server->lock);
+
+        if (count > 0) {
+            if (net_send_all(client->sock, client->sendbuf,
+                             (size_t)count * SLPROTO_PACKET_SIZE) < 0)
+                break;
+            client->sent += count;
+            platform_atomic_add_u64(&server->sent, (unsigned long long)count);
+            if (!caught_up)
+                seen_generation = 0;    /* More pending: do not wait */
+        }
+
+        if (server->config.disconnect_after > 0 && client->sent >= server->config.disconnect_after)
+            break;
+        if (finished || (client->fetch && caught_up && count == 0)) {
+            send_text(client, "END");
+            break;
+        }
+
+        /* INFO keepalives and BYE may arrive while streaming */
+        rc = read_commands(client, 0);
+        if (rc == 1)
+            rc = 0;
+    }
+
+    net_close(client->sock);
+    platform_atomic_add_u64(&server->active_clients, (unsigned long long)-1);
+    client->finished = 1;
+    PLATFORM_THREAD_RETURN;
+}
+
+/* ============================================================================
+ * SERVER
+ * ============================================================================ */
+
+static void free_client(Client *client) {
+    free(client->cursor);
+    free(client->sub_index);
+    free(client->sendbuf);
+    free(client);
+}
+
+static void reap_clients(SlServer *server, int wait_all) {
+    int i;
+
+    for (i = 0; i < SLSERVER_MAX_CLIENTS; i++) {
+        Client *client = server->clients[i];
+        if (client && (client->finished || wait_all)) {
+            platform_thread_join(client->thread);
+            free_client(client);
+            server->clients[i] = NULL;
+        }
+    }
+}
+
+static void accept_client(SlServer *server, NetSocket sock) {
+    Client *client;
+    int active = 0, slot = -1, i;
+
+    reap_clients(server, 0);
+    for (i = 0; i < SLSERVER_MAX_CLIENTS; i++) {
+        if (server->clients[i])
+            active++;
+        else if (slot < 0)
+            slot = i;
+    }
+    if (slot < 0 || active >= server->config.max_clients) {
+        net_close(sock);
+        return;
+    }
+
+    client = (Client*)calloc(1, sizeof(Client));
+    if (client == NULL) {
+        net_close(sock);
+        return;
+    }
+    client->server = server;
+    client->sock = sock;
+    client->cursor = (unsigned long long*)calloc((size_t)server->station_count,
+                                                 sizeof(unsigned long long));
+    client->sub_index = (int*)calloc((size_t)server->station_count, sizeof(int));
+    client->sendbuf = (char*)malloc((size_t)SLSERVER_SEND_BATCH * SLPROTO_PACKET_SIZE);
+    if (client->cursor == NULL || client->sub_index == NULL || client->sendbuf == NULL ||
+        platform_thread_create(&client->thread, client_thread_func, client) < 0) {
+        net_close(sock);
+        free_client(client);
+        return;
+    }
+
+    server->clients[slot] = client;
+    platform_atomic_add_u64(&server->connections, 1);
+    platform_atomic_add_u64(&server->active_clients, 1);
+}
+
+static PLATFORM_THREAD_FUNC(accept_thread_func) {
+    SlServer *server = (SlServer*)arg;
+
+    while (server->running) {
+        NetSocket sock;
+
+        if (net_wait_readable(server->listener, 500) <= 0)
+            continue;
+        sock = net_accept(server->listener);
+        if (sock != NET_INVALID_SOCKET)
+            accept_client(server, sock);
+    }
+
+    PLATFORM_THREAD_RETURN;
+}
+
+static void free_server(SlServer *server) {
+    int i;
+
+    for (i = 0; i < server->station_count; i++) {
+        free(server->stations[i].history);
+        free(server->stations[i].replay);
+    }
+    free(server->stations);
+    free(server);
+}
+
+SlServer* slserver_start(const SlServerConfig *config) {
+    SlServer *server;
+
+    if (config->history <= 0 || config->sample_rate <= 0.0 || net_init() < 0)
+        return NULL;
+
+    server = (SlServer*)calloc(1, sizeof(SlServer));
+    if (server == NULL)
+        return NULL;
+    server->config = *config;
+    server->rate = config->rate;
+    server->started = platform_time_now();
+
+    if (setup_sources(server) < 0) {
+        fprintf(stderr, "[SLServer] No usable stations\n");
+        free_server(server);
+        return NULL;
+    }
+
+    server->listener = net_listen_tcp(config->host, config->port, 16);
+    if (server->listener == NET_INVALID_SOCKET) {
+        fprintf(stderr, "[SLServer] Cannot listen on port %d\n", config->port);
+        free_server(server);
+        return NULL;
+    }
+
+    platform_mutex_init(&server->lock);
+    platform_cond_init(&server->cond);
+    server->running = 1;
+
+    if (platform_thread_create(&server->generator_thread, generator_thread_func, server) < 0) {
+        net_close(server->listener);
+        free_server(server);
+        return NULL;
+    }
+    if (platform_thread_create(&server->accept_thread, accept_thread_func, server) < 0) {
+        server->running = 0;
+        platform_thread_join(server->generator_thread);
+        net_close(server->listener);
+        free_server(server);
+        return NULL;
+    }
+
+    printf("[SLServer] Serving %d stations on port %d\n", server->station_count, config->port);
+    return server;
+}
+
+void slserver_stop(SlServer *server) {
+    if (server == NULL)
+        return;
+
+    server->running = 0;
+    platform_mutex_lock(&server->lock);
+    platform_cond_broadcast(&server->cond);
+    platform_mutex_unlock(&server->lock);
+
+    platform_thread_join(server->accept_thread);
+    platform_thread_join(server->generator_thread);
+    reap_clients(server, 1);
+    net_close(server->listener);
+
+    platform_cond_destroy(&server->cond);
+    platform_mutex_destroy(&server->lock);
+    free_server(server);
+}
+
+void slserver_set_rate(SlServer *server, double rate) {
+    int i;
+
+    platform_mutex_lock(&server->lock);
+    server->rate = rate > 0.0 ? rate : 0.0;
+    for (i = 0; i < server->station_count; i++)
+        server->stations[i].next_emit = 0.0;
+    platform_mutex_unlock(&server->lock);
+}
+
+void slserver_get_stats(SlServer *server, SlServerStats *stats) {
+    stats->generated = platform_atomic_load_u64(&server->generated);
+    stats->sent = platform_atomic_load_u64(&server->sent);
+    stats->overruns = platform_atomic_load_u64(&server->overruns);
+    stats->connections = platform_atomic_load_u64(&server->connections);
+    stats->stations = server->station_count;
+    stats->clients = (int)platform_atomic_load_u64(&server->active_clients);
+}
@@ -0,0 +1,60 @@
+#ifndef SLSERVER_H
+#define SLSERVER_H
+
+/*
+ * Stand-in SeedLink v3 server for end-to-end tests of the client.
+ *
+ * Generates synthetic INT32 streams, or replays 512-byte records from
+ * miniSEED files, at a configurable rate per station. Each station keeps a
+ * short history with its own sequence numbers so DATA <seq>, TIME windows
+ * and FETCH can be used to exercise reconnects, state recovery and
+ * backfill. Records are stamped with the wall clock when they are
+ * generated (unless keep_times is set), so a client's data latency is the
+ * end-to-end latency from generation to write.
+ */
+
+#include "netutil.h"
+
+#define SLSERVER_MAX_FILES 16
+#define SLSERVER_MAX_CLIENTS 32
+
+typedef struct {
+    char host[64];              /* Listen address, empty = 127.0.0.1 */
+    int port;
+    int streams;                /* Synthetic stations when no files are given */
+    char network[3];
+    double rate;                /* Records per second per station, 0 = real time */
+    double sample_rate;         /* Synthetic sample rate (Hz) */
+    int history;                /* Records kept per station */
+    int max_clients;
+    long disconnect_after;      /* Drop a client after N packets, 0 = never */
+    int keep_times;             /* Replay with original times, once */
+    const char *files[SLSERVER_MAX_FILES];
+    int file_count;
+} SlServerConfig;
+
+typedef struct {
+    unsigned long long generated;   /* Records added to station histories */
+    unsigned long long sent;        /* Packets written to clients */
+    unsigned long long overruns;    /* Records a slow client skipped */
+    unsigned long long connections;
+    int clients;                    /* Currently connected */
+    int stations;
+} SlServerStats;
+
+typedef struct SlServer SlServer;
+
+void slserver_init_config(SlServerConfig *config);
+
+/* Load sources, bind and start the generator; NULL on failure */
+SlServer* slserver_start(const SlServerConfig *config);
+
+/* Stop all threads and free the server */
+void slserver_stop(SlServer *server);
+
+/* Change the per-station record rate while running (0 = real time) */
+void slserver_set_rate(SlServer *server, double rate);
+
+void slserver_get_stats(SlServer *server, SlServerStats *stats);
+
+#endif /* SLSERVER_H */
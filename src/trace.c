@@ -0,0 +1,182 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char *name;
+    long long start_us;
+    long long duration_us;
+} TraceEvent;
+
+typedef struct TraceRing {
+    TraceEvent *events;
+    unsigned long long capacity;
+    volatile unsigned long long written;    /* Total spans ever recorded */
+    int tid;
+    char thread_name[32];
+    struct TraceRing *next;
+} TraceRing;
+
+volatile int g_trace_enabled = 0;
+
+static char g_trace_path[512] = "trace.json";
+static int g_events_per_thread = DEFAULT_TRACE_EVENTS_PER_THREAD;
+static PlatformMutex g_trace_lock;
+static TraceRing *g_rings = NULL;
+static int g_next_tid = 1;
+static volatile int g_flush_requested = 0;
+static PLATFORM_THREAD_LOCAL TraceRing *tls_ring = NULL;
+
+void trace_init(const char *path, int events_per_thread) {
+    platform_mutex_init(&g_trace_lock);
+    if (path && path[0])
+        strncpy(g_trace_path, path, sizeof(g_trace_path) - 1);
+    if (events_per_thread > 0)
+        g_events_per_thread = events_per_thread;
+    g_trace_enabled = 1;
+    printf("[Trace] Recording spans, flush to %s\n", g_trace_path);
+}
+
+static TraceRing* thread_ring(void) {
+    TraceRing *ring;
+
+    if (tls_ring)
+        return tls_ring;
+
+    ring = (TraceRing*)calloc(1, sizeof(TraceRing));
+    if (ring == NULL)
+        return NULL;
+    ring->events = (TraceEvent*)calloc((size_t)g_events_per_thread, sizeof(TraceEvent));
+    if (ring->events == NULL) {
+        free(ring);
+        return NULL;
+    }
+    ring->capacity = (unsigned long long)g_events_per_thread;
+
+    platform_mutex_lock(&g_trace_lock);
+    ring->tid = g_next_tid++;
+    snprintf(ring->thread_name, sizeof(ring->thread_name), "thread-%d", ring->tid);
+    ring->next = g_rings;
+    g_rings = ring;
+    platform_mutex_unlock(&g_trace_lock);
+
+    tls_ring = ring;
+    return ring;
+}
+
+void trace_set_thread_name(const char *name) {
+    TraceRing *ring;
+
+    if (!g_trace_enabled)
+        return;
+    ring = thread_ring();
+    if (ring)
+        strncpy(ring->thread_name, name, sizeof(ring->thread_name) - 1);
+}
+
+void trace_record(const char *name, long long start_us) {
+    TraceRing *ring = thread_ring();
+    unsigned long long n;
+    TraceEvent *ev;
+
+    if (ring == NULL)
+        return;
+
+    n = ring->written;
+    ev = &ring->events[n % ring->capacity];
+    ev->name = name;
+    ev->start_us = start_us;
+    ev->duration_us = platform_monotonic_us() - start_us;
+    platform_atomic_store_u64(&ring->written, n + 1);
+}
+
+int trace_flush(void) {
+    char tmp_path[520];
+    FILE *fp;
+    TraceRing *ring;
+    int first = 1;
+    unsigned long long total = 0;
+
+    if (!g_trace_enabled)
+        return 0;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", g_trace_path);
+    fp = fopen(tmp_path, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "[Trace] Failed to open %s\n", tmp_path);
+        return -1;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    platform_mutex_lock(&g_trace_lock);
+    for (ring = g_rings; ring != NULL; ring = ring->next) {
+        unsigned long long end = platform_atomic_load_u64(&ring->written);
+        unsigned long long begin = end > ring->capacity ? end - ring->capacity : 0;
+
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n",
+                ring->tid, ring->thread_name);
+        first = 0;
+
+        for (unsigned long long i = begin; i < end; i++) {
+            TraceEvent ev = ring->events[i % ring->capacity];
+
+            /* Skip slots the owner may have overwritten while we read */
+            if (platform_atomic_load_u64(&ring->written) - i > ring->capacity)
+                continue;
+            if (ev.name == NULL)
+                continue;
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%lld,\"dur\":%lld}",
+                    ev.name, ring->tid, ev.start_us, ev.duration_us);
+            total++;
+        }
+    }
+    platform_mutex_unlock(&g_trace_lock);
+
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+#ifdef _WIN32
+    remove(g_trace_path);
+#endif
+    if (rename(tmp_path, g_trace_path) != 0) {
+        fprintf(stderr, "[Trace] Failed to rename %s to %s\n", tmp_path, g_trace_path);
+        remove(tmp_path);
+        return -1;
+    }
+
+    printf("[Trace] Wrote %llu spans to %s\n", total, g_trace_path);
+    return 0;
+}
+
+void trace_request_flush(void) {
+    g_flush_requested = 1;
+}
+
+void trace_poll(void) {
+    if (g_flush_requested) {
+        g_flush_requested = 0;
+        trace_flush();
+    }
+}
+
+void trace_shutdown(void) {
+    TraceRing *ring, *next;
+
+    if (!g_trace_enabled)
+        return;
+
+    g_trace_enabled = 0;
+    platform_mutex_lock(&g_trace_lock);
+    for (ring = g_rings; ring != NULL; ring = next) {
+        next = ring->next;
+        free(ring->events);
+        free(ring);
+    }
+    g_rings = NULL;
+    platform_mutex_unlock(&g_trace_lock);
+    platform_mutex_destroy(&g_trace_lock);
+}
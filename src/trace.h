@@ -0,0 +1,45 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * Optional span tracing of the hot paths.
+ *
+ * Each thread records complete spans into its own fixed-size ring (oldest
+ * spans are overwritten), so recording never locks or allocates after the
+ * first span of a thread. trace_flush() writes every ring as Chrome Trace
+ * Event JSON, viewable in chrome://tracing or Perfetto. When tracing is
+ * disabled a span costs one branch.
+ */
+
+#include "platform.h"
+
+#define DEFAULT_TRACE_EVENTS_PER_THREAD 65536
+
+extern volatile int g_trace_enabled;
+
+/* Enable tracing; events_per_thread <= 0 uses the default */
+void trace_init(const char *path, int events_per_thread);
+
+/* Label the calling thread in the trace viewer */
+void trace_set_thread_name(const char *name);
+
+/* Record a span that started at start_us (platform_monotonic_us) */
+void trace_record(const char *name, long long start_us);
+
+/* Write all rings to the configured file; safe to call from any thread */
+int trace_flush(void);
+
+/* Request a flush from a signal handler; performed by trace_poll() */
+void trace_request_flush(void);
+void trace_poll(void);
+
+/* Free every ring (after all traced threads stopped) */
+void trace_shutdown(void);
+
+/* name must be a string literal or otherwise outlive the trace */
+#define TRACE_BEGIN(var) \
+    long long var = g_trace_enabled ? platform_monotonic_us() : 0
+#define TRACE_END(var, name) \
+    do { if (var) trace_record(name, var); } while (0)
+
+#endif /* TRACE_H */